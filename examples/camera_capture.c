@@ -10,7 +10,7 @@
 #include "useeplus_camera.h"
 #include <stdio.h>
 #include <stdlib.h>
-#include <windows.h>
+#include <string.h>
 
 #define MAX_BUFFER_SIZE (1024*1024)  // 1MB buffer for JPEG frames
 
@@ -67,12 +67,14 @@ int main(int argc, char *argv[]) {
                devices[i].product_id);
         printf("      Path: %s\n", devices[i].device_path);
         
+#ifdef _WIN32
         // Check if this is the WinUSB interface path (has mi_01)
         if (strstr(devices[i].device_path, "mi_01")) {
             printf("      Type: WinUSB Interface 1 (CORRECT)\n");
         } else {
             printf("      Type: Generic USB (may not work with WinUSB)\n");
         }
+#endif
     }
     printf("\n");
     
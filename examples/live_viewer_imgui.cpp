@@ -263,58 +263,44 @@ static bool UpdateCameraTexture(const unsigned char* jpeg_data, size_t jpeg_size
     return true;
 }
 
-// Camera reading thread
-DWORD WINAPI CameraReadThread(LPVOID param) {
-    unsigned char *temp_buffer = (unsigned char*)malloc(MAX_FRAME_SIZE);
-    if (!temp_buffer) return 1;
-    
-    while (g_running) {
-        size_t bytes_read = 0;
-        int ret = camera_read_frame(g_camera, temp_buffer, MAX_FRAME_SIZE, 
-                                    &bytes_read, 1000);
+// Frame callback (driver dispatch thread) - writes to circular buffer
+void OnCameraFrame(const camera_frame_view_t *frame, void *user_data) {
+    const unsigned char *frame_data = frame->data;
+    size_t bytes_read = frame->size;
+    DWORD capture_time = GetTickCount();
+    DWORD interval = g_last_frame_time ? (capture_time - g_last_frame_time) : 0;
+    
+    // Add frame to circular buffer
+    EnterCriticalSection(&g_frame_lock);
+    if (bytes_read <= MAX_FRAME_SIZE && g_buffer_fill_level < g_smoothing_buffer_size) {
+        // Write to current write position
+        memcpy(g_frame_ring[g_write_pos].data, frame_data, bytes_read);
+        g_frame_ring[g_write_pos].size = bytes_read;
+        g_frame_ring[g_write_pos].filled = true;
         
-        if (ret == CAMERA_SUCCESS && bytes_read > 0) {
-            DWORD capture_time = GetTickCount();
-            DWORD interval = g_last_frame_time ? (capture_time - g_last_frame_time) : 0;
-            
-            // Add frame to circular buffer
-            EnterCriticalSection(&g_frame_lock);
-            if (bytes_read <= MAX_FRAME_SIZE && g_buffer_fill_level < g_smoothing_buffer_size) {
-                // Write to current write position
-                memcpy(g_frame_ring[g_write_pos].data, temp_buffer, bytes_read);
-                g_frame_ring[g_write_pos].size = bytes_read;
-                g_frame_ring[g_write_pos].filled = true;
-                
-                // Advance write position
-                g_write_pos = (g_write_pos + 1) % g_smoothing_buffer_size;
-                
-                // Track buffer fill level
-                if (g_buffer_fill_level < g_smoothing_buffer_size) {
-                    g_buffer_fill_level++;
-                }
-                
-                g_total_frames++;
-                
-                // Log frame capture timing
-                if (g_log_file && g_enable_logging && g_last_frame_time > 0) {
-                    fprintf(g_log_file, "CAPTURE,frame=%u,interval=%lu ms,size=%zu bytes,buffered=%d\n", 
-                            g_total_frames, interval, bytes_read, g_buffer_fill_level);
-                    if (interval > 100) {
-                        fprintf(g_log_file, "WARNING: Long capture interval! %lu ms (buffered frames will smooth this)\n", interval);
-                        fflush(g_log_file);
-                    }
-                }
+        // Advance write position
+        g_write_pos = (g_write_pos + 1) % g_smoothing_buffer_size;
+        
+        // Track buffer fill level
+        if (g_buffer_fill_level < g_smoothing_buffer_size) {
+            g_buffer_fill_level++;
+        }
+        
+        g_total_frames++;
+        
+        // Log frame capture timing
+        if (g_log_file && g_enable_logging && g_last_frame_time > 0) {
+            fprintf(g_log_file, "CAPTURE,frame=%u,interval=%lu ms,size=%zu bytes,buffered=%d\n", 
+                    g_total_frames, interval, bytes_read, g_buffer_fill_level);
+            if (interval > 100) {
+                fprintf(g_log_file, "WARNING: Long capture interval! %lu ms (buffered frames will smooth this)\n", interval);
+                fflush(g_log_file);
             }
-            LeaveCriticalSection(&g_frame_lock);
-            
-            g_last_frame_time = capture_time;
-        } else if (ret == CAMERA_ERROR_TIMEOUT) {
-            continue;
         }
     }
+    LeaveCriticalSection(&g_frame_lock);
     
-    free(temp_buffer);
-    return 0;
+    g_last_frame_time = capture_time;
 }
 
 // Render ImGui controls
@@ -600,8 +586,13 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     }
     printf("Camera opened!\n");
     
+    // Frames are pushed to OnCameraFrame from the driver's dispatch thread,
+    // so a slow copy never holds up USB reads
+    camera_set_frame_callback(g_camera, OnCameraFrame, NULL, CAMERA_CALLBACK_DISPATCHER);
+    
     // Start streaming
     printf("Starting streaming...\n");
+    g_start_time = GetTickCount();
     int ret = camera_start_streaming(g_camera);
     if (ret != CAMERA_SUCCESS) {
         char msg[512];
@@ -616,10 +607,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     }
     printf("Streaming started!\n");
     
-    // Start camera reading thread
-    g_start_time = GetTickCount();
-    HANDLE thread = CreateThread(NULL, 0, CameraReadThread, NULL, 0, NULL);
-    
     // Register window class
     WNDCLASSA wc = {0};
     wc.lpfnWndProc = WindowProc;
@@ -640,7 +627,6 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     if (!hwnd) {
         MessageBoxA(NULL, "Failed to create window", "Error", MB_OK);
         g_running = false;
-        WaitForSingleObject(thread, INFINITE);
         camera_stop_streaming(g_camera);
         camera_close(g_camera);
         for (int i = 0; i < MAX_SMOOTHING_BUFFER_SIZE; i++) {
@@ -704,11 +690,7 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance,
     g_running = false;
     KillTimer(hwnd, DISPLAY_TIMER_ID);
     
-    printf("\nStopping camera thread...\n");
-    WaitForSingleObject(thread, INFINITE);
-    CloseHandle(thread);
-    
-    printf("Stopping streaming...\n");
+    printf("\nStopping streaming...\n");
     camera_stop_streaming(g_camera);
     
     printf("Closing camera...\n");
@@ -23,10 +23,16 @@ extern "C" {
 #include <stdbool.h>
 
 // DLL export/import macros
-#ifdef USEEPLUS_CAMERA_EXPORTS
-    #define CAMERA_API __declspec(dllexport)
+#if defined(_WIN32)
+    #ifdef USEEPLUS_CAMERA_EXPORTS
+        #define CAMERA_API __declspec(dllexport)
+    #else
+        #define CAMERA_API __declspec(dllimport)
+    #endif
+#elif defined(USEEPLUS_CAMERA_EXPORTS)
+    #define CAMERA_API __attribute__((visibility("default")))
 #else
-    #define CAMERA_API __declspec(dllimport)
+    #define CAMERA_API
 #endif
 
 // Camera handle type (opaque pointer)
@@ -42,6 +48,26 @@ typedef void* CAMERA_HANDLE;
 #define CAMERA_ERROR_INVALID_PARAM -6
 #define CAMERA_ERROR_USB_FAILED    -7
 #define CAMERA_ERROR_TIMEOUT       -8
+#define CAMERA_ERROR_DECODE_FAILED -9
+#define CAMERA_ERROR_NOT_SUPPORTED -10
+
+// Bulk reads kept in flight while streaming (see camera_set_transfer_depth)
+#define CAMERA_DEFAULT_TRANSFER_DEPTH  4
+#define CAMERA_MAX_TRANSFER_DEPTH      16
+
+// Frames buffered between the read thread and the application
+// (see camera_set_frame_buffers)
+#define CAMERA_DEFAULT_FRAME_BUFFERS   12
+#define CAMERA_MAX_FRAME_BUFFERS       64
+
+// Which buffered frame a read returns (see camera_set_read_mode)
+#define CAMERA_READ_FIFO    0  // Oldest first, every frame (default)
+#define CAMERA_READ_LATEST  1  // Newest only, older ones skipped
+
+// Largest JPEG frame kept (see camera_set_max_frame_size)
+#define CAMERA_DEFAULT_MAX_FRAME_SIZE  (1024*1024)
+#define CAMERA_MIN_FRAME_SIZE          (4*1024)
+#define CAMERA_MAX_FRAME_SIZE          (16*1024*1024)
 
 // Camera device information
 typedef struct {
@@ -51,6 +77,153 @@ typedef struct {
     char description[128];
 } camera_device_info_t;
 
+// Frame buffer allocation statistics (see camera_get_alloc_stats)
+typedef struct {
+    unsigned int allocations;           // Frame buffers taken from the heap since open
+    unsigned long long allocated_bytes; // Total size of those buffers
+    unsigned int buffers_grown;         // Frames moved to a larger buffer mid-assembly
+} camera_alloc_stats_t;
+
+// Extended streaming statistics (see camera_get_stats_ex)
+#define CAMERA_STATS_VERSION      6
+#define CAMERA_HISTOGRAM_BUCKETS  32
+
+// Durations in log2 buckets of microseconds: buckets[0] counts values below
+// 1 us, buckets[i] values in [2^(i-1), 2^i) us, the last bucket the rest
+typedef struct {
+    unsigned int buckets[CAMERA_HISTOGRAM_BUCKETS];
+    unsigned int count;
+    unsigned int max_us;
+    unsigned long long sum_us;
+} camera_histogram_t;
+
+typedef struct {
+    unsigned int size;                  // Set to sizeof(camera_stats_ex_t) before the call
+    unsigned int version;               // Filled in with CAMERA_STATS_VERSION
+
+    unsigned long long bytes_received;  // Bulk data received since open
+    unsigned long long packets_received;
+    unsigned int bad_header_packets;    // Packets without the AA BB 07 header
+    unsigned int frames_captured;
+    unsigned int frames_discarded;      // Partial frames abandoned when a new frame began
+    unsigned int frames_oversize;       // Frames that exceeded the max frame size
+    unsigned int frames_overflow;       // Frames dropped because every buffer was in use
+    unsigned int read_timeouts;         // Bulk reads that completed with no data
+    unsigned int read_errors;           // Bulk reads that failed
+
+    camera_histogram_t usb_read;         // Wait for each bulk read to complete
+    camera_histogram_t assembly;         // First packet of a frame to its last
+    camera_histogram_t frame_interval;   // Between consecutive completed frames
+    camera_histogram_t consumer_latency; // Frame completed to handed to the application
+
+    // Version 2
+    unsigned int frames_skipped;        // Passed over by CAMERA_READ_LATEST reads
+
+    // Version 3: loss seen in the packet headers' frame and packet counters,
+    // counted only while the headers are consistent with each other
+    unsigned int packets_lost;
+    unsigned int frames_lost;           // Whole frames the camera sent but never arrived
+    unsigned int header_resyncs;        // Times the headers stopped being consistent
+
+    // Version 4
+    unsigned int payloads_copied;       // Packet payloads the read thread copied instead of
+                                        // leaving in their receive buffer
+
+    // Version 5
+    unsigned int thread_attr_failures;  // Thread settings the OS refused (see camera_set_thread_attr)
+
+    // Version 6
+    unsigned int decode_frames_dropped; // Frames the decode threads dropped: by the backpressure
+                                        // policy, or with no memory to queue them
+} camera_stats_ex_t;
+
+// Where frame callbacks run (see camera_set_frame_callback)
+#define CAMERA_CALLBACK_INLINE      0  // On the USB read thread, as each frame completes
+#define CAMERA_CALLBACK_DISPATCHER  1  // On a driver thread fed from the frame buffers
+
+// Frame passed to a frame callback
+typedef struct {
+    const unsigned char *data;          // JPEG data, valid until the callback returns
+    size_t size;                        // JPEG size in bytes
+    unsigned int sequence;              // Frame number since open; gaps are lost frames
+    unsigned long long completed_us;    // Last packet received, monotonic clock in us
+    unsigned long long delivered_us;    // Callback invoked, same clock
+} camera_frame_view_t;
+
+typedef void (*camera_frame_callback_t)(const camera_frame_view_t *frame, void *user_data);
+
+// Driver threads whose scheduling can be set (see camera_set_thread_attr)
+#define CAMERA_THREAD_READ      0  // USB read thread, also runs CAMERA_CALLBACK_INLINE callbacks
+#define CAMERA_THREAD_DISPATCH  1  // Runs CAMERA_CALLBACK_DISPATCHER callbacks, or feeds
+                                   // the decode threads (camera_set_decode_threads)
+
+// Thread priorities
+#define CAMERA_PRIORITY_NORMAL         0
+#define CAMERA_PRIORITY_ABOVE_NORMAL   1
+#define CAMERA_PRIORITY_HIGHEST        2
+#define CAMERA_PRIORITY_TIME_CRITICAL  3
+
+// Scheduling attributes of a driver thread
+typedef struct {
+    int priority;                       // CAMERA_PRIORITY_*
+    bool realtime;                      // MMCSS "Capture" task on Windows, SCHED_FIFO on Linux
+    unsigned long long affinity_mask;   // CPUs the thread may run on, bit n = CPU n; 0 = any
+    char name[32];                      // Shown in debuggers and profilers; empty = driver default
+} camera_thread_attr_t;
+
+// Size of the proprietary header in front of every USB packet
+#define CAMERA_PACKET_HEADER_SIZE  12
+
+// Frame metadata (see camera_read_frame_ex); times in us on the
+// monotonic clock (QueryPerformanceCounter, CLOCK_MONOTONIC)
+typedef struct {
+    unsigned int sequence;              // Frame number since open; gaps are lost frames
+    unsigned int packet_count;          // USB packets the frame arrived in
+    unsigned long long first_packet_us; // First packet of the frame received
+    unsigned long long completed_us;    // Packet with the end marker received
+    unsigned long long delivered_us;    // Handed to the application
+    unsigned char header[CAMERA_PACKET_HEADER_SIZE];  // First packet's header, as received
+} camera_frame_info_t;
+
+// Pixel formats of camera_read_decoded_frame
+#define CAMERA_PIXEL_RGBA  0  // 4 bytes per pixel: R, G, B, 255
+#define CAMERA_PIXEL_BGRA  1  // 4 bytes per pixel: B, G, R, 255 (GDI, GDI+ and Direct3D 32-bit layout)
+#define CAMERA_PIXEL_GRAY  2  // 1 byte per pixel, luma
+#define CAMERA_PIXEL_I420  3  // Planar YUV 4:2:0: Y, then U (Cb), then V (Cr), full range as in JPEG
+
+// Decoded frames the application can hold at once (camera_read_decoded_frame)
+#define CAMERA_MAX_DECODED_FRAMES  4
+
+// Decode threads (camera_set_decode_threads)
+#define CAMERA_MAX_DECODE_THREADS  16
+
+// What the decode threads do when the application falls behind
+#define CAMERA_DECODE_BLOCK        0  // Stop taking frames; the frame buffers fill and drop as usual
+#define CAMERA_DECODE_DROP_OLDEST  1  // Drop the oldest frame not yet read (see camera_set_decode_threads)
+#define CAMERA_DECODE_DROP_NEWEST  2  // Drop the frame just completed
+
+// A decoded frame, valid until camera_release_decoded_frame
+typedef struct {
+    int format;                         // CAMERA_PIXEL_*
+    int width;
+    int height;
+    int scale;                          // Scale-down factor from the camera image: 1, 2, 4 or 8
+    const unsigned char *planes[3];     // Y, U, V for CAMERA_PIXEL_I420; otherwise planes[0] only
+    int strides[3];                     // Bytes per row of each plane (may exceed the visible width)
+    unsigned int sequence;              // Frame number since open, as in camera_frame_info_t
+    unsigned long long completed_us;    // Last packet received, monotonic clock in us
+    unsigned long long decode_us;       // Time spent decoding
+} camera_decoded_frame_t;
+
+// One destination of camera_read_frames
+typedef struct {
+    unsigned char *buffer;              // In: where to copy the frame
+    size_t buffer_size;                 // In: size of buffer
+    size_t size;                        // Out: JPEG size in bytes
+    unsigned int sequence;              // Out: frame number since open, as in camera_frame_view_t
+    unsigned long long completed_us;    // Out: last packet received, monotonic clock in us
+} camera_frame_entry_t;
+
 /**
  * Enumerate connected cameras
  * 
@@ -75,6 +248,22 @@ CAMERA_API CAMERA_HANDLE camera_open(void);
  */
 CAMERA_API CAMERA_HANDLE camera_open_path(const char *device_path);
 
+/**
+ * Open a recorded packet capture as if it were a camera
+ * 
+ * The capture's bulk transfers are fed through the same frame assembly
+ * and ring as live data, so the whole open/stream/read path can run
+ * without hardware. Once the capture is exhausted and all frames have
+ * been read, reads fail with CAMERA_ERROR_NO_FRAME. Each
+ * camera_start_streaming restarts playback from the beginning.
+ * 
+ * @param capture_path Capture file path
+ * @param speed Playback speed: 1.0 = original timing, 2.0 = twice as fast,
+ *              0 = as fast as frames are read
+ * @return Camera handle on success, NULL on failure
+ */
+CAMERA_API CAMERA_HANDLE camera_open_replay(const char *capture_path, double speed);
+
 /**
  * Close the camera and release resources
  * 
@@ -98,6 +287,63 @@ CAMERA_API int camera_start_streaming(CAMERA_HANDLE handle);
  */
 CAMERA_API void camera_stop_streaming(CAMERA_HANDLE handle);
 
+/**
+ * Set how many 64 KiB bulk reads are kept outstanding while streaming
+ * 
+ * With more than one read in flight the endpoint always has a buffer to
+ * fill while the previous one is being parsed. Takes effect on the next
+ * camera_start_streaming. Default is CAMERA_DEFAULT_TRANSFER_DEPTH.
+ * 
+ * @param handle Camera handle
+ * @param depth Number of reads in flight (1 to CAMERA_MAX_TRANSFER_DEPTH)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_transfer_depth(CAMERA_HANDLE handle, int depth);
+
+/**
+ * Set the largest JPEG frame the driver keeps
+ * 
+ * Frame buffers start at 64 KiB and grow on demand up to this size; frames
+ * that grow past it without an end marker are discarded and counted as
+ * oversize (see camera_get_drop_stats). Takes effect on the next
+ * camera_start_streaming. Default is CAMERA_DEFAULT_MAX_FRAME_SIZE.
+ * 
+ * @param handle Camera handle
+ * @param max_bytes Frame size limit (CAMERA_MIN_FRAME_SIZE to CAMERA_MAX_FRAME_SIZE)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_max_frame_size(CAMERA_HANDLE handle, size_t max_bytes);
+
+/**
+ * Set how many completed frames the driver can hold for the application
+ * 
+ * When every buffer is queued or leased, newly completed frames are
+ * dropped and counted as overflow. Takes effect on the next
+ * camera_start_streaming. Default is CAMERA_DEFAULT_FRAME_BUFFERS.
+ * 
+ * @param handle Camera handle
+ * @param count Number of frame buffers (2 to CAMERA_MAX_FRAME_BUFFERS)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_frame_buffers(CAMERA_HANDLE handle, int count);
+
+/**
+ * Choose which buffered frame camera_read_frame / camera_acquire_frame return
+ * 
+ * CAMERA_READ_FIFO returns every frame, oldest first; a reader slower than
+ * the camera sees frames that are up to the buffer count old.
+ * CAMERA_READ_LATEST returns the most recently completed frame and skips
+ * the older ones, for live preview where only the current image matters.
+ * Skipped frames are counted in camera_stats_ex_t.frames_skipped, not as
+ * overflow. Also applies to CAMERA_CALLBACK_DISPATCHER callbacks. Takes
+ * effect on the next read.
+ * 
+ * @param handle Camera handle
+ * @param mode CAMERA_READ_FIFO or CAMERA_READ_LATEST
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_read_mode(CAMERA_HANDLE handle, int mode);
+
 /**
  * Read a complete JPEG frame from the camera
  * This function blocks until a frame is available or timeout occurs
@@ -115,6 +361,245 @@ CAMERA_API int camera_read_frame(CAMERA_HANDLE handle,
                                   size_t *bytes_read,
                                   unsigned int timeout_ms);
 
+/**
+ * Read a frame together with its metadata
+ * 
+ * Same as camera_read_frame, and also fills in info: sequence number,
+ * when the first and last packet arrived and when the frame was handed
+ * over, the number of packets and the raw header of the first packet.
+ * Differences between frames give the capture jitter; gaps in the
+ * sequence are frames lost before the application saw them.
+ * 
+ * @param handle Camera handle
+ * @param buffer Buffer to store JPEG data
+ * @param buffer_size Size of the buffer
+ * @param bytes_read Pointer to store actual bytes read
+ * @param info Receives the frame metadata
+ * @param timeout_ms Timeout in milliseconds (0 = no timeout)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_read_frame_ex(CAMERA_HANDLE handle,
+                                    unsigned char *buffer,
+                                    size_t buffer_size,
+                                    size_t *bytes_read,
+                                    camera_frame_info_t *info,
+                                    unsigned int timeout_ms);
+
+/**
+ * Read every ready frame, up to count, in one call
+ * 
+ * Blocks like camera_read_frame until at least one frame is available,
+ * then copies the queued frames oldest first into the entries under a
+ * single lock acquisition. A consumer that archives every frame wakes
+ * once per burst instead of once per frame.
+ * 
+ * A frame larger than its entry's buffer ends the batch and stays queued;
+ * if that is the first frame the call fails with CAMERA_ERROR_BUFFER_SMALL
+ * and frames[0].size holds the size needed. With CAMERA_READ_LATEST only
+ * the newest frame is returned.
+ * 
+ * @param handle Camera handle
+ * @param frames Destination buffers; size and metadata are filled in
+ * @param count Number of entries in frames
+ * @param frames_read Number of entries filled
+ * @param timeout_ms Timeout for the first frame in milliseconds (0 = no timeout)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_read_frames(CAMERA_HANDLE handle,
+                                  camera_frame_entry_t *frames,
+                                  int count,
+                                  int *frames_read,
+                                  unsigned int timeout_ms);
+
+/**
+ * Acquire the next complete JPEG frame without copying it
+ * 
+ * Returns a read-only pointer into the driver's frame ring. The slot is
+ * reference counted: the driver skips it instead of overwriting it until
+ * camera_release_frame is called, so release frames promptly - while a
+ * slot is leased the ring holds one frame less before dropping.
+ * Frames are consumed in the same order as camera_read_frame.
+ * 
+ * @param handle Camera handle
+ * @param data Receives pointer to the JPEG data (valid until released)
+ * @param size Receives the JPEG size in bytes
+ * @param timeout_ms Timeout in milliseconds (0 = no timeout)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_acquire_frame(CAMERA_HANDLE handle,
+                                     const unsigned char **data,
+                                     size_t *size,
+                                     unsigned int timeout_ms);
+
+/**
+ * Release a frame obtained from camera_acquire_frame
+ * 
+ * All acquired frames must be released before camera_close.
+ * 
+ * @param handle Camera handle
+ * @param data Pointer returned by camera_acquire_frame
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_release_frame(CAMERA_HANDLE handle, const unsigned char *data);
+
+/**
+ * Read the next frame decoded to pixels
+ * 
+ * Takes the next JPEG frame like camera_acquire_frame and decodes it in
+ * the calling thread with libjpeg-turbo, into a buffer the library keeps
+ * and reuses: release the frame with camera_release_decoded_frame to
+ * return the buffer. At most CAMERA_MAX_DECODED_FRAMES frames can be held
+ * at once. Decoding a 4:2:0 frame to CAMERA_PIXEL_I420 copies the planes
+ * as stored, without colour conversion. Frames come out at full size
+ * unless camera_set_decode_size allows a smaller one.
+ * 
+ * With decode threads (camera_set_decode_threads) frames are decoded
+ * ahead in the background and this call only waits for the next one;
+ * format must be the one given to camera_set_decode_threads.
+ * 
+ * A frame that cannot be decoded is consumed and reported with
+ * CAMERA_ERROR_DECODE_FAILED; the next call moves on to the next frame.
+ * Libraries built without libjpeg-turbo return CAMERA_ERROR_NOT_SUPPORTED.
+ * 
+ * @param handle Camera handle
+ * @param format CAMERA_PIXEL_*
+ * @param frame Receives the image and its metadata
+ * @param timeout_ms Timeout in milliseconds (0 = no timeout)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_read_decoded_frame(CAMERA_HANDLE handle,
+                                         int format,
+                                         camera_decoded_frame_t *frame,
+                                         unsigned int timeout_ms);
+
+/**
+ * Decode frames on a pool of background threads
+ * 
+ * While streaming, every completed frame is copied to one of `threads`
+ * decoder threads, each with its own JPEG decompressor, and
+ * camera_read_decoded_frame returns the decoded frames in capture order.
+ * Idle threads take queued frames from busy ones, so a slow frame does
+ * not hold up the others. Up to 2 x threads + CAMERA_MAX_DECODED_FRAMES
+ * frames are in the pipeline; when the application falls behind, policy
+ * decides which are dropped (counted in
+ * camera_stats_ex_t.decode_frames_dropped).
+ * 
+ * CAMERA_DECODE_DROP_OLDEST makes room by dropping the oldest frame not
+ * yet read, whether still waiting for a thread or already decoded (that
+ * decode is then wasted). If a thread is decoding it, the wait for that
+ * decode holds up the next frame; if the application holds it, the new
+ * frame is dropped instead.
+ * 
+ * The threads take every frame, so camera_read_frame and
+ * camera_acquire_frame fail with CAMERA_ERROR_INVALID_PARAM while they
+ * are set.
+ * 
+ * Only while not streaming, with no decoded frames held, and not
+ * together with a frame callback. Takes effect at the next
+ * camera_start_streaming. Libraries built without libjpeg-turbo return
+ * CAMERA_ERROR_NOT_SUPPORTED.
+ * 
+ * @param handle Camera handle
+ * @param threads Decoder threads, 1 to CAMERA_MAX_DECODE_THREADS, or 0 to
+ *                decode in camera_read_decoded_frame (the default)
+ * @param format CAMERA_PIXEL_* to decode to
+ * @param policy CAMERA_DECODE_BLOCK, CAMERA_DECODE_DROP_OLDEST or
+ *               CAMERA_DECODE_DROP_NEWEST
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_decode_threads(CAMERA_HANDLE handle, int threads, int format, int policy);
+
+/**
+ * Set the size decoded frames are displayed at
+ * 
+ * camera_read_decoded_frame then decodes at 1/2, 1/4 or 1/8 of the camera
+ * resolution - whichever is smallest while still at least width x height -
+ * using the JPEG decoder's scaled inverse DCT, so a thumbnail or grid view
+ * costs a fraction of a full decode. Check camera_decoded_frame_t.width
+ * and height for the size delivered. Takes effect from the next frame.
+ * 
+ * @param handle Camera handle
+ * @param width Display width in pixels (0 = no limit from the width)
+ * @param height Display height in pixels (0 = no limit from the height)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_decode_size(CAMERA_HANDLE handle, int width, int height);
+
+/**
+ * Release a frame obtained from camera_read_decoded_frame
+ * 
+ * All decoded frames must be released before camera_close.
+ * 
+ * @param handle Camera handle
+ * @param frame Frame filled in by camera_read_decoded_frame
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_release_decoded_frame(CAMERA_HANDLE handle, const camera_decoded_frame_t *frame);
+
+/**
+ * Have completed frames pushed to a callback instead of read
+ * 
+ * With a callback set, frames are delivered in order to the callback and
+ * camera_read_frame / camera_acquire_frame fail with
+ * CAMERA_ERROR_INVALID_PARAM. Can only be changed while not streaming,
+ * and not set together with decode threads (camera_set_decode_threads).
+ * 
+ * CAMERA_CALLBACK_INLINE calls it on the USB read thread the moment a
+ * frame completes - lowest latency, but the callback must return quickly
+ * (copy the data, signal a thread) or bulk reads stall behind it.
+ * 
+ * CAMERA_CALLBACK_DISPATCHER calls it on a separate driver thread. A slow
+ * callback never delays USB reads; frames wait in the frame buffers
+ * meanwhile and are dropped as overflow when those are full.
+ * 
+ * The callback must not call camera_stop_streaming or camera_close;
+ * camera_stop_streaming waits for a running callback to return.
+ * 
+ * @param handle Camera handle
+ * @param callback Function to call per frame, NULL to go back to reading
+ * @param user_data Passed to the callback unchanged
+ * @param mode CAMERA_CALLBACK_INLINE or CAMERA_CALLBACK_DISPATCHER
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_frame_callback(CAMERA_HANDLE handle,
+                                         camera_frame_callback_t callback,
+                                         void *user_data,
+                                         int mode);
+
+/**
+ * Set the scheduling attributes of a driver thread
+ * 
+ * A busy machine can preempt the USB read thread long enough for the
+ * camera's own frame buffer to overflow. Raising its priority, marking it
+ * realtime or pinning it to a reserved CPU keeps bulk reads flowing.
+ * The realtime hint registers the thread with MMCSS as a "Capture" task
+ * on Windows and switches it to SCHED_FIFO on Linux (which needs
+ * CAP_SYS_NICE or an rtprio limit); priority then selects the level
+ * within that class. Linux keeps only the first 15 characters of a name.
+ * 
+ * Each thread applies its settings as camera_start_streaming creates it,
+ * so they can only be changed while not streaming. A setting the OS
+ * refuses is written to the debug log and counted in
+ * camera_stats_ex_t.thread_attr_failures; the thread runs without it.
+ * By default threads run at normal priority on any CPU.
+ * 
+ * @param handle Camera handle
+ * @param thread CAMERA_THREAD_READ or CAMERA_THREAD_DISPATCH
+ * @param attr Attributes to use
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_set_thread_attr(CAMERA_HANDLE handle, int thread, const camera_thread_attr_t *attr);
+
+/**
+ * Get the scheduling attributes set for a driver thread
+ * 
+ * @param handle Camera handle
+ * @param thread CAMERA_THREAD_READ or CAMERA_THREAD_DISPATCH
+ * @param attr Receives the attributes, with the default name filled in
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_get_thread_attr(CAMERA_HANDLE handle, int thread, camera_thread_attr_t *attr);
+
 /**
  * Get the last error message
  * Thread-safe, returns error for the calling thread
@@ -143,12 +628,114 @@ CAMERA_API int camera_get_stats(CAMERA_HANDLE handle,
                                  unsigned int *frames_captured,
                                  unsigned int *frames_dropped);
 
+/**
+ * Get frame drop counters by cause
+ * 
+ * @param handle Camera handle
+ * @param frames_oversize Frames discarded for exceeding the max frame size
+ * @param frames_overflow Frames dropped because every frame buffer was in use
+ *                        (same as frames_dropped in camera_get_stats)
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_get_drop_stats(CAMERA_HANDLE handle,
+                                     unsigned int *frames_oversize,
+                                     unsigned int *frames_overflow);
+
+/**
+ * Get frame buffer allocation statistics
+ * 
+ * Frame buffers come from a per-camera pool that is filled when streaming
+ * starts and grows by size class when a frame outgrows its buffer. Once
+ * every buffer is large enough for the stream, allocations stays constant
+ * from frame to frame.
+ * 
+ * @param handle Camera handle
+ * @param stats Receives the counters
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_get_alloc_stats(CAMERA_HANDLE handle, camera_alloc_stats_t *stats);
+
+/**
+ * Get extended streaming statistics
+ * 
+ * Counters and histograms accumulate from camera_open and are updated
+ * without locks while streaming, so this is cheap enough to poll every
+ * frame. Fields within a snapshot are not updated atomically together.
+ * 
+ * Set stats->size to sizeof(camera_stats_ex_t) first. Later versions only
+ * append fields; a smaller size receives just the fields it covers.
+ * 
+ * @param handle Camera handle
+ * @param stats Receives the statistics
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_get_stats_ex(CAMERA_HANDLE handle, camera_stats_ex_t *stats);
+
+/**
+ * Start recording every raw bulk packet received to a capture file
+ *
+ * Packets are stamped with their arrival time and written by a background
+ * thread, so recording never stalls the USB read loop. The file can be
+ * played back with camera_open_replay or inspected with capture_stats.
+ * Recording continues across stop/start streaming until
+ * camera_stop_recording or camera_close.
+ *
+ * Recording can also be enabled for every opened camera by setting
+ * environment variable: USEEPLUS_RECORD=path
+ *
+ * @param handle Camera handle
+ * @param path Capture file path, overwritten if it exists
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_start_recording(CAMERA_HANDLE handle, const char *path);
+
+/**
+ * Stop recording and close the capture file
+ *
+ * Packets the background writer could not keep up with are left out of
+ * the file; their number is written to the debug log.
+ *
+ * @param handle Camera handle
+ * @return CAMERA_SUCCESS, or an error code if the file could not be written
+ */
+CAMERA_API int camera_stop_recording(CAMERA_HANDLE handle);
+
+/**
+ * Start tracing pipeline events to a binary trace file
+ *
+ * Records timestamped events for each bulk read, packet, frame start and
+ * end, frame queued, frame handed to the application and frame dropped.
+ * Events are buffered per thread and written by a background thread.
+ * Convert the file with trace_to_json and open the result in a trace
+ * viewer (chrome://tracing or ui.perfetto.dev) to see per-frame timing.
+ *
+ * Tracing can also be enabled for every opened camera (live or replay)
+ * by setting environment variable: USEEPLUS_TRACE=path
+ *
+ * @param handle Camera handle
+ * @param path Trace file path, overwritten if it exists
+ * @return CAMERA_SUCCESS or error code
+ */
+CAMERA_API int camera_start_trace(CAMERA_HANDLE handle, const char *path);
+
+/**
+ * Stop tracing and close the trace file
+ *
+ * @param handle Camera handle
+ * @return CAMERA_SUCCESS, or an error code if the file could not be written
+ */
+CAMERA_API int camera_stop_trace(CAMERA_HANDLE handle);
+
 /**
  * Enable/disable debug logging to file
  * 
  * When enabled, detailed logs are written to 'useeplus_debug.log' in the current directory.
  * This includes USB operations, frame processing, timing information, and error details.
  * 
+ * Messages are queued without locking and written by a background thread
+ * every few milliseconds, so logging barely affects streaming timing.
+ * Disabling logging writes out everything queued before closing the file.
+ * 
  * Logging can also be enabled by setting environment variable: USEEPLUS_DEBUG=1
  * 
  * @param enable true to enable logging, false to disable
@@ -163,6 +750,16 @@ CAMERA_API int camera_set_debug_logging(bool enable);
  */
 CAMERA_API bool camera_is_debug_logging_enabled(void);
 
+/**
+ * Get the number of debug messages dropped
+ * 
+ * A thread that logs faster than the background writer drains its queue
+ * loses messages instead of waiting; each gap is also noted in the log.
+ * 
+ * @return Messages dropped since the process started
+ */
+CAMERA_API unsigned int camera_get_debug_log_dropped(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,333 @@
+/**
+ * Useeplus SuperCamera - Asynchronous Debug Logger
+ *
+ * See async_log.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "async_log.h"
+#include "atomics.h"
+#include "platform.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_MASK   (ASYNC_LOG_RING_ENTRIES - 1)
+#define TEXT_SIZE   (ASYNC_LOG_ENTRY_SIZE - 16)
+#define BATCH_SIZE  (64*1024)
+
+typedef struct log_entry {
+    unsigned long long ticks;   // platform_ticks() at the call
+    unsigned int thread_id;
+    unsigned int length;
+    char text[TEXT_SIZE];
+} log_entry_t;
+
+typedef struct log_ring {
+    struct log_ring *next;          // Registry link, rings are never unlinked
+    unsigned int thread_id;         // Owner, set when claimed
+    atomic32_t abandoned;           // Owner has exited, free to reclaim once empty
+    atomic32_t dropped;             // Written by the owner only
+
+    // Drain thread only
+    uint32_t drain_head;
+    uint32_t dropped_reported;
+
+    // Entry indices, free-running; head is written by the owner only,
+    // tail by the drain thread only
+    char pad0[CACHE_LINE_SIZE];
+    atomic32_t head;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+    atomic32_t tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+
+    log_entry_t entries[ASYNC_LOG_RING_ENTRIES];
+} log_ring_t;
+
+static struct {
+    bool initialized;
+    platform_lock_t *lock;          // Ring registry
+    platform_tls_t *tls;            // Calling thread's ring
+    log_ring_t *rings;
+
+    atomic32_t running;
+    atomic32_t unregistered;        // Messages lost because no ring could be allocated
+    platform_thread_t *drain_thread;
+    platform_event_t *stop_event;
+    FILE *file;
+
+    // Wall-clock time of base_ticks, for converting entry stamps
+    unsigned long long base_ticks;
+    unsigned long long frequency;
+    unsigned long long base_ms;     // Milliseconds since midnight
+
+    // Drain thread only
+    char batch[BATCH_SIZE];
+    size_t batch_used;
+    unsigned int session_dropped;
+} g_log;
+
+// Runs when a thread (or fiber) exits; its ring is drained as usual and
+// handed to the next thread that needs one
+static void PLATFORM_CALLBACK thread_exit(void *data) {
+    log_ring_t *ring = (log_ring_t*)data;
+    if (ring) {
+        atomic32_store_release(&ring->abandoned, 1);
+    }
+}
+
+static log_ring_t* claim_ring(void) {
+    log_ring_t *ring;
+
+    platform_lock_enter(g_log.lock);
+
+    for (ring = g_log.rings; ring; ring = ring->next) {
+        if (atomic32_load_acquire(&ring->abandoned) &&
+            atomic32_load_acquire(&ring->tail) == ring->head) {
+            atomic32_store_release(&ring->abandoned, 0);
+            break;
+        }
+    }
+
+    if (!ring) {
+        ring = (log_ring_t*)calloc(1, sizeof(log_ring_t));
+        if (ring) {
+            ring->next = g_log.rings;
+            g_log.rings = ring;
+        }
+    }
+
+    if (ring) {
+        ring->thread_id = platform_thread_id();
+        platform_tls_set(g_log.tls, ring);
+    }
+
+    platform_lock_leave(g_log.lock);
+    return ring;
+}
+
+// Write the batch buffer out (drain thread)
+static void flush_batch(void) {
+    if (g_log.batch_used > 0) {
+        fwrite(g_log.batch, 1, g_log.batch_used, g_log.file);
+        g_log.batch_used = 0;
+    }
+}
+
+// Append one log line with its time and thread prefix (drain thread)
+static void append_line(unsigned long long ticks, unsigned int thread_id, const char *text, unsigned int length) {
+    unsigned long long delta = ticks > g_log.base_ticks ? ticks - g_log.base_ticks : 0;
+    unsigned long long ms = (g_log.base_ms + delta * 1000 / g_log.frequency) % (24ULL * 3600 * 1000);
+    int n;
+
+    if (BATCH_SIZE - g_log.batch_used < ASYNC_LOG_ENTRY_SIZE + 64) {
+        flush_batch();
+    }
+
+    n = snprintf(g_log.batch + g_log.batch_used, BATCH_SIZE - g_log.batch_used,
+                 "[%02u:%02u:%02u.%03u][TID:%u] %.*s\n",
+                 (unsigned int)(ms / 3600000), (unsigned int)(ms / 60000 % 60),
+                 (unsigned int)(ms / 1000 % 60), (unsigned int)(ms % 1000),
+                 thread_id, (int)length, text);
+    if (n > 0) {
+        g_log.batch_used += (size_t)n;
+    }
+}
+
+// Write every message published so far, oldest first across all threads
+static void drain(void) {
+    log_ring_t *rings, *ring;
+    unsigned long long now;
+
+    // Rings are only ever prepended, so the list from here on is stable
+    platform_lock_enter(g_log.lock);
+    rings = g_log.rings;
+    platform_lock_leave(g_log.lock);
+
+    // Stop at what is there now so a busy thread cannot keep us here
+    for (ring = rings; ring; ring = ring->next) {
+        ring->drain_head = (uint32_t)atomic32_load_acquire(&ring->head);
+    }
+
+    for (;;) {
+        log_ring_t *oldest = NULL;
+        log_entry_t *entry = NULL;
+
+        for (ring = rings; ring; ring = ring->next) {
+            uint32_t tail = (uint32_t)ring->tail;
+            if (tail != ring->drain_head) {
+                log_entry_t *candidate = &ring->entries[tail & RING_MASK];
+                if (!entry || candidate->ticks < entry->ticks) {
+                    oldest = ring;
+                    entry = candidate;
+                }
+            }
+        }
+
+        if (!oldest) {
+            break;
+        }
+
+        append_line(entry->ticks, entry->thread_id, entry->text, entry->length);
+        atomic32_store_release(&oldest->tail, (long)((uint32_t)oldest->tail + 1));
+    }
+
+    // Note drops where they happened, as far as the next wakeup can tell
+    now = platform_ticks();
+    for (ring = rings; ring; ring = ring->next) {
+        uint32_t dropped = (uint32_t)atomic32_load_relaxed(&ring->dropped);
+        if (dropped != ring->dropped_reported) {
+            char note[64];
+            uint32_t count = dropped - ring->dropped_reported;
+            int n = snprintf(note, sizeof(note), "*** %lu debug messages dropped ***", (unsigned long)count);
+            append_line(now, ring->thread_id, note, (unsigned int)n);
+            ring->dropped_reported = dropped;
+            g_log.session_dropped += (unsigned int)count;
+        }
+    }
+
+    flush_batch();
+    fflush(g_log.file);
+}
+
+static void drain_thread_proc(void *param) {
+    (void)param;
+
+    while (platform_event_wait(g_log.stop_event, ASYNC_LOG_FLUSH_INTERVAL) == PLATFORM_WAIT_TIMEOUT) {
+        drain();
+    }
+
+    drain();
+}
+
+bool async_log_start(FILE *file) {
+    platform_local_time_t now;
+    log_ring_t *ring;
+
+    if (!g_log.initialized) {
+        // Created once and kept for the life of the process
+        if (!g_log.tls) {
+            g_log.tls = platform_tls_create(thread_exit);
+        }
+        if (!g_log.stop_event) {
+            g_log.stop_event = platform_event_create(true);
+        }
+        if (!g_log.lock) {
+            g_log.lock = platform_lock_create();
+        }
+        if (!g_log.tls || !g_log.stop_event || !g_log.lock) {
+            return false;
+        }
+        g_log.initialized = true;
+    }
+
+    if (atomic32_load_acquire(&g_log.running)) {
+        return false;
+    }
+
+    // Messages left over from the last session belong to no file
+    platform_lock_enter(g_log.lock);
+    for (ring = g_log.rings; ring; ring = ring->next) {
+        atomic32_store_release(&ring->tail, atomic32_load_acquire(&ring->head));
+        ring->dropped_reported = (uint32_t)atomic32_load_relaxed(&ring->dropped);
+    }
+    platform_lock_leave(g_log.lock);
+
+    g_log.file = file;
+    g_log.batch_used = 0;
+    g_log.session_dropped = 0;
+
+    platform_local_time(&now);
+    g_log.base_ticks = platform_ticks();
+    g_log.frequency = platform_ticks_per_second();
+    g_log.base_ms = ((now.hour * 60ULL + now.minute) * 60 + now.second) * 1000 + now.millisecond;
+
+    platform_event_reset(g_log.stop_event);
+    g_log.drain_thread = platform_thread_create(drain_thread_proc, NULL);
+    if (!g_log.drain_thread) {
+        return false;
+    }
+
+    atomic32_store_release(&g_log.running, 1);
+    return true;
+}
+
+unsigned int async_log_stop(void) {
+    if (!g_log.initialized || !atomic32_load_acquire(&g_log.running)) {
+        return 0;
+    }
+
+    // Calls already past the running check still land in their ring and
+    // are written if the drain below sees them, discarded otherwise
+    atomic32_store_release(&g_log.running, 0);
+
+    platform_event_set(g_log.stop_event);
+    platform_thread_wait(g_log.drain_thread, PLATFORM_WAIT_INFINITE);
+    platform_thread_close(g_log.drain_thread);
+    g_log.drain_thread = NULL;
+    g_log.file = NULL;
+
+    return g_log.session_dropped;
+}
+
+void async_log_write(const char *format, va_list args) {
+    log_ring_t *ring;
+    log_entry_t *entry;
+    uint32_t head, tail;
+    int length;
+
+    if (!atomic32_load_acquire(&g_log.running)) {
+        return;
+    }
+
+    ring = (log_ring_t*)platform_tls_get(g_log.tls);
+    if (!ring) {
+        ring = claim_ring();
+        if (!ring) {
+            atomic32_fetch_add(&g_log.unregistered, 1);
+            return;
+        }
+    }
+
+    head = (uint32_t)ring->head;
+    tail = (uint32_t)atomic32_load_acquire(&ring->tail);
+    if (head - tail >= ASYNC_LOG_RING_ENTRIES) {
+        // Drain thread is behind; never wait for it
+        atomic32_store_relaxed(&ring->dropped, atomic32_load_relaxed(&ring->dropped) + 1);
+        return;
+    }
+
+    entry = &ring->entries[head & RING_MASK];
+    entry->ticks = platform_ticks();
+    entry->thread_id = ring->thread_id;
+
+    length = vsnprintf(entry->text, TEXT_SIZE, format, args);
+    if (length < 0) {
+        length = 0;
+    } else if (length >= TEXT_SIZE) {
+        length = TEXT_SIZE - 1;
+    }
+    entry->length = (unsigned int)length;
+
+    atomic32_store_release(&ring->head, (long)(head + 1));
+}
+
+unsigned int async_log_dropped(void) {
+    unsigned int dropped;
+    log_ring_t *ring;
+
+    if (!g_log.initialized) {
+        return 0;
+    }
+
+    dropped = (unsigned int)atomic32_load_acquire(&g_log.unregistered);
+
+    platform_lock_enter(g_log.lock);
+    for (ring = g_log.rings; ring; ring = ring->next) {
+        dropped += (unsigned int)atomic32_load_relaxed(&ring->dropped);
+    }
+    platform_lock_leave(g_log.lock);
+
+    return dropped;
+}
@@ -0,0 +1,71 @@
+/**
+ * Useeplus SuperCamera - Asynchronous Debug Logger
+ *
+ * Backs debug_log without taking a lock or touching the file on the
+ * calling thread. Each thread that logs gets its own single-producer ring
+ * of fixed-size entries; a message is formatted straight into the next
+ * free entry and stamped with the monotonic clock. A background thread
+ * wakes every ASYNC_LOG_FLUSH_INTERVAL ms, merges the rings in timestamp
+ * order, converts the stamps to wall-clock time and writes the lines in
+ * large batches with one flush per wakeup.
+ *
+ * A thread whose ring is full drops the message and counts it; the drain
+ * thread writes a note with the number dropped into the log in its place.
+ * Messages longer than the entry are truncated.
+ *
+ * Rings are allocated on a thread's first message and recycled once their
+ * thread has exited and they are empty, so memory is bounded by the number
+ * of threads logging at the same time.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef ASYNC_LOG_H
+#define ASYNC_LOG_H
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+
+#define ASYNC_LOG_ENTRY_SIZE      256   // Bytes per message, header included
+#define ASYNC_LOG_RING_ENTRIES    512   // Per thread, power of two
+#define ASYNC_LOG_FLUSH_INTERVAL  20    // Drain thread wakeup, ms
+
+/**
+ * Start draining to a log file
+ *
+ * The file stays owned by the caller, who may write to it before start
+ * and after async_log_stop. Messages logged while stopped are discarded.
+ *
+ * @param file Open log file
+ * @return true on success, false if already started or the drain thread
+ *         could not be created
+ */
+bool async_log_start(FILE *file);
+
+/**
+ * Write out every message logged so far and stop the drain thread
+ *
+ * @return Messages dropped during this session because a ring was full
+ */
+unsigned int async_log_stop(void);
+
+/**
+ * Log one message (any thread, never blocks)
+ *
+ * No-op unless started. The line is prefixed with the time and the
+ * calling thread's id; no newline is needed.
+ *
+ * @param format printf-style format
+ * @param args Arguments
+ */
+void async_log_write(const char *format, va_list args);
+
+/**
+ * Messages dropped since the process started because a ring was full
+ *
+ * @return Dropped message count
+ */
+unsigned int async_log_dropped(void);
+
+#endif // ASYNC_LOG_H
@@ -0,0 +1,121 @@
+/**
+ * Useeplus SuperCamera - Minimal Atomic Operations
+ *
+ * The library is C99 and built with MSVC, which has no <stdatomic.h> in C
+ * mode, so the few atomic operations the lock-free paths need are mapped
+ * onto Interlocked* intrinsics (MSVC) or __atomic builtins (GCC/Clang).
+ *
+ * The relaxed operations are for statistics: counters with a single
+ * writer are updated with a relaxed load and store (no locked
+ * instruction) and may be read from any thread without tearing.
+ *
+ * atomic32_t is 32 bits everywhere (long is 64 bits on LP64 POSIX), so
+ * free-running ring indices wrap alike on both platforms; compute their
+ * differences in uint32_t.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef USEEPLUS_ATOMICS_H
+#define USEEPLUS_ATOMICS_H
+
+#include <stdint.h>
+
+// Size of a cache line, used to keep producer and consumer indices apart
+#define CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+typedef volatile long atomic32_t;
+typedef volatile __int64 atomic64_t;
+
+#if defined(_M_IX86) || defined(_M_X64)
+// x86/x64 loads and stores are already acquire/release; stop the compiler
+// from reordering around them
+#define ATOMIC_ORDER_BARRIER() _ReadWriteBarrier()
+#define ATOMIC_FULL_BARRIER()  _mm_mfence()
+#else
+#define ATOMIC_ORDER_BARRIER() __dmb(_ARM64_BARRIER_ISH)
+#define ATOMIC_FULL_BARRIER()  __dmb(_ARM64_BARRIER_ISH)
+#endif
+
+static __inline long atomic32_load_acquire(atomic32_t *p) {
+    long value = *p;
+    ATOMIC_ORDER_BARRIER();
+    return value;
+}
+
+static __inline void atomic32_store_release(atomic32_t *p, long value) {
+    ATOMIC_ORDER_BARRIER();
+    *p = value;
+}
+
+// Returns the value before the addition
+static __inline long atomic32_fetch_add(atomic32_t *p, long value) {
+    return _InterlockedExchangeAdd(p, value);
+}
+
+static __inline void atomic_fence_full(void) {
+    ATOMIC_FULL_BARRIER();
+}
+
+static __inline long atomic32_load_relaxed(atomic32_t *p) {
+    return __iso_volatile_load32((const volatile __int32*)p);
+}
+
+static __inline void atomic32_store_relaxed(atomic32_t *p, long value) {
+    __iso_volatile_store32((volatile __int32*)p, value);
+}
+
+// Single 64-bit access even on 32-bit x86
+static __inline long long atomic64_load_relaxed(atomic64_t *p) {
+    return __iso_volatile_load64(p);
+}
+
+static __inline void atomic64_store_relaxed(atomic64_t *p, long long value) {
+    __iso_volatile_store64(p, value);
+}
+
+#else // GCC / Clang
+
+typedef int32_t atomic32_t;
+typedef long long atomic64_t __attribute__((aligned(8)));  // i386 aligns long long to 4
+
+static inline long atomic32_load_acquire(atomic32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void atomic32_store_release(atomic32_t *p, long value) {
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+// Returns the value before the addition
+static inline long atomic32_fetch_add(atomic32_t *p, long value) {
+    return __atomic_fetch_add(p, value, __ATOMIC_ACQ_REL);
+}
+
+static inline void atomic_fence_full(void) {
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline long atomic32_load_relaxed(atomic32_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void atomic32_store_relaxed(atomic32_t *p, long value) {
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+}
+
+static inline long long atomic64_load_relaxed(atomic64_t *p) {
+    return __atomic_load_n(p, __ATOMIC_RELAXED);
+}
+
+static inline void atomic64_store_relaxed(atomic64_t *p, long long value) {
+    __atomic_store_n(p, value, __ATOMIC_RELAXED);
+}
+
+#endif
+
+#endif // USEEPLUS_ATOMICS_H
@@ -0,0 +1,112 @@
+/**
+ * Useeplus SuperCamera - Packet Capture File Format
+ *
+ * See capture_file.h for the layout.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "capture_file.h"
+
+#include <string.h>
+
+static unsigned int read_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+           ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static unsigned long long read_u64(const unsigned char *p) {
+    return (unsigned long long)read_u32(p) | ((unsigned long long)read_u32(p + 4) << 32);
+}
+
+static void write_u32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+void capture_encode_file_header(unsigned char *out) {
+    memcpy(out, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE);
+    write_u32(out + 8, CAPTURE_VERSION);
+    write_u32(out + 12, CAPTURE_FILE_HEADER_SIZE);
+}
+
+void capture_encode_record_header(unsigned char *out, unsigned long long timestamp_us, size_t length) {
+    write_u32(out, (unsigned int)timestamp_us);
+    write_u32(out + 4, (unsigned int)(timestamp_us >> 32));
+    write_u32(out + 8, (unsigned int)length);
+}
+
+bool capture_reader_open(capture_reader_t *r, const char *path) {
+    unsigned char header[CAPTURE_FILE_HEADER_SIZE];
+    unsigned int header_size;
+
+    memset(r, 0, sizeof(*r));
+
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        return false;
+    }
+
+    if (fread(header, 1, sizeof(header), r->file) != sizeof(header) ||
+        memcmp(header, CAPTURE_MAGIC, CAPTURE_MAGIC_SIZE) != 0) {
+        capture_reader_close(r);
+        return false;
+    }
+
+    r->version = read_u32(header + 8);
+    header_size = read_u32(header + 12);
+
+    // Newer minor revisions may grow the header; records start after it
+    if (r->version != CAPTURE_VERSION || header_size < CAPTURE_FILE_HEADER_SIZE ||
+        fseek(r->file, (long)header_size, SEEK_SET) != 0) {
+        capture_reader_close(r);
+        return false;
+    }
+
+    r->data_offset = (long)header_size;
+    return true;
+}
+
+int capture_reader_next(capture_reader_t *r, capture_record_t *record,
+                        unsigned char *buffer, size_t capacity) {
+    unsigned char header[CAPTURE_RECORD_HEADER_SIZE];
+    size_t got = fread(header, 1, sizeof(header), r->file);
+    size_t keep;
+
+    if (got == 0 && feof(r->file)) {
+        return CAPTURE_END;
+    }
+    if (got != sizeof(header)) {
+        return CAPTURE_CORRUPT;
+    }
+
+    record->timestamp_us = read_u64(header);
+    record->length = read_u32(header + 8);
+    if (record->length > CAPTURE_MAX_RECORD) {
+        return CAPTURE_CORRUPT;
+    }
+
+    keep = record->length < capacity ? record->length : capacity;
+    if (keep > 0 && fread(buffer, 1, keep, r->file) != keep) {
+        return CAPTURE_CORRUPT;
+    }
+    if (keep < record->length && fseek(r->file, (long)(record->length - keep), SEEK_CUR) != 0) {
+        return CAPTURE_CORRUPT;
+    }
+
+    return CAPTURE_RECORD;
+}
+
+bool capture_reader_rewind(capture_reader_t *r) {
+    clearerr(r->file);
+    return fseek(r->file, r->data_offset, SEEK_SET) == 0;
+}
+
+void capture_reader_close(capture_reader_t *r) {
+    if (r->file) {
+        fclose(r->file);
+        r->file = NULL;
+    }
+}
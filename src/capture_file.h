@@ -0,0 +1,109 @@
+/**
+ * Useeplus SuperCamera - Packet Capture File Format
+ *
+ * A capture holds the raw bulk IN transfers received from the camera, in
+ * order, each stamped with its arrival time. The packet recorder writes
+ * it and the replay transport plays it back instead of talking to the
+ * device; the reader below is also what the capture tools build on.
+ *
+ * Layout (all integers little-endian):
+ *
+ *   File header, 16 bytes
+ *     char[8]  magic        "USEECAP1"
+ *     u32      version      CAPTURE_VERSION
+ *     u32      header_size  Size of this header, records start here
+ *
+ *   Records, repeated until end of file
+ *     u64      timestamp_us Arrival time, microseconds since capture start
+ *     u32      length       Payload bytes that follow
+ *     u8[]     payload      Data of one completed bulk transfer
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#define CAPTURE_MAGIC             "USEECAP1"
+#define CAPTURE_MAGIC_SIZE        8
+#define CAPTURE_VERSION           1
+#define CAPTURE_FILE_HEADER_SIZE  16
+#define CAPTURE_RECORD_HEADER_SIZE 12
+#define CAPTURE_MAX_RECORD        (1024*1024)  // Sanity limit when reading
+
+// Results of capture_reader_next()
+#define CAPTURE_RECORD  1
+#define CAPTURE_END     0
+#define CAPTURE_CORRUPT -1
+
+typedef struct capture_record {
+    unsigned long long timestamp_us;
+    size_t length;          // Payload length as stored in the file
+} capture_record_t;
+
+typedef struct capture_reader {
+    FILE *file;
+    unsigned int version;
+    long data_offset;       // Offset of the first record
+} capture_reader_t;
+
+/**
+ * Encode the file header
+ *
+ * @param out Receives CAPTURE_FILE_HEADER_SIZE bytes
+ */
+void capture_encode_file_header(unsigned char *out);
+
+/**
+ * Encode a record header; the payload follows it directly
+ *
+ * @param out Receives CAPTURE_RECORD_HEADER_SIZE bytes
+ * @param timestamp_us Arrival time in microseconds since capture start
+ * @param length Payload length
+ */
+void capture_encode_record_header(unsigned char *out, unsigned long long timestamp_us, size_t length);
+
+/**
+ * Open a capture file and validate its header
+ *
+ * @param r Reader to initialize
+ * @param path Capture file path
+ * @return true on success
+ */
+bool capture_reader_open(capture_reader_t *r, const char *path);
+
+/**
+ * Read the next record
+ *
+ * Payloads larger than capacity are truncated to capacity; record->length
+ * still reports the stored length.
+ *
+ * @param r Reader
+ * @param record Receives timestamp and length
+ * @param buffer Receives the payload
+ * @param capacity Size of buffer
+ * @return CAPTURE_RECORD, CAPTURE_END or CAPTURE_CORRUPT
+ */
+int capture_reader_next(capture_reader_t *r, capture_record_t *record,
+                        unsigned char *buffer, size_t capacity);
+
+/**
+ * Seek back to the first record
+ *
+ * @param r Reader
+ * @return true on success
+ */
+bool capture_reader_rewind(capture_reader_t *r);
+
+/**
+ * Close the capture file
+ *
+ * @param r Reader
+ */
+void capture_reader_close(capture_reader_t *r);
+
+#endif // CAPTURE_FILE_H
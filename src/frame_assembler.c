@@ -0,0 +1,463 @@
+/**
+ * Useeplus SuperCamera - Frame Assembler
+ *
+ * See frame_assembler.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "frame_assembler.h"
+#include "marker_scan.h"
+
+#include <string.h>
+
+// Check for JPEG SOI marker (FF D8) at the start of a buffer
+static bool starts_with_soi(const unsigned char *data, size_t length) {
+    return length >= 2 && data[0] == 0xFF && data[1] == 0xD8;
+}
+
+// Same for bytes spread over segments
+static bool segments_start_with_soi(const rx_segment_t *segments, int count) {
+    unsigned char head[2];
+    size_t have = 0;
+
+    for (int i = 0; i < count && have < 2; i++) {
+        for (size_t j = 0; j < segments[i].size && have < 2; j++) {
+            head[have++] = segments[i].data[j];
+        }
+    }
+    return starts_with_soi(head, have);
+}
+
+// The frame under construction begins with SOI
+static bool frame_has_soi(const frame_assembler_t *fa) {
+    return fa->gathered ? segments_start_with_soi(fa->segments, fa->segment_count)
+                        : starts_with_soi(fa->data, fa->size);
+}
+
+static void release_segments(const rx_segment_t *segments, int count) {
+    for (int i = 0; i < count; i++) {
+        rx_buffer_unref(segments[i].buffer);
+    }
+}
+
+void frame_assembler_init(frame_assembler_t *fa, size_t max_frame_size) {
+    memset(fa, 0, sizeof(*fa));
+    fa->max_frame_size = max_frame_size;
+}
+
+void frame_assembler_attach(frame_assembler_t *fa, unsigned char *data, size_t capacity) {
+    frame_assembler_attach_gather(fa, data, capacity, NULL, 0);
+}
+
+void frame_assembler_attach_gather(frame_assembler_t *fa, unsigned char *data, size_t capacity,
+                                   rx_segment_t *segments, int max_segments) {
+    // References of a partial frame are dropped against the old storage
+    frame_assembler_reset(fa);
+    fa->data = data;
+    fa->capacity = data ? capacity : 0;
+    fa->segments = segments;
+    fa->max_segments = segments ? max_segments : 0;
+}
+
+void frame_assembler_reset(frame_assembler_t *fa) {
+    release_segments(fa->segments, fa->segment_count);
+    release_segments(fa->carry, fa->carry_count);
+    fa->segment_count = 0;
+    fa->carry_count = 0;
+    fa->gathered = false;
+    fa->size = 0;
+    fa->scan_pos = 0;
+    fa->pending_ff = false;
+    fa->complete_size = 0;
+    fa->deferred = NULL;
+    fa->deferred_size = 0;
+    fa->deferred_buffer = NULL;
+    fa->frame_vouched = false;
+}
+
+// Finish a gathered frame in the frame buffer, which has room for it:
+// segment storage is full, or a payload cannot be referenced
+static void coalesce(frame_assembler_t *fa) {
+    size_t offset = 0;
+
+    for (int i = 0; i < fa->segment_count; i++) {
+        memcpy(fa->data + offset, fa->segments[i].data, fa->segments[i].size);
+        offset += fa->segments[i].size;
+    }
+    release_segments(fa->segments, fa->segment_count);
+    fa->payloads_copied += fa->segment_count;
+    fa->segment_count = 0;
+    fa->gathered = false;
+}
+
+// Add a payload the frame has room for: referenced in its receive buffer
+// while the frame is gathered, copied otherwise
+static void append(frame_assembler_t *fa, rx_buffer_t *buffer,
+                   const unsigned char *payload, size_t size) {
+    if (fa->size == 0) {
+        fa->gathered = buffer && fa->max_segments > 0;
+    } else if (fa->gathered && (!buffer || fa->segment_count == fa->max_segments)) {
+        coalesce(fa);
+    }
+
+    if (fa->gathered) {
+        rx_segment_t *segment = &fa->segments[fa->segment_count++];
+        segment->buffer = buffer;
+        segment->data = payload;
+        segment->size = size;
+        rx_buffer_ref(buffer);
+    } else {
+        memcpy(fa->data + fa->size, payload, size);
+        fa->payloads_copied++;
+    }
+    fa->size += size;
+}
+
+// A frame did not end where the fast path looked; scan everything again
+static void leave_fast_path(frame_assembler_t *fa) {
+    fa->fast_path = false;
+    fa->tail_streak = 0;
+    fa->fast_path_fallbacks++;
+}
+
+// Learn from each completed frame whether EOI sits at a packet tail
+static void note_frame_end(frame_assembler_t *fa) {
+    if (fa->size - fa->complete_size <= FRAME_TAIL_WINDOW) {
+        fa->tail_streak++;
+        if (fa->fast_path_enabled && fa->tail_streak >= FRAME_FAST_PATH_AFTER) {
+            fa->fast_path = true;
+        }
+    } else if (fa->fast_path) {
+        // Ended mid-packet, found by scanning a frame nobody vouched for
+        leave_fast_path(fa);
+    } else {
+        fa->tail_streak = 0;
+    }
+}
+
+// Split a completed gathered frame at the EOI: its segments end there,
+// the bytes after it are kept in carry for the next frame
+static void split_segments(frame_assembler_t *fa) {
+    size_t offset = 0;
+    int last = 0;
+
+    while (offset + fa->segments[last].size < fa->complete_size) {
+        offset += fa->segments[last].size;
+        last++;
+    }
+
+    rx_segment_t *eoi = &fa->segments[last];
+    size_t keep = fa->complete_size - offset;
+    int rest = fa->segment_count - last - 1;    // Segments wholly after the EOI
+    int partial = keep < eoi->size ? 1 : 0;
+
+    fa->carry_count = 0;
+    if (partial + rest <= FRAME_CARRY_SEGMENTS) {
+        if (partial) {
+            rx_segment_t *carry = &fa->carry[fa->carry_count++];
+            carry->buffer = eoi->buffer;
+            carry->data = eoi->data + keep;
+            carry->size = eoi->size - keep;
+            rx_buffer_ref(eoi->buffer);
+        }
+        // Whole segments move over with their reference
+        for (int i = last + 1; i < fa->segment_count; i++) {
+            fa->carry[fa->carry_count++] = fa->segments[i];
+        }
+    } else {
+        // Too much to carry; dropped like leftover data without an SOI
+        release_segments(&fa->segments[last + 1], rest);
+    }
+
+    eoi->size = keep;
+    fa->segment_count = last + 1;
+}
+
+// EOI found: the first complete_size bytes form the frame
+static int frame_complete(frame_assembler_t *fa, size_t complete_size) {
+    fa->complete_size = complete_size;
+    note_frame_end(fa);
+    if (fa->gathered) {
+        split_segments(fa);
+    }
+    return FRAME_ASM_COMPLETE;
+}
+
+// Gather bytes [first, size) of a gathered frame into out
+static const unsigned char* copy_tail(const frame_assembler_t *fa, unsigned char *out, size_t first) {
+    size_t end = fa->size;
+
+    for (int i = fa->segment_count - 1; i >= 0 && end > first; i--) {
+        const rx_segment_t *segment = &fa->segments[i];
+        size_t start = end - segment->size;
+        size_t from = start > first ? start : first;
+
+        memcpy(out + (from - first), segment->data + (from - start), end - from);
+        end = start;
+    }
+    return out;
+}
+
+// Fast path: look for EOI only in the last bytes of the frame so far.
+// Nothing is marked as scanned, so a fallback scan covers the whole frame
+static int scan_tail(frame_assembler_t *fa) {
+    unsigned char window[FRAME_TAIL_WINDOW + 1];
+    size_t size = fa->size;
+    size_t first = size > FRAME_TAIL_WINDOW + 1 ? size - FRAME_TAIL_WINDOW - 1 : 0;
+    const unsigned char *tail = fa->gathered ? copy_tail(fa, window, first) : fa->data + first;
+
+    for (size_t i = first; i + 1 < size; i++) {
+        if (tail[i - first] == 0xFF && tail[i - first + 1] == 0xD9 &&
+            i + 2 >= FRAME_MIN_JPEG_SIZE && frame_has_soi(fa)) {
+            return frame_complete(fa, i + 2);
+        }
+    }
+
+    if (size > fa->max_frame_size) {
+        // Maybe the end went by mid-packet
+        leave_fast_path(fa);
+        return frame_assembler_scan(fa);
+    }
+
+    return FRAME_ASM_NEED_MORE;
+}
+
+void frame_assembler_abandon(frame_assembler_t *fa) {
+    if (fa->size > 0) {
+        frame_assembler_reset(fa);
+        fa->restarts++;
+    }
+}
+
+size_t frame_assembler_required_capacity(const frame_assembler_t *fa,
+                                         const unsigned char *packet, size_t length) {
+    if (length <= FRAME_PACKET_HEADER_SIZE || packet[0] != 0xaa || packet[1] != 0xbb || packet[2] != 0x07) {
+        return 0;
+    }
+
+    size_t payload_size = length - FRAME_PACKET_HEADER_SIZE;
+
+    // A new SOI restarts the frame, data without one is skipped; see
+    // frame_assembler_push
+    if (starts_with_soi(packet + FRAME_PACKET_HEADER_SIZE, payload_size)) {
+        return payload_size;
+    }
+    return fa->size > 0 ? fa->size + payload_size : 0;
+}
+
+void frame_assembler_relocate(frame_assembler_t *fa, unsigned char *data, size_t capacity) {
+    if (fa->size > 0 && !fa->gathered) {
+        memcpy(data, fa->data, fa->size);
+    }
+    fa->data = data;
+    fa->capacity = capacity;
+}
+
+int frame_assembler_push(frame_assembler_t *fa, const unsigned char *packet, size_t length) {
+    return frame_assembler_push_ref(fa, NULL, packet, length);
+}
+
+int frame_assembler_push_ref(frame_assembler_t *fa, rx_buffer_t *buffer,
+                             const unsigned char *packet, size_t length) {
+    // Check for valid packet header (AA BB 07)
+    if (length < 3 || packet[0] != 0xaa || packet[1] != 0xbb || packet[2] != 0x07) {
+        return FRAME_ASM_BAD_HEADER;
+    }
+
+    if (length <= FRAME_PACKET_HEADER_SIZE) {
+        return FRAME_ASM_NEED_MORE;
+    }
+
+    // Extract payload (skip 12-byte header)
+    const unsigned char *payload = packet + FRAME_PACKET_HEADER_SIZE;
+    size_t payload_size = length - FRAME_PACKET_HEADER_SIZE;
+    bool has_soi = starts_with_soi(payload, payload_size);
+
+    // A frame still open on the fast path may have ended mid-packet
+    if (has_soi && fa->size > 0 && fa->fast_path) {
+        leave_fast_path(fa);
+        if (frame_assembler_scan(fa) == FRAME_ASM_COMPLETE) {
+            fa->deferred = payload;
+            fa->deferred_size = payload_size;
+            fa->deferred_buffer = buffer;
+            return FRAME_ASM_COMPLETE;
+        }
+    }
+
+    // New JPEG starting - if we have an incomplete frame, discard it
+    if (has_soi && fa->size > 0) {
+        frame_assembler_reset(fa);
+        fa->restarts++;
+    }
+
+    // Without an SOI at the start the data can never complete a frame, so
+    // skip the rest of a discarded frame until the next one begins
+    if (!has_soi && fa->size == 0) {
+        return FRAME_ASM_NEED_MORE;
+    }
+
+    // Check if we have enough space in current frame
+    if (fa->size + payload_size > fa->capacity) {
+        // Buffer overflow - discard this incomplete frame and start fresh
+        if (fa->fast_path) {
+            leave_fast_path(fa);
+        }
+        frame_assembler_reset(fa);
+
+        // If this packet has SOI, start new frame with it
+        if (has_soi && payload_size <= fa->capacity) {
+            append(fa, buffer, payload, payload_size);
+        }
+        return FRAME_ASM_OVERFLOW;
+    }
+
+    // Take the payload and search only the new bytes; the fast path only
+    // trusts packet tails while headers vouch for every packet of the frame
+    fa->frame_vouched = (fa->size == 0 || fa->frame_vouched) && fa->header_vouched;
+    append(fa, buffer, payload, payload_size);
+
+    return fa->fast_path && fa->frame_vouched ? scan_tail(fa) : frame_assembler_scan(fa);
+}
+
+// Search frame bytes [scan_pos, end) for EOI, where bytes[i - first] is
+// frame byte i. Returns true with scan_pos just past a valid EOI
+static bool scan_span(frame_assembler_t *fa, const unsigned char *bytes, size_t first, size_t end) {
+    size_t i = fa->scan_pos;
+    bool ff = fa->pending_ff;
+
+    // Look for JPEG EOI marker (FF D9), resuming where the last scan stopped.
+    // Bytes between markers are skipped by the vectorized 0xFF search.
+    while (i < end) {
+        if (ff) {
+            unsigned char b = bytes[i++ - first];
+
+            if (b == 0xD9) {
+                // Verify this is a complete valid JPEG (has SOI at start)
+                if (i >= FRAME_MIN_JPEG_SIZE && frame_has_soi(fa)) {
+                    fa->scan_pos = i;
+                    fa->pending_ff = false;
+                    return true;
+                }
+            }
+
+            // Runs of 0xFF fill bytes keep the marker candidate alive
+            ff = (b == 0xFF);
+            continue;
+        }
+
+        i += marker_find_ff(bytes + (i - first), end - i);
+        if (i < end) {
+            ff = true;
+            i++;
+        }
+    }
+
+    fa->scan_pos = i;
+    fa->pending_ff = ff;
+    return false;
+}
+
+int frame_assembler_scan(frame_assembler_t *fa) {
+    if (!fa->gathered) {
+        if (scan_span(fa, fa->data, 0, fa->size)) {
+            return frame_complete(fa, fa->scan_pos);
+        }
+    } else {
+        // A marker split across segments is caught by pending_ff
+        size_t first = 0;
+        for (int i = 0; i < fa->segment_count && fa->scan_pos < fa->size; i++) {
+            size_t end = first + fa->segments[i].size;
+            if (fa->scan_pos < end && scan_span(fa, fa->segments[i].data, first, end)) {
+                return frame_complete(fa, fa->scan_pos);
+            }
+            first = end;
+        }
+    }
+
+    // Safety check: if frame is getting too large without EOI, discard it
+    if (fa->size > fa->max_frame_size) {
+        frame_assembler_reset(fa);
+        return FRAME_ASM_TOO_LARGE;
+    }
+
+    return FRAME_ASM_NEED_MORE;
+}
+
+// Start the next frame with leftover segments if they begin a JPEG,
+// as segments again where the new storage allows
+static void carry_over(frame_assembler_t *fa, const rx_segment_t *carry, int count) {
+    size_t size = 0;
+
+    for (int i = 0; i < count; i++) {
+        size += carry[i].size;
+    }
+
+    if (!fa->data || !segments_start_with_soi(carry, count) || size > fa->capacity) {
+        release_segments(carry, count);
+        return;
+    }
+
+    if (count <= fa->max_segments) {
+        memcpy(fa->segments, carry, count * sizeof(rx_segment_t));
+        fa->segment_count = count;
+        fa->gathered = true;
+    } else {
+        size_t offset = 0;
+        for (int i = 0; i < count; i++) {
+            memcpy(fa->data + offset, carry[i].data, carry[i].size);
+            offset += carry[i].size;
+        }
+        release_segments(carry, count);
+        fa->payloads_copied += count;
+    }
+    fa->size = size;
+}
+
+void frame_assembler_handoff(frame_assembler_t *fa, unsigned char *data, size_t capacity) {
+    frame_assembler_handoff_gather(fa, data, capacity, NULL, 0);
+}
+
+void frame_assembler_handoff_gather(frame_assembler_t *fa, unsigned char *data, size_t capacity,
+                                    rx_segment_t *segments, int max_segments) {
+    const unsigned char *leftover_data = fa->data + fa->complete_size;
+    size_t leftover = fa->size - fa->complete_size;
+    rx_segment_t carry[FRAME_CARRY_SEGMENTS];
+    int carry_count = 0;
+
+    if (fa->deferred) {
+        // After a fast path fallback the next frame is the packet held back
+        leftover_data = fa->deferred;
+        leftover = fa->deferred_size;
+        if (fa->deferred_buffer) {
+            carry[0].buffer = fa->deferred_buffer;
+            carry[0].data = fa->deferred;
+            carry[0].size = fa->deferred_size;
+            rx_buffer_ref(fa->deferred_buffer);
+            carry_count = 1;
+        }
+    } else if (fa->gathered) {
+        // Bytes after the EOI were split off when the frame completed
+        carry_count = fa->carry_count;
+        memcpy(carry, fa->carry, carry_count * sizeof(rx_segment_t));
+        fa->carry_count = 0;
+        leftover = 0;
+    }
+
+    // The completed frame's segments now belong to the caller
+    fa->segment_count = 0;
+    frame_assembler_reset(fa);
+
+    fa->data = data;
+    fa->capacity = data ? capacity : 0;
+    fa->segments = segments;
+    fa->max_segments = segments ? max_segments : 0;
+
+    // Carry over data after EOI, but only if it looks like a JPEG start
+    if (carry_count > 0) {
+        carry_over(fa, carry, carry_count);
+    } else if (data && starts_with_soi(leftover_data, leftover) && leftover <= capacity) {
+        memmove(data, leftover_data, leftover);  // data may be the old buffer
+        fa->size = leftover;
+    }
+}
@@ -0,0 +1,264 @@
+/**
+ * Useeplus SuperCamera - Frame Assembler
+ *
+ * Reassembles complete JPEG frames from the camera's bulk packet stream.
+ * Each USB packet carries a 12-byte proprietary header (AA BB 07 ...)
+ * followed by a slice of JPEG data. Frames start with SOI (FF D8) at the
+ * beginning of a payload and end with EOI (FF D9) somewhere in a payload.
+ *
+ * The EOI search is incremental: every payload byte is inspected exactly
+ * once, and a trailing 0xFF at the end of one packet is remembered so an
+ * EOI marker split across two packets is still found. Marker candidates
+ * are located with the vectorized scanner in marker_scan.h.
+ *
+ * Tail fast path: the camera ends every frame at the end of a packet, and
+ * the next frame starts with SOI at the start of the next packet. Once
+ * FRAME_FAST_PATH_AFTER frames in a row have confirmed that, only the
+ * last FRAME_TAIL_WINDOW bytes of each packet are checked for EOI and the
+ * rest of the payload is not scanned at all - but only for frames whose
+ * every packet the caller has vouched for with header_vouched (a trusted
+ * packet header placed it in the frame). A frame with a packet nobody
+ * vouched for is scanned incrementally as usual, so an EOI that went by
+ * mid-packet, with the next frame run on behind it, is still found.
+ * A frame that does not end at a packet tail shows up as an SOI arriving
+ * (or the size limit reached) with a frame still open, or as a frame
+ * completing mid-packet; the open frame is then scanned in full, the
+ * fast path is switched off and has to be earned again.
+ *
+ * Scatter-gather: with segment storage attached (the _gather variants of
+ * attach and handoff), payloads pushed with frame_assembler_push_ref()
+ * are not copied; the frame records references into the USB receive
+ * buffers they arrived in, and the frame buffer only reserves room for a
+ * later copy. A frame that runs out of segments, or gets a payload with
+ * no receive buffer to reference, is copied into the frame buffer and
+ * finished there. On completion, bytes after the EOI are split off so
+ * the completed frame's segments end exactly at the EOI.
+ *
+ * This module has no platform dependencies and performs no locking or
+ * allocation; the caller owns the frame storage and hands it over with
+ * frame_assembler_attach() / frame_assembler_handoff(), or swaps in a
+ * larger buffer mid-frame with frame_assembler_relocate().
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef FRAME_ASSEMBLER_H
+#define FRAME_ASSEMBLER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "rx_pool.h"
+
+// Protocol constants
+#define FRAME_PACKET_HEADER_SIZE 12    // Proprietary header is 12 bytes
+#define FRAME_MIN_JPEG_SIZE      1000  // Smaller EOI-terminated blobs are not frames
+#define FRAME_TAIL_WINDOW        16    // Bytes at a packet's end searched on the fast path
+#define FRAME_FAST_PATH_AFTER    8     // Frames ending at a packet tail before the fast path
+#define FRAME_CARRY_SEGMENTS     8     // Segments after an EOI carried into the next frame
+
+// Results of frame_assembler_push() / frame_assembler_scan()
+#define FRAME_ASM_NEED_MORE    0  // Payload buffered (or skipped until an SOI), frame not complete yet
+#define FRAME_ASM_COMPLETE     1  // complete_size bytes at data[0] form a JPEG
+#define FRAME_ASM_BAD_HEADER   2  // Packet had no AA BB 07 header, ignored
+#define FRAME_ASM_OVERFLOW     3  // Payload did not fit, partial frame discarded
+#define FRAME_ASM_TOO_LARGE    4  // Exceeded max_frame_size without EOI, discarded
+
+typedef struct frame_assembler {
+    // Storage for the frame under construction (owned by the caller)
+    unsigned char *data;
+    size_t capacity;
+    size_t size;
+
+    // Frames growing past this without an EOI are discarded
+    size_t max_frame_size;
+
+    // Incremental EOI search: data[0, scan_pos) has already been inspected
+    size_t scan_pos;
+    bool pending_ff;        // data[scan_pos - 1] is 0xFF (EOI may straddle packets)
+
+    // Length of the completed frame after FRAME_ASM_COMPLETE
+    size_t complete_size;
+
+    // Partial frames abandoned because a new SOI arrived or packets were
+    // lost (running count)
+    unsigned int restarts;
+
+    // Tail fast path; fast_path_enabled and header_vouched are the
+    // caller's choice, the rest is learned from the stream
+    bool fast_path_enabled;
+    bool header_vouched;        // The packet pushed next sits where a trusted header says
+    bool fast_path;             // Only packet tails are checked for EOI
+    bool frame_vouched;         // Every packet of the frame so far was vouched for
+    unsigned int tail_streak;   // Consecutive frames that ended at a packet tail
+    unsigned int fast_path_fallbacks;  // Times the fast path missed an EOI (running count)
+
+    // SOI payload that arrived while a frame missed on the fast path was
+    // still open; frame_assembler_handoff() starts the next frame with it
+    const unsigned char *deferred;
+    size_t deferred_size;
+    rx_buffer_t *deferred_buffer;   // Its receive buffer, if pushed with one
+
+    // Scatter-gather storage (owned by the caller, NULL = always copy).
+    // While gathered, the frame is segments[0, segment_count) and data
+    // holds nothing; the references belong to the assembler until
+    // frame_assembler_handoff() passes a completed frame on
+    rx_segment_t *segments;
+    int max_segments;
+    int segment_count;
+    bool gathered;
+
+    // Bytes after the EOI of a gathered frame, referenced until handoff
+    rx_segment_t carry[FRAME_CARRY_SEGMENTS];
+    int carry_count;
+
+    // Payloads copied into frame storage, including segments copied when
+    // a gathered frame had to be coalesced (running count)
+    unsigned int payloads_copied;
+} frame_assembler_t;
+
+/**
+ * Initialize assembler state
+ *
+ * @param fa Assembler to initialize
+ * @param max_frame_size Discard threshold for frames without EOI
+ */
+void frame_assembler_init(frame_assembler_t *fa, size_t max_frame_size);
+
+/**
+ * Attach frame storage, discarding any partial frame
+ *
+ * @param fa Assembler
+ * @param data Buffer to assemble into (may be NULL to detach)
+ * @param capacity Size of the buffer
+ */
+void frame_assembler_attach(frame_assembler_t *fa, unsigned char *data, size_t capacity);
+
+/**
+ * Attach frame storage with room for segment references, discarding any
+ * partial frame
+ *
+ * @param fa Assembler
+ * @param data Buffer reserving room for the frame (may be NULL to detach)
+ * @param capacity Size of the buffer
+ * @param segments Segment storage (may be NULL to always copy)
+ * @param max_segments Entries in segments
+ */
+void frame_assembler_attach_gather(frame_assembler_t *fa, unsigned char *data, size_t capacity,
+                                   rx_segment_t *segments, int max_segments);
+
+/**
+ * Discard the partial frame and reset the scan position
+ *
+ * @param fa Assembler
+ */
+void frame_assembler_reset(frame_assembler_t *fa);
+
+/**
+ * Discard the partial frame as incomplete, e.g. after packet loss
+ *
+ * Counted in restarts like a frame abandoned for a new SOI; does nothing
+ * when no frame is under way.
+ *
+ * @param fa Assembler
+ */
+void frame_assembler_abandon(frame_assembler_t *fa);
+
+/**
+ * Storage the frame will need once a packet has been pushed
+ *
+ * Lets the caller move the partial frame to larger storage with
+ * frame_assembler_relocate() before frame_assembler_push() would have to
+ * discard it with FRAME_ASM_OVERFLOW.
+ *
+ * @param fa Assembler
+ * @param packet Packet about to be pushed
+ * @param length Packet length in bytes
+ * @return Frame size after the push, 0 if the packet adds no payload
+ */
+size_t frame_assembler_required_capacity(const frame_assembler_t *fa,
+                                         const unsigned char *packet, size_t length);
+
+/**
+ * Move the partial frame to new storage, keeping the scan position
+ * (a gathered frame keeps its segments and is not copied)
+ *
+ * @param fa Assembler
+ * @param data New buffer, at least fa->size bytes
+ * @param capacity Size of the new buffer
+ */
+void frame_assembler_relocate(frame_assembler_t *fa, unsigned char *data, size_t capacity);
+
+/**
+ * Feed one raw USB packet (header + payload)
+ *
+ * @param fa Assembler
+ * @param packet Packet data as read from the bulk endpoint
+ * @param length Packet length in bytes
+ * @return FRAME_ASM_* result code
+ */
+int frame_assembler_push(frame_assembler_t *fa, const unsigned char *packet, size_t length);
+
+/**
+ * Feed one raw USB packet that lies in a receive buffer
+ *
+ * With segment storage attached the payload is referenced rather than
+ * copied (rx_buffer_ref); the references are dropped when the frame is
+ * discarded or, after frame_assembler_handoff(), by the frame's owner.
+ *
+ * @param fa Assembler
+ * @param buffer Receive buffer holding the packet (NULL = copy, as
+ *               frame_assembler_push)
+ * @param packet Packet data as read from the bulk endpoint
+ * @param length Packet length in bytes
+ * @return FRAME_ASM_* result code
+ */
+int frame_assembler_push_ref(frame_assembler_t *fa, rx_buffer_t *buffer,
+                             const unsigned char *packet, size_t length);
+
+/**
+ * Continue the EOI search over bytes not inspected yet
+ *
+ * Used after frame_assembler_handoff() when leftover data may already
+ * contain another complete frame.
+ *
+ * @param fa Assembler
+ * @return FRAME_ASM_NEED_MORE, FRAME_ASM_COMPLETE or FRAME_ASM_TOO_LARGE
+ */
+int frame_assembler_scan(frame_assembler_t *fa);
+
+/**
+ * Move on to new storage after FRAME_ASM_COMPLETE
+ *
+ * The completed frame stays in the old buffer (now owned by the caller).
+ * Bytes following the EOI are carried over to the new buffer if they
+ * start a new JPEG (SOI), otherwise they are discarded. After a fast path
+ * fallback the payload of the packet that was pushed is carried over
+ * instead, so the packet must still be valid.
+ *
+ * @param fa Assembler
+ * @param data New buffer to assemble into (may be NULL)
+ * @param capacity Size of the new buffer
+ */
+void frame_assembler_handoff(frame_assembler_t *fa, unsigned char *data, size_t capacity);
+
+/**
+ * Move on to new storage with room for segment references after
+ * FRAME_ASM_COMPLETE
+ *
+ * A gathered frame's segments, segments[0, segment_count) of the old
+ * storage, now belong to the caller, who drops their references once the
+ * frame is no longer needed. Leftover bytes are carried over as segments
+ * where possible. The new storage may be the old, to drop the frame and
+ * keep what follows it.
+ *
+ * @param fa Assembler
+ * @param data New buffer reserving room for the frame (may be NULL)
+ * @param capacity Size of the new buffer
+ * @param segments New segment storage (may be NULL to always copy)
+ * @param max_segments Entries in segments
+ */
+void frame_assembler_handoff_gather(frame_assembler_t *fa, unsigned char *data, size_t capacity,
+                                    rx_segment_t *segments, int max_segments);
+
+#endif // FRAME_ASSEMBLER_H
@@ -0,0 +1,430 @@
+/**
+ * Useeplus SuperCamera - JPEG Frame Decoder
+ *
+ * See frame_decoder.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "frame_decoder.h"
+
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#ifndef JCS_ALPHA_EXTENSIONS
+#error "frame_decoder.c needs libjpeg-turbo (JCS_EXT_RGBA / JCS_EXT_BGRA output)"
+#endif
+
+// Output block size of a component at the current scale
+#if JPEG_LIB_VERSION >= 70
+#define SCALED_BLOCK(comp)      ((comp)->DCT_h_scaled_size)
+#define MIN_SCALED_BLOCK(cinfo) ((cinfo)->min_DCT_v_scaled_size)
+#else
+#define SCALED_BLOCK(comp)      ((comp)->DCT_scaled_size)
+#define MIN_SCALED_BLOCK(cinfo) ((cinfo)->min_DCT_scaled_size)
+#endif
+
+#define MAX_READ_ROWS 16    // Rows handed to libjpeg per call
+
+// libjpeg reports fatal errors through error_exit, which must not return
+typedef struct decoder_error {
+    struct jpeg_error_mgr pub;
+    jmp_buf jump;
+} decoder_error_t;
+
+struct frame_decoder {
+    struct jpeg_decompress_struct cinfo;
+    decoder_error_t error;
+    frame_image_t image;
+    bool active;            // Between start and finish or abort
+    bool raw;               // I420 read as raw downsampled planes
+    bool raw_chroma_full;   // Raw chroma came out at luma resolution (scaled)
+    unsigned char *scratch; // Raw: sink for rows past the image; else YCbCr rows
+    size_t scratch_size;
+    char message[JMSG_LENGTH_MAX];
+};
+
+static void error_exit(j_common_ptr cinfo) {
+    decoder_error_t *error = (decoder_error_t*)cinfo->err;
+    longjmp(error->jump, 1);
+}
+
+// Warnings (corrupt data, premature end of data) are not worth a message each
+static void emit_message(j_common_ptr cinfo, int msg_level) {
+    (void)cinfo;
+    (void)msg_level;
+}
+
+// Record the message of the error that ended a decode and reset libjpeg
+static void fail(frame_decoder_t *d) {
+    (*d->error.pub.format_message)((j_common_ptr)&d->cinfo, d->message);
+    jpeg_abort_decompress(&d->cinfo);
+    d->active = false;
+}
+
+static bool ensure_scratch(frame_decoder_t *d, size_t size) {
+    unsigned char *scratch;
+
+    if (size <= d->scratch_size) {
+        return true;
+    }
+
+    scratch = (unsigned char*)realloc(d->scratch, size);
+    if (!scratch) {
+        snprintf(d->message, sizeof(d->message), "Out of memory");
+        return false;
+    }
+    d->scratch = scratch;
+    d->scratch_size = size;
+    return true;
+}
+
+// The camera's layout: full-resolution luma, chroma halved both ways
+static bool is_yuv420(const struct jpeg_decompress_struct *cinfo) {
+    return cinfo->jpeg_color_space == JCS_YCbCr && cinfo->num_components == 3 &&
+           cinfo->comp_info[0].h_samp_factor == 2 && cinfo->comp_info[0].v_samp_factor == 2 &&
+           cinfo->comp_info[1].h_samp_factor == 1 && cinfo->comp_info[1].v_samp_factor == 1 &&
+           cinfo->comp_info[2].h_samp_factor == 1 && cinfo->comp_info[2].v_samp_factor == 1;
+}
+
+int frame_decoder_pick_scale(int width, int height, int target_width, int target_height) {
+    int scale = FRAME_DECODER_MAX_SCALE;
+
+    if (target_width <= 0 && target_height <= 0) {
+        return 1;
+    }
+
+    // libjpeg rounds scaled dimensions up
+    while (scale > 1 &&
+           ((target_width > 0 && (width + scale - 1) / scale < target_width) ||
+            (target_height > 0 && (height + scale - 1) / scale < target_height))) {
+        scale /= 2;
+    }
+    return scale;
+}
+
+frame_decoder_t* frame_decoder_create(void) {
+    // volatile: read again after a longjmp back to the setjmp below
+    frame_decoder_t *volatile d = (frame_decoder_t*)calloc(1, sizeof(frame_decoder_t));
+
+    if (!d) {
+        return NULL;
+    }
+
+    d->cinfo.err = jpeg_std_error(&d->error.pub);
+    d->error.pub.error_exit = error_exit;
+    d->error.pub.emit_message = emit_message;
+    if (setjmp(d->error.jump)) {
+        free(d);
+        return NULL;
+    }
+    jpeg_create_decompress(&d->cinfo);
+
+    snprintf(d->message, sizeof(d->message), "No error");
+    return d;
+}
+
+void frame_decoder_destroy(frame_decoder_t *d) {
+    if (!d) {
+        return;
+    }
+
+    jpeg_destroy_decompress(&d->cinfo);
+    free(d->scratch);
+    free(d);
+}
+
+bool frame_decoder_start(frame_decoder_t *d, const unsigned char *jpeg, size_t size,
+                         int format, int target_width, int target_height, frame_image_t *image) {
+    struct jpeg_decompress_struct *cinfo = &d->cinfo;
+    frame_image_t *out = &d->image;
+
+    if (d->active) {
+        frame_decoder_abort(d);
+    }
+
+    if (format < FRAME_DECODER_RGBA || format > FRAME_DECODER_I420) {
+        snprintf(d->message, sizeof(d->message), "Unknown pixel format %d", format);
+        return false;
+    }
+
+    if (setjmp(d->error.jump)) {
+        fail(d);
+        return false;
+    }
+
+    jpeg_mem_src(cinfo, (unsigned char*)jpeg, (unsigned long)size);
+    jpeg_read_header(cinfo, TRUE);
+    d->active = true;
+    d->raw = false;
+    d->raw_chroma_full = false;
+
+    // Scaled inverse DCT: 1/2, 1/4 or 1/8 costs a fraction of a full decode
+    cinfo->scale_num = 1;
+    cinfo->scale_denom = (unsigned int)frame_decoder_pick_scale((int)cinfo->image_width,
+                                                                (int)cinfo->image_height,
+                                                                target_width, target_height);
+
+    switch (format) {
+        case FRAME_DECODER_RGBA:
+            cinfo->out_color_space = JCS_EXT_RGBA;
+            break;
+        case FRAME_DECODER_BGRA:
+            cinfo->out_color_space = JCS_EXT_BGRA;
+            break;
+        case FRAME_DECODER_GRAY:
+            cinfo->out_color_space = JCS_GRAYSCALE;
+            break;
+        default:
+            // A grayscale JPEG has no chroma to convert; its planes are flat
+            if (cinfo->jpeg_color_space == JCS_GRAYSCALE) {
+                cinfo->out_color_space = JCS_GRAYSCALE;
+            } else {
+                cinfo->out_color_space = JCS_YCbCr;
+                d->raw = is_yuv420(cinfo);
+            }
+            cinfo->raw_data_out = d->raw;
+            break;
+    }
+
+    jpeg_calc_output_dimensions(cinfo);
+
+    // When scaling, libjpeg-turbo gives chroma a larger inverse DCT instead
+    // of upsampling it, so raw chroma comes out at luma resolution and is
+    // averaged down in decode_raw
+    d->raw_chroma_full = d->raw &&
+                         SCALED_BLOCK(&cinfo->comp_info[1]) != SCALED_BLOCK(&cinfo->comp_info[0]);
+
+    memset(out, 0, sizeof(*out));
+    out->format = format;
+    out->width = (int)cinfo->output_width;
+    out->height = (int)cinfo->output_height;
+    out->scale = (int)cinfo->scale_denom;
+
+    if (format == FRAME_DECODER_I420) {
+        int chroma_width = (out->width + 1) / 2;
+        int chroma_height = (out->height + 1) / 2;
+
+        // Raw planes come out in whole blocks, so rows are padded to them
+        out->planes = 3;
+        out->strides[0] = d->raw ? (int)(cinfo->comp_info[0].width_in_blocks *
+                                         SCALED_BLOCK(&cinfo->comp_info[0])) : out->width;
+        out->strides[1] = d->raw && !d->raw_chroma_full ?
+                          (int)(cinfo->comp_info[1].width_in_blocks * SCALED_BLOCK(&cinfo->comp_info[1])) :
+                          chroma_width;
+        out->strides[2] = out->strides[1];
+        out->offsets[1] = (size_t)out->strides[0] * (size_t)out->height;
+        out->offsets[2] = out->offsets[1] + (size_t)out->strides[1] * (size_t)chroma_height;
+        out->size = out->offsets[2] + (size_t)out->strides[2] * (size_t)chroma_height;
+    } else {
+        out->planes = 1;
+        out->strides[0] = out->width * cinfo->out_color_components;
+        out->size = (size_t)out->strides[0] * (size_t)out->height;
+    }
+
+    *image = *out;
+    return true;
+}
+
+// Packed formats and grayscale, several rows per call
+static void decode_rows(frame_decoder_t *d, unsigned char *plane, int stride) {
+    struct jpeg_decompress_struct *cinfo = &d->cinfo;
+    JSAMPROW rows[MAX_READ_ROWS];
+
+    while (cinfo->output_scanline < cinfo->output_height) {
+        JDIMENSION first = cinfo->output_scanline;
+        JDIMENSION count = cinfo->output_height - first;
+
+        if (count > MAX_READ_ROWS) {
+            count = MAX_READ_ROWS;
+        }
+        for (JDIMENSION i = 0; i < count; i++) {
+            rows[i] = plane + (size_t)(first + i) * (size_t)stride;
+        }
+        jpeg_read_scanlines(cinfo, rows, count);
+    }
+}
+
+// Bytes per row of a component's raw plane
+static size_t raw_stride(const jpeg_component_info *comp) {
+    return (size_t)comp->width_in_blocks * (size_t)SCALED_BLOCK(comp);
+}
+
+// Average full-resolution chroma rows (2 per output row) over 2x2
+static void halve_chroma(unsigned char *dst, int dst_stride, int dst_rows, int width,
+                         JSAMPARRAY src, int src_rows) {
+    int dst_width = (width + 1) / 2;
+
+    for (int y = 0; y < dst_rows; y++) {
+        const unsigned char *r0 = src[y * 2];
+        const unsigned char *r1 = src[y * 2 + 1 < src_rows ? y * 2 + 1 : y * 2];
+        unsigned char *out = dst + (size_t)y * (size_t)dst_stride;
+
+        for (int x = 0; x < dst_width; x++) {
+            int x0 = x * 2;
+            int x1 = x0 + 1 < width ? x0 + 1 : x0;
+            out[x] = (unsigned char)((r0[x0] + r0[x1] + r1[x0] + r1[x1] + 2) / 4);
+        }
+    }
+}
+
+// I420 from a 4:2:0 JPEG: the downsampled planes as stored, one iMCU row
+// (16 luma rows, 8 chroma rows at full scale) per call. Scaled chroma that
+// comes out at luma resolution is decoded to scratch and halved
+static void decode_raw(frame_decoder_t *d, unsigned char *buffer) {
+    struct jpeg_decompress_struct *cinfo = &d->cinfo;
+    const frame_image_t *image = &d->image;
+    int block = MIN_SCALED_BLOCK(cinfo);
+    int luma_rows = cinfo->max_v_samp_factor * block;
+    int chroma_rows = SCALED_BLOCK(&cinfo->comp_info[1]);
+    int chroma_height = (image->height + 1) / 2;
+    size_t full_stride = raw_stride(&cinfo->comp_info[1]);
+    JSAMPROW rows[FRAME_DECODER_MAX_PLANES][MAX_READ_ROWS];
+    JSAMPARRAY planes[FRAME_DECODER_MAX_PLANES] = { rows[0], rows[1], rows[2] };
+
+    // Full-resolution chroma goes to scratch, after the luma sink row
+    if (d->raw_chroma_full) {
+        for (int p = 1; p < FRAME_DECODER_MAX_PLANES; p++) {
+            for (int i = 0; i < chroma_rows; i++) {
+                rows[p][i] = d->scratch + (size_t)image->strides[0] +
+                             ((size_t)(p - 1) * (size_t)chroma_rows + (size_t)i) * full_stride;
+            }
+        }
+    }
+
+    while (cinfo->output_scanline < cinfo->output_height) {
+        int first = (int)cinfo->output_scanline;
+        int chroma_first = first / 2;
+
+        // Rows past the bottom of a plane still get decoded; they land in scratch
+        for (int i = 0; i < luma_rows; i++) {
+            int y = first + i;
+            rows[0][i] = y < image->height ? buffer + (size_t)y * (size_t)image->strides[0] : d->scratch;
+        }
+        if (!d->raw_chroma_full) {
+            for (int p = 1; p < FRAME_DECODER_MAX_PLANES; p++) {
+                for (int i = 0; i < block; i++) {
+                    int y = chroma_first + i;
+                    rows[p][i] = y < chroma_height ?
+                                 buffer + image->offsets[p] + (size_t)y * (size_t)image->strides[p] :
+                                 d->scratch;
+                }
+            }
+        }
+        jpeg_read_raw_data(cinfo, planes, (JDIMENSION)luma_rows);
+
+        if (d->raw_chroma_full && chroma_first < chroma_height) {
+            int count = chroma_height - chroma_first < block ? chroma_height - chroma_first : block;
+            int valid = image->height - first < chroma_rows ? image->height - first : chroma_rows;
+
+            for (int p = 1; p < FRAME_DECODER_MAX_PLANES; p++) {
+                halve_chroma(buffer + image->offsets[p] + (size_t)chroma_first * (size_t)image->strides[p],
+                             image->strides[p], count, image->width, planes[p], valid);
+            }
+        }
+    }
+}
+
+// I420 from any other JPEG: convert to YCbCr, then average chroma over 2x2
+static void decode_yuv(frame_decoder_t *d, unsigned char *buffer) {
+    struct jpeg_decompress_struct *cinfo = &d->cinfo;
+    const frame_image_t *image = &d->image;
+    int width = image->width;
+    int chroma_width = (width + 1) / 2;
+    int chroma_height = (image->height + 1) / 2;
+    unsigned char *u = buffer + image->offsets[1];
+    unsigned char *v = buffer + image->offsets[2];
+
+    if (cinfo->out_color_components == 1) {
+        decode_rows(d, buffer, image->strides[0]);
+        memset(u, 128, (size_t)image->strides[1] * (size_t)chroma_height);
+        memset(v, 128, (size_t)image->strides[2] * (size_t)chroma_height);
+        return;
+    }
+
+    for (int cy = 0; cy < chroma_height; cy++) {
+        JSAMPROW rows[2] = { d->scratch, d->scratch + (size_t)width * 3 };
+        int count = 0;
+
+        while (count < 2 && cinfo->output_scanline < cinfo->output_height) {
+            count += (int)jpeg_read_scanlines(cinfo, &rows[count], 1);
+        }
+        if (count == 1) {
+            memcpy(rows[1], rows[0], (size_t)width * 3);  // Odd height: repeat the last row
+        }
+
+        for (int r = 0; r < count; r++) {
+            unsigned char *y = buffer + (size_t)(cy * 2 + r) * (size_t)image->strides[0];
+            for (int x = 0; x < width; x++) {
+                y[x] = rows[r][x * 3];
+            }
+        }
+
+        for (int cx = 0; cx < chroma_width; cx++) {
+            int x0 = cx * 2;
+            int x1 = x0 + 1 < width ? x0 + 1 : x0;
+            for (int c = 1; c <= 2; c++) {
+                int sum = rows[0][x0 * 3 + c] + rows[0][x1 * 3 + c] +
+                          rows[1][x0 * 3 + c] + rows[1][x1 * 3 + c];
+                (c == 1 ? u : v)[(size_t)cy * (size_t)image->strides[c] + (size_t)cx] =
+                    (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool frame_decoder_finish(frame_decoder_t *d, unsigned char *buffer) {
+    struct jpeg_decompress_struct *cinfo = &d->cinfo;
+    size_t scratch = 0;
+
+    if (!d->active) {
+        snprintf(d->message, sizeof(d->message), "No frame started");
+        return false;
+    }
+
+    // Sized before libjpeg is entered, so a failure needs no longjmp
+    if (d->raw) {
+        scratch = (size_t)d->image.strides[0];
+        if (d->raw_chroma_full) {
+            scratch += 2 * (size_t)SCALED_BLOCK(&cinfo->comp_info[1]) * raw_stride(&cinfo->comp_info[1]);
+        }
+    } else if (d->image.format == FRAME_DECODER_I420) {
+        scratch = (size_t)d->image.width * 6;
+    }
+    if (!ensure_scratch(d, scratch)) {
+        frame_decoder_abort(d);
+        return false;
+    }
+
+    if (setjmp(d->error.jump)) {
+        fail(d);
+        return false;
+    }
+
+    jpeg_start_decompress(cinfo);
+    if (d->raw) {
+        decode_raw(d, buffer);
+    } else if (d->image.format == FRAME_DECODER_I420) {
+        decode_yuv(d, buffer);
+    } else {
+        decode_rows(d, buffer, d->image.strides[0]);
+    }
+    jpeg_finish_decompress(cinfo);
+
+    d->active = false;
+    return true;
+}
+
+void frame_decoder_abort(frame_decoder_t *d) {
+    if (d->active) {
+        jpeg_abort_decompress(&d->cinfo);
+        d->active = false;
+    }
+}
+
+const char* frame_decoder_error(const frame_decoder_t *d) {
+    return d->message;
+}
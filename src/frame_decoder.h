@@ -0,0 +1,135 @@
+/**
+ * Useeplus SuperCamera - JPEG Frame Decoder
+ *
+ * Decodes camera frames with libjpeg-turbo into RGBA, BGRA, grayscale or
+ * planar YUV 4:2:0. One decoder owns one libjpeg decompressor and reuses
+ * it, and its scratch memory, for every frame, so decoding a stream does
+ * no per-frame setup beyond parsing the headers.
+ *
+ * Decoding is split in two so the caller can size the output buffer
+ * between the steps (from a pool, for example):
+ *
+ *   frame_decoder_start(d, jpeg, size, format, &image);   // headers, layout
+ *   buffer = get_buffer(image.size);
+ *   frame_decoder_finish(d, buffer);                      // or _abort
+ *
+ * YUV output of a 4:2:0 JPEG - what the camera sends - is read straight
+ * from the decompressor as raw downsampled planes, skipping upsampling
+ * and colour conversion altogether.
+ *
+ * Given a target size, frames are decoded at 1/2, 1/4 or 1/8 scale with
+ * libjpeg's scaled inverse DCT when that still covers the target, which
+ * cuts the IDCT and colour conversion work by the square of the factor.
+ *
+ * A decoder is not thread-safe; use one per thread.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef FRAME_DECODER_H
+#define FRAME_DECODER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Output formats, the same values as CAMERA_PIXEL_*
+#define FRAME_DECODER_RGBA  0
+#define FRAME_DECODER_BGRA  1
+#define FRAME_DECODER_GRAY  2
+#define FRAME_DECODER_I420  3
+
+#define FRAME_DECODER_MAX_PLANES 3
+
+// Largest scale-down: libjpeg's smallest inverse DCT is 1x1 per 8x8 block
+#define FRAME_DECODER_MAX_SCALE  8
+
+typedef struct frame_decoder frame_decoder_t;
+
+// Layout of a decoded image inside its buffer
+typedef struct frame_image {
+    int format;                                 // FRAME_DECODER_*
+    int width;
+    int height;
+    int scale;                                  // Scale-down factor: 1, 2, 4 or 8
+    int planes;                                 // 1, or 3 for I420 (Y, Cb, Cr)
+    size_t offsets[FRAME_DECODER_MAX_PLANES];   // Start of each plane
+    int strides[FRAME_DECODER_MAX_PLANES];      // Bytes per row of each plane
+    size_t size;                                // Buffer size needed
+} frame_image_t;
+
+/**
+ * Create a decoder
+ *
+ * @return Decoder, or NULL if out of memory
+ */
+frame_decoder_t* frame_decoder_create(void);
+
+/**
+ * Destroy a decoder (NULL is ignored)
+ *
+ * @param d Decoder
+ */
+void frame_decoder_destroy(frame_decoder_t *d);
+
+/**
+ * Read a frame's headers and work out the output layout
+ *
+ * The JPEG data must stay valid until frame_decoder_finish or
+ * frame_decoder_abort.
+ *
+ * The frame is scaled down by the largest factor (2, 4 or 8) that keeps
+ * it at least target_width x target_height; 0 leaves a dimension
+ * unconstrained, and 0 x 0 decodes at full size.
+ *
+ * @param d Decoder
+ * @param jpeg JPEG data
+ * @param size JPEG size in bytes
+ * @param format FRAME_DECODER_*
+ * @param target_width Smallest useful output width, or 0
+ * @param target_height Smallest useful output height, or 0
+ * @param image Receives dimensions, scale and plane layout
+ * @return true on success; false if the data is not a JPEG or the format
+ *         is unknown (see frame_decoder_error)
+ */
+bool frame_decoder_start(frame_decoder_t *d, const unsigned char *jpeg, size_t size,
+                         int format, int target_width, int target_height, frame_image_t *image);
+
+/**
+ * Scale-down factor frame_decoder_start picks for an image size
+ *
+ * @param width Full image width
+ * @param height Full image height
+ * @param target_width Smallest useful output width, or 0
+ * @param target_height Smallest useful output height, or 0
+ * @return 1, 2, 4 or 8
+ */
+int frame_decoder_pick_scale(int width, int height, int target_width, int target_height);
+
+/**
+ * Decode the frame started with frame_decoder_start
+ *
+ * Corrupt entropy-coded data is not an error; libjpeg fills what it
+ * cannot decode, as it does for a frame cut short.
+ *
+ * @param d Decoder
+ * @param buffer Receives the image, at least image.size bytes
+ * @return true on success; false on a fatal decoding error
+ */
+bool frame_decoder_finish(frame_decoder_t *d, unsigned char *buffer);
+
+/**
+ * Drop a frame started with frame_decoder_start without decoding it
+ *
+ * @param d Decoder
+ */
+void frame_decoder_abort(frame_decoder_t *d);
+
+/**
+ * Why the last call failed
+ *
+ * @param d Decoder
+ * @return Message
+ */
+const char* frame_decoder_error(const frame_decoder_t *d);
+
+#endif // FRAME_DECODER_H
@@ -0,0 +1,88 @@
+/**
+ * Useeplus SuperCamera - Frame Buffer Pool
+ *
+ * See frame_pool.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "frame_pool.h"
+
+#include <stdlib.h>
+
+// Index of the smallest class holding size, or -1 if none does
+static int size_class(size_t size) {
+    size_t class_size = FRAME_POOL_MIN_SIZE;
+
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        if (size <= class_size) {
+            return c;
+        }
+        class_size <<= 1;
+    }
+    return -1;
+}
+
+void frame_pool_init(frame_pool_t *pool) {
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        pool->free_list[c] = NULL;
+        pool->free_count[c] = 0;
+    }
+    pool->allocations = 0;
+    pool->allocated_bytes = 0;
+}
+
+void frame_pool_free(frame_pool_t *pool) {
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        void *buffer = pool->free_list[c];
+        while (buffer) {
+            void *next = *(void**)buffer;
+            free(buffer);
+            buffer = next;
+        }
+        pool->free_list[c] = NULL;
+        pool->free_count[c] = 0;
+    }
+}
+
+size_t frame_pool_class_size(size_t size) {
+    int c = size_class(size);
+    return c < 0 ? 0 : (size_t)FRAME_POOL_MIN_SIZE << c;
+}
+
+unsigned char* frame_pool_get(frame_pool_t *pool, size_t min_size, size_t *capacity) {
+    int c = size_class(min_size);
+    void *buffer;
+
+    if (c < 0) {
+        return NULL;
+    }
+
+    buffer = pool->free_list[c];
+    if (buffer) {
+        pool->free_list[c] = *(void**)buffer;
+        pool->free_count[c]--;
+    } else {
+        buffer = malloc((size_t)FRAME_POOL_MIN_SIZE << c);
+        if (!buffer) {
+            return NULL;
+        }
+        pool->allocations++;
+        pool->allocated_bytes += (size_t)FRAME_POOL_MIN_SIZE << c;
+    }
+
+    *capacity = (size_t)FRAME_POOL_MIN_SIZE << c;
+    return (unsigned char*)buffer;
+}
+
+void frame_pool_put(frame_pool_t *pool, unsigned char *data, size_t capacity) {
+    int c;
+
+    if (!data) return;
+
+    // Capacities always come from frame_pool_get, so this is exact
+    c = size_class(capacity);
+    *(void**)data = pool->free_list[c];
+    pool->free_list[c] = data;
+    pool->free_count[c]++;
+}
@@ -0,0 +1,82 @@
+/**
+ * Useeplus SuperCamera - Frame Buffer Pool
+ *
+ * Supplies frame storage for the ring slots in power-of-two size classes
+ * (64 KiB up to FRAME_POOL_MAX_SIZE, 16 MiB). Buffers given back to the
+ * pool are kept on a per-class free list and handed out again, so once
+ * every slot holds a buffer large enough for the stream, assembling
+ * frames causes no heap traffic at all. The counters record every trip
+ * to the heap.
+ *
+ * The pool is not thread-safe; only the USB read thread uses it while
+ * streaming.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define FRAME_POOL_MIN_SIZE  (64*1024)
+#define FRAME_POOL_CLASSES   9                                       // 64 KiB .. 16 MiB
+#define FRAME_POOL_MAX_SIZE  (FRAME_POOL_MIN_SIZE << (FRAME_POOL_CLASSES - 1))
+
+typedef struct frame_pool {
+    // Free buffers per size class, linked through their first bytes
+    void *free_list[FRAME_POOL_CLASSES];
+    unsigned int free_count[FRAME_POOL_CLASSES];
+
+    // Statistics
+    unsigned int allocations;           // Buffers taken from the heap
+    unsigned long long allocated_bytes; // Total size of those buffers
+} frame_pool_t;
+
+/**
+ * Initialize an empty pool
+ *
+ * @param pool Pool to initialize
+ */
+void frame_pool_init(frame_pool_t *pool);
+
+/**
+ * Free every buffer on the free lists (buffers handed out are not tracked)
+ *
+ * @param pool Pool
+ */
+void frame_pool_free(frame_pool_t *pool);
+
+/**
+ * Round a size up to its size class
+ *
+ * @param size Requested size
+ * @return Capacity of the smallest class holding size, or 0 if size
+ *         exceeds FRAME_POOL_MAX_SIZE
+ */
+size_t frame_pool_class_size(size_t size);
+
+/**
+ * Take a buffer of at least min_size bytes
+ *
+ * Served from the free list of the matching class, from the heap only
+ * when that list is empty.
+ *
+ * @param pool Pool
+ * @param min_size Required size (at most FRAME_POOL_MAX_SIZE)
+ * @param capacity Receives the buffer's actual size
+ * @return Buffer, or NULL if min_size is too large or out of memory
+ */
+unsigned char* frame_pool_get(frame_pool_t *pool, size_t min_size, size_t *capacity);
+
+/**
+ * Return a buffer obtained from frame_pool_get
+ *
+ * @param pool Pool
+ * @param data Buffer (may be NULL)
+ * @param capacity Capacity reported by frame_pool_get
+ */
+void frame_pool_put(frame_pool_t *pool, unsigned char *data, size_t capacity);
+
+#endif // FRAME_POOL_H
@@ -0,0 +1,171 @@
+/**
+ * Useeplus SuperCamera - Lock-Free Frame Ring
+ *
+ * See frame_ring.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "frame_ring.h"
+
+#include <string.h>
+
+// Queue indices are free-running counters; wrap without signed overflow
+static long next_index(long index) {
+    return (long)((uint32_t)index + 1);
+}
+
+// Drop the references a frame holds on receive buffers
+static void release_segments(frame_slot_t *slot) {
+    for (int i = 0; i < slot->segment_count; i++) {
+        rx_buffer_unref(slot->segments[i].buffer);
+    }
+    slot->segment_count = 0;
+}
+
+void frame_ring_init(frame_ring_t *ring, int slot_count) {
+    memset(ring, 0, sizeof(*ring));
+    ring->slot_count = slot_count;
+}
+
+void frame_ring_set_slot_count(frame_ring_t *ring, int slot_count) {
+    ring->slot_count = slot_count;
+
+    // Move the write slot into range if it fell outside; when every slot
+    // in range is leased it stays where it is until the next publish
+    if (ring->write_slot >= slot_count) {
+        for (int i = 0; i < slot_count; i++) {
+            if (atomic32_load_acquire(&ring->slots[i].refs) == 0) {
+                ring->write_slot = i;
+                ring->slots[i].size = 0;
+                break;
+            }
+        }
+    }
+}
+
+void frame_ring_reset(frame_ring_t *ring) {
+    // Release the queue's references; the write slot is never queued or
+    // leased, so the producer can keep assembling into it
+    while (frame_ring_peek(ring)) {
+        frame_ring_pop(ring);
+    }
+    ring->slots[ring->write_slot].size = 0;
+}
+
+frame_slot_t* frame_ring_write_slot(frame_ring_t *ring) {
+    return &ring->slots[ring->write_slot];
+}
+
+int frame_ring_publish(frame_ring_t *ring, size_t size, bool *was_empty) {
+    int current = ring->write_slot;
+    int next = current;
+    frame_slot_t *slot = &ring->slots[current];
+
+    *was_empty = false;
+
+    // Find a slot that is neither queued nor leased for the next frame
+    for (int i = 1; i <= ring->slot_count; i++) {
+        int candidate = (current + i) % ring->slot_count;
+        if (atomic32_load_acquire(&ring->slots[candidate].refs) == 0) {
+            next = candidate;
+            break;
+        }
+    }
+
+    if (next == current) {
+        // Consumer is holding every other slot - drop the frame and keep
+        // assembling here
+        slot->size = 0;
+        release_segments(slot);
+        return FRAME_RING_DROPPED;
+    }
+
+    slot->size = size;
+    atomic32_store_release(&slot->refs, 1);  // Reference held by the queue entry
+
+    long head = ring->head;
+    ring->queue[head & (FRAME_RING_QUEUE - 1)] = current;
+    atomic32_store_release(&ring->head, next_index(head));
+
+    // Order the head store before reading tail (pairs with the fence in
+    // frame_ring_empty_before_wait) so exactly one side sees the transition
+    atomic_fence_full();
+    *was_empty = (atomic32_load_acquire(&ring->tail) == head);
+
+    ring->write_slot = next;
+    ring->slots[next].size = 0;
+    return FRAME_RING_PUBLISHED;
+}
+
+frame_slot_t* frame_ring_peek(frame_ring_t *ring) {
+    long tail = ring->tail;
+
+    if (atomic32_load_acquire(&ring->head) == tail) {
+        return NULL;
+    }
+    return &ring->slots[ring->queue[tail & (FRAME_RING_QUEUE - 1)]];
+}
+
+int frame_ring_queued(frame_ring_t *ring) {
+    return (int)((uint32_t)atomic32_load_acquire(&ring->head) - (uint32_t)ring->tail);
+}
+
+void frame_ring_pop(frame_ring_t *ring) {
+    long tail = ring->tail;
+    frame_slot_t *slot = &ring->slots[ring->queue[tail & (FRAME_RING_QUEUE - 1)]];
+
+    release_segments(slot);
+    atomic32_store_release(&ring->tail, next_index(tail));
+    atomic32_fetch_add(&slot->refs, -1);
+}
+
+frame_slot_t* frame_ring_acquire(frame_ring_t *ring) {
+    frame_slot_t *slot = frame_ring_peek(ring);
+
+    if (!slot) {
+        return NULL;
+    }
+
+    // The queue's reference becomes the lease
+    slot->leased = true;
+    atomic32_store_release(&ring->tail, next_index(ring->tail));
+    return slot;
+}
+
+bool frame_ring_release(frame_ring_t *ring, const unsigned char *data) {
+    for (int i = 0; i < FRAME_RING_MAX_SLOTS; i++) {
+        frame_slot_t *slot = &ring->slots[i];
+        if (slot->leased && slot->data == data) {
+            slot->leased = false;
+            atomic32_fetch_add(&slot->refs, -1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void frame_slot_read(const frame_slot_t *slot, unsigned char *out) {
+    if (slot->segment_count == 0) {
+        memcpy(out, slot->data, slot->size);
+        return;
+    }
+
+    for (int i = 0; i < slot->segment_count; i++) {
+        memcpy(out, slot->segments[i].data, slot->segments[i].size);
+        out += slot->segments[i].size;
+    }
+}
+
+void frame_slot_coalesce(frame_slot_t *slot) {
+    // The producer reserved capacity for the whole frame
+    if (slot->segment_count > 0) {
+        frame_slot_read(slot, slot->data);
+        release_segments(slot);
+    }
+}
+
+bool frame_ring_empty_before_wait(frame_ring_t *ring) {
+    atomic_fence_full();
+    return atomic32_load_acquire(&ring->head) == ring->tail;
+}
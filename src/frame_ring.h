@@ -0,0 +1,202 @@
+/**
+ * Useeplus SuperCamera - Lock-Free Frame Ring
+ *
+ * Hands completed JPEG frames from the USB read thread (single producer)
+ * to the API consumers (single consumer) without a shared lock.
+ *
+ * Frames live in a fixed set of slots. The producer assembles into a slot
+ * it owns exclusively; when the frame completes, the slot index is pushed
+ * onto a single-producer/single-consumer queue with atomic head/tail
+ * indices kept on separate cache lines. Each slot carries a reference
+ * count (one for the queue entry, one per consumer lease), and the
+ * producer only ever claims slots whose count is zero - so leased slots
+ * are skipped and never overwritten.
+ *
+ * A slot's frame is either contiguous in data or, when the producer kept
+ * the payloads in their USB receive buffers, a list of segments; data
+ * then only reserves room for the frame. Consumers copy a frame out with
+ * frame_slot_read(), or call frame_slot_coalesce() first when they need
+ * the bytes in one piece. Either way the frame is copied once.
+ *
+ * When no free slot is left for the next frame the producer drops the
+ * frame it just completed (it cannot take entries back from the consumer
+ * side of the queue). Consumers that share a ring across threads must
+ * serialize the consumer calls among themselves.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef FRAME_RING_H
+#define FRAME_RING_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "atomics.h"
+#include "rx_pool.h"
+
+#define FRAME_RING_DEFAULT_SLOTS 12  // Camera has 10-frame buffer, use 12 for safety margin
+#define FRAME_RING_MAX_SLOTS     64  // CAMERA_MAX_FRAME_BUFFERS
+#define FRAME_RING_QUEUE         64  // Power of two >= FRAME_RING_MAX_SLOTS
+#define FRAME_RING_HEADER_SIZE   12  // FRAME_PACKET_HEADER_SIZE
+#define FRAME_RING_MAX_SEGMENTS  64  // Packets a frame can span without being copied
+
+// Results of frame_ring_publish()
+#define FRAME_RING_PUBLISHED  0
+#define FRAME_RING_DROPPED    1  // No free slot for the next frame, frame discarded
+
+typedef struct frame_slot {
+    unsigned char *data;
+    size_t capacity;
+    size_t size;
+    // Frame metadata, set by the producer before publishing
+    unsigned long long start_time;  // First packet received
+    unsigned long long ready_time;  // EOI found
+    unsigned int frame_id;          // Producer's frame sequence number
+    unsigned int packet_count;      // Packets the frame spans
+    unsigned char header[FRAME_RING_HEADER_SIZE];  // Raw header of the first packet
+    // Payloads still in receive buffers, in order; 0 = the frame is in data
+    rx_segment_t segments[FRAME_RING_MAX_SEGMENTS];
+    int segment_count;
+    atomic32_t refs;    // Queue entry + leases; 0 = free for the producer
+    bool leased;        // Consumer-side: handed out by frame_ring_acquire()
+} frame_slot_t;
+
+typedef struct frame_ring {
+    frame_slot_t slots[FRAME_RING_MAX_SLOTS];
+    int slot_count;     // Slots the producer cycles through
+    int write_slot;     // Producer-owned slot under assembly
+
+    // Completed slot indices; head is written by the producer only,
+    // tail by the consumer only
+    int queue[FRAME_RING_QUEUE];
+    char pad0[CACHE_LINE_SIZE];
+    atomic32_t head;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+    atomic32_t tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+} frame_ring_t;
+
+/**
+ * Initialize an empty ring (slot buffers are attached by the caller)
+ *
+ * @param ring Ring to initialize
+ * @param slot_count Number of slots in use (2 to FRAME_RING_MAX_SLOTS)
+ */
+void frame_ring_init(frame_ring_t *ring, int slot_count);
+
+/**
+ * Change the number of slots in use
+ *
+ * Slots beyond the new count keep their buffers and any lease on them
+ * stays valid until released; they are just no longer filled. Neither
+ * producer nor consumer may be active and the queue must be empty (as
+ * after frame_ring_reset).
+ *
+ * @param ring Ring
+ * @param slot_count Number of slots in use (2 to FRAME_RING_MAX_SLOTS)
+ */
+void frame_ring_set_slot_count(frame_ring_t *ring, int slot_count);
+
+/**
+ * Drop all queued frames and restart on a free slot
+ *
+ * Leased frames stay valid. Neither producer nor consumer may be active.
+ *
+ * @param ring Ring
+ */
+void frame_ring_reset(frame_ring_t *ring);
+
+/**
+ * Get the slot the producer is assembling into (producer only)
+ *
+ * @param ring Ring
+ * @return Slot owned by the producer
+ */
+frame_slot_t* frame_ring_write_slot(frame_ring_t *ring);
+
+/**
+ * Publish the write slot as a completed frame and move to a free slot
+ * (producer only)
+ *
+ * When no other slot is free the frame is dropped instead, with its
+ * segment references, and the write slot stays where it is.
+ *
+ * @param ring Ring
+ * @param size Size of the completed frame
+ * @param was_empty Set to true if the queue was empty before this frame,
+ *                  i.e. a waiting consumer needs to be woken
+ * @return FRAME_RING_PUBLISHED or FRAME_RING_DROPPED
+ */
+int frame_ring_publish(frame_ring_t *ring, size_t size, bool *was_empty);
+
+/**
+ * Get the oldest completed frame without consuming it (consumer only)
+ *
+ * @param ring Ring
+ * @return Slot, or NULL if the queue is empty
+ */
+frame_slot_t* frame_ring_peek(frame_ring_t *ring);
+
+/**
+ * Count the completed frames waiting in the queue (consumer only)
+ *
+ * The producer may add more concurrently, never fewer.
+ *
+ * @param ring Ring
+ * @return Number of queued frames
+ */
+int frame_ring_queued(frame_ring_t *ring);
+
+/**
+ * Consume the frame returned by frame_ring_peek, dropping its receive
+ * buffer references (consumer only)
+ *
+ * @param ring Ring
+ */
+void frame_ring_pop(frame_ring_t *ring);
+
+/**
+ * Consume the oldest frame but keep its slot as a lease (consumer only)
+ *
+ * @param ring Ring
+ * @return Leased slot, or NULL if the queue is empty
+ */
+frame_slot_t* frame_ring_acquire(frame_ring_t *ring);
+
+/**
+ * Return a leased slot to the producer (consumer only)
+ *
+ * @param ring Ring
+ * @param data Data pointer of the leased slot
+ * @return true if the pointer belonged to a leased slot
+ */
+bool frame_ring_release(frame_ring_t *ring, const unsigned char *data);
+
+/**
+ * Copy a queued or leased frame to a buffer of at least slot->size bytes
+ * (consumer only)
+ *
+ * @param slot Slot
+ * @param out Destination
+ */
+void frame_slot_read(const frame_slot_t *slot, unsigned char *out);
+
+/**
+ * Gather a segmented frame into the slot's own buffer and drop its
+ * receive buffer references (consumer only, before handing out data)
+ *
+ * @param slot Queued or leased slot
+ */
+void frame_slot_coalesce(frame_slot_t *slot);
+
+/**
+ * Check whether the queue is empty, ordered against a concurrent publish
+ * (consumer only, call before blocking on the wakeup event)
+ *
+ * @param ring Ring
+ * @return true if the consumer may sleep until the producer signals
+ */
+bool frame_ring_empty_before_wait(frame_ring_t *ring);
+
+#endif // FRAME_RING_H
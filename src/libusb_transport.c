@@ -0,0 +1,656 @@
+/**
+ * Useeplus SuperCamera - libusb Transport
+ *
+ * See libusb_transport.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "libusb_transport.h"
+#include "platform.h"
+
+#include <libusb.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define READ_TIMEOUT_MS  1000  // Device-side timeout of bulk IN reads
+#define WRITE_TIMEOUT_MS 1000
+#define STREAMING_ALT_SETTING 1
+
+// Streaming: completions waiting for wait_stream. Each entry holds a pool
+// buffer or is the one error entry, so this never fills up
+#define STREAM_QUEUE_SIZE 256
+#define EVENT_POLL_MS     100   // Event handling timeout; a freed pool buffer cuts it short
+#define STREAM_STOP_MS    2000  // How long stop_stream waits for the event thread
+
+struct libusb_transport;
+
+typedef struct read_slot {
+    struct libusb_transfer *transfer;
+    int completed;      // Set by the completion callback
+    atomic32_t pending; // Submitted and not reaped yet; read by abort_reads
+    struct libusb_transport *owner;
+    rx_buffer_t *buffer;    // Streaming: pool buffer being read into
+} read_slot_t;
+
+// A completed streaming read; a NULL buffer carries an error
+typedef struct stream_entry {
+    rx_buffer_t *buffer;
+    size_t length;
+    int result;
+} stream_entry_t;
+
+typedef struct libusb_transport {
+    usb_transport_t base;
+    libusb_context *context;
+    libusb_device_handle *handle;
+    int interface_number;
+    bool claimed;
+    unsigned char pipe_in;
+    unsigned char pipe_out;
+    read_slot_t reads[USB_TRANSPORT_MAX_READS];
+
+    // Streaming: the first depth slots are resubmitted from their
+    // completion callbacks on event_thread, the only thread handling
+    // libusb events, and their buffers queued for wait_stream
+    rx_pool_t *pool;
+    int depth;
+    size_t transfer_size;
+    platform_thread_t *event_thread;
+    atomic32_t streaming;               // Between start_stream and stop_stream
+    platform_event_t *stream_ready;     // Set when the queue may have been seen empty
+    atomic32_t in_flight;               // Submitted reads whose callback has not run
+    atomic32_t stopping;                // No more submits; wait_stream aborts
+    bool stream_failed;                 // Event thread: the error entry is queued
+    stream_entry_t queue[STREAM_QUEUE_SIZE];
+    atomic32_t queue_head;              // Next entry wait_stream takes
+    atomic32_t queue_tail;              // Next entry the event thread fills
+} libusb_transport_t;
+
+static void set_transport_error(libusb_transport_t *t, const char *what, int rc) {
+    snprintf(t->base.error, sizeof(t->base.error), "%s failed: %s", what, libusb_error_name(rc));
+}
+
+// Parse "BBB:DDD" into bus number and device address
+static bool parse_path(const char *path, unsigned int *bus, unsigned int *address) {
+    return sscanf(path, "%u:%u", bus, address) == 2 && *bus <= 255 && *address <= 255;
+}
+
+static void LIBUSB_CALL read_complete(struct libusb_transfer *transfer) {
+    read_slot_t *slot = (read_slot_t*)transfer->user_data;
+    slot->completed = 1;
+}
+
+// Hand a completion to wait_stream (event thread)
+static void stream_push(libusb_transport_t *t, rx_buffer_t *buffer, size_t length, int result) {
+    long tail = atomic32_load_relaxed(&t->queue_tail);
+    stream_entry_t *entry = &t->queue[tail & (STREAM_QUEUE_SIZE - 1)];
+
+    entry->buffer = buffer;
+    entry->length = length;
+    entry->result = result;
+    atomic32_store_release(&t->queue_tail, tail + 1);
+
+    // Only a reader that emptied the queue can be waiting; pairs with the
+    // fence in lu_wait_stream
+    atomic_fence_full();
+    if (atomic32_load_acquire(&t->queue_head) == tail) {
+        platform_event_set(t->stream_ready);
+    }
+}
+
+// Queue the stream's error; later failures keep the first message
+static void stream_fail(libusb_transport_t *t, const char *format, ...) {
+    va_list args;
+
+    if (t->stream_failed) {
+        return;
+    }
+
+    va_start(args, format);
+    vsnprintf(t->base.error, sizeof(t->base.error), format, args);
+    va_end(args);
+
+    t->stream_failed = true;
+    stream_push(t, NULL, 0, USB_XFER_ERROR);
+}
+
+static void LIBUSB_CALL stream_complete(struct libusb_transfer *transfer);
+
+// (Re)submit a streaming read, claiming a buffer if it has none; a read
+// left unsubmitted for want of a buffer is retried by the event loop once
+// the pool wakes it
+static void stream_submit(libusb_transport_t *t, read_slot_t *read) {
+    int rc;
+
+    if (atomic32_load_acquire(&t->stopping) || t->stream_failed) {
+        if (read->buffer) {
+            rx_buffer_unref(read->buffer);
+            read->buffer = NULL;
+        }
+        return;
+    }
+
+    if (!read->buffer) {
+        read->buffer = rx_pool_get(t->pool);
+        if (!read->buffer) {
+            return;
+        }
+    }
+
+    libusb_fill_bulk_transfer(read->transfer, t->handle, t->pipe_in, read->buffer->data,
+                              (int)t->transfer_size, stream_complete, read, READ_TIMEOUT_MS);
+
+    atomic32_store_release(&read->pending, 1);
+    atomic32_fetch_add(&t->in_flight, 1);
+    rc = libusb_submit_transfer(read->transfer);
+    if (rc != LIBUSB_SUCCESS) {
+        atomic32_store_release(&read->pending, 0);
+        atomic32_fetch_add(&t->in_flight, -1);
+        rx_buffer_unref(read->buffer);
+        read->buffer = NULL;
+        stream_fail(t, "libusb_submit_transfer failed: %s", libusb_error_name(rc));
+    }
+}
+
+// Completion of a streaming read (event thread): queue the buffer and put
+// the read straight back on the bus with a fresh one
+static void LIBUSB_CALL stream_complete(struct libusb_transfer *transfer) {
+    read_slot_t *read = (read_slot_t*)transfer->user_data;
+    libusb_transport_t *t = read->owner;
+
+    switch (transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            // A device-side timeout without data is not worth reporting
+            if (transfer->actual_length > 0) {
+                stream_push(t, read->buffer, (size_t)transfer->actual_length, USB_XFER_OK);
+                read->buffer = NULL;
+            }
+            break;
+        case LIBUSB_TRANSFER_CANCELLED:
+            break;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            stream_fail(t, "Device disconnected");
+            break;
+        default:
+            stream_fail(t, "Bulk read failed: transfer status %d", (int)transfer->status);
+            break;
+    }
+
+    atomic32_store_release(&read->pending, 0);
+    atomic32_fetch_add(&t->in_flight, -1);
+    stream_submit(t, read);
+}
+
+// Pool wake callback (any thread): a buffer is free for a starved read
+static void stream_pool_wake(void *context) {
+    libusb_transport_t *t = (libusb_transport_t*)context;
+    libusb_interrupt_event_handler(t->context);
+}
+
+// Streaming event loop. Created from the read thread, so it starts out
+// with the read thread's priority and affinity
+static void event_thread_proc(void *param) {
+    libusb_transport_t *t = (libusb_transport_t*)param;
+
+    // Run until stopped with every read back
+    while (!atomic32_load_acquire(&t->stopping) || atomic32_load_acquire(&t->in_flight) > 0) {
+        struct timeval tv;
+        int rc;
+
+        for (int i = 0; i < t->depth; i++) {
+            read_slot_t *read = &t->reads[i];
+
+            if (atomic32_load_acquire(&t->stopping)) {
+                // Also catches a read resubmitted while abort_reads ran
+                if (atomic32_load_acquire(&read->pending)) {
+                    libusb_cancel_transfer(read->transfer);
+                }
+            } else if (!atomic32_load_acquire(&read->pending)) {
+                // First submit, or no buffer was free when it completed
+                stream_submit(t, read);
+            }
+        }
+
+        // A read still without a buffer is retried when the pool wakes
+        // the event handler
+        tv.tv_sec = 0;
+        tv.tv_usec = EVENT_POLL_MS * 1000;
+        rc = libusb_handle_events_timeout_completed(t->context, &tv, NULL);
+        if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+            stream_fail(t, "libusb_handle_events failed: %s", libusb_error_name(rc));
+            break;
+        }
+    }
+}
+
+static int lu_open_device(usb_transport_t *transport, const char *path) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    libusb_device **list;
+    unsigned int bus, address;
+    ssize_t count;
+    int rc;
+
+    if (!parse_path(path, &bus, &address)) {
+        snprintf(t->base.error, sizeof(t->base.error), "Invalid device path '%s' (expected bus:address)", path);
+        return USB_XFER_ERROR;
+    }
+
+    rc = libusb_init(&t->context);
+    if (rc != LIBUSB_SUCCESS) {
+        t->context = NULL;
+        set_transport_error(t, "libusb_init", rc);
+        return USB_XFER_ERROR;
+    }
+
+    count = libusb_get_device_list(t->context, &list);
+    if (count < 0) {
+        set_transport_error(t, "libusb_get_device_list", (int)count);
+        return USB_XFER_ERROR;
+    }
+
+    rc = LIBUSB_ERROR_NO_DEVICE;
+    for (ssize_t i = 0; i < count; i++) {
+        if (libusb_get_bus_number(list[i]) == bus && libusb_get_device_address(list[i]) == address) {
+            rc = libusb_open(list[i], &t->handle);
+            break;
+        }
+    }
+    libusb_free_device_list(list, 1);
+
+    if (rc != LIBUSB_SUCCESS) {
+        t->handle = NULL;
+        set_transport_error(t, "Failed to open device: libusb_open", rc);
+        return USB_XFER_ERROR;
+    }
+
+    // A kernel driver bound to the interface is detached while it is
+    // claimed; not supported everywhere, and not needed where it is not
+    libusb_set_auto_detach_kernel_driver(t->handle, 1);
+
+    rc = libusb_claim_interface(t->handle, t->interface_number);
+    if (rc != LIBUSB_SUCCESS) {
+        snprintf(t->base.error, sizeof(t->base.error),
+                 "Failed to claim interface %d: %s. Possible issues:\n"
+                 "  1. Another application has the device open\n"
+                 "  2. Insufficient permissions (add a udev rule for 2ce3:3828)",
+                 t->interface_number, libusb_error_name(rc));
+        return USB_XFER_ERROR;
+    }
+    t->claimed = true;
+
+    // Clear any stale state from previous sessions and start at
+    // alternate setting 0
+    libusb_set_interface_alt_setting(t->handle, t->interface_number, 0);
+    libusb_clear_halt(t->handle, t->pipe_in);
+    libusb_clear_halt(t->handle, t->pipe_out);
+
+    return USB_XFER_OK;
+}
+
+static bool lu_stop_stream(usb_transport_t *transport);
+
+static void lu_close_device(usb_transport_t *transport) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+
+    if (t->event_thread) {
+        lu_stop_stream(transport);
+    }
+
+    if (t->handle) {
+        if (t->claimed) {
+            // Reset interface to default state before releasing it
+            libusb_set_interface_alt_setting(t->handle, t->interface_number, 0);
+            libusb_release_interface(t->handle, t->interface_number);
+        }
+        libusb_close(t->handle);
+    }
+
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        libusb_free_transfer(t->reads[i].transfer);
+    }
+
+    if (t->context) {
+        libusb_exit(t->context);
+    }
+
+    platform_event_destroy(t->stream_ready);
+    free(t);
+}
+
+static void lu_reset(usb_transport_t *transport) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+
+    if (t->handle) {
+        libusb_clear_halt(t->handle, t->pipe_in);
+    }
+}
+
+static int lu_start_streaming(usb_transport_t *transport) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    int rc;
+
+    // Reset to alternate setting 0 first, then set to 1 (clean state)
+    libusb_set_interface_alt_setting(t->handle, t->interface_number, 0);
+    libusb_clear_halt(t->handle, t->pipe_in);
+
+    rc = libusb_set_interface_alt_setting(t->handle, t->interface_number, STREAMING_ALT_SETTING);
+    if (rc != LIBUSB_SUCCESS) {
+        set_transport_error(t, "Failed to set alternate setting", rc);
+        return USB_XFER_ERROR;
+    }
+
+    return USB_XFER_OK;
+}
+
+static int lu_write_command(usb_transport_t *transport, const unsigned char *data, size_t length) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    int sent = 0;
+    int rc;
+
+    rc = libusb_bulk_transfer(t->handle, t->pipe_out, (unsigned char*)data, (int)length,
+                              &sent, WRITE_TIMEOUT_MS);
+    if (rc != LIBUSB_SUCCESS) {
+        set_transport_error(t, "libusb_bulk_transfer (OUT)", rc);
+        return USB_XFER_ERROR;
+    }
+
+    if ((size_t)sent != length) {
+        snprintf(t->base.error, sizeof(t->base.error), "Short write: %d / %zu bytes", sent, length);
+        return USB_XFER_ERROR;
+    }
+
+    return USB_XFER_OK;
+}
+
+static int lu_submit_read(usb_transport_t *transport, int slot,
+                          unsigned char *buffer, size_t length) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    read_slot_t *read = &t->reads[slot];
+    int rc;
+
+    read->completed = 0;
+    libusb_fill_bulk_transfer(read->transfer, t->handle, t->pipe_in, buffer, (int)length,
+                              read_complete, read, READ_TIMEOUT_MS);
+
+    rc = libusb_submit_transfer(read->transfer);
+    if (rc != LIBUSB_SUCCESS) {
+        set_transport_error(t, "libusb_submit_transfer", rc);
+        return USB_XFER_ERROR;
+    }
+
+    atomic32_store_release(&read->pending, 1);
+    return USB_XFER_OK;
+}
+
+static int lu_wait_read(usb_transport_t *transport, int slot,
+                        unsigned int timeout_ms, size_t *bytes_read) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    read_slot_t *read = &t->reads[slot];
+    unsigned long long frequency = platform_ticks_per_second();
+    unsigned long long deadline = platform_ticks() + (unsigned long long)timeout_ms * frequency / 1000;
+
+    *bytes_read = 0;
+
+    // Completion callbacks of every slot run here, on the reaping thread
+    while (!read->completed) {
+        int rc;
+
+        if (timeout_ms == USB_WAIT_INFINITE) {
+            rc = libusb_handle_events_completed(t->context, &read->completed);
+        } else {
+            unsigned long long now = platform_ticks();
+            unsigned long long remaining_us;
+            struct timeval tv;
+
+            if (now >= deadline) {
+                return USB_XFER_TIMEOUT;
+            }
+            remaining_us = (deadline - now) * 1000000ULL / frequency;
+            tv.tv_sec = (long)(remaining_us / 1000000ULL);
+            tv.tv_usec = (long)(remaining_us % 1000000ULL);
+            rc = libusb_handle_events_timeout_completed(t->context, &tv, &read->completed);
+        }
+
+        if (rc != LIBUSB_SUCCESS && rc != LIBUSB_ERROR_INTERRUPTED) {
+            set_transport_error(t, "libusb_handle_events", rc);
+            return USB_XFER_ERROR;
+        }
+    }
+
+    atomic32_store_release(&read->pending, 0);
+
+    switch (read->transfer->status) {
+        case LIBUSB_TRANSFER_COMPLETED:
+        case LIBUSB_TRANSFER_TIMED_OUT:
+            // A device-side timeout may still have delivered part of the data
+            *bytes_read = (size_t)read->transfer->actual_length;
+            return USB_XFER_OK;
+        case LIBUSB_TRANSFER_CANCELLED:
+            return USB_XFER_ABORTED;
+        case LIBUSB_TRANSFER_NO_DEVICE:
+            snprintf(t->base.error, sizeof(t->base.error), "Device disconnected");
+            return USB_XFER_ERROR;
+        default:
+            snprintf(t->base.error, sizeof(t->base.error), "Bulk read failed: transfer status %d",
+                     (int)read->transfer->status);
+            return USB_XFER_ERROR;
+    }
+}
+
+static void lu_abort_reads(usb_transport_t *transport) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    // Called from other threads than start_stream/stop_stream, so this
+    // goes by streaming, not event_thread
+    bool streaming = atomic32_load_acquire(&t->streaming) != 0;
+
+    // A stream stops resubmitting; the event thread cancels whatever
+    // slips past the loop below
+    if (streaming) {
+        atomic32_store_release(&t->stopping, 1);
+    }
+
+    // Cancelled transfers complete with LIBUSB_TRANSFER_CANCELLED in the
+    // reaping thread's wait_read; one that already finished is left alone
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        if (atomic32_load_acquire(&t->reads[i].pending)) {
+            libusb_cancel_transfer(t->reads[i].transfer);
+        }
+    }
+
+    if (streaming) {
+        platform_event_set(t->stream_ready);
+    }
+}
+
+static int lu_start_stream(usb_transport_t *transport, rx_pool_t *pool, int depth,
+                           size_t transfer_size) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+
+    if (depth < 1 || depth > USB_TRANSPORT_MAX_READS || t->event_thread) {
+        snprintf(t->base.error, sizeof(t->base.error), "Invalid stream (depth %d)", depth);
+        return USB_XFER_ERROR;
+    }
+
+    t->pool = pool;
+    t->depth = depth;
+    t->transfer_size = transfer_size;
+    t->stream_failed = false;
+    atomic32_store_relaxed(&t->in_flight, 0);
+    atomic32_store_relaxed(&t->stopping, 0);
+    atomic32_store_relaxed(&t->queue_head, 0);
+    atomic32_store_relaxed(&t->queue_tail, 0);
+    platform_event_reset(t->stream_ready);
+    rx_pool_set_wake(pool, stream_pool_wake, t);
+    atomic32_store_release(&t->streaming, 1);
+
+    // The event thread submits every read on its first pass; submit
+    // errors reach the reader through wait_stream
+    t->event_thread = platform_thread_create(event_thread_proc, t);
+    if (!t->event_thread) {
+        atomic32_store_release(&t->streaming, 0);
+        snprintf(t->base.error, sizeof(t->base.error), "Failed to create USB event thread: %lu",
+                 platform_last_error());
+        return USB_XFER_ERROR;
+    }
+
+    return USB_XFER_OK;
+}
+
+static int lu_wait_stream(usb_transport_t *transport, unsigned int timeout_ms,
+                          rx_buffer_t **buffer, size_t *length) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    unsigned long long frequency = platform_ticks_per_second();
+    unsigned long long deadline = platform_ticks() + (unsigned long long)timeout_ms * frequency / 1000;
+
+    *buffer = NULL;
+    *length = 0;
+
+    while (!atomic32_load_acquire(&t->stopping)) {
+        long head = atomic32_load_relaxed(&t->queue_head);
+        unsigned int wait_ms = PLATFORM_WAIT_INFINITE;
+
+        // Pairs with the fence in stream_push: either the event thread sees
+        // the queue emptied and sets the event, or this sees its entry
+        atomic_fence_full();
+        if (head != atomic32_load_acquire(&t->queue_tail)) {
+            stream_entry_t entry = t->queue[head & (STREAM_QUEUE_SIZE - 1)];
+
+            atomic32_store_release(&t->queue_head, head + 1);
+            if (entry.result == USB_XFER_OK) {
+                *buffer = entry.buffer;
+                *length = entry.length;
+            }
+            return entry.result;
+        }
+
+        if (timeout_ms != USB_WAIT_INFINITE) {
+            unsigned long long now = platform_ticks();
+
+            if (now >= deadline) {
+                return USB_XFER_TIMEOUT;
+            }
+            wait_ms = (unsigned int)((deadline - now) * 1000 / frequency) + 1;
+        }
+        platform_event_wait(t->stream_ready, wait_ms);
+    }
+
+    return USB_XFER_ABORTED;
+}
+
+static bool lu_stop_stream(usb_transport_t *transport) {
+    libusb_transport_t *t = (libusb_transport_t*)transport;
+    bool drained;
+
+    if (!t->event_thread) {
+        return true;
+    }
+
+    lu_abort_reads(transport);
+
+    if (platform_thread_wait(t->event_thread, STREAM_STOP_MS) == PLATFORM_WAIT_TIMEOUT) {
+        platform_thread_terminate(t->event_thread);
+    }
+    platform_thread_close(t->event_thread);
+    t->event_thread = NULL;
+    atomic32_store_release(&t->streaming, 0);
+
+    // Completions nobody picked up, and buffers of reads not resubmitted
+    while (atomic32_load_relaxed(&t->queue_head) != atomic32_load_relaxed(&t->queue_tail)) {
+        long head = atomic32_load_relaxed(&t->queue_head);
+        stream_entry_t *entry = &t->queue[head & (STREAM_QUEUE_SIZE - 1)];
+
+        if (entry->buffer) {
+            rx_buffer_unref(entry->buffer);
+        }
+        atomic32_store_relaxed(&t->queue_head, head + 1);
+    }
+
+    drained = atomic32_load_acquire(&t->in_flight) == 0;
+    for (int i = 0; i < t->depth; i++) {
+        if (t->reads[i].buffer && !atomic32_load_relaxed(&t->reads[i].pending)) {
+            rx_buffer_unref(t->reads[i].buffer);
+            t->reads[i].buffer = NULL;
+        }
+    }
+
+    return drained;
+}
+
+static const usb_transport_ops_t lu_ops = {
+    .open            = lu_open_device,
+    .close           = lu_close_device,
+    .reset           = lu_reset,
+    .start_streaming = lu_start_streaming,
+    .write_command   = lu_write_command,
+    .submit_read     = lu_submit_read,
+    .wait_read       = lu_wait_read,
+    .abort_reads     = lu_abort_reads,
+    .start_stream    = lu_start_stream,
+    .wait_stream     = lu_wait_stream,
+    .stop_stream     = lu_stop_stream,
+};
+
+usb_transport_t* libusb_transport_create(int interface_number, unsigned char pipe_in,
+                                         unsigned char pipe_out) {
+    libusb_transport_t *t = (libusb_transport_t*)calloc(1, sizeof(libusb_transport_t));
+
+    if (!t) {
+        return NULL;
+    }
+
+    t->base.ops = &lu_ops;
+    t->interface_number = interface_number;
+    t->pipe_in = pipe_in;
+    t->pipe_out = pipe_out;
+
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        t->reads[i].owner = t;
+        t->reads[i].transfer = libusb_alloc_transfer(0);
+        if (!t->reads[i].transfer) {
+            lu_close_device(&t->base);
+            return NULL;
+        }
+    }
+
+    t->stream_ready = platform_event_create(false);
+    if (!t->stream_ready) {
+        lu_close_device(&t->base);
+        return NULL;
+    }
+
+    return &t->base;
+}
+
+int libusb_transport_enumerate(unsigned short vendor_id, unsigned short product_id,
+                               char (*paths)[256], int max_paths) {
+    libusb_context *context;
+    libusb_device **list;
+    ssize_t count;
+    int found = 0;
+
+    if (libusb_init(&context) != LIBUSB_SUCCESS) {
+        return -1;
+    }
+
+    count = libusb_get_device_list(context, &list);
+    for (ssize_t i = 0; i < count && found < max_paths; i++) {
+        struct libusb_device_descriptor desc;
+
+        if (libusb_get_device_descriptor(list[i], &desc) == LIBUSB_SUCCESS &&
+            desc.idVendor == vendor_id && desc.idProduct == product_id) {
+            snprintf(paths[found++], 256, "%03u:%03u",
+                     (unsigned int)libusb_get_bus_number(list[i]),
+                     (unsigned int)libusb_get_device_address(list[i]));
+        }
+    }
+
+    if (count >= 0) {
+        libusb_free_device_list(list, 1);
+    }
+    libusb_exit(context);
+    return found;
+}
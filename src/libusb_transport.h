@@ -0,0 +1,51 @@
+/**
+ * Useeplus SuperCamera - libusb Transport
+ *
+ * usb_transport_t implementation on libusb-1.0, for Linux and other
+ * systems without WinUSB. Every transfer slot owns a libusb_transfer, so
+ * several bulk IN reads can be outstanding at once; wait_read runs
+ * libusb's event handling on the calling thread until the slot's transfer
+ * has completed.
+ *
+ * The transport also streams, which the read pipeline prefers: a
+ * dedicated event thread handles libusb events and resubmits each bulk IN
+ * transfer from its completion callback with a fresh buffer from the
+ * pipeline's pool, so the endpoint stays busy while the read thread is
+ * still parsing; completed buffers are queued to the read thread, which
+ * hands them to the frame assembler without copying.
+ *
+ * Devices are addressed by bus number and device address, written as
+ * "BBB:DDD" (the form lsusb shows).
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef LIBUSB_TRANSPORT_H
+#define LIBUSB_TRANSPORT_H
+
+#include "usb_transport.h"
+
+/**
+ * Create an unopened libusb transport
+ *
+ * @param interface_number Interface to claim
+ * @param pipe_in Bulk IN endpoint address
+ * @param pipe_out Bulk OUT endpoint address
+ * @return Transport, or NULL if out of memory
+ */
+usb_transport_t* libusb_transport_create(int interface_number, unsigned char pipe_in,
+                                         unsigned char pipe_out);
+
+/**
+ * Find attached devices by vendor and product id
+ *
+ * @param vendor_id USB vendor id
+ * @param product_id USB product id
+ * @param paths Receives a "BBB:DDD" path per device found
+ * @param max_paths Entries in paths
+ * @return Number of paths filled in, or -1 if libusb is unavailable
+ */
+int libusb_transport_enumerate(unsigned short vendor_id, unsigned short product_id,
+                               char (*paths)[256], int max_paths);
+
+#endif // LIBUSB_TRANSPORT_H
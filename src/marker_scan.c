@@ -0,0 +1,190 @@
+/**
+ * Useeplus SuperCamera - JPEG Marker Scanner
+ *
+ * See marker_scan.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "marker_scan.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    #include <intrin.h>
+    #define MARKER_SCAN_X86 1
+    #define TARGET_SSE2
+    #define TARGET_AVX2
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+    #include <immintrin.h>
+    #include <cpuid.h>
+    #define MARKER_SCAN_X86 1
+    #define TARGET_SSE2 __attribute__((target("sse2")))
+    #define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+typedef size_t (*find_ff_fn)(const unsigned char *data, size_t length);
+
+static size_t find_ff_scalar(const unsigned char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        if (data[i] == 0xFF) return i;
+    }
+    return length;
+}
+
+#ifdef MARKER_SCAN_X86
+
+// Index of the lowest set bit (mask must be non-zero)
+static unsigned int lowest_bit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (unsigned int)index;
+#else
+    return (unsigned int)__builtin_ctz(mask);
+#endif
+}
+
+TARGET_SSE2
+static size_t find_ff_sse2(const unsigned char *data, size_t length) {
+    const __m128i ff = _mm_set1_epi8((char)0xFF);
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, ff));
+        if (mask) return i + lowest_bit(mask);
+    }
+
+    return i + find_ff_scalar(data + i, length - i);
+}
+
+TARGET_AVX2
+static size_t find_ff_avx2(const unsigned char *data, size_t length) {
+    const __m256i ff = _mm256_set1_epi8((char)0xFF);
+    size_t i = 0;
+
+    for (; i + 32 <= length; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(data + i));
+        unsigned int mask = (unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, ff));
+        if (mask) return i + lowest_bit(mask);
+    }
+
+    // Finish the tail here rather than in find_ff_sse2 so no legacy-SSE
+    // code runs with dirty upper YMM state
+    if (i + 16 <= length) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(data + i));
+        unsigned int mask = (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm256_castsi256_si128(ff)));
+        if (mask) return i + lowest_bit(mask);
+        i += 16;
+    }
+
+    return i + find_ff_scalar(data + i, length - i);
+}
+
+static void cpuid(int regs[4], int leaf, int subleaf) {
+#ifdef _MSC_VER
+    __cpuidex(regs, leaf, subleaf);
+#else
+    unsigned int a = 0, b = 0, c = 0, d = 0;
+    __cpuid_count(leaf, subleaf, a, b, c, d);
+    regs[0] = (int)a; regs[1] = (int)b; regs[2] = (int)c; regs[3] = (int)d;
+#endif
+}
+
+static unsigned long long read_xcr0(void) {
+#ifdef _MSC_VER
+    return _xgetbv(0);
+#else
+    unsigned int eax, edx;
+    __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return ((unsigned long long)edx << 32) | eax;
+#endif
+}
+
+static int cpu_has_sse2(void) {
+    int regs[4];
+    cpuid(regs, 1, 0);
+    return (regs[3] >> 26) & 1;
+}
+
+static int cpu_has_avx2(void) {
+    int regs[4];
+
+    cpuid(regs, 0, 0);
+    if (regs[0] < 7) return 0;
+
+    // AVX support plus OS-enabled YMM state (OSXSAVE + XCR0 bits 1,2)
+    cpuid(regs, 1, 0);
+    if (!((regs[2] >> 27) & 1) || !((regs[2] >> 28) & 1)) return 0;
+    if ((read_xcr0() & 0x6) != 0x6) return 0;
+
+    cpuid(regs, 7, 0);
+    return (regs[1] >> 5) & 1;
+}
+
+#endif // MARKER_SCAN_X86
+
+static size_t find_ff_resolve(const unsigned char *data, size_t length);
+
+static find_ff_fn g_find_ff = find_ff_resolve;
+static int g_kernel = MARKER_SCAN_SCALAR;
+
+int marker_scan_supported(int kernel) {
+    switch (kernel) {
+        case MARKER_SCAN_AUTO:
+        case MARKER_SCAN_SCALAR:
+            return 1;
+#ifdef MARKER_SCAN_X86
+        case MARKER_SCAN_SSE2:
+            return cpu_has_sse2();
+        case MARKER_SCAN_AVX2:
+            return cpu_has_avx2();
+#endif
+        default:
+            return 0;
+    }
+}
+
+int marker_scan_select(int kernel) {
+    if (kernel == MARKER_SCAN_AUTO || kernel > MARKER_SCAN_AVX2) {
+        kernel = MARKER_SCAN_AVX2;
+    }
+    while (kernel > MARKER_SCAN_SCALAR && !marker_scan_supported(kernel)) {
+        kernel--;
+    }
+
+    switch (kernel) {
+#ifdef MARKER_SCAN_X86
+        case MARKER_SCAN_AVX2: g_find_ff = find_ff_avx2; break;
+        case MARKER_SCAN_SSE2: g_find_ff = find_ff_sse2; break;
+#endif
+        default:
+            kernel = MARKER_SCAN_SCALAR;
+            g_find_ff = find_ff_scalar;
+            break;
+    }
+
+    g_kernel = kernel;
+    return kernel;
+}
+
+// First call picks the kernel; racing threads all select the same one
+static size_t find_ff_resolve(const unsigned char *data, size_t length) {
+    marker_scan_select(MARKER_SCAN_AUTO);
+    return g_find_ff(data, length);
+}
+
+size_t marker_find_ff(const unsigned char *data, size_t length) {
+    return g_find_ff(data, length);
+}
+
+const char* marker_scan_kernel_name(void) {
+    if (g_find_ff == find_ff_resolve) {
+        marker_scan_select(MARKER_SCAN_AUTO);
+    }
+
+    switch (g_kernel) {
+        case MARKER_SCAN_AVX2: return "avx2";
+        case MARKER_SCAN_SSE2: return "sse2";
+        default:               return "scalar";
+    }
+}
@@ -0,0 +1,57 @@
+/**
+ * Useeplus SuperCamera - JPEG Marker Scanner
+ *
+ * Locates 0xFF bytes (JPEG marker candidates) in a buffer. On x86/x64 the
+ * search runs 16 (SSE2) or 32 (AVX2) bytes per step; the kernel is chosen
+ * once at runtime via CPUID, with a portable scalar loop as fallback.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef MARKER_SCAN_H
+#define MARKER_SCAN_H
+
+#include <stddef.h>
+
+// Scanner kernels
+#define MARKER_SCAN_AUTO    0  // Best kernel supported by this CPU
+#define MARKER_SCAN_SCALAR  1
+#define MARKER_SCAN_SSE2    2
+#define MARKER_SCAN_AVX2    3
+
+/**
+ * Find the first 0xFF byte
+ *
+ * @param data Buffer to search
+ * @param length Number of bytes to search
+ * @return Offset of the first 0xFF, or length if there is none
+ */
+size_t marker_find_ff(const unsigned char *data, size_t length);
+
+/**
+ * Select the scanner kernel
+ *
+ * Kernels the CPU does not support fall back to the next best one.
+ * Intended for benchmarks and verification; the library uses AUTO.
+ *
+ * @param kernel MARKER_SCAN_* kernel
+ * @return Kernel actually selected
+ */
+int marker_scan_select(int kernel);
+
+/**
+ * Check whether a kernel can run on this CPU
+ *
+ * @param kernel MARKER_SCAN_* kernel
+ * @return Non-zero if supported
+ */
+int marker_scan_supported(int kernel);
+
+/**
+ * Get the name of the active kernel ("scalar", "sse2" or "avx2")
+ *
+ * @return Kernel name
+ */
+const char* marker_scan_kernel_name(void);
+
+#endif // MARKER_SCAN_H
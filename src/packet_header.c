@@ -0,0 +1,115 @@
+/**
+ * Useeplus SuperCamera - Packet Header Decoding
+ *
+ * See packet_header.h for the layout.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "packet_header.h"
+
+#include <string.h>
+
+static unsigned short read_u16(const unsigned char *p) {
+    return (unsigned short)(p[0] | (p[1] << 8));
+}
+
+static void write_u16(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+bool packet_header_decode(const unsigned char *packet, size_t length, packet_header_t *header) {
+    if (length < PACKET_HEADER_SIZE || packet[0] != 0xaa || packet[1] != 0xbb) {
+        return false;
+    }
+
+    header->type = packet[2];
+    header->camera = packet[3];
+    header->frame_id = packet[4];
+    header->flags = packet[5];
+    header->packet_index = read_u16(packet + 6);
+    header->payload_length = read_u16(packet + 8);
+    return true;
+}
+
+void packet_header_encode(unsigned char *out, const packet_header_t *header) {
+    memset(out, 0, PACKET_HEADER_SIZE);
+    out[0] = 0xaa;
+    out[1] = 0xbb;
+    out[2] = header->type;
+    out[3] = header->camera;
+    out[4] = header->frame_id;
+    out[5] = header->flags;
+    write_u16(out + 6, header->packet_index);
+    write_u16(out + 8, header->payload_length);
+}
+
+void packet_stream_init(packet_stream_t *ps) {
+    memset(ps, 0, sizeof(*ps));
+}
+
+void packet_stream_resync(packet_stream_t *ps) {
+    ps->trusted = false;
+    ps->consistent = 0;
+    ps->have_last = false;
+}
+
+int packet_stream_check(packet_stream_t *ps, const packet_header_t *header,
+                        size_t payload_size, bool payload_soi) {
+    unsigned int lost_packets = 0;
+    unsigned int lost_frames = 0;
+    bool new_frame = false;
+
+    // Video data whose length field matches, with SOI on packet 0 and only there
+    bool fits = header->type == PACKET_TYPE_VIDEO &&
+                header->payload_length == payload_size &&
+                payload_soi == (header->packet_index == 0);
+
+    if (fits && ps->have_last) {
+        if (header->frame_id == ps->last_frame_id) {
+            if (header->packet_index <= ps->last_index) {
+                fits = false;  // Repeated or reordered - not a counter after all
+            } else {
+                lost_packets = header->packet_index - ps->last_index - 1u;
+            }
+        } else {
+            // The tail of the previous frame may be missing too; that part
+            // of a loss cannot be counted
+            new_frame = true;
+            lost_frames = (unsigned char)(header->frame_id - ps->last_frame_id - 1);
+            lost_packets = header->packet_index;
+        }
+    }
+
+    ps->have_last = true;
+    ps->last_frame_id = header->frame_id;
+    ps->last_index = header->packet_index;
+
+    if (!fits) {
+        if (ps->trusted) {
+            ps->trusted = false;
+            ps->resyncs++;
+        }
+        ps->consistent = 0;
+        return PACKET_UNTRUSTED;
+    }
+
+    if (!ps->trusted) {
+        // A gap before the layout is confirmed is as likely a wrong guess
+        if (lost_packets || lost_frames) {
+            ps->consistent = 0;
+        } else if (++ps->consistent >= PACKET_STREAM_TRUST_AFTER) {
+            ps->trusted = true;
+        }
+        return PACKET_UNTRUSTED;
+    }
+
+    if (lost_packets || lost_frames) {
+        ps->lost_packets += lost_packets;
+        ps->lost_frames += lost_frames;
+        return PACKET_LOST;
+    }
+
+    return new_frame ? PACKET_FRAME_START : PACKET_IN_SEQUENCE;
+}
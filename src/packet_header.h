@@ -0,0 +1,109 @@
+/**
+ * Useeplus SuperCamera - Packet Header Decoding
+ *
+ * Every bulk packet starts with a 12-byte proprietary header. The original
+ * driver only checks the AA BB 07 prefix; the rest of the layout below is
+ * inferred and not confirmed by the vendor (all integers little-endian):
+ *
+ *   u8[2]  magic           AA BB
+ *   u8     type            07 = video data
+ *   u8     camera          Camera / lens index
+ *   u8     frame_id        Incremented once per frame, wraps at 256
+ *   u8     flags           Not interpreted
+ *   u16    packet_index    Packet number within the frame, from 0
+ *   u16    payload_length  Bytes following the header
+ *   u16    reserved
+ *
+ * Because the layout is a hypothesis, the stream checker only trusts it
+ * after PACKET_STREAM_TRUST_AFTER packets in a row agree with it and with
+ * the payload (SOI exactly on packet 0). While trusted, index and frame id
+ * gaps reveal lost packets and frames; any disagreement drops the trust
+ * and the caller falls back to JPEG marker scanning alone.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef PACKET_HEADER_H
+#define PACKET_HEADER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PACKET_HEADER_SIZE         12   // FRAME_PACKET_HEADER_SIZE
+#define PACKET_TYPE_VIDEO          0x07
+#define PACKET_STREAM_TRUST_AFTER  64   // Consistent packets before gaps count as loss
+
+// Results of packet_stream_check()
+#define PACKET_UNTRUSTED    0  // Layout not (or no longer) confirmed, header ignored
+#define PACKET_IN_SEQUENCE  1  // Next packet of the current frame
+#define PACKET_FRAME_START  2  // First packet of the next frame
+#define PACKET_LOST         3  // Follows a gap, see lost_packets / lost_frames
+
+typedef struct packet_header {
+    unsigned char type;
+    unsigned char camera;
+    unsigned char frame_id;
+    unsigned char flags;
+    unsigned short packet_index;
+    unsigned short payload_length;
+} packet_header_t;
+
+typedef struct packet_stream {
+    bool trusted;
+    unsigned int consistent;        // Packets in a row that fit the layout
+    bool have_last;
+    unsigned char last_frame_id;
+    unsigned short last_index;
+
+    // Running counts
+    unsigned int lost_packets;      // Missing packet indices while trusted
+    unsigned int lost_frames;       // Missing frame ids while trusted
+    unsigned int resyncs;           // Times the layout stopped matching
+} packet_stream_t;
+
+/**
+ * Decode a packet header
+ *
+ * @param packet Packet data as read from the bulk endpoint
+ * @param length Packet length in bytes
+ * @param header Receives the fields
+ * @return false if the packet is too short or lacks the AA BB prefix
+ */
+bool packet_header_decode(const unsigned char *packet, size_t length, packet_header_t *header);
+
+/**
+ * Encode a packet header (synthetic streams)
+ *
+ * @param out Receives PACKET_HEADER_SIZE bytes
+ * @param header Fields; magic is added
+ */
+void packet_header_encode(unsigned char *out, const packet_header_t *header);
+
+/**
+ * Reset the stream checker to untrusted
+ *
+ * @param ps Checker
+ */
+void packet_stream_init(packet_stream_t *ps);
+
+/**
+ * Start over on a new stream: forget the previous packet and the trust,
+ * keep the counters
+ *
+ * @param ps Checker
+ */
+void packet_stream_resync(packet_stream_t *ps);
+
+/**
+ * Check a packet header against the previous ones
+ *
+ * @param ps Checker
+ * @param header Decoded header
+ * @param payload_size Bytes following the header
+ * @param payload_soi Payload starts with a JPEG SOI marker
+ * @return PACKET_* result; after PACKET_LOST the counters include the gap
+ */
+int packet_stream_check(packet_stream_t *ps, const packet_header_t *header,
+                        size_t payload_size, bool payload_soi);
+
+#endif // PACKET_HEADER_H
@@ -0,0 +1,224 @@
+/**
+ * Useeplus SuperCamera - Raw Packet Recorder
+ *
+ * See packet_recorder.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "packet_recorder.h"
+#include "capture_file.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_MASK (PACKET_RECORDER_RING_SIZE - 1)
+
+// Copy into the ring at a free-running position, wrapping at the end
+static void ring_copy(packet_recorder_t *r, uint32_t pos,
+                      const unsigned char *data, size_t length) {
+    size_t offset = pos & RING_MASK;
+    size_t first = PACKET_RECORDER_RING_SIZE - offset;
+
+    if (first > length) first = length;
+    memcpy(r->ring + offset, data, first);
+    if (length > first) {
+        memcpy(r->ring, data + first, length - first);
+    }
+}
+
+// Write everything the read thread has published so far (writer thread)
+static void drain(packet_recorder_t *r) {
+    uint32_t head = (uint32_t)atomic32_load_acquire(&r->head);
+    uint32_t tail = (uint32_t)r->tail;
+
+    while (tail != head) {
+        size_t offset = tail & RING_MASK;
+        size_t chunk = (size_t)(head - tail);
+
+        if (chunk > PACKET_RECORDER_RING_SIZE - offset) {
+            chunk = PACKET_RECORDER_RING_SIZE - offset;
+        }
+
+        // After a write error keep consuming so the read thread isn't
+        // stalled on a full ring; the recording is already incomplete
+        if (!r->write_failed) {
+            if (fwrite(r->ring + offset, 1, chunk, r->file) == chunk) {
+                r->bytes_written += chunk;
+            } else {
+                r->write_failed = true;
+            }
+        }
+
+        tail += (uint32_t)chunk;
+        atomic32_store_release(&r->tail, (long)tail);
+    }
+}
+
+static void writer_thread_proc(void *param) {
+    packet_recorder_t *r = (packet_recorder_t*)param;
+
+    while (platform_event_wait(r->stop_event, PACKET_RECORDER_FLUSH_INTERVAL) == PLATFORM_WAIT_TIMEOUT) {
+        drain(r);
+    }
+
+    // The read thread has left packet_recorder_write, nothing more arrives
+    drain(r);
+}
+
+packet_recorder_t* packet_recorder_create(void) {
+    packet_recorder_t *r = (packet_recorder_t*)calloc(1, sizeof(packet_recorder_t));
+    if (!r) {
+        return NULL;
+    }
+
+    r->stop_event = platform_event_create(true);
+    r->control_lock = platform_lock_create();
+    if (!r->stop_event || !r->control_lock) {
+        platform_event_destroy(r->stop_event);
+        platform_lock_destroy(r->control_lock);
+        free(r);
+        return NULL;
+    }
+
+    r->frequency = platform_ticks_per_second();
+    return r;
+}
+
+void packet_recorder_destroy(packet_recorder_t *r) {
+    if (!r) return;
+
+    packet_recorder_stop(r);
+    platform_event_destroy(r->stop_event);
+    platform_lock_destroy(r->control_lock);
+    free(r->ring);
+    free(r);
+}
+
+bool packet_recorder_start(packet_recorder_t *r, const char *path) {
+    unsigned char header[CAPTURE_FILE_HEADER_SIZE];
+
+    platform_lock_enter(r->control_lock);
+
+    if (atomic32_load_acquire(&r->active)) {
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    if (!r->ring) {
+        r->ring = (unsigned char*)malloc(PACKET_RECORDER_RING_SIZE);
+        if (!r->ring) {
+            platform_lock_leave(r->control_lock);
+            return false;
+        }
+    }
+
+    r->file = fopen(path, "wb");
+    if (!r->file) {
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    capture_encode_file_header(header);
+    if (fwrite(header, 1, sizeof(header), r->file) != sizeof(header)) {
+        fclose(r->file);
+        r->file = NULL;
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    // The ring was drained by the last stop, so head == tail here
+    r->dropped = 0;
+    r->write_failed = false;
+    r->bytes_written = sizeof(header);
+    platform_event_reset(r->stop_event);
+
+    r->writer_thread = platform_thread_create(writer_thread_proc, r);
+    if (!r->writer_thread) {
+        fclose(r->file);
+        r->file = NULL;
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    r->start_time = platform_ticks();
+    atomic32_store_release(&r->active, 1);
+
+    platform_lock_leave(r->control_lock);
+    return true;
+}
+
+unsigned int packet_recorder_stop(packet_recorder_t *r) {
+    unsigned int dropped;
+
+    platform_lock_enter(r->control_lock);
+
+    if (!atomic32_load_acquire(&r->active)) {
+        platform_lock_leave(r->control_lock);
+        return 0;
+    }
+
+    // Dekker-style handshake with packet_recorder_write: after the fence
+    // either the read thread sees active == 0, or we see its busy flag and
+    // wait for the packet it is copying
+    atomic32_store_release(&r->active, 0);
+    atomic_fence_full();
+    while (atomic32_load_acquire(&r->busy)) {
+        platform_sleep_ms(0);
+    }
+
+    // Let the writer drain the rest and exit
+    platform_event_set(r->stop_event);
+    platform_thread_wait(r->writer_thread, PLATFORM_WAIT_INFINITE);
+    platform_thread_close(r->writer_thread);
+    r->writer_thread = NULL;
+
+    if (fclose(r->file) != 0) {
+        r->write_failed = true;
+    }
+    r->file = NULL;
+
+    dropped = (unsigned int)r->dropped;
+
+    platform_lock_leave(r->control_lock);
+    return dropped;
+}
+
+bool packet_recorder_is_active(packet_recorder_t *r) {
+    return atomic32_load_acquire(&r->active) != 0;
+}
+
+void packet_recorder_write(packet_recorder_t *r, const unsigned char *data, size_t length) {
+    unsigned char header[CAPTURE_RECORD_HEADER_SIZE];
+
+    // Cheap check first so an idle recorder costs one load per packet
+    if (!atomic32_load_acquire(&r->active)) {
+        return;
+    }
+
+    atomic32_store_release(&r->busy, 1);
+    atomic_fence_full();
+
+    if (atomic32_load_acquire(&r->active)) {
+        uint32_t head = (uint32_t)r->head;
+        uint32_t tail = (uint32_t)atomic32_load_acquire(&r->tail);
+        size_t used = (size_t)(head - tail);
+        size_t needed = CAPTURE_RECORD_HEADER_SIZE + length;
+
+        if (needed > PACKET_RECORDER_RING_SIZE - used) {
+            // Writer is behind; never wait for it on the read thread
+            atomic32_fetch_add(&r->dropped, 1);
+        } else {
+            unsigned long long ticks;
+
+            ticks = platform_ticks() - r->start_time;
+
+            capture_encode_record_header(header, ticks * 1000000ULL / r->frequency, length);
+            ring_copy(r, head, header, sizeof(header));
+            ring_copy(r, head + (uint32_t)sizeof(header), data, length);
+            atomic32_store_release(&r->head, (long)(head + (uint32_t)needed));
+        }
+    }
+
+    atomic32_store_release(&r->busy, 0);
+}
@@ -0,0 +1,112 @@
+/**
+ * Useeplus SuperCamera - Raw Packet Recorder
+ *
+ * Records every bulk IN transfer the read thread receives to a capture
+ * file (see capture_file.h), stamped with its arrival time, so a session
+ * can be replayed or analyzed offline.
+ *
+ * The read thread only copies the packet into a lock-free byte ring; a
+ * background writer thread drains the ring to disk. The read thread never
+ * waits on the file system - when the writer falls behind and the ring is
+ * full, the packet is left out of the recording and counted as dropped.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef PACKET_RECORDER_H
+#define PACKET_RECORDER_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "atomics.h"
+#include "platform.h"
+
+#define PACKET_RECORDER_RING_SIZE      (16*1024*1024)  // Power of two
+#define PACKET_RECORDER_FLUSH_INTERVAL 10              // Writer wakeup, ms
+
+typedef struct packet_recorder {
+    platform_lock_t *control_lock;  // Serializes start/stop
+    FILE *file;
+    platform_thread_t *writer_thread;
+    platform_event_t *stop_event;
+
+    unsigned char *ring;            // Encoded records, allocated on first start
+    unsigned long long start_time;  // platform_ticks()
+    unsigned long long frequency;
+
+    // Recording on/off and the producer's in-write flag (see
+    // packet_recorder_stop for how the two are used together)
+    atomic32_t active;
+    atomic32_t busy;
+    atomic32_t dropped;             // Packets that did not fit in the ring
+
+    // Byte positions, free-running; head is written by the read thread
+    // only, tail by the writer thread only
+    char pad0[CACHE_LINE_SIZE];
+    atomic32_t head;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+    atomic32_t tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+
+    bool write_failed;              // Writer thread only
+    unsigned long long bytes_written;
+} packet_recorder_t;
+
+/**
+ * Create an idle recorder
+ *
+ * @return Recorder, or NULL if out of memory
+ */
+packet_recorder_t* packet_recorder_create(void);
+
+/**
+ * Stop recording and free the recorder
+ *
+ * The read thread must no longer call packet_recorder_write.
+ *
+ * @param r Recorder (may be NULL)
+ */
+void packet_recorder_destroy(packet_recorder_t *r);
+
+/**
+ * Start recording to a new capture file
+ *
+ * @param r Recorder
+ * @param path Capture file path, overwritten if it exists
+ * @return true on success, false if already recording or the file,
+ *         ring or writer thread could not be created
+ */
+bool packet_recorder_start(packet_recorder_t *r, const char *path);
+
+/**
+ * Stop recording, write out everything still buffered and close the file
+ *
+ * Safe to call while the read thread is writing packets.
+ *
+ * @param r Recorder
+ * @return Number of packets dropped because the ring was full
+ */
+unsigned int packet_recorder_stop(packet_recorder_t *r);
+
+/**
+ * Check whether a recording is in progress
+ *
+ * @param r Recorder
+ * @return true while recording
+ */
+bool packet_recorder_is_active(packet_recorder_t *r);
+
+/**
+ * Append one received packet (read thread only, never blocks)
+ *
+ * Does nothing when not recording.
+ *
+ * @param r Recorder
+ * @param data Packet data
+ * @param length Packet length
+ */
+void packet_recorder_write(packet_recorder_t *r, const unsigned char *data, size_t length);
+
+#endif // PACKET_RECORDER_H
@@ -0,0 +1,563 @@
+/**
+ * Useeplus SuperCamera - Parallel JPEG Decoder
+ *
+ * See parallel_decoder.h for an overview.
+ *
+ * Slot states and tickets are guarded by the decoder lock; each deque
+ * has its own lock, taken after the decoder lock when both are needed.
+ * Tickets [tail, head) are the frames submitted and not yet taken, and
+ * ticket t lives in slot t % frames, so the ring is full exactly when
+ * the slot for ticket head is still in use.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "parallel_decoder.h"
+#include "atomics.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Slot states
+#define SLOT_FREE      0
+#define SLOT_FILLING   1   // Producer copying the JPEG in, outside the lock
+#define SLOT_QUEUED    2   // Ticket in a worker's deque
+#define SLOT_DECODING  3
+#define SLOT_DONE      4   // Decoded (or failed), waiting for the consumer
+#define SLOT_HELD      5   // Taken by the consumer, not yet released
+
+typedef struct decode_slot {
+    int state;
+    unsigned long long ticket;
+    int worker;                 // Deque holding the ticket while queued
+    bool discard;               // Flushed while decoding: free it when done
+    bool failed;
+    unsigned char *jpeg;
+    size_t jpeg_size;
+    size_t jpeg_capacity;
+    unsigned char *image;
+    size_t image_capacity;
+    decode_result_t result;
+} decode_slot_t;
+
+typedef struct decode_worker {
+    parallel_decoder_t *pd;
+    int index;
+    platform_thread_t *thread;
+    platform_event_t *wake;
+    frame_decoder_t *decoder;
+    bool idle;                  // Waiting for work (decoder lock)
+
+    // Ticket deque: the owner takes from the front, thieves from the back
+    platform_lock_t *lock;
+    unsigned long long tickets[PARALLEL_DECODER_MAX_FRAMES];
+    int first;
+    int count;
+} decode_worker_t;
+
+struct parallel_decoder {
+    platform_lock_t *lock;
+    platform_event_t *ready;        // A slot finished decoding, or the tail moved
+    platform_event_t *space;        // A slot became free or finished decoding
+    atomic32_t stopping;            // Set by destroy; workers exit
+
+    int format;
+    int policy;
+    int target_width;
+    int target_height;
+
+    int frames;
+    decode_slot_t slots[PARALLEL_DECODER_MAX_FRAMES];
+    unsigned long long head;        // Next ticket to submit
+    unsigned long long tail;        // Next ticket to take
+    unsigned int generation;        // Bumped by flush
+    int held;
+
+    int threads;
+    decode_worker_t workers[PARALLEL_DECODER_MAX_THREADS];
+
+    parallel_decoder_stats_t stats;
+};
+
+static void deque_push(decode_worker_t *w, unsigned long long ticket) {
+    platform_lock_enter(w->lock);
+    w->tickets[(w->first + w->count) % PARALLEL_DECODER_MAX_FRAMES] = ticket;
+    w->count++;
+    platform_lock_leave(w->lock);
+}
+
+static bool deque_take(decode_worker_t *w, bool oldest, unsigned long long *ticket) {
+    bool taken = false;
+
+    platform_lock_enter(w->lock);
+    if (w->count > 0) {
+        if (oldest) {
+            *ticket = w->tickets[w->first];
+            w->first = (w->first + 1) % PARALLEL_DECODER_MAX_FRAMES;
+        } else {
+            *ticket = w->tickets[(w->first + w->count - 1) % PARALLEL_DECODER_MAX_FRAMES];
+        }
+        w->count--;
+        taken = true;
+    }
+    platform_lock_leave(w->lock);
+    return taken;
+}
+
+// Take a dropped or flushed ticket back out; a worker may have popped it
+// already, in which case it finds the slot reassigned and skips it
+static void deque_remove(decode_worker_t *w, unsigned long long ticket) {
+    platform_lock_enter(w->lock);
+    for (int i = 0; i < w->count; i++) {
+        if (w->tickets[(w->first + i) % PARALLEL_DECODER_MAX_FRAMES] == ticket) {
+            for (int j = i; j < w->count - 1; j++) {
+                w->tickets[(w->first + j) % PARALLEL_DECODER_MAX_FRAMES] =
+                    w->tickets[(w->first + j + 1) % PARALLEL_DECODER_MAX_FRAMES];
+            }
+            w->count--;
+            break;
+        }
+    }
+    platform_lock_leave(w->lock);
+}
+
+// Own deque first, then steal
+static bool take_ticket(decode_worker_t *w, unsigned long long *ticket, bool *stolen) {
+    parallel_decoder_t *pd = w->pd;
+
+    *stolen = false;
+    if (deque_take(w, true, ticket)) {
+        return true;
+    }
+    for (int i = 1; i < pd->threads; i++) {
+        if (deque_take(&pd->workers[(w->index + i) % pd->threads], false, ticket)) {
+            *stolen = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Free a slot that was never taken (decoder lock held)
+static void drop_slot(parallel_decoder_t *pd, decode_slot_t *slot) {
+    if (slot->state == SLOT_QUEUED) {
+        deque_remove(&pd->workers[slot->worker], slot->ticket);
+    }
+    if (slot->state == SLOT_DECODING) {
+        slot->discard = true;
+    } else {
+        slot->state = SLOT_FREE;
+    }
+}
+
+static bool grow(unsigned char **buffer, size_t *capacity, size_t size) {
+    unsigned char *grown;
+
+    if (size <= *capacity) {
+        return true;
+    }
+    grown = (unsigned char*)realloc(*buffer, size);
+    if (!grown) {
+        return false;
+    }
+    *buffer = grown;
+    *capacity = size;
+    return true;
+}
+
+static void decode_slot(decode_worker_t *w, decode_slot_t *slot, int target_width, int target_height) {
+    parallel_decoder_t *pd = w->pd;
+    decode_result_t *result = &slot->result;
+    unsigned long long start = platform_ticks();
+
+    slot->failed = true;
+    if (!frame_decoder_start(w->decoder, slot->jpeg, slot->jpeg_size, pd->format,
+                             target_width, target_height, &result->image)) {
+        snprintf(result->error, sizeof(result->error), "%s", frame_decoder_error(w->decoder));
+    } else if (!grow(&slot->image, &slot->image_capacity, result->image.size)) {
+        frame_decoder_abort(w->decoder);
+        snprintf(result->error, sizeof(result->error), "Out of memory for a %dx%d image",
+                 result->image.width, result->image.height);
+    } else if (!frame_decoder_finish(w->decoder, slot->image)) {
+        snprintf(result->error, sizeof(result->error), "%s", frame_decoder_error(w->decoder));
+    } else {
+        result->data = slot->image;
+        slot->failed = false;
+    }
+    result->decode_ticks = platform_ticks() - start;
+}
+
+static void run_ticket(decode_worker_t *w, unsigned long long ticket, bool stolen) {
+    parallel_decoder_t *pd = w->pd;
+    decode_slot_t *slot = &pd->slots[ticket % (unsigned long long)pd->frames];
+    int target_width, target_height;
+
+    platform_lock_enter(pd->lock);
+    if (slot->ticket != ticket || slot->state != SLOT_QUEUED) {
+        platform_lock_leave(pd->lock);
+        return;  // Dropped or flushed after it left the deque
+    }
+    slot->state = SLOT_DECODING;
+    target_width = pd->target_width;
+    target_height = pd->target_height;
+    if (stolen) {
+        pd->stats.stolen++;
+    }
+    platform_lock_leave(pd->lock);
+
+    // The slot belongs to this worker until it is marked done
+    decode_slot(w, slot, target_width, target_height);
+
+    platform_lock_enter(pd->lock);
+    pd->stats.decoded++;
+    if (slot->failed) {
+        pd->stats.failed++;
+    }
+    if (slot->discard) {
+        slot->discard = false;
+        slot->state = SLOT_FREE;
+    } else {
+        slot->state = SLOT_DONE;
+    }
+    platform_lock_leave(pd->lock);
+
+    platform_event_set(pd->ready);
+    platform_event_set(pd->space);
+}
+
+static void worker_proc(void *arg) {
+    decode_worker_t *w = (decode_worker_t*)arg;
+    parallel_decoder_t *pd = w->pd;
+    unsigned long long ticket;
+    bool stolen;
+
+    while (!atomic32_load_acquire(&pd->stopping)) {
+        if (!take_ticket(w, &ticket, &stolen)) {
+            // Announce idleness, then look once more: a ticket pushed
+            // before the producer saw the flag is found here, one pushed
+            // after comes with a wakeup
+            platform_lock_enter(pd->lock);
+            w->idle = true;
+            platform_lock_leave(pd->lock);
+
+            if (!take_ticket(w, &ticket, &stolen)) {
+                platform_event_wait(w->wake, PLATFORM_WAIT_INFINITE);
+                continue;
+            }
+
+            platform_lock_enter(pd->lock);
+            w->idle = false;
+            platform_lock_leave(pd->lock);
+        }
+        run_ticket(w, ticket, stolen);
+    }
+}
+
+// Milliseconds left until deadline (in ticks), 0 once passed
+static unsigned int remaining_ms(unsigned long long deadline) {
+    unsigned long long now = platform_ticks();
+
+    if (now >= deadline) {
+        return 0;
+    }
+    return (unsigned int)((deadline - now) * 1000ULL / platform_ticks_per_second()) + 1;
+}
+
+static unsigned long long deadline_after(unsigned int timeout_ms) {
+    if (timeout_ms == PLATFORM_WAIT_INFINITE) {
+        return ~0ULL;
+    }
+    return platform_ticks() + (unsigned long long)timeout_ms * platform_ticks_per_second() / 1000ULL;
+}
+
+// Wait on an event with the decoder lock released; false on timeout
+static bool wait_unlocked(parallel_decoder_t *pd, platform_event_t *event, unsigned long long deadline) {
+    unsigned int timeout = deadline == ~0ULL ? PLATFORM_WAIT_INFINITE : remaining_ms(deadline);
+    int result;
+
+    if (timeout == 0) {
+        return false;
+    }
+    platform_lock_leave(pd->lock);
+    result = platform_event_wait(event, timeout);
+    platform_lock_enter(pd->lock);
+    return result == PLATFORM_WAIT_OK;
+}
+
+parallel_decoder_t* parallel_decoder_create(int threads, int frames, int format, int policy) {
+    parallel_decoder_t *pd;
+
+    if (threads < 1 || threads > PARALLEL_DECODER_MAX_THREADS ||
+        frames <= threads || frames > PARALLEL_DECODER_MAX_FRAMES ||
+        format < FRAME_DECODER_RGBA || format > FRAME_DECODER_I420 ||
+        policy < PARALLEL_DECODER_BLOCK || policy > PARALLEL_DECODER_DROP_NEWEST) {
+        return NULL;
+    }
+
+    pd = (parallel_decoder_t*)calloc(1, sizeof(parallel_decoder_t));
+    if (!pd) {
+        return NULL;
+    }
+
+    pd->format = format;
+    pd->policy = policy;
+    pd->frames = frames;
+    pd->threads = threads;
+    pd->lock = platform_lock_create();
+    pd->ready = platform_event_create(false);
+    pd->space = platform_event_create(false);
+    if (!pd->lock || !pd->ready || !pd->space) {
+        parallel_decoder_destroy(pd);
+        return NULL;
+    }
+
+    for (int i = 0; i < threads; i++) {
+        decode_worker_t *w = &pd->workers[i];
+
+        w->pd = pd;
+        w->index = i;
+        w->lock = platform_lock_create();
+        w->wake = platform_event_create(false);
+        w->decoder = frame_decoder_create();
+        if (!w->lock || !w->wake || !w->decoder) {
+            parallel_decoder_destroy(pd);
+            return NULL;
+        }
+    }
+
+    // Started last, so destroy never waits on a worker that has no decoder
+    for (int i = 0; i < threads; i++) {
+        pd->workers[i].thread = platform_thread_create(worker_proc, &pd->workers[i]);
+        if (!pd->workers[i].thread) {
+            parallel_decoder_destroy(pd);
+            return NULL;
+        }
+    }
+
+    return pd;
+}
+
+void parallel_decoder_destroy(parallel_decoder_t *pd) {
+    if (!pd) {
+        return;
+    }
+
+    atomic32_store_release(&pd->stopping, 1);
+    for (int i = 0; i < pd->threads; i++) {
+        if (pd->workers[i].wake) {
+            platform_event_set(pd->workers[i].wake);
+        }
+    }
+
+    for (int i = 0; i < pd->threads; i++) {
+        decode_worker_t *w = &pd->workers[i];
+
+        if (w->thread) {
+            platform_thread_wait(w->thread, PLATFORM_WAIT_INFINITE);
+            platform_thread_close(w->thread);
+        }
+        frame_decoder_destroy(w->decoder);
+        platform_event_destroy(w->wake);
+        platform_lock_destroy(w->lock);
+    }
+
+    for (int i = 0; i < pd->frames; i++) {
+        free(pd->slots[i].jpeg);
+        free(pd->slots[i].image);
+    }
+
+    platform_event_destroy(pd->ready);
+    platform_event_destroy(pd->space);
+    platform_lock_destroy(pd->lock);
+    free(pd);
+}
+
+void parallel_decoder_set_target(parallel_decoder_t *pd, int width, int height) {
+    platform_lock_enter(pd->lock);
+    pd->target_width = width;
+    pd->target_height = height;
+    platform_lock_leave(pd->lock);
+}
+
+int parallel_decoder_submit(parallel_decoder_t *pd, const unsigned char *jpeg, size_t size,
+                            unsigned int sequence, unsigned long long timestamp,
+                            unsigned int timeout_ms) {
+    unsigned long long deadline = deadline_after(timeout_ms);
+    unsigned long long ticket;
+    unsigned int generation;
+    decode_slot_t *slot;
+    decode_worker_t *owner, *wake = NULL;
+
+    platform_lock_enter(pd->lock);
+    generation = pd->generation;
+    ticket = pd->head;
+    slot = &pd->slots[ticket % (unsigned long long)pd->frames];
+
+    // Make room
+    while (slot->state != SLOT_FREE) {
+        bool decoding = slot->state == SLOT_DECODING;
+
+        if (pd->policy == PARALLEL_DECODER_DROP_OLDEST && !decoding && slot->ticket >= pd->tail) {
+            // The slot holds the oldest frame not taken (ticket == tail)
+            drop_slot(pd, slot);
+            pd->tail++;
+            pd->stats.dropped++;
+            platform_event_set(pd->ready);
+            continue;
+        }
+        // Under DROP_OLDEST, the consumer holds the slot: nothing older can go
+        if (pd->policy == PARALLEL_DECODER_DROP_NEWEST ||
+            (pd->policy == PARALLEL_DECODER_DROP_OLDEST && !decoding)) {
+            pd->stats.dropped++;
+            platform_lock_leave(pd->lock);
+            return PARALLEL_DECODER_DROPPED;
+        }
+
+        // Blocking, or the oldest frame is mid-decode; a worker signals
+        // space when it is done
+
+        if (!wait_unlocked(pd, pd->space, deadline) && slot->state != SLOT_FREE) {
+            platform_lock_leave(pd->lock);
+            return PARALLEL_DECODER_TIMEOUT;
+        }
+        if (pd->generation != generation) {
+            platform_lock_leave(pd->lock);
+            return PARALLEL_DECODER_FLUSHED;
+        }
+    }
+
+    slot->state = SLOT_FILLING;
+    slot->ticket = ticket;
+    platform_lock_leave(pd->lock);
+
+    // Only the producer touches a filling slot
+    if (!grow(&slot->jpeg, &slot->jpeg_capacity, size)) {
+        platform_lock_enter(pd->lock);
+        slot->state = SLOT_FREE;
+        platform_lock_leave(pd->lock);
+        return PARALLEL_DECODER_FAILED;
+    }
+    memcpy(slot->jpeg, jpeg, size);
+    slot->jpeg_size = size;
+    memset(&slot->result, 0, sizeof(slot->result));
+    slot->result.sequence = sequence;
+    slot->result.timestamp = timestamp;
+
+    platform_lock_enter(pd->lock);
+    if (pd->generation != generation) {
+        slot->state = SLOT_FREE;
+        platform_lock_leave(pd->lock);
+        return PARALLEL_DECODER_FLUSHED;
+    }
+
+    // Queue round-robin; wake the owner, or another worker to steal it
+    // if the owner is busy
+    owner = &pd->workers[ticket % (unsigned long long)pd->threads];
+    slot->worker = owner->index;
+    slot->state = SLOT_QUEUED;
+    deque_push(owner, ticket);
+    pd->head++;
+    pd->stats.submitted++;
+
+    for (int i = 0; i < pd->threads && !wake; i++) {
+        decode_worker_t *w = &pd->workers[(owner->index + i) % pd->threads];
+        if (w->idle) {
+            w->idle = false;
+            wake = w;
+        }
+    }
+    platform_lock_leave(pd->lock);
+
+    if (wake) {
+        platform_event_set(wake->wake);
+    }
+    return PARALLEL_DECODER_OK;
+}
+
+int parallel_decoder_next(parallel_decoder_t *pd, unsigned int timeout_ms, decode_result_t *result) {
+    unsigned long long deadline = deadline_after(timeout_ms);
+    unsigned int generation;
+
+    platform_lock_enter(pd->lock);
+    generation = pd->generation;
+
+    while (true) {
+        if (pd->tail < pd->head) {
+            decode_slot_t *slot = &pd->slots[pd->tail % (unsigned long long)pd->frames];
+
+            if (slot->state == SLOT_DONE) {
+                *result = slot->result;
+                pd->tail++;
+                if (slot->failed) {
+                    slot->state = SLOT_FREE;
+                    platform_lock_leave(pd->lock);
+                    platform_event_set(pd->space);
+                    return PARALLEL_DECODER_FAILED;
+                }
+                slot->state = SLOT_HELD;
+                pd->held++;
+                platform_lock_leave(pd->lock);
+                return PARALLEL_DECODER_OK;
+            }
+        }
+
+        if (!wait_unlocked(pd, pd->ready, deadline)) {
+            platform_lock_leave(pd->lock);
+            return PARALLEL_DECODER_TIMEOUT;
+        }
+        if (pd->generation != generation) {
+            platform_lock_leave(pd->lock);
+            return PARALLEL_DECODER_FLUSHED;
+        }
+    }
+}
+
+bool parallel_decoder_release(parallel_decoder_t *pd, const unsigned char *data) {
+    bool released = false;
+
+    platform_lock_enter(pd->lock);
+    for (int i = 0; i < pd->frames && !released; i++) {
+        decode_slot_t *slot = &pd->slots[i];
+        if (slot->state == SLOT_HELD && slot->image == data) {
+            slot->state = SLOT_FREE;
+            pd->held--;
+            released = true;
+        }
+    }
+    platform_lock_leave(pd->lock);
+
+    if (released) {
+        platform_event_set(pd->space);
+    }
+    return released;
+}
+
+void parallel_decoder_flush(parallel_decoder_t *pd) {
+    platform_lock_enter(pd->lock);
+    pd->generation++;
+    for (unsigned long long t = pd->tail; t < pd->head; t++) {
+        drop_slot(pd, &pd->slots[t % (unsigned long long)pd->frames]);
+    }
+    pd->tail = pd->head;
+    platform_lock_leave(pd->lock);
+
+    platform_event_set(pd->ready);
+    platform_event_set(pd->space);
+}
+
+int parallel_decoder_held(parallel_decoder_t *pd) {
+    int held;
+
+    platform_lock_enter(pd->lock);
+    held = pd->held;
+    platform_lock_leave(pd->lock);
+    return held;
+}
+
+void parallel_decoder_get_stats(parallel_decoder_t *pd, parallel_decoder_stats_t *stats) {
+    platform_lock_enter(pd->lock);
+    *stats = pd->stats;
+    platform_lock_leave(pd->lock);
+}
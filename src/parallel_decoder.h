@@ -0,0 +1,175 @@
+/**
+ * Useeplus SuperCamera - Parallel JPEG Decoder
+ *
+ * Spreads frame decoding over a pool of worker threads and hands the
+ * results back in the order the frames were submitted. One producer
+ * thread submits frames, one consumer thread takes them out:
+ *
+ *   parallel_decoder_submit(pd, jpeg, size, sequence, time, timeout);
+ *   ...
+ *   parallel_decoder_next(pd, timeout, &result);       // in submit order
+ *   parallel_decoder_release(pd, result.data);
+ *
+ * Frames live in a fixed ring of slots that doubles as the reorder
+ * buffer: a submitted frame is copied into the next slot, and its ticket
+ * (submit count) is queued to one worker round-robin. Each worker has its
+ * own frame_decoder and its own ticket deque; it takes the oldest ticket
+ * from its own deque and, when that is empty, steals the newest from
+ * another worker's. Decoded images stay in their slot until the consumer
+ * has taken and released them, and the slot's JPEG and image buffers are
+ * kept for the next frame it carries.
+ *
+ * When every slot is in use, the policy decides what gives:
+ *
+ *   PARALLEL_DECODER_BLOCK        submit waits for a slot
+ *   PARALLEL_DECODER_DROP_OLDEST  the frame in the slot the new one needs
+ *                                 is dropped, if it has not been taken
+ *   PARALLEL_DECODER_DROP_NEWEST  the frame being submitted is dropped
+ *
+ * Slots are reused in ticket order, so with the ring full the slot the
+ * new frame needs holds the oldest frame submitted. DROP_OLDEST therefore
+ * drops the oldest frame not yet taken, and depending on that frame:
+ *
+ *   queued or decoded   dropped at once; a decoded frame's decode is wasted
+ *   being decoded       submit waits for the decode to finish, then drops it
+ *   held by consumer    nothing older can make room, so the new frame is
+ *                       dropped instead, as under DROP_NEWEST
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef PARALLEL_DECODER_H
+#define PARALLEL_DECODER_H
+
+#include "frame_decoder.h"
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define PARALLEL_DECODER_MAX_THREADS  16
+#define PARALLEL_DECODER_MAX_FRAMES   64
+
+// Backpressure policies, the same values as CAMERA_DECODE_*
+#define PARALLEL_DECODER_BLOCK        0
+#define PARALLEL_DECODER_DROP_OLDEST  1
+#define PARALLEL_DECODER_DROP_NEWEST  2
+
+// Results of parallel_decoder_submit and parallel_decoder_next
+#define PARALLEL_DECODER_OK       0
+#define PARALLEL_DECODER_DROPPED  1   // submit: the new frame was dropped
+#define PARALLEL_DECODER_TIMEOUT  2
+#define PARALLEL_DECODER_FLUSHED  3   // parallel_decoder_flush ran during the call
+#define PARALLEL_DECODER_FAILED   4   // submit: out of memory; next: the frame did not decode
+
+typedef struct parallel_decoder parallel_decoder_t;
+
+// A decoded frame, valid until parallel_decoder_release
+typedef struct decode_result {
+    frame_image_t image;
+    const unsigned char *data;          // Image buffer, image.size bytes
+    unsigned int sequence;              // As submitted
+    unsigned long long timestamp;       // As submitted
+    unsigned long long decode_ticks;    // Time the worker spent decoding
+    char error[128];                    // Why decoding failed (PARALLEL_DECODER_FAILED)
+} decode_result_t;
+
+typedef struct parallel_decoder_stats {
+    unsigned long long submitted;       // Frames accepted by submit
+    unsigned long long decoded;         // Frames decoded, including ones flushed afterwards
+    unsigned long long failed;          // Frames that did not decode
+    unsigned long long stolen;          // Frames a worker took from another's deque
+    unsigned int dropped;               // Frames dropped by the backpressure policy
+} parallel_decoder_stats_t;
+
+/**
+ * Create a decoder and start its worker threads
+ *
+ * @param threads Worker threads, 1 to PARALLEL_DECODER_MAX_THREADS
+ * @param frames Slots, threads + 1 to PARALLEL_DECODER_MAX_FRAMES; frames
+ *               held by the consumer count against them
+ * @param format FRAME_DECODER_*
+ * @param policy PARALLEL_DECODER_BLOCK / _DROP_OLDEST / _DROP_NEWEST
+ * @return Decoder, or NULL on invalid parameters or failure
+ */
+parallel_decoder_t* parallel_decoder_create(int threads, int frames, int format, int policy);
+
+/**
+ * Stop the workers and free everything, including frames still held
+ *
+ * @param pd Decoder (NULL is ignored)
+ */
+void parallel_decoder_destroy(parallel_decoder_t *pd);
+
+/**
+ * Set the target size of frames decoded from now on (see
+ * frame_decoder_start); 0 x 0 decodes at full size
+ *
+ * @param pd Decoder
+ * @param width Smallest useful output width, or 0
+ * @param height Smallest useful output height, or 0
+ */
+void parallel_decoder_set_target(parallel_decoder_t *pd, int width, int height);
+
+/**
+ * Copy a JPEG frame in and queue it for decoding (producer thread only)
+ *
+ * @param pd Decoder
+ * @param jpeg JPEG data, only read during the call
+ * @param size JPEG size in bytes
+ * @param sequence Passed through to the result
+ * @param timestamp Passed through to the result
+ * @param timeout_ms How long PARALLEL_DECODER_BLOCK waits for a slot,
+ *                   or PLATFORM_WAIT_INFINITE
+ * @return PARALLEL_DECODER_OK, _DROPPED, _TIMEOUT, _FLUSHED or _FAILED
+ */
+int parallel_decoder_submit(parallel_decoder_t *pd, const unsigned char *jpeg, size_t size,
+                            unsigned int sequence, unsigned long long timestamp,
+                            unsigned int timeout_ms);
+
+/**
+ * Take the next decoded frame, in submit order (consumer thread only)
+ *
+ * A frame that failed to decode is consumed and reported with
+ * PARALLEL_DECODER_FAILED and result->error; it needs no release.
+ *
+ * @param pd Decoder
+ * @param timeout_ms Timeout in ms, or PLATFORM_WAIT_INFINITE
+ * @param result Receives the frame
+ * @return PARALLEL_DECODER_OK, _TIMEOUT, _FLUSHED or _FAILED
+ */
+int parallel_decoder_next(parallel_decoder_t *pd, unsigned int timeout_ms, decode_result_t *result);
+
+/**
+ * Give a frame from parallel_decoder_next back (any thread)
+ *
+ * @param pd Decoder
+ * @param data result.data of the frame
+ * @return true if the frame was held from this decoder
+ */
+bool parallel_decoder_release(parallel_decoder_t *pd, const unsigned char *data);
+
+/**
+ * Drop every frame not yet taken, and end waits in submit and next with
+ * PARALLEL_DECODER_FLUSHED. Frames the consumer holds are kept.
+ *
+ * @param pd Decoder
+ */
+void parallel_decoder_flush(parallel_decoder_t *pd);
+
+/**
+ * Frames the consumer has taken and not released
+ *
+ * @param pd Decoder
+ * @return Held frame count
+ */
+int parallel_decoder_held(parallel_decoder_t *pd);
+
+/**
+ * Counters since create
+ *
+ * @param pd Decoder
+ * @param stats Receives the counters
+ */
+void parallel_decoder_get_stats(parallel_decoder_t *pd, parallel_decoder_stats_t *stats);
+
+#endif // PARALLEL_DECODER_H
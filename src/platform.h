@@ -0,0 +1,210 @@
+/**
+ * Useeplus SuperCamera - Platform Layer
+ *
+ * Operating system services the driver needs beyond C99, behind one
+ * interface with an implementation per OS: platform_win32.c (Win32) and
+ * platform_posix.c (pthreads, Linux extensions where available).
+ *
+ * Threads, events and locks behave like their Win32 counterparts, which
+ * the driver was written against: an event is auto- or manual-reset, a
+ * lock is recursive, a wait takes a timeout in milliseconds. The clock is
+ * monotonic (QueryPerformanceCounter, CLOCK_MONOTONIC) and counts
+ * platform_ticks_per_second() ticks per second.
+ *
+ * Thread scheduling: a thread applies its own attributes as it starts -
+ * priority, the realtime hint, the CPUs it may run on and a name for
+ * debuggers and profilers - and reverts them before it exits. Settings
+ * are applied independently and best effort; one the OS refuses (a
+ * realtime class without the privilege, a CPU outside the process's
+ * affinity) is reported and the thread runs on without it.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Storage class of thread-local variables
+#if defined(_MSC_VER)
+#define PLATFORM_THREAD_LOCAL __declspec(thread)
+#else
+#define PLATFORM_THREAD_LOCAL __thread
+#endif
+
+// Calling convention of callbacks the OS invokes (TLS destructors)
+#ifdef _WIN32
+#define PLATFORM_CALLBACK __stdcall
+#else
+#define PLATFORM_CALLBACK
+#endif
+
+#define PLATFORM_WAIT_INFINITE  0xFFFFFFFFu
+
+// Results of platform_thread_wait / platform_event_wait
+#define PLATFORM_WAIT_OK       0
+#define PLATFORM_WAIT_TIMEOUT  1
+#define PLATFORM_WAIT_FAILED   2
+
+typedef struct platform_thread platform_thread_t;
+typedef struct platform_event platform_event_t;
+typedef struct platform_lock platform_lock_t;
+typedef struct platform_tls platform_tls_t;
+
+typedef void (*platform_thread_proc_t)(void *arg);
+typedef void (PLATFORM_CALLBACK *platform_tls_destructor_t)(void *value);
+
+typedef struct platform_local_time {
+    int year, month, day;
+    int hour, minute, second, millisecond;
+} platform_local_time_t;
+
+/**
+ * Start a thread
+ *
+ * @param proc Thread function
+ * @param arg Passed to proc
+ * @return Thread, or NULL on failure (see platform_last_error)
+ */
+platform_thread_t* platform_thread_create(platform_thread_proc_t proc, void *arg);
+
+/**
+ * Wait for a thread to return
+ *
+ * @param thread Thread
+ * @param timeout_ms Timeout in ms, or PLATFORM_WAIT_INFINITE
+ * @return PLATFORM_WAIT_OK once it has returned, else PLATFORM_WAIT_TIMEOUT
+ */
+int platform_thread_wait(platform_thread_t *thread, unsigned int timeout_ms);
+
+/**
+ * Kill a thread that did not return (last resort: it gets no chance to
+ * release what it holds)
+ *
+ * @param thread Thread
+ */
+void platform_thread_terminate(platform_thread_t *thread);
+
+/**
+ * Release a thread handle; a thread still running is left to finish on
+ * its own
+ *
+ * @param thread Thread (may be NULL)
+ */
+void platform_thread_close(platform_thread_t *thread);
+
+// Id of the calling thread, as debuggers and the OS show it
+unsigned int platform_thread_id(void);
+
+/**
+ * Create an event, initially not signalled
+ *
+ * @param manual_reset true: stays signalled until reset; false: a
+ *                     successful wait resets it
+ * @return Event, or NULL on failure
+ */
+platform_event_t* platform_event_create(bool manual_reset);
+
+void platform_event_destroy(platform_event_t *event);
+void platform_event_set(platform_event_t *event);
+void platform_event_reset(platform_event_t *event);
+
+/**
+ * Wait until an event is signalled
+ *
+ * @param event Event
+ * @param timeout_ms Timeout in ms (0 = poll), or PLATFORM_WAIT_INFINITE
+ * @return PLATFORM_WAIT_OK, PLATFORM_WAIT_TIMEOUT or PLATFORM_WAIT_FAILED
+ */
+int platform_event_wait(platform_event_t *event, unsigned int timeout_ms);
+
+/**
+ * Create a recursive lock
+ *
+ * @return Lock, or NULL on failure
+ */
+platform_lock_t* platform_lock_create(void);
+
+void platform_lock_destroy(platform_lock_t *lock);
+void platform_lock_enter(platform_lock_t *lock);
+void platform_lock_leave(platform_lock_t *lock);
+
+/**
+ * Allocate a thread-local slot, NULL in every thread
+ *
+ * @param destructor Called with a thread's non-NULL value when the thread
+ *                   exits (may be NULL)
+ * @return Slot, or NULL on failure
+ */
+platform_tls_t* platform_tls_create(platform_tls_destructor_t destructor);
+
+void* platform_tls_get(platform_tls_t *tls);
+void platform_tls_set(platform_tls_t *tls, void *value);
+
+// Monotonic clock
+unsigned long long platform_ticks(void);
+unsigned long long platform_ticks_per_second(void);
+
+// Sleep; 0 gives up the rest of the time slice
+void platform_sleep_ms(unsigned int ms);
+
+// Wall-clock time in the local time zone
+void platform_local_time(platform_local_time_t *time);
+
+// Error code of the last failed platform call on this thread
+unsigned long platform_last_error(void);
+
+// Thread priorities, mapped onto the native scheduler
+#define PLATFORM_PRIORITY_NORMAL         0
+#define PLATFORM_PRIORITY_ABOVE_NORMAL   1
+#define PLATFORM_PRIORITY_HIGHEST        2
+#define PLATFORM_PRIORITY_TIME_CRITICAL  3
+
+#define PLATFORM_THREAD_NAME_SIZE  32
+
+typedef struct platform_thread_attr {
+    int priority;                       // PLATFORM_PRIORITY_*
+    bool realtime;                      // MMCSS "Capture" task (Windows), SCHED_FIFO (Linux)
+    unsigned long long affinity_mask;   // Bit n = CPU n; 0 = any CPU
+    const char *name;                   // NULL = leave unnamed
+} platform_thread_attr_t;
+
+// What a thread changed about itself, undone by platform_thread_revert
+typedef struct platform_thread_sched {
+    void *mmcss;                // MMCSS registration (Windows)
+    unsigned int failed;        // Settings the OS refused
+    char error[128];            // Why the first of them was refused
+} platform_thread_sched_t;
+
+/**
+ * Apply scheduling attributes to the calling thread
+ *
+ * @param sched Receives what was changed and what failed
+ * @param attr Attributes; PLATFORM_PRIORITY_NORMAL without realtime,
+ *             a zero mask and a NULL name leave the defaults alone
+ * @return true if every setting was applied
+ */
+bool platform_thread_apply(platform_thread_sched_t *sched, const platform_thread_attr_t *attr);
+
+/**
+ * Undo what platform_thread_apply registered for the calling thread
+ * (call before the thread exits)
+ *
+ * @param sched State filled in by platform_thread_apply
+ */
+void platform_thread_revert(platform_thread_sched_t *sched);
+
+/**
+ * Read back the calling thread's scheduling attributes
+ *
+ * @param attr Receives priority, realtime and affinity; name is set to
+ *             NULL unless name_buffer is given
+ * @param name_buffer Receives the thread name (may be NULL)
+ * @param name_size Size of name_buffer
+ * @return true on success
+ */
+bool platform_thread_query(platform_thread_attr_t *attr, char *name_buffer, size_t name_size);
+
+#endif // PLATFORM_H
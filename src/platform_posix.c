@@ -0,0 +1,533 @@
+/**
+ * Useeplus SuperCamera - Platform Layer (POSIX)
+ *
+ * See platform.h for an overview. Affinity, per-thread nice values and
+ * thread names use Linux extensions; elsewhere those settings report
+ * that they are not supported.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "platform.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#endif
+
+struct platform_thread {
+    pthread_t handle;
+    platform_thread_proc_t proc;
+    void *arg;
+
+    // pthreads can only join without a timeout, so the thread reports
+    // its return under the lock
+    pthread_mutex_t lock;
+    pthread_cond_t done_cond;
+    bool done;
+    bool joined;
+    bool detached;      // Handle closed while running; the thread frees the struct
+};
+
+struct platform_event {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool manual_reset;
+    bool signalled;
+};
+
+struct platform_lock {
+    pthread_mutex_t mutex;
+};
+
+struct platform_tls {
+    pthread_key_t key;
+};
+
+static PLATFORM_THREAD_LOCAL int last_error;
+
+// Condition variable timed against CLOCK_MONOTONIC, like the tick clock
+static bool init_cond(pthread_cond_t *cond) {
+    pthread_condattr_t attr;
+    bool ok;
+
+    if (pthread_condattr_init(&attr) != 0) {
+        return false;
+    }
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    ok = pthread_cond_init(cond, &attr) == 0;
+    pthread_condattr_destroy(&attr);
+    return ok;
+}
+
+static struct timespec deadline_after(unsigned int timeout_ms) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    return ts;
+}
+
+// Wait on cond until *flag is set; lock is held
+static int wait_flag(pthread_cond_t *cond, pthread_mutex_t *lock, bool *flag, unsigned int timeout_ms) {
+    struct timespec deadline;
+
+    if (timeout_ms == PLATFORM_WAIT_INFINITE) {
+        while (!*flag) {
+            pthread_cond_wait(cond, lock);
+        }
+        return PLATFORM_WAIT_OK;
+    }
+
+    deadline = deadline_after(timeout_ms);
+    while (!*flag) {
+        int error = pthread_cond_timedwait(cond, lock, &deadline);
+        if (error == ETIMEDOUT) {
+            return *flag ? PLATFORM_WAIT_OK : PLATFORM_WAIT_TIMEOUT;
+        }
+        if (error != 0) {
+            last_error = error;
+            return PLATFORM_WAIT_FAILED;
+        }
+    }
+    return PLATFORM_WAIT_OK;
+}
+
+static void free_thread(platform_thread_t *thread) {
+    pthread_cond_destroy(&thread->done_cond);
+    pthread_mutex_destroy(&thread->lock);
+    free(thread);
+}
+
+static void* thread_start(void *param) {
+    platform_thread_t *thread = (platform_thread_t*)param;
+    bool detached;
+
+    thread->proc(thread->arg);
+
+    pthread_mutex_lock(&thread->lock);
+    thread->done = true;
+    detached = thread->detached;
+    pthread_cond_broadcast(&thread->done_cond);
+    pthread_mutex_unlock(&thread->lock);
+
+    if (detached) {
+        free_thread(thread);
+    }
+    return NULL;
+}
+
+platform_thread_t* platform_thread_create(platform_thread_proc_t proc, void *arg) {
+    platform_thread_t *thread = (platform_thread_t*)calloc(1, sizeof(platform_thread_t));
+    int error;
+
+    if (!thread) {
+        last_error = ENOMEM;
+        return NULL;
+    }
+
+    thread->proc = proc;
+    thread->arg = arg;
+    pthread_mutex_init(&thread->lock, NULL);
+    if (!init_cond(&thread->done_cond)) {
+        last_error = EAGAIN;
+        pthread_mutex_destroy(&thread->lock);
+        free(thread);
+        return NULL;
+    }
+
+    if ((error = pthread_create(&thread->handle, NULL, thread_start, thread)) != 0) {
+        last_error = error;
+        free_thread(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+int platform_thread_wait(platform_thread_t *thread, unsigned int timeout_ms) {
+    int result;
+
+    if (thread->joined) {
+        return PLATFORM_WAIT_OK;
+    }
+
+    pthread_mutex_lock(&thread->lock);
+    result = wait_flag(&thread->done_cond, &thread->lock, &thread->done, timeout_ms);
+    pthread_mutex_unlock(&thread->lock);
+
+    if (result == PLATFORM_WAIT_OK) {
+        pthread_join(thread->handle, NULL);
+        thread->joined = true;
+        return PLATFORM_WAIT_OK;
+    }
+    return PLATFORM_WAIT_TIMEOUT;
+}
+
+void platform_thread_terminate(platform_thread_t *thread) {
+    // Cancelled at its next cancellation point (a blocking call)
+    if (!thread->joined) {
+        pthread_cancel(thread->handle);
+        pthread_join(thread->handle, NULL);
+        thread->joined = true;
+    }
+}
+
+void platform_thread_close(platform_thread_t *thread) {
+    bool running;
+
+    if (!thread) {
+        return;
+    }
+
+    if (thread->joined) {
+        free_thread(thread);
+        return;
+    }
+
+    pthread_mutex_lock(&thread->lock);
+    running = !thread->done;
+    thread->detached = running;
+    pthread_mutex_unlock(&thread->lock);
+
+    pthread_detach(thread->handle);
+    if (!running) {
+        free_thread(thread);
+    }
+}
+
+unsigned int platform_thread_id(void) {
+#ifdef __linux__
+    return (unsigned int)syscall(SYS_gettid);
+#else
+    return (unsigned int)(size_t)pthread_self();
+#endif
+}
+
+platform_event_t* platform_event_create(bool manual_reset) {
+    platform_event_t *event = (platform_event_t*)calloc(1, sizeof(platform_event_t));
+
+    if (!event) {
+        last_error = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_init(&event->lock, NULL);
+    if (!init_cond(&event->cond)) {
+        last_error = EAGAIN;
+        pthread_mutex_destroy(&event->lock);
+        free(event);
+        return NULL;
+    }
+
+    event->manual_reset = manual_reset;
+    return event;
+}
+
+void platform_event_destroy(platform_event_t *event) {
+    if (event) {
+        pthread_cond_destroy(&event->cond);
+        pthread_mutex_destroy(&event->lock);
+        free(event);
+    }
+}
+
+void platform_event_set(platform_event_t *event) {
+    pthread_mutex_lock(&event->lock);
+    event->signalled = true;
+    if (event->manual_reset) {
+        pthread_cond_broadcast(&event->cond);
+    } else {
+        pthread_cond_signal(&event->cond);
+    }
+    pthread_mutex_unlock(&event->lock);
+}
+
+void platform_event_reset(platform_event_t *event) {
+    pthread_mutex_lock(&event->lock);
+    event->signalled = false;
+    pthread_mutex_unlock(&event->lock);
+}
+
+int platform_event_wait(platform_event_t *event, unsigned int timeout_ms) {
+    int result;
+
+    pthread_mutex_lock(&event->lock);
+    result = wait_flag(&event->cond, &event->lock, &event->signalled, timeout_ms);
+    if (result == PLATFORM_WAIT_OK && !event->manual_reset) {
+        event->signalled = false;
+    }
+    pthread_mutex_unlock(&event->lock);
+    return result;
+}
+
+platform_lock_t* platform_lock_create(void) {
+    platform_lock_t *lock = (platform_lock_t*)malloc(sizeof(platform_lock_t));
+    pthread_mutexattr_t attr;
+
+    if (!lock) {
+        last_error = ENOMEM;
+        return NULL;
+    }
+
+    // Recursive, like a CRITICAL_SECTION
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&lock->mutex, &attr);
+    pthread_mutexattr_destroy(&attr);
+    return lock;
+}
+
+void platform_lock_destroy(platform_lock_t *lock) {
+    if (lock) {
+        pthread_mutex_destroy(&lock->mutex);
+        free(lock);
+    }
+}
+
+void platform_lock_enter(platform_lock_t *lock) {
+    pthread_mutex_lock(&lock->mutex);
+}
+
+void platform_lock_leave(platform_lock_t *lock) {
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+platform_tls_t* platform_tls_create(platform_tls_destructor_t destructor) {
+    platform_tls_t *tls = (platform_tls_t*)malloc(sizeof(platform_tls_t));
+    int error;
+
+    if (!tls) {
+        last_error = ENOMEM;
+        return NULL;
+    }
+
+    if ((error = pthread_key_create(&tls->key, destructor)) != 0) {
+        last_error = error;
+        free(tls);
+        return NULL;
+    }
+
+    return tls;
+}
+
+void* platform_tls_get(platform_tls_t *tls) {
+    return pthread_getspecific(tls->key);
+}
+
+void platform_tls_set(platform_tls_t *tls, void *value) {
+    pthread_setspecific(tls->key, value);
+}
+
+unsigned long long platform_ticks(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+unsigned long long platform_ticks_per_second(void) {
+    return 1000000000ULL;
+}
+
+void platform_sleep_ms(unsigned int ms) {
+    struct timespec ts;
+
+    if (ms == 0) {
+        sched_yield();
+        return;
+    }
+
+    ts.tv_sec = ms / 1000;
+    ts.tv_nsec = (long)(ms % 1000) * 1000000L;
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+void platform_local_time(platform_local_time_t *time) {
+    struct timespec ts;
+    struct tm tm;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    localtime_r(&ts.tv_sec, &tm);
+    time->year = tm.tm_year + 1900;
+    time->month = tm.tm_mon + 1;
+    time->day = tm.tm_mday;
+    time->hour = tm.tm_hour;
+    time->minute = tm.tm_min;
+    time->second = tm.tm_sec;
+    time->millisecond = (int)(ts.tv_nsec / 1000000L);
+}
+
+unsigned long platform_last_error(void) {
+    return (unsigned long)last_error;
+}
+
+// Linux limits thread names to 15 characters plus the terminator
+#define POSIX_THREAD_NAME_MAX 16
+
+// Nice values used for the priorities outside the realtime class
+static const int priority_nice[] = { 0, -5, -10, -20 };
+
+static void fail(platform_thread_sched_t *sched, const char *what, int error) {
+    if (sched->failed++ == 0) {
+        snprintf(sched->error, sizeof(sched->error), "%s failed: %s", what, strerror(error));
+    }
+}
+
+static int clamp_priority(int priority) {
+    if (priority < PLATFORM_PRIORITY_NORMAL) return PLATFORM_PRIORITY_NORMAL;
+    if (priority > PLATFORM_PRIORITY_TIME_CRITICAL) return PLATFORM_PRIORITY_TIME_CRITICAL;
+    return priority;
+}
+
+// Spread the priorities over the SCHED_FIFO range: NORMAL at the bottom,
+// TIME_CRITICAL at the top
+static int fifo_priority(int priority) {
+    int low = sched_get_priority_min(SCHED_FIFO);
+    int high = sched_get_priority_max(SCHED_FIFO);
+    return low + (high - low) * clamp_priority(priority) / PLATFORM_PRIORITY_TIME_CRITICAL;
+}
+
+bool platform_thread_apply(platform_thread_sched_t *sched, const platform_thread_attr_t *attr) {
+    pthread_t self = pthread_self();
+    int error;
+
+    memset(sched, 0, sizeof(*sched));
+
+    if (attr->realtime) {
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = fifo_priority(attr->priority);
+        if ((error = pthread_setschedparam(self, SCHED_FIFO, &param)) != 0) {
+            fail(sched, "SCHED_FIFO", error);
+        }
+    } else if (attr->priority != PLATFORM_PRIORITY_NORMAL) {
+#ifdef __linux__
+        // Linux applies nice values per thread when given a thread id
+        pid_t tid = (pid_t)syscall(SYS_gettid);
+        if (setpriority(PRIO_PROCESS, (id_t)tid, priority_nice[clamp_priority(attr->priority)]) != 0) {
+            fail(sched, "setpriority", errno);
+        }
+#else
+        fail(sched, "Thread priority", ENOTSUP);
+#endif
+    }
+
+    if (attr->affinity_mask) {
+#ifdef __linux__
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+            if (attr->affinity_mask & (1ULL << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        if ((error = pthread_setaffinity_np(self, sizeof(cpus), &cpus)) != 0) {
+            fail(sched, "pthread_setaffinity_np", error);
+        }
+#else
+        fail(sched, "CPU affinity", ENOTSUP);
+#endif
+    }
+
+    if (attr->name && attr->name[0]) {
+#ifdef __linux__
+        char name[POSIX_THREAD_NAME_MAX];
+        snprintf(name, sizeof(name), "%s", attr->name);
+        if ((error = pthread_setname_np(self, name)) != 0) {
+            fail(sched, "pthread_setname_np", error);
+        }
+#endif
+    }
+
+    return sched->failed == 0;
+}
+
+void platform_thread_revert(platform_thread_sched_t *sched) {
+    // Scheduling settings die with the thread; nothing is registered
+    sched->mmcss = NULL;
+}
+
+bool platform_thread_query(platform_thread_attr_t *attr, char *name_buffer, size_t name_size) {
+    pthread_t self = pthread_self();
+    struct sched_param param;
+    int policy;
+
+    if (pthread_getschedparam(self, &policy, &param) != 0) {
+        return false;
+    }
+
+    memset(attr, 0, sizeof(*attr));
+    if (policy == SCHED_FIFO || policy == SCHED_RR) {
+        int low = sched_get_priority_min(policy);
+        int high = sched_get_priority_max(policy);
+
+        attr->realtime = true;
+        attr->priority = high > low ?
+            ((param.sched_priority - low) * PLATFORM_PRIORITY_TIME_CRITICAL + (high - low) / 2) / (high - low) : 0;
+    }
+
+#ifdef __linux__
+    if (!attr->realtime) {
+        int nice;
+
+        errno = 0;
+        nice = getpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid));
+        if (errno == 0) {
+            for (int p = PLATFORM_PRIORITY_TIME_CRITICAL; p > PLATFORM_PRIORITY_NORMAL; p--) {
+                if (nice <= priority_nice[p]) {
+                    attr->priority = p;
+                    break;
+                }
+            }
+        }
+    }
+
+    {
+        cpu_set_t cpus, process_cpus;
+        if (pthread_getaffinity_np(self, sizeof(cpus), &cpus) == 0 &&
+            sched_getaffinity(getpid(), sizeof(process_cpus), &process_cpus) == 0 &&
+            !CPU_EQUAL(&cpus, &process_cpus)) {
+            for (int cpu = 0; cpu < 64 && cpu < CPU_SETSIZE; cpu++) {
+                if (CPU_ISSET(cpu, &cpus)) {
+                    attr->affinity_mask |= 1ULL << cpu;
+                }
+            }
+        }
+    }
+
+    if (name_buffer && name_size > 0) {
+        char name[POSIX_THREAD_NAME_MAX];
+        name_buffer[0] = '\0';
+        if (pthread_getname_np(self, name, sizeof(name)) == 0) {
+            snprintf(name_buffer, name_size, "%s", name);
+        }
+        attr->name = name_buffer;
+    }
+#else
+    if (name_buffer && name_size > 0) {
+        name_buffer[0] = '\0';
+        attr->name = name_buffer;
+    }
+#endif
+
+    return true;
+}
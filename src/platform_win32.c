@@ -0,0 +1,321 @@
+/**
+ * Useeplus SuperCamera - Platform Layer (Win32)
+ *
+ * See platform.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "platform.h"
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct platform_thread {
+    HANDLE handle;
+    platform_thread_proc_t proc;
+    void *arg;
+};
+
+struct platform_lock {
+    CRITICAL_SECTION section;
+};
+
+struct platform_tls {
+    DWORD index;
+};
+
+static DWORD WINAPI thread_start(LPVOID param) {
+    platform_thread_t *thread = (platform_thread_t*)param;
+    thread->proc(thread->arg);
+    return 0;
+}
+
+platform_thread_t* platform_thread_create(platform_thread_proc_t proc, void *arg) {
+    platform_thread_t *thread = (platform_thread_t*)calloc(1, sizeof(platform_thread_t));
+
+    if (!thread) {
+        SetLastError(ERROR_NOT_ENOUGH_MEMORY);
+        return NULL;
+    }
+
+    thread->proc = proc;
+    thread->arg = arg;
+    thread->handle = CreateThread(NULL, 0, thread_start, thread, 0, NULL);
+    if (!thread->handle) {
+        free(thread);
+        return NULL;
+    }
+
+    return thread;
+}
+
+int platform_thread_wait(platform_thread_t *thread, unsigned int timeout_ms) {
+    DWORD result = WaitForSingleObject(thread->handle,
+                                       timeout_ms == PLATFORM_WAIT_INFINITE ? INFINITE : timeout_ms);
+    return result == WAIT_OBJECT_0 ? PLATFORM_WAIT_OK : PLATFORM_WAIT_TIMEOUT;
+}
+
+void platform_thread_terminate(platform_thread_t *thread) {
+    TerminateThread(thread->handle, 0);
+}
+
+void platform_thread_close(platform_thread_t *thread) {
+    // The thread only touches the struct before proc returns, and a
+    // thread still running is only ever closed after being terminated
+    if (thread) {
+        CloseHandle(thread->handle);
+        free(thread);
+    }
+}
+
+unsigned int platform_thread_id(void) {
+    return (unsigned int)GetCurrentThreadId();
+}
+
+// Events are Win32 events; the handle is the pointer
+platform_event_t* platform_event_create(bool manual_reset) {
+    return (platform_event_t*)CreateEvent(NULL, manual_reset ? TRUE : FALSE, FALSE, NULL);
+}
+
+void platform_event_destroy(platform_event_t *event) {
+    if (event) {
+        CloseHandle((HANDLE)event);
+    }
+}
+
+void platform_event_set(platform_event_t *event) {
+    SetEvent((HANDLE)event);
+}
+
+void platform_event_reset(platform_event_t *event) {
+    ResetEvent((HANDLE)event);
+}
+
+int platform_event_wait(platform_event_t *event, unsigned int timeout_ms) {
+    DWORD result = WaitForSingleObject((HANDLE)event,
+                                       timeout_ms == PLATFORM_WAIT_INFINITE ? INFINITE : timeout_ms);
+    if (result == WAIT_OBJECT_0) return PLATFORM_WAIT_OK;
+    if (result == WAIT_TIMEOUT) return PLATFORM_WAIT_TIMEOUT;
+    return PLATFORM_WAIT_FAILED;
+}
+
+platform_lock_t* platform_lock_create(void) {
+    platform_lock_t *lock = (platform_lock_t*)malloc(sizeof(platform_lock_t));
+    if (lock) {
+        InitializeCriticalSection(&lock->section);
+    }
+    return lock;
+}
+
+void platform_lock_destroy(platform_lock_t *lock) {
+    if (lock) {
+        DeleteCriticalSection(&lock->section);
+        free(lock);
+    }
+}
+
+void platform_lock_enter(platform_lock_t *lock) {
+    EnterCriticalSection(&lock->section);
+}
+
+void platform_lock_leave(platform_lock_t *lock) {
+    LeaveCriticalSection(&lock->section);
+}
+
+// Fiber-local storage, so the destructor also runs for threads that exit
+platform_tls_t* platform_tls_create(platform_tls_destructor_t destructor) {
+    platform_tls_t *tls = (platform_tls_t*)malloc(sizeof(platform_tls_t));
+
+    if (!tls) {
+        return NULL;
+    }
+
+    tls->index = FlsAlloc((PFLS_CALLBACK_FUNCTION)destructor);
+    if (tls->index == FLS_OUT_OF_INDEXES) {
+        free(tls);
+        return NULL;
+    }
+
+    return tls;
+}
+
+void* platform_tls_get(platform_tls_t *tls) {
+    return FlsGetValue(tls->index);
+}
+
+void platform_tls_set(platform_tls_t *tls, void *value) {
+    FlsSetValue(tls->index, value);
+}
+
+unsigned long long platform_ticks(void) {
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return (unsigned long long)now.QuadPart;
+}
+
+unsigned long long platform_ticks_per_second(void) {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (unsigned long long)frequency.QuadPart;
+}
+
+void platform_sleep_ms(unsigned int ms) {
+    Sleep(ms);
+}
+
+void platform_local_time(platform_local_time_t *time) {
+    SYSTEMTIME st;
+
+    GetLocalTime(&st);
+    time->year = st.wYear;
+    time->month = st.wMonth;
+    time->day = st.wDay;
+    time->hour = st.wHour;
+    time->minute = st.wMinute;
+    time->second = st.wSecond;
+    time->millisecond = st.wMilliseconds;
+}
+
+unsigned long platform_last_error(void) {
+    return (unsigned long)GetLastError();
+}
+
+// avrt.dll (MMCSS) and SetThreadDescription (Windows 10 1607) are looked
+// up at run time so the library still loads where they are missing
+typedef HANDLE (WINAPI *av_set_fn)(LPCSTR task_name, LPDWORD task_index);
+typedef BOOL (WINAPI *av_revert_fn)(HANDLE handle);
+typedef HRESULT (WINAPI *set_description_fn)(HANDLE thread, PCWSTR description);
+typedef HRESULT (WINAPI *get_description_fn)(HANDLE thread, PWSTR *description);
+
+// avrt.dll is loaded on the first realtime thread and kept for the life of
+// the process, so its entry points stay valid for every revert
+static INIT_ONCE g_avrt_once = INIT_ONCE_STATIC_INIT;
+static av_set_fn g_av_set;
+static av_revert_fn g_av_revert;
+
+static BOOL CALLBACK load_avrt(PINIT_ONCE once, PVOID param, PVOID *context) {
+    HMODULE avrt = LoadLibraryA("avrt.dll");
+
+    (void)once;
+    (void)param;
+    (void)context;
+    if (avrt) {
+        g_av_set = (av_set_fn)GetProcAddress(avrt, "AvSetMmThreadCharacteristicsA");
+        g_av_revert = (av_revert_fn)GetProcAddress(avrt, "AvRevertMmThreadCharacteristics");
+    }
+    return TRUE;
+}
+
+static void fail(platform_thread_sched_t *sched, const char *what, DWORD error) {
+    if (sched->failed++ == 0) {
+        snprintf(sched->error, sizeof(sched->error), "%s failed: %lu", what, error);
+    }
+}
+
+static int native_priority(int priority) {
+    switch (priority) {
+        case PLATFORM_PRIORITY_ABOVE_NORMAL:  return THREAD_PRIORITY_ABOVE_NORMAL;
+        case PLATFORM_PRIORITY_HIGHEST:       return THREAD_PRIORITY_HIGHEST;
+        case PLATFORM_PRIORITY_TIME_CRITICAL: return THREAD_PRIORITY_TIME_CRITICAL;
+        default:                              return THREAD_PRIORITY_NORMAL;
+    }
+}
+
+bool platform_thread_apply(platform_thread_sched_t *sched, const platform_thread_attr_t *attr) {
+    HANDLE self = GetCurrentThread();
+
+    memset(sched, 0, sizeof(*sched));
+
+    // MMCSS first: it raises the thread into the realtime band on its own,
+    // and an explicit priority then moves it within that band
+    if (attr->realtime) {
+        DWORD task_index = 0;
+
+        InitOnceExecuteOnce(&g_avrt_once, load_avrt, NULL, NULL);
+        if (!g_av_set || !g_av_revert) {
+            fail(sched, "MMCSS (avrt.dll)", ERROR_PROC_NOT_FOUND);
+        } else if (!(sched->mmcss = g_av_set("Capture", &task_index))) {
+            fail(sched, "AvSetMmThreadCharacteristics", GetLastError());
+        }
+    }
+
+    if (attr->priority != PLATFORM_PRIORITY_NORMAL &&
+        !SetThreadPriority(self, native_priority(attr->priority))) {
+        fail(sched, "SetThreadPriority", GetLastError());
+    }
+
+    if (attr->affinity_mask && !SetThreadAffinityMask(self, (DWORD_PTR)attr->affinity_mask)) {
+        fail(sched, "SetThreadAffinityMask", GetLastError());
+    }
+
+    if (attr->name && attr->name[0]) {
+        set_description_fn set_description = (set_description_fn)
+            GetProcAddress(GetModuleHandleA("kernel32.dll"), "SetThreadDescription");
+        WCHAR wide[PLATFORM_THREAD_NAME_SIZE];
+
+        // Only a debugging aid; older systems simply keep unnamed threads
+        if (set_description &&
+            MultiByteToWideChar(CP_UTF8, 0, attr->name, -1, wide, PLATFORM_THREAD_NAME_SIZE)) {
+            HRESULT hr = set_description(self, wide);
+            if (FAILED(hr)) {
+                fail(sched, "SetThreadDescription", (DWORD)hr);
+            }
+        }
+    }
+
+    return sched->failed == 0;
+}
+
+void platform_thread_revert(platform_thread_sched_t *sched) {
+    // mmcss is only set once both avrt.dll entry points were found
+    if (sched->mmcss) {
+        g_av_revert(sched->mmcss);
+        sched->mmcss = NULL;
+    }
+}
+
+bool platform_thread_query(platform_thread_attr_t *attr, char *name_buffer, size_t name_size) {
+    HANDLE self = GetCurrentThread();
+    int priority = GetThreadPriority(self);
+    DWORD_PTR process_mask, system_mask;
+
+    if (priority == THREAD_PRIORITY_ERROR_RETURN) {
+        return false;
+    }
+
+    memset(attr, 0, sizeof(*attr));
+    attr->priority = priority >= THREAD_PRIORITY_TIME_CRITICAL ? PLATFORM_PRIORITY_TIME_CRITICAL :
+                     priority >= THREAD_PRIORITY_HIGHEST ? PLATFORM_PRIORITY_HIGHEST :
+                     priority >= THREAD_PRIORITY_ABOVE_NORMAL ? PLATFORM_PRIORITY_ABOVE_NORMAL :
+                     PLATFORM_PRIORITY_NORMAL;
+
+    // There is no GetThreadAffinityMask: setting the process mask returns
+    // the previous thread mask, which is then put back
+    if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask)) {
+        DWORD_PTR previous = SetThreadAffinityMask(self, process_mask);
+        if (previous) {
+            SetThreadAffinityMask(self, previous);
+            attr->affinity_mask = previous == process_mask ? 0 : (unsigned long long)previous;
+        }
+    }
+
+    if (name_buffer && name_size > 0) {
+        get_description_fn get_description = (get_description_fn)
+            GetProcAddress(GetModuleHandleA("kernel32.dll"), "GetThreadDescription");
+        PWSTR wide = NULL;
+
+        name_buffer[0] = '\0';
+        if (get_description && SUCCEEDED(get_description(self, &wide)) && wide) {
+            if (!WideCharToMultiByte(CP_UTF8, 0, wide, -1, name_buffer, (int)name_size, NULL, NULL)) {
+                name_buffer[0] = '\0';
+            }
+            LocalFree(wide);
+        }
+        attr->name = name_buffer;
+    }
+
+    return true;
+}
@@ -0,0 +1,208 @@
+/**
+ * Useeplus SuperCamera - Pipelined Bulk Reader
+ *
+ * See read_pipeline.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "read_pipeline.h"
+
+#include <string.h>
+
+// How long read_pipeline_stop waits for a cancelled transfer to come back
+#define READ_PIPELINE_DRAIN_MS 1000
+
+bool read_pipeline_init(read_pipeline_t *p, usb_transport_t *transport,
+                        int depth, size_t transfer_size, int buffer_count) {
+    memset(p, 0, sizeof(*p));
+
+    if (!transport || depth < 1 || depth > READ_PIPELINE_MAX_DEPTH || buffer_count < depth) {
+        return false;
+    }
+
+    if (!rx_pool_init(&p->pool, buffer_count, transfer_size)) {
+        return false;
+    }
+
+    p->transport = transport;
+    p->depth = depth;
+    p->transfer_size = transfer_size;
+    p->streaming = transport->ops->start_stream != NULL;
+
+    // A streaming transport claims its own buffers as it submits
+    for (int i = 0; i < depth && !p->streaming; i++) {
+        p->buffers[i] = rx_pool_get(&p->pool);
+    }
+
+    return true;
+}
+
+void read_pipeline_free(read_pipeline_t *p) {
+    // A transfer the transport never handed back may still be written to
+    if (p->stuck) {
+        return;
+    }
+
+    rx_pool_free(&p->pool);
+    for (int i = 0; i < READ_PIPELINE_MAX_DEPTH; i++) {
+        p->buffers[i] = NULL;
+    }
+    p->spare = NULL;
+    p->depth = 0;
+}
+
+int read_pipeline_start(read_pipeline_t *p) {
+    p->head = 0;
+    p->in_flight = 0;
+    p->reaped = false;
+
+    if (p->streaming) {
+        int result = p->transport->ops->start_stream(p->transport, &p->pool, p->depth,
+                                                     p->transfer_size);
+        if (result == USB_XFER_OK) {
+            p->in_flight = p->depth;
+        }
+        return result;
+    }
+
+    for (int i = 0; i < p->depth; i++) {
+        int result = p->transport->ops->submit_read(p->transport, i, p->buffers[i]->data,
+                                                    p->transfer_size);
+        if (result != USB_XFER_OK) {
+            read_pipeline_stop(p);
+            return result;
+        }
+        p->in_flight++;
+    }
+
+    return USB_XFER_OK;
+}
+
+int read_pipeline_wait(read_pipeline_t *p, unsigned int timeout_ms,
+                       const unsigned char **data, size_t *length) {
+    size_t bytes_read = 0;
+    int result;
+
+    *data = NULL;
+    *length = 0;
+
+    if (p->reaped || p->in_flight == 0) {
+        return USB_XFER_ERROR;
+    }
+
+    if (p->streaming) {
+        result = p->transport->ops->wait_stream(p->transport, timeout_ms, &p->current, &bytes_read);
+        if (result == USB_XFER_OK) {
+            p->reaped = true;
+            *data = p->current->data;
+            *length = bytes_read;
+        }
+        return result;
+    }
+
+    // Always the oldest transfer: completions are consumed in bus order
+    result = p->transport->ops->wait_read(p->transport, p->head, timeout_ms, &bytes_read);
+    if (result == USB_XFER_TIMEOUT) {
+        return result;
+    }
+
+    p->reaped = true;
+    p->in_flight--;
+
+    if (result == USB_XFER_OK) {
+        *data = p->buffers[p->head]->data;
+        *length = bytes_read;
+    }
+    return result;
+}
+
+rx_buffer_t* read_pipeline_lend(read_pipeline_t *p) {
+    if (!p->reaped) {
+        return NULL;
+    }
+
+    // The transport refills every read it has in flight from the pool;
+    // lending the last free buffers would leave it nothing to submit
+    if (p->streaming) {
+        return rx_pool_available(&p->pool) >= p->depth ? p->current : NULL;
+    }
+
+    // Make sure the requeue has something else to receive into
+    if (!p->spare) {
+        p->spare = rx_pool_get(&p->pool);
+    }
+    return p->spare ? p->buffers[p->head] : NULL;
+}
+
+int read_pipeline_requeue(read_pipeline_t *p) {
+    rx_buffer_t *buffer;
+    int result;
+
+    if (!p->reaped) {
+        return USB_XFER_ERROR;
+    }
+
+    // The transport has long resubmitted this read with another buffer
+    if (p->streaming) {
+        rx_buffer_unref(p->current);
+        p->current = NULL;
+        p->reaped = false;
+        return USB_XFER_OK;
+    }
+
+    // Only a lent buffer gains references, so the spare exists
+    buffer = p->buffers[p->head];
+    if (atomic32_load_acquire(&buffer->refs) > 1) {
+        rx_buffer_unref(buffer);
+        buffer = p->spare;
+        p->spare = NULL;
+        p->buffers[p->head] = buffer;
+    }
+
+    result = p->transport->ops->submit_read(p->transport, p->head,
+                                            buffer->data, p->transfer_size);
+    if (result != USB_XFER_OK) {
+        return result;
+    }
+
+    p->in_flight++;
+    p->reaped = false;
+    p->head = (p->head + 1) % p->depth;
+    return USB_XFER_OK;
+}
+
+void read_pipeline_stop(read_pipeline_t *p) {
+    int first = p->reaped ? p->head + 1 : p->head;
+
+    if (p->streaming) {
+        if (p->in_flight > 0 && !p->transport->ops->stop_stream(p->transport)) {
+            p->stuck = true;
+        }
+        if (p->current) {
+            rx_buffer_unref(p->current);
+            p->current = NULL;
+        }
+        p->in_flight = 0;
+        p->reaped = false;
+        return;
+    }
+
+    if (p->in_flight > 0) {
+        p->transport->ops->abort_reads(p->transport);
+    }
+
+    // Outstanding transfers follow the head in submission order
+    for (int i = 0; i < p->in_flight; i++) {
+        size_t bytes_read;
+        int slot = (first + i) % p->depth;
+        if (p->transport->ops->wait_read(p->transport, slot, READ_PIPELINE_DRAIN_MS,
+                                         &bytes_read) == USB_XFER_TIMEOUT) {
+            p->stuck = true;
+        }
+    }
+
+    p->head = 0;
+    p->in_flight = 0;
+    p->reaped = false;
+}
@@ -0,0 +1,134 @@
+/**
+ * Useeplus SuperCamera - Pipelined Bulk Reader
+ *
+ * Keeps a fixed number of bulk IN reads outstanding on a transport so the
+ * endpoint always has a buffer to fill while the read thread is parsing
+ * the previous one. Transfers are reaped strictly in submission order, so
+ * packets reach the frame assembler in the order they came off the bus.
+ *
+ * Transfers read into buffers from an rx_pool. A caller that wants to keep
+ * received bytes past the requeue borrows the buffer with
+ * read_pipeline_lend() and takes references on it; the requeue then
+ * submits a spare buffer from the pool in its place.
+ *
+ * A transport that streams (usb_transport_ops_t.start_stream) resubmits
+ * its reads itself as they complete, claiming buffers from the same pool,
+ * and the pipeline only hands its completions on: the requeue just drops
+ * the pipeline's reference, and a buffer is lent out only while the pool
+ * keeps enough free buffers for every read in flight.
+ *
+ * Typical loop:
+ *
+ *   read_pipeline_start(&p);
+ *   while (running) {
+ *       if (read_pipeline_wait(&p, timeout, &data, &len) != USB_XFER_OK) ...;
+ *       process(data, len, read_pipeline_lend(&p));
+ *       read_pipeline_requeue(&p);
+ *   }
+ *   read_pipeline_stop(&p);
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef READ_PIPELINE_H
+#define READ_PIPELINE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "usb_transport.h"
+#include "rx_pool.h"
+
+#define READ_PIPELINE_MAX_DEPTH  USB_TRANSPORT_MAX_READS
+
+typedef struct read_pipeline {
+    usb_transport_t *transport;
+    rx_pool_t pool;
+    rx_buffer_t *buffers[READ_PIPELINE_MAX_DEPTH];  // Buffer of each transfer slot
+    rx_buffer_t *spare;     // Claimed by read_pipeline_lend for the next requeue
+    rx_buffer_t *current;   // Streaming: buffer returned by read_pipeline_wait
+    size_t transfer_size;
+    int depth;          // Number of transfers kept in flight
+    int head;           // Oldest outstanding transfer, reaped next
+    int in_flight;      // Submitted and not yet reaped
+    bool reaped;        // head has been reaped by read_pipeline_wait
+    bool stuck;         // A transfer never completed; buffers must not be freed
+    bool streaming;     // The transport resubmits reads itself; slots unused
+} read_pipeline_t;
+
+/**
+ * Allocate the receive buffer pool
+ *
+ * @param p Pipeline to initialize
+ * @param transport Transport to read from
+ * @param depth Transfers kept in flight (1 to READ_PIPELINE_MAX_DEPTH)
+ * @param transfer_size Size of each bulk read
+ * @param buffer_count Receive buffers (depth to RX_POOL_MAX_BUFFERS); those
+ *                     beyond depth replace buffers lent out
+ * @return true on success
+ */
+bool read_pipeline_init(read_pipeline_t *p, usb_transport_t *transport,
+                        int depth, size_t transfer_size, int buffer_count);
+
+/**
+ * Release the receive buffers (the pipeline must be stopped and no
+ * references may be left)
+ *
+ * @param p Pipeline
+ */
+void read_pipeline_free(read_pipeline_t *p);
+
+/**
+ * Submit every transfer (or start the transport's stream)
+ *
+ * @param p Pipeline
+ * @return USB_XFER_OK, or the submit error (nothing is left in flight)
+ */
+int read_pipeline_start(read_pipeline_t *p);
+
+/**
+ * Wait for the oldest transfer to complete
+ *
+ * On USB_XFER_TIMEOUT the transfer is still pending and the call can
+ * simply be repeated. On USB_XFER_OK the data stays valid until
+ * read_pipeline_requeue.
+ *
+ * @param p Pipeline
+ * @param timeout_ms Timeout in milliseconds (USB_WAIT_INFINITE = no timeout)
+ * @param data Receives pointer to the received bytes
+ * @param length Receives number of bytes received (may be 0)
+ * @return USB_XFER_OK, USB_XFER_TIMEOUT, USB_XFER_ABORTED or USB_XFER_ERROR
+ */
+int read_pipeline_wait(read_pipeline_t *p, unsigned int timeout_ms,
+                       const unsigned char **data, size_t *length);
+
+/**
+ * Lend out the buffer returned by read_pipeline_wait
+ *
+ * References the caller takes on the buffer (rx_buffer_ref) keep its
+ * bytes valid after read_pipeline_requeue; they are dropped with
+ * rx_buffer_unref from any thread.
+ *
+ * @param p Pipeline
+ * @return The buffer, or NULL if the pool has no spare to receive into
+ *         meanwhile - the data must then be copied before the requeue
+ */
+rx_buffer_t* read_pipeline_lend(read_pipeline_t *p);
+
+/**
+ * Resubmit the transfer returned by read_pipeline_wait and move on
+ * to the next one; a buffer still referenced is swapped for the spare
+ *
+ * @param p Pipeline
+ * @return USB_XFER_OK or the submit error
+ */
+int read_pipeline_requeue(read_pipeline_t *p);
+
+/**
+ * Cancel and reap every outstanding transfer
+ *
+ * @param p Pipeline
+ */
+void read_pipeline_stop(read_pipeline_t *p);
+
+#endif // READ_PIPELINE_H
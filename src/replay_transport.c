@@ -0,0 +1,192 @@
+/**
+ * Useeplus SuperCamera - Capture Replay Transport
+ *
+ * See replay_transport.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "replay_transport.h"
+#include "capture_file.h"
+#include "atomics.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Longest single sleep, so abort_reads is noticed promptly
+#define REPLAY_SLEEP_SLICE_MS 5
+
+typedef struct replay_transport {
+    usb_transport_t base;
+    capture_reader_t reader;
+    double speed;
+
+    // Playback clock, set by the first record after start_streaming
+    bool clock_started;
+    unsigned long long first_timestamp_us;
+    double start_time;
+
+    // Record read ahead into a slot's buffer but not yet due
+    int staged_slot;        // -1 = none
+    capture_record_t staged;
+
+    unsigned char *buffers[USB_TRANSPORT_MAX_READS];
+    size_t lengths[USB_TRANSPORT_MAX_READS];
+
+    atomic32_t aborted;
+} replay_transport_t;
+
+static double now_seconds(void) {
+    return (double)platform_ticks() / (double)platform_ticks_per_second();
+}
+
+static int replay_open(usb_transport_t *transport, const char *path) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+
+    if (!capture_reader_open(&t->reader, path)) {
+        snprintf(t->base.error, sizeof(t->base.error),
+                 "Failed to open capture file '%s' (missing or not a version %d capture)",
+                 path, CAPTURE_VERSION);
+        return USB_XFER_ERROR;
+    }
+
+    return USB_XFER_OK;
+}
+
+static void replay_close(usb_transport_t *transport) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+
+    capture_reader_close(&t->reader);
+    free(t);
+}
+
+static void replay_reset(usb_transport_t *transport) {
+    (void)transport;
+}
+
+static int replay_start_streaming(usb_transport_t *transport) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+
+    // Every stream plays the capture from the beginning
+    if (!capture_reader_rewind(&t->reader)) {
+        snprintf(t->base.error, sizeof(t->base.error), "Failed to rewind capture file");
+        return USB_XFER_ERROR;
+    }
+
+    t->clock_started = false;
+    t->staged_slot = -1;
+    atomic32_store_release(&t->aborted, 0);
+    return USB_XFER_OK;
+}
+
+static int replay_write_command(usb_transport_t *transport, const unsigned char *data, size_t length) {
+    (void)transport;
+    (void)data;
+    (void)length;
+    return USB_XFER_OK;
+}
+
+static int replay_submit_read(usb_transport_t *transport, int slot,
+                              unsigned char *buffer, size_t length) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+
+    t->buffers[slot] = buffer;
+    t->lengths[slot] = length;
+    return USB_XFER_OK;
+}
+
+static int replay_wait_read(usb_transport_t *transport, int slot,
+                            unsigned int timeout_ms, size_t *bytes_read) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+    double deadline = timeout_ms == USB_WAIT_INFINITE ? -1.0 : now_seconds() + timeout_ms / 1000.0;
+    double due;
+
+    *bytes_read = 0;
+
+    if (atomic32_load_acquire(&t->aborted)) {
+        t->staged_slot = -1;
+        return USB_XFER_ABORTED;
+    }
+
+    // Reads are reaped in submission order, so the next record belongs
+    // to whichever slot is waited on; it stays staged there across timeouts
+    if (t->staged_slot != slot) {
+        int result = capture_reader_next(&t->reader, &t->staged, t->buffers[slot], t->lengths[slot]);
+        if (result == CAPTURE_END) {
+            return USB_XFER_END;
+        }
+        if (result != CAPTURE_RECORD) {
+            snprintf(t->base.error, sizeof(t->base.error), "Capture file is truncated or corrupt");
+            return USB_XFER_ERROR;
+        }
+        t->staged_slot = slot;
+
+        if (!t->clock_started) {
+            t->clock_started = true;
+            t->first_timestamp_us = t->staged.timestamp_us;
+            t->start_time = now_seconds();
+        }
+    }
+
+    if (t->speed > 0.0) {
+        due = t->start_time +
+              (double)(t->staged.timestamp_us - t->first_timestamp_us) / 1e6 / t->speed;
+
+        for (;;) {
+            double now = now_seconds();
+            double until = due;
+            if (now >= due) {
+                break;
+            }
+            if (deadline >= 0.0 && now >= deadline) {
+                return USB_XFER_TIMEOUT;
+            }
+            if (deadline >= 0.0 && deadline < until) {
+                until = deadline;
+            }
+
+            unsigned int ms = (unsigned int)((until - now) * 1000.0);
+            platform_sleep_ms(ms < 1 ? 1 : (ms > REPLAY_SLEEP_SLICE_MS ? REPLAY_SLEEP_SLICE_MS : ms));
+
+            if (atomic32_load_acquire(&t->aborted)) {
+                t->staged_slot = -1;
+                return USB_XFER_ABORTED;
+            }
+        }
+    }
+
+    t->staged_slot = -1;
+    *bytes_read = t->staged.length < t->lengths[slot] ? t->staged.length : t->lengths[slot];
+    return USB_XFER_OK;
+}
+
+static void replay_abort_reads(usb_transport_t *transport) {
+    replay_transport_t *t = (replay_transport_t*)transport;
+    atomic32_store_release(&t->aborted, 1);
+}
+
+static const usb_transport_ops_t replay_ops = {
+    .open            = replay_open,
+    .close           = replay_close,
+    .reset           = replay_reset,
+    .start_streaming = replay_start_streaming,
+    .write_command   = replay_write_command,
+    .submit_read     = replay_submit_read,
+    .wait_read       = replay_wait_read,
+    .abort_reads     = replay_abort_reads,
+};
+
+usb_transport_t* replay_transport_create(double speed) {
+    replay_transport_t *t = (replay_transport_t*)calloc(1, sizeof(replay_transport_t));
+
+    if (!t) {
+        return NULL;
+    }
+
+    t->base.ops = &replay_ops;
+    t->speed = speed;
+    t->staged_slot = -1;
+    return &t->base;
+}
@@ -0,0 +1,28 @@
+/**
+ * Useeplus SuperCamera - Capture Replay Transport
+ *
+ * usb_transport_t implementation that plays back a packet capture file
+ * (see capture_file.h) instead of talking to a device. Each record is
+ * delivered as one completed bulk read, either at its recorded time
+ * scaled by a speed factor or as fast as the reader consumes them.
+ * Commands are accepted and ignored. Once the capture is exhausted every
+ * read completes with USB_XFER_END.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef REPLAY_TRANSPORT_H
+#define REPLAY_TRANSPORT_H
+
+#include "usb_transport.h"
+
+/**
+ * Create an unopened replay transport
+ *
+ * @param speed Playback speed: 1.0 = original timing, 2.0 = twice as
+ *              fast, 0 = no pacing at all
+ * @return Transport, or NULL if out of memory
+ */
+usb_transport_t* replay_transport_create(double speed);
+
+#endif // REPLAY_TRANSPORT_H
@@ -0,0 +1,93 @@
+/**
+ * Useeplus SuperCamera - USB Receive Buffer Pool
+ *
+ * See rx_pool.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "rx_pool.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+bool rx_pool_init(rx_pool_t *pool, int count, size_t buffer_size) {
+    memset(pool, 0, sizeof(*pool));
+
+    if (count < 1 || count > RX_POOL_MAX_BUFFERS || buffer_size == 0) {
+        return false;
+    }
+
+    pool->count = count;
+    pool->buffer_size = buffer_size;
+
+    for (int i = 0; i < count; i++) {
+        pool->buffers[i].pool = pool;
+        pool->buffers[i].data = (unsigned char*)malloc(buffer_size);
+        if (!pool->buffers[i].data) {
+            rx_pool_free(pool);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void rx_pool_free(rx_pool_t *pool) {
+    for (int i = 0; i < RX_POOL_MAX_BUFFERS; i++) {
+        free(pool->buffers[i].data);
+        pool->buffers[i].data = NULL;
+        pool->buffers[i].refs = 0;
+    }
+    pool->count = 0;
+}
+
+int rx_pool_available(rx_pool_t *pool) {
+    int available = 0;
+
+    for (int i = 0; i < pool->count; i++) {
+        if (atomic32_load_relaxed(&pool->buffers[i].refs) == 0) {
+            available++;
+        }
+    }
+    return available;
+}
+
+void rx_pool_set_wake(rx_pool_t *pool, void (*wake)(void *context), void *context) {
+    pool->wake = wake;
+    pool->wake_context = context;
+    atomic32_store_release(&pool->starved, 0);
+}
+
+static rx_buffer_t* claim_free(rx_pool_t *pool) {
+    // Buffers are mostly released in the order they were taken, so the
+    // one after the last claim is usually free
+    for (int i = 0; i < pool->count; i++) {
+        int index = (pool->next + i) % pool->count;
+        rx_buffer_t *buffer = &pool->buffers[index];
+
+        if (atomic32_load_acquire(&buffer->refs) == 0) {
+            atomic32_store_release(&buffer->refs, 1);
+            pool->next = (index + 1) % pool->count;
+            return buffer;
+        }
+    }
+    return NULL;
+}
+
+rx_buffer_t* rx_pool_get(rx_pool_t *pool) {
+    rx_buffer_t *buffer = claim_free(pool);
+
+    // Ask for a wake, then look once more for a buffer freed before the
+    // request was visible; pairs with the fence in rx_buffer_unref
+    if (!buffer && pool->wake) {
+        atomic32_store_release(&pool->starved, 1);
+        atomic_fence_full();
+        buffer = claim_free(pool);
+    }
+
+    if (!buffer) {
+        pool->exhausted++;
+    }
+    return buffer;
+}
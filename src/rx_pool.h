@@ -0,0 +1,128 @@
+/**
+ * Useeplus SuperCamera - USB Receive Buffer Pool
+ *
+ * A fixed set of reference-counted buffers that bulk IN transfers read
+ * into. The read pipeline holds one reference on each buffer it has
+ * submitted; a frame that keeps a payload in place (an rx_segment_t)
+ * holds another, so the bytes outlive the transfer and the pipeline
+ * resubmits a fresh buffer instead.
+ *
+ * Only the USB read thread takes buffers from the pool and adds
+ * references (or, while a transport streams, the transport's event
+ * thread takes them and the read thread adds references). Consumers
+ * drop references from any thread; a buffer whose count reaches zero is
+ * free to be received into again, the same rule the frame ring applies
+ * to its slots.
+ *
+ * A claiming thread that should not spin while the pool is exhausted
+ * installs a wake callback: after rx_pool_get comes back empty, the
+ * reference drop that frees the next buffer runs it once, from the
+ * dropping thread.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef RX_POOL_H
+#define RX_POOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "atomics.h"
+
+#define RX_POOL_MAX_BUFFERS 128
+
+struct rx_pool;
+
+typedef struct rx_buffer {
+    unsigned char *data;
+    atomic32_t refs;    // Transfer + frame segments; 0 = free
+    struct rx_pool *pool;
+} rx_buffer_t;
+
+// Bytes of a frame left in a receive buffer, holding a reference on it
+typedef struct rx_segment {
+    rx_buffer_t *buffer;
+    const unsigned char *data;
+    size_t size;
+} rx_segment_t;
+
+typedef struct rx_pool {
+    rx_buffer_t buffers[RX_POOL_MAX_BUFFERS];
+    int count;
+    size_t buffer_size;
+    int next;                   // Where the search for a free buffer resumes
+    unsigned int exhausted;     // rx_pool_get found nothing free (running count)
+    atomic32_t starved;         // rx_pool_get came back empty; the next free wakes
+    void (*wake)(void *context);
+    void *wake_context;
+} rx_pool_t;
+
+/**
+ * Allocate the buffers, all free
+ *
+ * @param pool Pool to initialize
+ * @param count Number of buffers (1 to RX_POOL_MAX_BUFFERS)
+ * @param buffer_size Size of each buffer
+ * @return true on success
+ */
+bool rx_pool_init(rx_pool_t *pool, int count, size_t buffer_size);
+
+/**
+ * Free the buffers; no references may be left
+ *
+ * @param pool Pool
+ */
+void rx_pool_free(rx_pool_t *pool);
+
+/**
+ * Count the free buffers; a snapshot, since references are dropped
+ * concurrently (walks the pool)
+ *
+ * @param pool Pool
+ * @return Buffers with no reference
+ */
+int rx_pool_available(rx_pool_t *pool);
+
+/**
+ * Claim a free buffer with one reference (claiming thread only)
+ *
+ * @param pool Pool
+ * @return Buffer, or NULL if every buffer is referenced
+ */
+rx_buffer_t* rx_pool_get(rx_pool_t *pool);
+
+/**
+ * Install the callback run when a buffer frees up after rx_pool_get found
+ * none; set before buffers are claimed, it must stay callable until every
+ * reference is dropped. It runs on the thread dropping the reference, so
+ * it must only signal
+ *
+ * @param pool Pool
+ * @param wake Callback, or NULL for none
+ * @param context Passed to the callback
+ */
+void rx_pool_set_wake(rx_pool_t *pool, void (*wake)(void *context), void *context);
+
+// Add a reference to a buffer the caller already holds (read thread only)
+static __inline void rx_buffer_ref(rx_buffer_t *buffer) {
+    atomic32_fetch_add(&buffer->refs, 1);
+}
+
+// Drop a reference (any thread); the bytes must not be touched afterwards
+static __inline void rx_buffer_unref(rx_buffer_t *buffer) {
+    if (atomic32_fetch_add(&buffer->refs, -1) == 1) {
+        rx_pool_t *pool = buffer->pool;
+
+        // Pairs with the fence in rx_pool_get: either the claiming thread
+        // sees this buffer free, or this sees it starved. Several threads
+        // may wake it for one starvation; a spare wake costs a retry
+        atomic_fence_full();
+        if (atomic32_load_acquire(&pool->starved)) {
+            atomic32_store_relaxed(&pool->starved, 0);
+            pool->wake(pool->wake_context);
+        }
+    }
+}
+
+#endif // RX_POOL_H
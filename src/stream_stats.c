@@ -0,0 +1,44 @@
+/**
+ * Useeplus SuperCamera - Streaming Statistics
+ *
+ * See stream_stats.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "stream_stats.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+int stats_histogram_bucket(unsigned long long us) {
+    unsigned long value;
+
+    if (us == 0) {
+        return 0;
+    }
+
+    // Anything past 2^31 us (~36 min) lands in the last bucket anyway
+    value = us > 0xFFFFFFFFULL ? 0xFFFFFFFFUL : (unsigned long)us;
+
+#if defined(_MSC_VER)
+    unsigned long msb;
+    _BitScanReverse(&msb, value);
+#else
+    int msb = 31 - __builtin_clz((unsigned int)value);
+#endif
+
+    return (int)msb + 1 < STATS_HISTOGRAM_BUCKETS ? (int)msb + 1 : STATS_HISTOGRAM_BUCKETS - 1;
+}
+
+void stats_histogram_record(stats_histogram_t *h, unsigned long long us) {
+    long clamped = us > 0x7FFFFFFFULL ? 0x7FFFFFFF : (long)us;
+
+    stats_add(&h->buckets[stats_histogram_bucket(us)], 1);
+    stats_add(&h->count, 1);
+    stats_add64(&h->sum_us, (long long)us);
+    if (clamped > atomic32_load_relaxed(&h->max_us)) {
+        atomic32_store_relaxed(&h->max_us, clamped);
+    }
+}
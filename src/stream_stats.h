@@ -0,0 +1,84 @@
+/**
+ * Useeplus SuperCamera - Streaming Statistics
+ *
+ * Counters and latency histograms maintained while streaming. Every field
+ * has a single writer at a time (the read thread, or a consumer holding
+ * the consumer lock), so updates are a relaxed load and store with no
+ * locked instruction, and any thread can take a snapshot at any time.
+ *
+ * Histograms count durations in log2 buckets of microseconds: bucket 0
+ * holds values below 1 us, bucket i values in [2^(i-1), 2^i) us, and the
+ * last bucket everything from 2^(STATS_HISTOGRAM_BUCKETS-2) us up.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef STREAM_STATS_H
+#define STREAM_STATS_H
+
+#include "atomics.h"
+
+#define STATS_HISTOGRAM_BUCKETS 32
+
+typedef struct stats_histogram {
+    atomic32_t buckets[STATS_HISTOGRAM_BUCKETS];
+    atomic32_t count;
+    atomic32_t max_us;
+    atomic64_t sum_us;
+} stats_histogram_t;
+
+typedef struct stream_stats {
+    // Read thread
+    atomic64_t bytes_received;
+    atomic64_t packets_received;
+    atomic32_t bad_header_packets;
+    atomic32_t frames_captured;
+    atomic32_t frames_discarded;    // Partial frames abandoned for a new SOI
+    atomic32_t frames_oversize;     // Exceeded the max frame size
+    atomic32_t frames_overflow;     // Every frame buffer in use
+    atomic32_t read_timeouts;
+    atomic32_t read_errors;
+    atomic32_t packets_lost;        // Mirrors of the packet header checker
+    atomic32_t frames_lost;
+    atomic32_t header_resyncs;
+    atomic32_t payloads_copied;     // Mirror of the frame assembler's count
+    stats_histogram_t usb_read;     // Wait for each completed bulk read
+    stats_histogram_t assembly;     // First packet of a frame to its EOI
+    stats_histogram_t frame_interval;
+
+    // Consumers, under the consumer lock
+    char pad[CACHE_LINE_SIZE];
+    stats_histogram_t consumer_latency;  // Frame published to handed out
+    atomic32_t frames_skipped;           // Passed over by latest-frame reads
+    atomic32_t decode_submit_failures;   // Decode feed thread: no memory to queue a frame
+
+    // Every driver thread as it starts (several writers, atomic adds)
+    atomic32_t thread_attr_failures;
+} stream_stats_t;
+
+// Add to a counter (single writer)
+static __inline void stats_add(atomic32_t *counter, long n) {
+    atomic32_store_relaxed(counter, atomic32_load_relaxed(counter) + n);
+}
+
+static __inline void stats_add64(atomic64_t *counter, long long n) {
+    atomic64_store_relaxed(counter, atomic64_load_relaxed(counter) + n);
+}
+
+/**
+ * Bucket a duration falls into
+ *
+ * @param us Duration in microseconds
+ * @return Bucket index, 0 to STATS_HISTOGRAM_BUCKETS - 1
+ */
+int stats_histogram_bucket(unsigned long long us);
+
+/**
+ * Record one duration (single writer)
+ *
+ * @param h Histogram
+ * @param us Duration in microseconds
+ */
+void stats_histogram_record(stats_histogram_t *h, unsigned long long us);
+
+#endif // STREAM_STATS_H
@@ -0,0 +1,102 @@
+/**
+ * Useeplus SuperCamera - Pipeline Trace File Format
+ *
+ * See trace_file.h for the layout.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "trace_file.h"
+
+#include <string.h>
+
+static unsigned int read_u16(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8);
+}
+
+static unsigned int read_u32(const unsigned char *p) {
+    return (unsigned int)p[0] | ((unsigned int)p[1] << 8) |
+           ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static void write_u16(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void write_u32(unsigned char *p, unsigned int v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+    p[2] = (unsigned char)(v >> 16);
+    p[3] = (unsigned char)(v >> 24);
+}
+
+void trace_encode_file_header(unsigned char *out) {
+    memcpy(out, TRACE_MAGIC, TRACE_MAGIC_SIZE);
+    write_u32(out + 8, TRACE_VERSION);
+    write_u32(out + 12, TRACE_FILE_HEADER_SIZE);
+}
+
+void trace_encode_event(unsigned char *out, const trace_event_t *event) {
+    write_u32(out, (unsigned int)event->time_ns);
+    write_u32(out + 4, (unsigned int)(event->time_ns >> 32));
+    write_u32(out + 8, event->frame);
+    write_u32(out + 12, event->value);
+    write_u16(out + 16, event->type);
+    write_u16(out + 18, event->source);
+}
+
+bool trace_reader_open(trace_reader_t *r, const char *path) {
+    unsigned char header[TRACE_FILE_HEADER_SIZE];
+    unsigned int header_size;
+
+    memset(r, 0, sizeof(*r));
+
+    r->file = fopen(path, "rb");
+    if (!r->file) {
+        return false;
+    }
+
+    if (fread(header, 1, sizeof(header), r->file) != sizeof(header) ||
+        memcmp(header, TRACE_MAGIC, TRACE_MAGIC_SIZE) != 0) {
+        trace_reader_close(r);
+        return false;
+    }
+
+    r->version = read_u32(header + 8);
+    header_size = read_u32(header + 12);
+
+    if (r->version != TRACE_VERSION || header_size < TRACE_FILE_HEADER_SIZE ||
+        fseek(r->file, (long)header_size, SEEK_SET) != 0) {
+        trace_reader_close(r);
+        return false;
+    }
+
+    return true;
+}
+
+int trace_reader_next(trace_reader_t *r, trace_event_t *event) {
+    unsigned char data[TRACE_EVENT_SIZE];
+    size_t got = fread(data, 1, sizeof(data), r->file);
+
+    if (got == 0 && feof(r->file)) {
+        return TRACE_END;
+    }
+    if (got != sizeof(data)) {
+        return TRACE_CORRUPT;
+    }
+
+    event->time_ns = (unsigned long long)read_u32(data) | ((unsigned long long)read_u32(data + 4) << 32);
+    event->frame = read_u32(data + 8);
+    event->value = read_u32(data + 12);
+    event->type = (unsigned short)read_u16(data + 16);
+    event->source = (unsigned short)read_u16(data + 18);
+    return TRACE_RECORD;
+}
+
+void trace_reader_close(trace_reader_t *r) {
+    if (r->file) {
+        fclose(r->file);
+        r->file = NULL;
+    }
+}
@@ -0,0 +1,117 @@
+/**
+ * Useeplus SuperCamera - Pipeline Trace File Format
+ *
+ * A trace is a sequence of small fixed-size events recorded along the
+ * streaming pipeline: bulk reads, packets, frame boundaries, hand-off to
+ * the application and drops. The trace recorder writes it; trace_to_json
+ * converts it for a trace viewer.
+ *
+ * Layout (all integers little-endian):
+ *
+ *   File header, 16 bytes
+ *     char[8]  magic        "USEETRC1"
+ *     u32      version      TRACE_VERSION
+ *     u32      header_size  Size of this header, events start here
+ *
+ *   Events, TRACE_EVENT_SIZE bytes each, in time order
+ *     u64      time_ns      Nanoseconds since the trace started
+ *     u32      frame        Frame the event belongs to (0 = none)
+ *     u32      value        Type-specific, see the event types
+ *     u16      type         TRACE_EVENT_*
+ *     u16      source       TRACE_SOURCE_*
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef TRACE_FILE_H
+#define TRACE_FILE_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#define TRACE_MAGIC             "USEETRC1"
+#define TRACE_MAGIC_SIZE        8
+#define TRACE_VERSION           1
+#define TRACE_FILE_HEADER_SIZE  16
+#define TRACE_EVENT_SIZE        20
+
+// Event types; value meaning in brackets
+#define TRACE_EVENT_USB_READ_BEGIN   1  // Read thread starts waiting for a bulk read
+#define TRACE_EVENT_USB_READ_END     2  // Bulk read reaped [bytes, 0 on timeout]
+#define TRACE_EVENT_PACKET           3  // Packet parsed [packet bytes]
+#define TRACE_EVENT_SOI              4  // Packet started a new frame
+#define TRACE_EVENT_EOI              5  // Frame complete [JPEG bytes]
+#define TRACE_EVENT_FRAME_PUBLISHED  6  // Frame queued for the application [JPEG bytes]
+#define TRACE_EVENT_FRAME_CONSUMED   7  // Frame handed to the application [JPEG bytes]
+#define TRACE_EVENT_DROP             8  // Frame lost [TRACE_DROP_*]
+
+// Reasons of TRACE_EVENT_DROP
+#define TRACE_DROP_OVERFLOW   1  // Every frame buffer in use
+#define TRACE_DROP_OVERSIZE   2  // Exceeded the max frame size
+#define TRACE_DROP_DISCARDED  3  // Abandoned when the next frame began
+#define TRACE_DROP_SKIPPED    4  // Passed over for a newer frame by a latest-frame read
+
+// Threads recording events
+#define TRACE_SOURCE_READ      0  // USB read thread
+#define TRACE_SOURCE_CONSUMER  1  // Application threads reading frames
+#define TRACE_SOURCES          2
+
+// Results of trace_reader_next()
+#define TRACE_RECORD   1
+#define TRACE_END      0
+#define TRACE_CORRUPT -1
+
+typedef struct trace_event {
+    unsigned long long time_ns;
+    unsigned int frame;
+    unsigned int value;
+    unsigned short type;
+    unsigned short source;
+} trace_event_t;
+
+typedef struct trace_reader {
+    FILE *file;
+    unsigned int version;
+} trace_reader_t;
+
+/**
+ * Encode the file header
+ *
+ * @param out Receives TRACE_FILE_HEADER_SIZE bytes
+ */
+void trace_encode_file_header(unsigned char *out);
+
+/**
+ * Encode one event
+ *
+ * @param out Receives TRACE_EVENT_SIZE bytes
+ * @param event Event
+ */
+void trace_encode_event(unsigned char *out, const trace_event_t *event);
+
+/**
+ * Open a trace file and validate its header
+ *
+ * @param r Reader to initialize
+ * @param path Trace file path
+ * @return true on success
+ */
+bool trace_reader_open(trace_reader_t *r, const char *path);
+
+/**
+ * Read the next event
+ *
+ * @param r Reader
+ * @param event Receives the event
+ * @return TRACE_RECORD, TRACE_END or TRACE_CORRUPT
+ */
+int trace_reader_next(trace_reader_t *r, trace_event_t *event);
+
+/**
+ * Close the trace file
+ *
+ * @param r Reader
+ */
+void trace_reader_close(trace_reader_t *r);
+
+#endif // TRACE_FILE_H
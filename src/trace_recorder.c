@@ -0,0 +1,255 @@
+/**
+ * Useeplus SuperCamera - Pipeline Trace Recorder
+ *
+ * See trace_recorder.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "trace_recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define RING_MASK   (TRACE_RECORDER_RING_EVENTS - 1)
+#define BATCH_EVENTS 1024
+
+// Convert clock ticks since the start of the trace to nanoseconds
+static unsigned long long ticks_to_ns(trace_recorder_t *r, unsigned long long ticks) {
+    unsigned long long frequency = r->frequency;
+    return ticks / frequency * 1000000000ULL + ticks % frequency * 1000000000ULL / frequency;
+}
+
+// Write every event published so far, oldest first (writer thread)
+static void drain(trace_recorder_t *r) {
+    unsigned char batch[BATCH_EVENTS * TRACE_EVENT_SIZE];
+    uint32_t heads[TRACE_SOURCES];
+    size_t count = 0;
+
+    // Stop at what is there now so a busy producer cannot keep us here
+    for (int s = 0; s < TRACE_SOURCES; s++) {
+        heads[s] = (uint32_t)atomic32_load_acquire(&r->sources[s].head);
+    }
+
+    for (;;) {
+        trace_raw_event_t *oldest = NULL;
+        int oldest_source = 0;
+
+        for (int s = 0; s < TRACE_SOURCES; s++) {
+            trace_source_t *src = &r->sources[s];
+            uint32_t tail = (uint32_t)src->tail;
+            if (tail != heads[s]) {
+                trace_raw_event_t *e = &src->events[tail & RING_MASK];
+                if (!oldest || e->ticks < oldest->ticks) {
+                    oldest = e;
+                    oldest_source = s;
+                }
+            }
+        }
+
+        if (!oldest) {
+            break;
+        }
+
+        trace_event_t event;
+        unsigned long long start = r->start_time;
+        event.time_ns = oldest->ticks > start ? ticks_to_ns(r, oldest->ticks - start) : 0;
+        event.frame = oldest->frame;
+        event.value = oldest->value;
+        event.type = oldest->type;
+        event.source = (unsigned short)oldest_source;
+        trace_encode_event(batch + count * TRACE_EVENT_SIZE, &event);
+
+        trace_source_t *src = &r->sources[oldest_source];
+        atomic32_store_release(&src->tail, (long)((uint32_t)src->tail + 1));
+
+        if (++count == BATCH_EVENTS) {
+            if (!r->write_failed && fwrite(batch, TRACE_EVENT_SIZE, count, r->file) != count) {
+                r->write_failed = true;
+            }
+            r->events_written += count;
+            count = 0;
+        }
+    }
+
+    if (count > 0) {
+        if (!r->write_failed && fwrite(batch, TRACE_EVENT_SIZE, count, r->file) != count) {
+            r->write_failed = true;
+        }
+        r->events_written += count;
+    }
+}
+
+static void writer_thread_proc(void *param) {
+    trace_recorder_t *r = (trace_recorder_t*)param;
+
+    while (platform_event_wait(r->stop_event, TRACE_RECORDER_FLUSH_INTERVAL) == PLATFORM_WAIT_TIMEOUT) {
+        drain(r);
+    }
+
+    // Producers have left trace_recorder_emit, nothing more arrives
+    drain(r);
+}
+
+trace_recorder_t* trace_recorder_create(void) {
+    trace_recorder_t *r = (trace_recorder_t*)calloc(1, sizeof(trace_recorder_t));
+    if (!r) {
+        return NULL;
+    }
+
+    r->stop_event = platform_event_create(true);
+    r->control_lock = platform_lock_create();
+    if (!r->stop_event || !r->control_lock) {
+        platform_event_destroy(r->stop_event);
+        platform_lock_destroy(r->control_lock);
+        free(r);
+        return NULL;
+    }
+
+    r->frequency = platform_ticks_per_second();
+    return r;
+}
+
+void trace_recorder_destroy(trace_recorder_t *r) {
+    if (!r) return;
+
+    trace_recorder_stop(r);
+    platform_event_destroy(r->stop_event);
+    platform_lock_destroy(r->control_lock);
+    for (int s = 0; s < TRACE_SOURCES; s++) {
+        free(r->sources[s].events);
+    }
+    free(r);
+}
+
+bool trace_recorder_start(trace_recorder_t *r, const char *path) {
+    unsigned char header[TRACE_FILE_HEADER_SIZE];
+
+    platform_lock_enter(r->control_lock);
+
+    if (atomic32_load_acquire(&r->active)) {
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    for (int s = 0; s < TRACE_SOURCES; s++) {
+        if (!r->sources[s].events) {
+            r->sources[s].events = (trace_raw_event_t*)malloc(TRACE_RECORDER_RING_EVENTS * sizeof(trace_raw_event_t));
+            if (!r->sources[s].events) {
+                platform_lock_leave(r->control_lock);
+                return false;
+            }
+        }
+        // Drained by the last stop, so head == tail here
+        r->sources[s].dropped = 0;
+    }
+
+    r->file = fopen(path, "wb");
+    if (!r->file) {
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    trace_encode_file_header(header);
+    if (fwrite(header, 1, sizeof(header), r->file) != sizeof(header)) {
+        fclose(r->file);
+        r->file = NULL;
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    r->write_failed = false;
+    r->events_written = 0;
+    platform_event_reset(r->stop_event);
+
+    r->writer_thread = platform_thread_create(writer_thread_proc, r);
+    if (!r->writer_thread) {
+        fclose(r->file);
+        r->file = NULL;
+        platform_lock_leave(r->control_lock);
+        return false;
+    }
+
+    r->start_time = platform_ticks();
+    atomic32_store_release(&r->active, 1);
+
+    platform_lock_leave(r->control_lock);
+    return true;
+}
+
+unsigned int trace_recorder_stop(trace_recorder_t *r) {
+    unsigned int dropped = 0;
+
+    platform_lock_enter(r->control_lock);
+
+    if (!atomic32_load_acquire(&r->active)) {
+        platform_lock_leave(r->control_lock);
+        return 0;
+    }
+
+    // Same handshake as packet_recorder_stop, once per source
+    atomic32_store_release(&r->active, 0);
+    atomic_fence_full();
+    for (int s = 0; s < TRACE_SOURCES; s++) {
+        while (atomic32_load_acquire(&r->sources[s].busy)) {
+            platform_sleep_ms(0);
+        }
+    }
+
+    platform_event_set(r->stop_event);
+    platform_thread_wait(r->writer_thread, PLATFORM_WAIT_INFINITE);
+    platform_thread_close(r->writer_thread);
+    r->writer_thread = NULL;
+
+    if (fclose(r->file) != 0) {
+        r->write_failed = true;
+    }
+    r->file = NULL;
+
+    for (int s = 0; s < TRACE_SOURCES; s++) {
+        dropped += (unsigned int)r->sources[s].dropped;
+    }
+
+    platform_lock_leave(r->control_lock);
+    return dropped;
+}
+
+void trace_recorder_emit_at(trace_recorder_t *r, int source, int type,
+                            unsigned int frame, unsigned int value,
+                            unsigned long long ticks) {
+    trace_source_t *src = &r->sources[source];
+
+    if (!atomic32_load_acquire(&r->active)) {
+        return;
+    }
+
+    atomic32_store_release(&src->busy, 1);
+    atomic_fence_full();
+
+    if (atomic32_load_acquire(&r->active)) {
+        uint32_t head = (uint32_t)src->head;
+        uint32_t tail = (uint32_t)atomic32_load_acquire(&src->tail);
+
+        if (head - tail >= TRACE_RECORDER_RING_EVENTS) {
+            atomic32_store_relaxed(&src->dropped, atomic32_load_relaxed(&src->dropped) + 1);
+        } else {
+            trace_raw_event_t *e = &src->events[head & RING_MASK];
+            e->ticks = ticks;
+            e->frame = frame;
+            e->value = value;
+            e->type = (unsigned short)type;
+            atomic32_store_release(&src->head, (long)(head + 1));
+        }
+    }
+
+    atomic32_store_release(&src->busy, 0);
+}
+
+void trace_recorder_emit(trace_recorder_t *r, int source, int type,
+                         unsigned int frame, unsigned int value) {
+    if (!atomic32_load_acquire(&r->active)) {
+        return;
+    }
+
+    trace_recorder_emit_at(r, source, type, frame, value, platform_ticks());
+}
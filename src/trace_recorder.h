@@ -0,0 +1,140 @@
+/**
+ * Useeplus SuperCamera - Pipeline Trace Recorder
+ *
+ * Records trace events (see trace_file.h) while streaming. Each source -
+ * the read thread, and the consumers, which are serialized by the consumer
+ * lock - has its own lock-free ring of raw events stamped with
+ * platform_ticks(). A writer thread merges the rings in time order,
+ * converts the stamps and writes them out every few milliseconds.
+ *
+ * An inactive recorder costs one load per event site. When the writer
+ * falls behind, events are dropped and counted, never waited for.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef TRACE_RECORDER_H
+#define TRACE_RECORDER_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+#include "atomics.h"
+#include "platform.h"
+#include "trace_file.h"
+
+#define TRACE_RECORDER_RING_EVENTS    65536  // Per source, power of two
+#define TRACE_RECORDER_FLUSH_INTERVAL 10     // Writer wakeup, ms
+
+typedef struct trace_raw_event {
+    unsigned long long ticks;
+    unsigned int frame;
+    unsigned int value;
+    unsigned short type;
+} trace_raw_event_t;
+
+typedef struct trace_source {
+    trace_raw_event_t *events;
+    atomic32_t busy;                // Producer is inside trace_recorder_emit
+    atomic32_t dropped;             // Written by the producer only
+
+    // Event indices, free-running; head is written by the producer only,
+    // tail by the writer thread only
+    char pad0[CACHE_LINE_SIZE];
+    atomic32_t head;
+    char pad1[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+    atomic32_t tail;
+    char pad2[CACHE_LINE_SIZE - sizeof(atomic32_t)];
+} trace_source_t;
+
+typedef struct trace_recorder {
+    platform_lock_t *control_lock;  // Serializes start/stop
+    FILE *file;
+    platform_thread_t *writer_thread;
+    platform_event_t *stop_event;
+
+    unsigned long long start_time;  // platform_ticks()
+    unsigned long long frequency;
+
+    atomic32_t active;
+    trace_source_t sources[TRACE_SOURCES];
+
+    bool write_failed;              // Writer thread only
+    unsigned long long events_written;
+} trace_recorder_t;
+
+/**
+ * Create an idle recorder
+ *
+ * @return Recorder, or NULL if out of memory
+ */
+trace_recorder_t* trace_recorder_create(void);
+
+/**
+ * Stop tracing and free the recorder
+ *
+ * No thread may still emit events.
+ *
+ * @param r Recorder (may be NULL)
+ */
+void trace_recorder_destroy(trace_recorder_t *r);
+
+/**
+ * Start tracing to a new trace file
+ *
+ * @param r Recorder
+ * @param path Trace file path, overwritten if it exists
+ * @return true on success, false if already tracing or the file, rings
+ *         or writer thread could not be created
+ */
+bool trace_recorder_start(trace_recorder_t *r, const char *path);
+
+/**
+ * Stop tracing, write out every buffered event and close the file
+ *
+ * Safe to call while other threads emit events.
+ *
+ * @param r Recorder
+ * @return Number of events dropped because a ring was full
+ */
+unsigned int trace_recorder_stop(trace_recorder_t *r);
+
+/**
+ * Check whether a trace is being recorded
+ *
+ * @param r Recorder
+ * @return true while tracing
+ */
+static __inline bool trace_recorder_is_active(trace_recorder_t *r) {
+    return atomic32_load_acquire(&r->active) != 0;
+}
+
+/**
+ * Record an event that happens now (one thread per source at a time)
+ *
+ * Does nothing when not tracing.
+ *
+ * @param r Recorder
+ * @param source TRACE_SOURCE_*
+ * @param type TRACE_EVENT_*
+ * @param frame Frame the event belongs to
+ * @param value Type-specific value
+ */
+void trace_recorder_emit(trace_recorder_t *r, int source, int type,
+                         unsigned int frame, unsigned int value);
+
+/**
+ * Record an event with a platform_ticks() time taken earlier
+ *
+ * @param r Recorder
+ * @param source TRACE_SOURCE_*
+ * @param type TRACE_EVENT_*
+ * @param frame Frame the event belongs to
+ * @param value Type-specific value
+ * @param ticks When the event happened
+ */
+void trace_recorder_emit_at(trace_recorder_t *r, int source, int type,
+                            unsigned int frame, unsigned int value,
+                            unsigned long long ticks);
+
+#endif // TRACE_RECORDER_H
@@ -0,0 +1,101 @@
+/**
+ * Useeplus SuperCamera - USB Transport Interface
+ *
+ * Internal interface between the driver and whatever delivers the
+ * camera's bulk data. Everything useeplus_camera.c needs from the device
+ * goes through this table:
+ *
+ *   open / close        attach to and release the device
+ *   reset               clear stale data from the bulk IN pipe
+ *   start_streaming     select the streaming interface setting
+ *   write_command       send a command on the bulk OUT pipe
+ *   submit_read /       asynchronous bulk IN reads addressed by a small
+ *   wait_read           transfer slot number: submitted on a slot, later
+ *                       reaped with wait_read on the same slot
+ *   abort_reads         cancel all outstanding reads
+ *
+ * A transport may also stream (start_stream / wait_stream / stop_stream):
+ * it then keeps its own pool of reads in flight, resubmitting each one as
+ * it completes from its own completion handling, with buffers taken from
+ * the caller's rx_pool, and hands the completed buffers over in bus
+ * order. The read pipeline uses streaming whenever a transport offers it.
+ *
+ * Implementations: winusb_transport.c and libusb_transport.c (the real
+ * camera) and replay_transport.c (a recorded capture file).
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef USB_TRANSPORT_H
+#define USB_TRANSPORT_H
+
+#include <stddef.h>
+
+#include "rx_pool.h"
+
+#define USB_TRANSPORT_MAX_READS  16          // Transfer slots per transport
+#define USB_WAIT_INFINITE        0xFFFFFFFFu
+
+// Results of transport and read pipeline operations
+#define USB_XFER_OK       0
+#define USB_XFER_TIMEOUT  1  // Wait timed out, the transfer is still pending
+#define USB_XFER_ABORTED  2  // Transfer was cancelled by abort_reads
+#define USB_XFER_ERROR    3
+#define USB_XFER_END      4  // Source exhausted (replay only), no more data will come
+
+typedef struct usb_transport usb_transport_t;
+
+typedef struct usb_transport_ops {
+    // Attach to the device (device path or capture file); on failure the
+    // reason is left in transport->error
+    int (*open)(usb_transport_t *transport, const char *path);
+
+    // Release the device and free the transport (also after a failed open)
+    void (*close)(usb_transport_t *transport);
+
+    // Flush and reset the bulk IN pipe (no reads may be outstanding)
+    void (*reset)(usb_transport_t *transport);
+
+    // Put the device into streaming mode before the connect command
+    int (*start_streaming)(usb_transport_t *transport);
+
+    // Send a command on the bulk OUT pipe
+    int (*write_command)(usb_transport_t *transport, const unsigned char *data, size_t length);
+
+    // Start an asynchronous bulk IN transfer on a free transfer slot
+    int (*submit_read)(usb_transport_t *transport, int slot,
+                       unsigned char *buffer, size_t length);
+
+    // Wait for the transfer on slot to complete. A device-side timeout
+    // completes the transfer with USB_XFER_OK and 0 bytes
+    int (*wait_read)(usb_transport_t *transport, int slot,
+                     unsigned int timeout_ms, size_t *bytes_read);
+
+    // Cancel all outstanding reads; each must still be reaped with wait_read.
+    // May be called from another thread while a wait_read is blocked, and
+    // also ends a stream (wait_stream returns USB_XFER_ABORTED)
+    void (*abort_reads)(usb_transport_t *transport);
+
+    // Optional, NULL if the transport cannot stream. Start depth reads of
+    // transfer_size bytes into buffers claimed from pool; from here on the
+    // transport is the only thread claiming buffers from it
+    int (*start_stream)(usb_transport_t *transport, rx_pool_t *pool, int depth, size_t transfer_size);
+
+    // Wait for the next completed read. On USB_XFER_OK the caller owns the
+    // buffer's reference and drops it with rx_buffer_unref when done; reads
+    // that completed without data are not reported
+    int (*wait_stream)(usb_transport_t *transport, unsigned int timeout_ms,
+                       rx_buffer_t **buffer, size_t *length);
+
+    // Cancel the reads, wait for them and drop the references on completed
+    // buffers not picked up; false if a read never came back
+    bool (*stop_stream)(usb_transport_t *transport);
+} usb_transport_ops_t;
+
+// Implementations embed this as their first member
+struct usb_transport {
+    const usb_transport_ops_t *ops;
+    char error[256];    // Reason for the last failed operation
+};
+
+#endif // USB_TRANSPORT_H
@@ -10,7 +10,7 @@
  * - Ported from Linux kernel driver to Windows user-mode WinUSB
  * - Robust frame boundary detection with full SOI/EOI validation
  * - Improved USB cleanup for reliable camera reopening
- * - Optimized bulk read with timeouts and RAW_IO mode
+ * - Pipelined overlapped bulk reads with timeouts and RAW_IO mode
  * - Expanded ring buffer (12 frames) to handle camera's internal buffering
  * - Comprehensive pipe abort/flush/reset sequences
  * - State clearing on open to handle stale data from previous sessions
@@ -21,13 +21,31 @@
  */
 
 #include "useeplus_camera.h"
+#include "frame_assembler.h"
+#include "frame_ring.h"
+#include "frame_pool.h"
+#include "frame_decoder.h"
+#include "parallel_decoder.h"
+#include "packet_header.h"
+#include "read_pipeline.h"
+#include "replay_transport.h"
+#include "packet_recorder.h"
+#include "trace_recorder.h"
+#include "stream_stats.h"
+#include "async_log.h"
+#include "platform.h"
 
+#ifdef _WIN32
+#include "winusb_transport.h"
 #include <windows.h>
 #include <setupapi.h>
 #include <initguid.h>
-#include <winusb.h>
 #include <usb.h>
 #include <usbiodef.h>
+#else
+#include "libusb_transport.h"
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -35,20 +53,23 @@
 #include <ctype.h>
 
 // Suppress MSVC security warnings
+#ifdef _MSC_VER
 #pragma warning(disable: 4996)
+#endif
 
 // Define min macro for compatibility
 #ifndef min
 #define min(a, b) ((a) < (b) ? (a) : (b))
 #endif
 
+#ifdef _WIN32
 // WinUSB device interface GUID (used by Zadig)
 // {dee824ef-729b-4a0e-9c14-b7117d33a817}
 DEFINE_GUID(GUID_DEVINTERFACE_WINUSB,
     0xdee824ef, 0x729b, 0x4a0e, 0x9c, 0x14, 0xb7, 0x11, 0x7d, 0x33, 0xa8, 0x17);
 
-#pragma comment(lib, "winusb.lib")
 #pragma comment(lib, "setupapi.lib")
+#endif
 
 // Camera device identifiers
 #define VENDOR_ID  0x2ce3
@@ -61,56 +82,119 @@ DEFINE_GUID(GUID_DEVINTERFACE_WINUSB,
 
 // Protocol constants
 #define CONNECT_CMD_SIZE 5
-#define BUFFER_SIZE (64*1024)
-#define MAX_FRAMES 12  // Camera has 10-frame buffer, use 12 for safety margin
+#define TRANSFER_SIZE (64*1024)  // Size of each bulk read
+#define RX_BUFFERS    64         // Receive buffers: reads in flight plus payloads held by frames
 
-// Frame buffer structure
-typedef struct camera_frame {
+// Dispatch and decode feed thread wakeup while no frames arrive, ms
+#define DISPATCH_WAIT_TIMEOUT 100
+
+// A buffer for decoded frames (camera_read_decoded_frame), kept across
+// frames; held while the application has the frame
+typedef struct decoded_buffer {
     unsigned char *data;
-    size_t size;
     size_t capacity;
-    bool ready;
-} camera_frame_t;
+    bool held;
+} decoded_buffer_t;
+
+// Driver threads with settable scheduling (CAMERA_THREAD_*)
+#define THREAD_ROLES 2
+static const char *const default_thread_names[THREAD_ROLES] = { "camera-read", "camera-dispatch" };
 
 // Camera device structure
 typedef struct camera_device {
-    // USB handles
-    HANDLE device_handle;
-    WINUSB_INTERFACE_HANDLE winusb_handle;
+    // Device access (WinUSB, libusb or capture replay)
+    usb_transport_t *transport;
     char device_path[256];
     
     // Streaming state
     bool streaming;
-    HANDLE read_thread;
-    HANDLE stop_event;
-    
-    // Frame ring buffer
-    camera_frame_t frames[MAX_FRAMES];
-    int write_frame;  // Where new data is written
-    int read_frame;   // Where data is read from
-    CRITICAL_SECTION frame_lock;
-    HANDLE frame_ready_event;
-    
-    // Statistics
-    unsigned int frames_captured;
-    unsigned int frames_dropped;
+    platform_thread_t *read_thread;
+    platform_event_t *stop_event;
+    
+    // Overlapped bulk reads on EP_IN, kept transfer_depth deep
+    read_pipeline_t pipeline;
+    int transfer_depth;
+    
+    // Frame limits applied at the next camera_start_streaming
+    size_t max_frame_size;
+    int frame_buffers;
+    volatile bool stream_ended;  // Transport has no more data (replay)
+    
+    // Lock-free frame ring: the read thread is the only producer.
+    // Consumers serialize among themselves but never block the producer
+    frame_ring_t ring;
+    platform_lock_t *consumer_lock;
+    int read_mode;  // CAMERA_READ_*, under consumer_lock
+    platform_event_t *frame_ready_event;  // Signalled when the ring becomes non-empty
+    
+    // Assembles packets into the ring's write slot (read thread only)
+    frame_assembler_t assembler;
+    
+    // Slot storage, filled at start and grown by size class (read thread only)
+    frame_pool_t pool;
+    unsigned int buffers_grown;
+    
+    // Raw packet recording (camera_start_recording / USEEPLUS_RECORD)
+    packet_recorder_t *recorder;
+    
+    // JPEG decoding (camera_read_decoded_frame), all under decode_lock.
+    // One decompressor, created on first use; buffers grow by size class
+    platform_lock_t *decode_lock;
+    frame_decoder_t *decoder;
+    int decode_width;  // camera_set_decode_size, 0 = no limit
+    int decode_height;
+    frame_pool_t decode_pool;
+    decoded_buffer_t decoded[CAMERA_MAX_DECODED_FRAMES];
+    
+    // Decode threads (camera_set_decode_threads), changed only while
+    // stopped; the feed thread submits each completed frame to them
+    parallel_decoder_t *decoders;
+    int decoders_format;
+    platform_thread_t *decode_feed_thread;
+    
+    // Frame callback (camera_set_frame_callback), changed only while stopped
+    camera_frame_callback_t frame_callback;
+    void *callback_user_data;
+    int callback_mode;
+    platform_thread_t *dispatch_thread;
+    
+    // Scheduling of the read and dispatch threads, applied as they start
+    camera_thread_attr_t thread_attr[THREAD_ROLES];
+    
+    // Pipeline event trace (camera_start_trace / USEEPLUS_TRACE)
+    trace_recorder_t *tracer;
+    unsigned int frame_seq;  // Id of the frame under assembly (read thread only)
+    
+    // Statistics (camera_get_stats_ex); timestamps in platform_ticks()
+    stream_stats_t stats;
+    unsigned long long ticks_per_second;
+    unsigned long long frame_start;  // Arrival of the current frame's first packet
+    unsigned int frame_packets;      // Packets of the current frame so far
+    unsigned char frame_header[FRAME_PACKET_HEADER_SIZE];  // Its first packet's header
+    packet_stream_t packet_stream;   // Header counters, for loss detection
+    unsigned long long last_frame;   // Completion of the previous frame, 0 = none
     
     // Connection command
     unsigned char connect_cmd[CONNECT_CMD_SIZE];
 } camera_device_t;
 
 // Thread-local error storage
-static __declspec(thread) char last_error[256] = {0};
+static PLATFORM_THREAD_LOCAL char last_error[256] = {0};
 
-// Debug logging state
+// Debug logging state; g_log_lock serializes enabling and disabling,
+// messages themselves go through the lock-free async logger
 static bool g_debug_logging_enabled = false;
 static FILE *g_debug_log_file = NULL;
-static CRITICAL_SECTION g_log_lock;
-static bool g_log_lock_initialized = false;
+static platform_lock_t *g_log_lock = NULL;
 
 // Forward declarations
-static DWORD WINAPI read_thread_proc(LPVOID param);
-static void process_data(camera_device_t *dev, unsigned char *data, int length);
+static void read_thread_proc(void *param);
+static void dispatch_thread_proc(void *param);
+#ifdef USEEPLUS_HAVE_JPEG
+static void decode_feed_thread_proc(void *param);
+#endif
+static void process_data(camera_device_t *dev, const unsigned char *data, int length,
+                         unsigned long long arrival);
 static int send_command(camera_device_t *dev, unsigned char *data, int len);
 static void init_debug_logging(void);
 
@@ -122,94 +206,99 @@ static void set_error(const char *format, ...) {
     va_end(args);
 }
 
+// Case-insensitive string comparison (_stricmp / strcasecmp)
+static int compare_nocase(const char *a, const char *b) {
+    while (*a && tolower((unsigned char)*a) == tolower((unsigned char)*b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char)*a) - tolower((unsigned char)*b);
+}
+
 // Initialize debug logging system
 static void init_debug_logging(void) {
-    if (!g_log_lock_initialized) {
-        InitializeCriticalSection(&g_log_lock);
-        g_log_lock_initialized = true;
+    if (!g_log_lock) {
+        g_log_lock = platform_lock_create();
         
         // Check environment variable USEEPLUS_DEBUG
         char *env_debug = getenv("USEEPLUS_DEBUG");
         if (env_debug && (strcmp(env_debug, "1") == 0 || 
-                          _stricmp(env_debug, "true") == 0 ||
-                          _stricmp(env_debug, "yes") == 0)) {
+                          compare_nocase(env_debug, "true") == 0 ||
+                          compare_nocase(env_debug, "yes") == 0)) {
             camera_set_debug_logging(true);
         }
     }
 }
 
-// Write debug log entry with timestamp and thread ID
+// Write debug log entry; timestamp and thread ID are added by the logger.
+// Formats into this thread's ring and returns, the file is written by the
+// logger's own thread
 static void debug_log(const char *format, ...) {
-    if (!g_debug_logging_enabled || !g_debug_log_file) {
+    if (!g_debug_logging_enabled) {
         return;
     }
     
-    EnterCriticalSection(&g_log_lock);
-    
-    // Get timestamp
-    SYSTEMTIME st;
-    GetLocalTime(&st);
-    
-    // Get thread ID
-    DWORD thread_id = GetCurrentThreadId();
-    
-    // Write timestamp and thread ID
-    fprintf(g_debug_log_file, "[%02d:%02d:%02d.%03d][TID:%lu] ", 
-            st.wHour, st.wMinute, st.wSecond, st.wMilliseconds, thread_id);
-    
-    // Write log message
     va_list args;
     va_start(args, format);
-    vfprintf(g_debug_log_file, format, args);
+    async_log_write(format, args);
     va_end(args);
-    
-    fprintf(g_debug_log_file, "\n");
-    fflush(g_debug_log_file);
-    
-    LeaveCriticalSection(&g_log_lock);
 }
 
 // Enable/disable debug logging
 CAMERA_API int camera_set_debug_logging(bool enable) {
     init_debug_logging();
     
-    EnterCriticalSection(&g_log_lock);
+    platform_lock_enter(g_log_lock);
     
     if (enable && !g_debug_logging_enabled) {
         // Open log file
         g_debug_log_file = fopen("useeplus_debug.log", "a");
         if (!g_debug_log_file) {
-            LeaveCriticalSection(&g_log_lock);
+            platform_lock_leave(g_log_lock);
             set_error("Failed to open debug log file");
             return CAMERA_ERROR_INVALID_PARAM;
         }
         
-        g_debug_logging_enabled = true;
-        
         // Write header
-        SYSTEMTIME st;
-        GetLocalTime(&st);
+        platform_local_time_t st;
+        platform_local_time(&st);
         fprintf(g_debug_log_file, "\n");
         fprintf(g_debug_log_file, "========================================\n");
         fprintf(g_debug_log_file, "Useeplus Camera Debug Log\n");
         fprintf(g_debug_log_file, "Session started: %04d-%02d-%02d %02d:%02d:%02d\n",
-                st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+                st.year, st.month, st.day, st.hour, st.minute, st.second);
         fprintf(g_debug_log_file, "========================================\n");
         fflush(g_debug_log_file);
         
+        // From here on the logger's thread owns writes to the file
+        if (!async_log_start(g_debug_log_file)) {
+            fclose(g_debug_log_file);
+            g_debug_log_file = NULL;
+            platform_lock_leave(g_log_lock);
+            set_error("Failed to start debug logger");
+            return CAMERA_ERROR_INIT_FAILED;
+        }
+        
+        g_debug_logging_enabled = true;
+        
     } else if (!enable && g_debug_logging_enabled) {
-        // Close log file
+        g_debug_logging_enabled = false;
+        
+        // Write out everything logged so far, then close log file
+        unsigned int dropped = async_log_stop();
         if (g_debug_log_file) {
+            if (dropped > 0) {
+                fprintf(g_debug_log_file, "%u debug messages dropped (logger could not keep up)\n", dropped);
+            }
             fprintf(g_debug_log_file, "========================================\n");
             fprintf(g_debug_log_file, "Debug logging disabled\n");
             fprintf(g_debug_log_file, "========================================\n\n");
             fclose(g_debug_log_file);
             g_debug_log_file = NULL;
         }
-        g_debug_logging_enabled = false;
     }
     
-    LeaveCriticalSection(&g_log_lock);
+    platform_lock_leave(g_log_lock);
     return CAMERA_SUCCESS;
 }
 
@@ -218,6 +307,12 @@ CAMERA_API bool camera_is_debug_logging_enabled(void) {
     return g_debug_logging_enabled;
 }
 
+// Debug messages lost to full logger rings
+CAMERA_API unsigned int camera_get_debug_log_dropped(void) {
+    return async_log_dropped();
+}
+
+#ifdef _WIN32
 // Enumerate cameras using SetupAPI
 CAMERA_API int camera_enumerate(camera_device_info_t *devices, int max_devices) {
     HDEVINFO device_info_set;
@@ -360,6 +455,36 @@ CAMERA_API int camera_enumerate(camera_device_info_t *devices, int max_devices)
     SetupDiDestroyDeviceInfoList(device_info_set);
     return found_count;
 }
+#else
+// Enumerate cameras using libusb; paths are "bus:address"
+#define MAX_ENUMERATED 16
+
+CAMERA_API int camera_enumerate(camera_device_info_t *devices, int max_devices) {
+    char paths[MAX_ENUMERATED][256];
+    int found_count;
+    
+    init_debug_logging();
+    debug_log("camera_enumerate: Starting enumeration (max_devices=%d)", max_devices);
+    
+    found_count = libusb_transport_enumerate(VENDOR_ID, PRODUCT_ID, paths, MAX_ENUMERATED);
+    if (found_count < 0) {
+        set_error("Failed to enumerate devices");
+        return CAMERA_ERROR_NOT_FOUND;
+    }
+    
+    for (int i = 0; devices && i < found_count && i < max_devices; i++) {
+        devices[i].vendor_id = VENDOR_ID;
+        devices[i].product_id = PRODUCT_ID;
+        strncpy(devices[i].device_path, paths[i], sizeof(devices[i].device_path) - 1);
+        devices[i].device_path[sizeof(devices[i].device_path) - 1] = '\0';
+        strncpy(devices[i].description, "Useeplus SuperCamera (libusb)",
+                sizeof(devices[i].description) - 1);
+        devices[i].description[sizeof(devices[i].description) - 1] = '\0';
+    }
+    
+    return found_count;
+}
+#endif
 
 // Open first available camera
 CAMERA_API CAMERA_HANDLE camera_open(void) {
@@ -373,35 +498,44 @@ CAMERA_API CAMERA_HANDLE camera_open(void) {
     return camera_open_path(device.device_path);
 }
 
-// Open camera by device path
-CAMERA_API CAMERA_HANDLE camera_open_path(const char *device_path) {
+// Open a camera on the given transport (takes ownership of it)
+static CAMERA_HANDLE open_with_transport(usb_transport_t *transport, const char *path) {
     camera_device_t *dev = NULL;
-    BOOL result;
-    USB_INTERFACE_DESCRIPTOR interface_desc;
-    ULONG length_returned;
-    
-    init_debug_logging();
     
-    if (!device_path) {
-        set_error("Invalid device path");
-        debug_log("camera_open_path: ERROR - Invalid device path (NULL)");
+    if (!transport) {
+        set_error("Memory allocation failed");
         return NULL;
     }
     
-    debug_log("camera_open_path: Opening camera at '%s'", device_path);
-    
     // Allocate device structure
     dev = (camera_device_t*)calloc(1, sizeof(camera_device_t));
     if (!dev) {
+        transport->ops->close(transport);
         set_error("Memory allocation failed");
         return NULL;
     }
     
     // Initialize device structure
-    strncpy(dev->device_path, device_path, sizeof(dev->device_path) - 1);
-    InitializeCriticalSection(&dev->frame_lock);
-    dev->frame_ready_event = CreateEvent(NULL, FALSE, FALSE, NULL);
-    dev->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    strncpy(dev->device_path, path, sizeof(dev->device_path) - 1);
+    dev->transport = transport;
+    dev->consumer_lock = platform_lock_create();
+    dev->decode_lock = platform_lock_create();
+    frame_ring_init(&dev->ring, CAMERA_DEFAULT_FRAME_BUFFERS);
+    dev->frame_ready_event = platform_event_create(false);
+    dev->stop_event = platform_event_create(true);
+    frame_assembler_init(&dev->assembler, CAMERA_DEFAULT_MAX_FRAME_SIZE);
+    dev->assembler.fast_path_enabled = true;
+    frame_pool_init(&dev->pool);
+    frame_pool_init(&dev->decode_pool);
+    packet_stream_init(&dev->packet_stream);
+    dev->transfer_depth = CAMERA_DEFAULT_TRANSFER_DEPTH;
+    dev->max_frame_size = CAMERA_DEFAULT_MAX_FRAME_SIZE;
+    dev->frame_buffers = CAMERA_DEFAULT_FRAME_BUFFERS;
+    dev->read_mode = CAMERA_READ_FIFO;
+    dev->recorder = packet_recorder_create();
+    dev->tracer = trace_recorder_create();
+    
+    dev->ticks_per_second = platform_ticks_per_second();
     
     // Initialize connection command
     dev->connect_cmd[0] = 0xbb;
@@ -410,94 +544,95 @@ CAMERA_API CAMERA_HANDLE camera_open_path(const char *device_path) {
     dev->connect_cmd[3] = 0x00;
     dev->connect_cmd[4] = 0x00;
     
-    // Open device handle - WinUSB requires FILE_FLAG_OVERLAPPED
-    dev->device_handle = CreateFileA(device_path,
-                                     GENERIC_WRITE | GENERIC_READ,
-                                     FILE_SHARE_WRITE | FILE_SHARE_READ,
-                                     NULL,
-                                     OPEN_EXISTING,
-                                     FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
-                                     NULL);
-    
-    if (dev->device_handle == INVALID_HANDLE_VALUE) {
-        DWORD error = GetLastError();
-        set_error("Failed to open device: error %lu (0x%lx)", error, error);
-        debug_log("camera_open_path: ERROR - CreateFileA failed: error %lu (0x%lx)", error, error);
+    if (!dev->consumer_lock || !dev->decode_lock || !dev->frame_ready_event || !dev->stop_event) {
+        set_error("Failed to create events: %lu", platform_last_error());
         goto error;
     }
     
-    debug_log("camera_open_path: CreateFileA succeeded, handle = 0x%p", dev->device_handle);
-    
-    // Verify the handle is valid
-    char debug_msg[512];
-    snprintf(debug_msg, sizeof(debug_msg), "CreateFileA succeeded, handle = 0x%p", dev->device_handle);
-    OutputDebugStringA(debug_msg);
+    if (!dev->recorder || !dev->tracer) {
+        set_error("Memory allocation failed");
+        goto error;
+    }
     
-    // Initialize WinUSB
-    result = WinUsb_Initialize(dev->device_handle, &dev->winusb_handle);
-    if (!result) {
-        DWORD error = GetLastError();
-        
-        // Additional diagnostics
-        snprintf(debug_msg, sizeof(debug_msg), 
-                "WinUsb_Initialize failed: error %lu (0x%lx), handle was 0x%p", 
-                error, error, dev->device_handle);
-        OutputDebugStringA(debug_msg);
-        
-        set_error("WinUSB initialization failed: error %lu (0x%lx). Possible issues:\n"
-                 "  1. WinUSB driver not correctly installed on Interface 1\n"
-                 "  2. Another application has the device open\n"
-                 "  3. Insufficient permissions (try running as Administrator)",
-                 error, error);
-        debug_log("camera_open_path: ERROR - WinUsb_Initialize failed: error %lu (0x%lx)", error, error);
+    // Open the device and clear stale state from previous sessions
+    if (transport->ops->open(transport, path) != USB_XFER_OK) {
+        set_error("%s", transport->error);
+        debug_log("camera_open_path: ERROR - %s", transport->error);
         goto error;
     }
     
-    debug_log("camera_open_path: WinUsb_Initialize succeeded! Handle = 0x%p", dev->winusb_handle);
-    snprintf(debug_msg, sizeof(debug_msg), "WinUsb_Initialize succeeded! Handle = 0x%p", dev->winusb_handle);
-    OutputDebugStringA(debug_msg);
-    
-    // Clear any stale state from previous sessions
-    // Abort and flush all pipes first
-    WinUsb_AbortPipe(dev->winusb_handle, EP_IN);
-    WinUsb_AbortPipe(dev->winusb_handle, EP_OUT);
-    WinUsb_FlushPipe(dev->winusb_handle, EP_IN);
-    WinUsb_FlushPipe(dev->winusb_handle, EP_OUT);
-    WinUsb_ResetPipe(dev->winusb_handle, EP_IN);
-    WinUsb_ResetPipe(dev->winusb_handle, EP_OUT);
-    
-    // Ensure we start at alternate setting 0
-    WinUsb_SetCurrentAlternateSetting(dev->winusb_handle, 0);
-    Sleep(100);
-    
-    // Query interface to verify we have the right device
-    result = WinUsb_QueryInterfaceSettings(dev->winusb_handle, 0, &interface_desc);
-    if (result) {
-        // Log interface info for debugging
-        char debug_msg[256];
-        snprintf(debug_msg, sizeof(debug_msg),
-                "Camera interface: class=0x%02x, subclass=0x%02x, protocol=0x%02x, endpoints=%d",
-                interface_desc.bInterfaceClass,
-                interface_desc.bInterfaceSubClass,
-                interface_desc.bInterfaceProtocol,
-                interface_desc.bNumEndpoints);
-        OutputDebugStringA(debug_msg);
+    debug_log("camera_open_path: Device opened, handle = 0x%p", dev);
+    
+    // Check environment variable USEEPLUS_TRACE
+    char *env_trace = getenv("USEEPLUS_TRACE");
+    if (env_trace && env_trace[0]) {
+        if (camera_start_trace((CAMERA_HANDLE)dev, env_trace) == CAMERA_SUCCESS) {
+            debug_log("camera_open_path: Tracing to '%s' (USEEPLUS_TRACE)", env_trace);
+        } else {
+            debug_log("camera_open_path: WARNING - USEEPLUS_TRACE: %s", camera_get_error());
+        }
     }
     
     return (CAMERA_HANDLE)dev;
     
 error:
-    if (dev) {
-        if (dev->winusb_handle) WinUsb_Free(dev->winusb_handle);
-        if (dev->device_handle != INVALID_HANDLE_VALUE) CloseHandle(dev->device_handle);
-        if (dev->frame_ready_event) CloseHandle(dev->frame_ready_event);
-        if (dev->stop_event) CloseHandle(dev->stop_event);
-        DeleteCriticalSection(&dev->frame_lock);
-        free(dev);
-    }
+    transport->ops->close(transport);
+    packet_recorder_destroy(dev->recorder);
+    trace_recorder_destroy(dev->tracer);
+    platform_event_destroy(dev->frame_ready_event);
+    platform_event_destroy(dev->stop_event);
+    platform_lock_destroy(dev->consumer_lock);
+    platform_lock_destroy(dev->decode_lock);
+    free(dev);
     return NULL;
 }
 
+// Open camera by device path
+CAMERA_API CAMERA_HANDLE camera_open_path(const char *device_path) {
+    init_debug_logging();
+    
+    if (!device_path) {
+        set_error("Invalid device path");
+        debug_log("camera_open_path: ERROR - Invalid device path (NULL)");
+        return NULL;
+    }
+    
+    debug_log("camera_open_path: Opening camera at '%s'", device_path);
+    
+#ifdef _WIN32
+    CAMERA_HANDLE handle = open_with_transport(winusb_transport_create(EP_IN, EP_OUT), device_path);
+#else
+    CAMERA_HANDLE handle = open_with_transport(libusb_transport_create(INTERFACE_NUM, EP_IN, EP_OUT), device_path);
+#endif
+    
+    // Check environment variable USEEPLUS_RECORD (live cameras only)
+    char *env_record = getenv("USEEPLUS_RECORD");
+    if (handle && env_record && env_record[0]) {
+        if (camera_start_recording(handle, env_record) == CAMERA_SUCCESS) {
+            debug_log("camera_open_path: Recording packets to '%s' (USEEPLUS_RECORD)", env_record);
+        } else {
+            debug_log("camera_open_path: WARNING - USEEPLUS_RECORD: %s", camera_get_error());
+        }
+    }
+    
+    return handle;
+}
+
+// Open a recorded capture file as if it were a camera
+CAMERA_API CAMERA_HANDLE camera_open_replay(const char *capture_path, double speed) {
+    init_debug_logging();
+    
+    if (!capture_path || speed < 0.0) {
+        set_error("Invalid parameters");
+        debug_log("camera_open_replay: ERROR - Invalid parameters");
+        return NULL;
+    }
+    
+    debug_log("camera_open_replay: Replaying '%s' at speed %.2f", capture_path, speed);
+    
+    return open_with_transport(replay_transport_create(speed), capture_path);
+}
+
 // Close camera
 CAMERA_API void camera_close(CAMERA_HANDLE handle) {
     camera_device_t *dev = (camera_device_t*)handle;
@@ -509,83 +644,57 @@ CAMERA_API void camera_close(CAMERA_HANDLE handle) {
     // Stop streaming if active
     camera_stop_streaming(handle);
     
-    debug_log("camera_close: Beginning USB cleanup sequence");
-    
-    // Aggressive cleanup to ensure device can be reopened
-    if (dev->winusb_handle) {
-        // Abort any remaining transfers
-        debug_log("camera_close: Aborting pipes");
-        WinUsb_AbortPipe(dev->winusb_handle, EP_IN);
-        WinUsb_AbortPipe(dev->winusb_handle, EP_OUT);
-        Sleep(50);
-        
-        // Flush pipes thoroughly
-        WinUsb_FlushPipe(dev->winusb_handle, EP_IN);
-        WinUsb_FlushPipe(dev->winusb_handle, EP_OUT);
-        Sleep(50);
-        
-        // Reset pipes to clear any stale state
-        WinUsb_ResetPipe(dev->winusb_handle, EP_IN);
-        WinUsb_ResetPipe(dev->winusb_handle, EP_OUT);
-        Sleep(50);
-        
-        // Reset interface to default state before closing
-        WinUsb_SetCurrentAlternateSetting(dev->winusb_handle, 0);
-        Sleep(100);
-    }
-    
-    debug_log("camera_close: Freeing WinUSB and device handles");
+    // The read thread is gone; finish any recording and trace
+    camera_stop_recording(handle);
+    packet_recorder_destroy(dev->recorder);
+    dev->recorder = NULL;
+    camera_stop_trace(handle);
+    trace_recorder_destroy(dev->tracer);
+    dev->tracer = NULL;
     
-    // Free WinUSB
-    if (dev->winusb_handle) {
-        WinUsb_Free(dev->winusb_handle);
-        dev->winusb_handle = NULL;
-    }
+    debug_log("camera_close: Beginning USB cleanup sequence");
     
-    // Close device handle
-    if (dev->device_handle != INVALID_HANDLE_VALUE) {
-        CloseHandle(dev->device_handle);
-        dev->device_handle = INVALID_HANDLE_VALUE;
-    }
+    // Aggressive cleanup to ensure device can be reopened, then release it
+    dev->transport->ops->close(dev->transport);
+    dev->transport = NULL;
     
     debug_log("camera_close: Camera closed successfully");
     
     // Free frame buffers
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        free(dev->frames[i].data);
-        dev->frames[i].data = NULL;
+    for (int i = 0; i < FRAME_RING_MAX_SLOTS; i++) {
+        frame_pool_put(&dev->pool, dev->ring.slots[i].data, dev->ring.slots[i].capacity);
+        dev->ring.slots[i].data = NULL;
     }
+    frame_pool_free(&dev->pool);
     
-    // Cleanup sync objects
-    if (dev->frame_ready_event) {
-        CloseHandle(dev->frame_ready_event);
+    // Free the decoder and its buffers
+    for (int i = 0; i < CAMERA_MAX_DECODED_FRAMES; i++) {
+        frame_pool_put(&dev->decode_pool, dev->decoded[i].data, dev->decoded[i].capacity);
     }
-    if (dev->stop_event) {
-        CloseHandle(dev->stop_event);
-    }
-    DeleteCriticalSection(&dev->frame_lock);
+    frame_pool_free(&dev->decode_pool);
+#ifdef USEEPLUS_HAVE_JPEG
+    frame_decoder_destroy(dev->decoder);
+    parallel_decoder_destroy(dev->decoders);
+#endif
+    
+    // Cleanup sync objects
+    platform_event_destroy(dev->frame_ready_event);
+    platform_event_destroy(dev->stop_event);
+    platform_lock_destroy(dev->consumer_lock);
+    platform_lock_destroy(dev->decode_lock);
     
     free(dev);
 }
 
 // Send command to camera
 static int send_command(camera_device_t *dev, unsigned char *data, int len) {
-    ULONG bytes_sent;
-    BOOL result;
+    usb_transport_t *transport = dev->transport;
     
     debug_log("send_command: Sending %d bytes to camera", len);
     
-    result = WinUsb_WritePipe(dev->winusb_handle, EP_OUT, data, len, &bytes_sent, NULL);
-    
-    if (!result) {
-        DWORD error = GetLastError();
-        set_error("Failed to send command: %d", error);
-        debug_log("send_command: ERROR - WinUsb_WritePipe failed: %lu", error);
-        return CAMERA_ERROR_USB_FAILED;
-    }
-    
-    if (bytes_sent != len) {
-        set_error("Short write: %lu / %d bytes", bytes_sent, len);
+    if (transport->ops->write_command(transport, data, (size_t)len) != USB_XFER_OK) {
+        set_error("Failed to send command: %s", transport->error);
+        debug_log("send_command: ERROR - %s", transport->error);
         return CAMERA_ERROR_USB_FAILED;
     }
     
@@ -595,9 +704,6 @@ static int send_command(camera_device_t *dev, unsigned char *data, int len) {
 // Start streaming
 CAMERA_API int camera_start_streaming(CAMERA_HANDLE handle) {
     camera_device_t *dev = (camera_device_t*)handle;
-    BOOL result;
-    UCHAR alt_setting = 1;
-    USB_INTERFACE_DESCRIPTOR if_desc;
     
     if (!dev) {
         set_error("Invalid handle");
@@ -612,28 +718,17 @@ CAMERA_API int camera_start_streaming(CAMERA_HANDLE handle) {
     
     debug_log("camera_start_streaming: Starting streaming on handle 0x%p", handle);
     
-    // Query current interface descriptor
-    result = WinUsb_QueryInterfaceSettings(dev->winusb_handle, 0, &if_desc);
-    if (result) {
-        char debug_msg[256];
-        snprintf(debug_msg, sizeof(debug_msg), 
-                "Camera interface: %d alternate settings available\n", 
-                if_desc.bNumEndpoints);
-        OutputDebugStringA(debug_msg);
+    // Both would consume the frames; neither would see the whole stream
+    if (dev->decoders && dev->frame_callback) {
+        set_error("Decode threads and a frame callback cannot be used together");
+        debug_log("camera_start_streaming: ERROR - %s", camera_get_error());
+        return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    // Reset to alternate setting 0 first, then set to 1 (clean state)
-    WinUsb_SetCurrentAlternateSetting(dev->winusb_handle, 0);
-    Sleep(10);
-    
-    // Reset and flush the input pipe before starting
-    WinUsb_ResetPipe(dev->winusb_handle, EP_IN);
-    WinUsb_FlushPipe(dev->winusb_handle, EP_IN);
-    
-    // Set alternate interface setting to 1
-    result = WinUsb_SetCurrentAlternateSetting(dev->winusb_handle, alt_setting);
-    if (!result) {
-        set_error("Failed to set alternate setting: %d", GetLastError());
+    // Select the streaming interface setting on a freshly reset pipe
+    if (dev->transport->ops->start_streaming(dev->transport) != USB_XFER_OK) {
+        set_error("%s", dev->transport->error);
+        debug_log("camera_start_streaming: ERROR - %s", dev->transport->error);
         return CAMERA_ERROR_INIT_FAILED;
     }
     
@@ -643,23 +738,83 @@ CAMERA_API int camera_start_streaming(CAMERA_HANDLE handle) {
         return ret;
     }
     
+    // Allocate the receive buffers: transfer_depth in flight, the rest
+    // standing in while frames hold on to payloads
+    if (!read_pipeline_init(&dev->pipeline, dev->transport, dev->transfer_depth, TRANSFER_SIZE, RX_BUFFERS)) {
+        set_error("Failed to allocate %d receive buffers", RX_BUFFERS);
+        debug_log("camera_start_streaming: ERROR - read_pipeline_init failed (depth=%d)", dev->transfer_depth);
+        return CAMERA_ERROR_INIT_FAILED;
+    }
+    
+    // Apply the frame limits; the queue is empty after open or stop
+    frame_ring_set_slot_count(&dev->ring, dev->frame_buffers);
+    dev->assembler.max_frame_size = dev->max_frame_size;
+    
+    // Give every slot its frame buffer now, not on the read thread.
+    // Buffers start small and grow on demand up to max_frame_size
+    for (int i = 0; i < dev->frame_buffers; i++) {
+        frame_slot_t *slot = &dev->ring.slots[i];
+        if (!slot->data) {
+            slot->data = frame_pool_get(&dev->pool, FRAME_POOL_MIN_SIZE, &slot->capacity);
+            if (!slot->data) {
+                set_error("Failed to allocate frame buffers");
+                debug_log("camera_start_streaming: ERROR - Frame buffer allocation failed");
+                read_pipeline_free(&dev->pipeline);
+                return CAMERA_ERROR_INIT_FAILED;
+            }
+        }
+    }
+    frame_slot_t *write_slot = frame_ring_write_slot(&dev->ring);
+    frame_assembler_attach_gather(&dev->assembler, write_slot->data, write_slot->capacity,
+                                  write_slot->segments, FRAME_RING_MAX_SEGMENTS);
+    
     // Reset event
-    ResetEvent(dev->stop_event);
+    platform_event_reset(dev->stop_event);
+    dev->stream_ended = false;
+    dev->last_frame = 0;  // No frame interval across a restart
+    packet_stream_resync(&dev->packet_stream);
     
     debug_log("camera_start_streaming: Creating read thread");
     
     // Start read thread
     dev->streaming = true;
-    dev->read_thread = CreateThread(NULL, 0, read_thread_proc, dev, 0, NULL);
+    dev->read_thread = platform_thread_create(read_thread_proc, dev);
     
     if (!dev->read_thread) {
         dev->streaming = false;
-        DWORD error = GetLastError();
-        set_error("Failed to create read thread: %d", error);
+        unsigned long error = platform_last_error();
+        set_error("Failed to create read thread: %lu", error);
         debug_log("camera_start_streaming: ERROR - Failed to create read thread: %lu", error);
+        read_pipeline_free(&dev->pipeline);
         return CAMERA_ERROR_INIT_FAILED;
     }
     
+    // Callbacks off the read thread get their own consumer thread
+    if (dev->frame_callback && dev->callback_mode == CAMERA_CALLBACK_DISPATCHER) {
+        dev->dispatch_thread = platform_thread_create(dispatch_thread_proc, dev);
+        if (!dev->dispatch_thread) {
+            unsigned long error = platform_last_error();
+            debug_log("camera_start_streaming: ERROR - Failed to create dispatch thread: %lu", error);
+            camera_stop_streaming(handle);
+            set_error("Failed to create dispatch thread: %lu", error);
+            return CAMERA_ERROR_INIT_FAILED;
+        }
+    }
+    
+#ifdef USEEPLUS_HAVE_JPEG
+    // Decode threads are fed by a consumer thread of their own
+    if (dev->decoders) {
+        dev->decode_feed_thread = platform_thread_create(decode_feed_thread_proc, dev);
+        if (!dev->decode_feed_thread) {
+            unsigned long error = platform_last_error();
+            debug_log("camera_start_streaming: ERROR - Failed to create decode feed thread: %lu", error);
+            camera_stop_streaming(handle);
+            set_error("Failed to create decode feed thread: %lu", error);
+            return CAMERA_ERROR_INIT_FAILED;
+        }
+    }
+#endif
+    
     debug_log("camera_start_streaming: Streaming started successfully");
     return CAMERA_SUCCESS;
 }
@@ -672,97 +827,192 @@ CAMERA_API void camera_stop_streaming(CAMERA_HANDLE handle) {
     
     debug_log("camera_stop_streaming: Stopping streaming on handle 0x%p", handle);
     
-    // Signal thread to stop
+    // Signal threads to stop; the frame event wakes a waiting dispatcher
     dev->streaming = false;
-    SetEvent(dev->stop_event);
+    platform_event_set(dev->stop_event);
+    platform_event_set(dev->frame_ready_event);
     
     // Abort any pending USB transfers FIRST (interrupts blocking reads)
-    if (dev->winusb_handle) {
-        WinUsb_AbortPipe(dev->winusb_handle, EP_IN);
-    }
+    dev->transport->ops->abort_reads(dev->transport);
     
     // Wait for thread to exit with timeout
     if (dev->read_thread) {
-        DWORD result = WaitForSingleObject(dev->read_thread, 2000);
-        if (result == WAIT_TIMEOUT) {
-            // Force terminate if still running
-            TerminateThread(dev->read_thread, 0);
+        if (platform_thread_wait(dev->read_thread, 2000) == PLATFORM_WAIT_TIMEOUT) {
+            // Force terminate if still running, then reap its transfers
+            platform_thread_terminate(dev->read_thread);
+            read_pipeline_stop(&dev->pipeline);
         }
-        CloseHandle(dev->read_thread);
+        platform_thread_close(dev->read_thread);
         dev->read_thread = NULL;
     }
     
-    // Flush the USB pipe to clear any stale data
-    if (dev->winusb_handle) {
-        WinUsb_FlushPipe(dev->winusb_handle, EP_IN);
-        WinUsb_ResetPipe(dev->winusb_handle, EP_IN);
+    // Let a running callback finish; the dispatcher returns its lease
+    if (dev->dispatch_thread) {
+        platform_thread_wait(dev->dispatch_thread, PLATFORM_WAIT_INFINITE);
+        platform_thread_close(dev->dispatch_thread);
+        dev->dispatch_thread = NULL;
     }
     
-    // Clear all frames
-    EnterCriticalSection(&dev->frame_lock);
-    for (int i = 0; i < MAX_FRAMES; i++) {
-        dev->frames[i].ready = false;
-        dev->frames[i].size = 0;
+#ifdef USEEPLUS_HAVE_JPEG
+    // A flush ends the feed thread's wait for a free decoder slot and
+    // drops the frames not yet read; the second one drops any frame it
+    // submitted after the first
+    if (dev->decoders) {
+        parallel_decoder_flush(dev->decoders);
+        if (dev->decode_feed_thread) {
+            platform_thread_wait(dev->decode_feed_thread, PLATFORM_WAIT_INFINITE);
+            platform_thread_close(dev->decode_feed_thread);
+            dev->decode_feed_thread = NULL;
+        }
+        parallel_decoder_flush(dev->decoders);
     }
-    dev->read_frame = 0;
-    dev->write_frame = 0;
-    ResetEvent(dev->frame_ready_event);
-    LeaveCriticalSection(&dev->frame_lock);
+#endif
+    
+    // Flush the USB pipe to clear any stale data
+    dev->transport->ops->reset(dev->transport);
+    
+    // Clear all queued frames (leased frames stay valid until released)
+    // The read thread has exited, so the producer side is idle here
+    platform_lock_enter(dev->consumer_lock);
+    frame_ring_reset(&dev->ring);
+    frame_slot_t *slot = frame_ring_write_slot(&dev->ring);
+    frame_assembler_attach_gather(&dev->assembler, slot->data, slot->capacity,
+                                  slot->segments, FRAME_RING_MAX_SEGMENTS);
+    platform_event_reset(dev->frame_ready_event);
+    platform_lock_leave(dev->consumer_lock);
+    
+    // All transfers have been reaped by the read thread, and no frame
+    // refers to a receive buffer any more (leases were coalesced)
+    read_pipeline_free(&dev->pipeline);
     
     // Small delay to ensure USB operations complete
-    Sleep(50);
+    platform_sleep_ms(50);
+}
+
+// Current monotonic clock value
+static unsigned long long now_ticks(void) {
+    return platform_ticks();
+}
+
+// Convert clock ticks to microseconds; split so absolute counter values
+// cannot overflow the multiplication
+static unsigned long long ticks_to_us(camera_device_t *dev, unsigned long long ticks) {
+    unsigned long long frequency = dev->ticks_per_second;
+    return ticks / frequency * 1000000ULL + ticks % frequency * 1000000ULL / frequency;
+}
+
+// Apply a driver thread's scheduling attributes to the calling thread
+static void apply_thread_attr(camera_device_t *dev, int role, platform_thread_sched_t *sched) {
+    const camera_thread_attr_t *attr = &dev->thread_attr[role];
+    platform_thread_attr_t native;
+    
+    native.priority = attr->priority;
+    native.realtime = attr->realtime;
+    native.affinity_mask = attr->affinity_mask;
+    native.name = attr->name[0] ? attr->name : default_thread_names[role];
+    
+    if (!platform_thread_apply(sched, &native)) {
+        atomic32_fetch_add(&dev->stats.thread_attr_failures, (long)sched->failed);
+        debug_log("%s: WARNING - %u thread setting(s) not applied: %s",
+                  native.name, sched->failed, sched->error);
+    }
+    
+    if (attr->priority != CAMERA_PRIORITY_NORMAL || attr->realtime || attr->affinity_mask) {
+        platform_thread_attr_t actual;
+        if (platform_thread_query(&actual, NULL, 0)) {
+            debug_log("%s: priority=%d realtime=%d affinity=0x%llx", native.name,
+                      actual.priority, actual.realtime ? 1 : 0, actual.affinity_mask);
+        }
+    }
 }
 
 // USB read thread
-static DWORD WINAPI read_thread_proc(LPVOID param) {
+static void read_thread_proc(void *param) {
     camera_device_t *dev = (camera_device_t*)param;
-    unsigned char buffer[BUFFER_SIZE];
-    ULONG bytes_read;
-    BOOL result;
-    ULONG timeout_ms = 1000;  // 1 second timeout
+    const unsigned char *data;
+    size_t bytes_read;
+    int result;
+    unsigned int timeout_ms = 1000;  // 1 second timeout
+    platform_thread_sched_t sched;
     
+    apply_thread_attr(dev, CAMERA_THREAD_READ, &sched);
     debug_log("read_thread_proc: Read thread started");
     
-    // Set pipe policy for timeouts
-    if (dev->winusb_handle) {
-        WinUsb_SetPipePolicy(dev->winusb_handle, EP_IN, PIPE_TRANSFER_TIMEOUT, 
-                            sizeof(timeout_ms), &timeout_ms);
-        
-        // Try to enable RAW_IO for better performance
-        UCHAR raw_io = TRUE;
-        WinUsb_SetPipePolicy(dev->winusb_handle, EP_IN, RAW_IO, 
-                            sizeof(raw_io), &raw_io);
+    // Queue every transfer up front so the endpoint never idles
+    result = read_pipeline_start(&dev->pipeline);
+    if (result != USB_XFER_OK) {
+        debug_log("read_thread_proc: ERROR - Failed to submit bulk reads: %s", dev->transport->error);
+        platform_thread_revert(&sched);
+        return;
     }
     
+    debug_log("read_thread_proc: %d bulk reads in flight%s", dev->pipeline.depth,
+              dev->pipeline.streaming ? " (resubmitted by the transport)" : "");
+    
     while (dev->streaming) {
         // Check if we should stop
-        if (WaitForSingleObject(dev->stop_event, 0) == WAIT_OBJECT_0) {
+        if (platform_event_wait(dev->stop_event, 0) == PLATFORM_WAIT_OK) {
             break;
         }
         
-        // Read from bulk endpoint with timeout
-        result = WinUsb_ReadPipe(dev->winusb_handle, EP_IN,
-                                buffer, BUFFER_SIZE, &bytes_read, NULL);
+        // Reap the oldest transfer; the others keep receiving meanwhile
+        unsigned long long wait_start = now_ticks();
+        result = read_pipeline_wait(&dev->pipeline, timeout_ms, &data, &bytes_read);
+        unsigned long long arrival = now_ticks();
+        
+        if (trace_recorder_is_active(dev->tracer)) {
+            trace_recorder_emit_at(dev->tracer, TRACE_SOURCE_READ, TRACE_EVENT_USB_READ_BEGIN, 0, 0, wait_start);
+            trace_recorder_emit_at(dev->tracer, TRACE_SOURCE_READ, TRACE_EVENT_USB_READ_END, 0,
+                                   result == USB_XFER_OK ? (unsigned int)bytes_read : 0, arrival);
+        }
+        
+        if (result == USB_XFER_TIMEOUT) {
+            // Timeout - this is OK, transfer is still pending
+            stats_add(&dev->stats.read_timeouts, 1);
+            continue;
+        }
+        
+        if (result == USB_XFER_END) {
+            // Capture exhausted - let readers drain the ring, then fail fast
+            debug_log("read_thread_proc: End of stream");
+            dev->stream_ended = true;
+            platform_event_set(dev->frame_ready_event);
+            break;
+        }
         
-        if (!result) {
-            DWORD error = GetLastError();
-            if (error == ERROR_SEM_TIMEOUT || error == ERROR_TIMEOUT) {
-                // Timeout - this is OK, just continue
-                continue;
-            } else if (error != ERROR_SEM_TIMEOUT) {
+        if (result != USB_XFER_OK) {
+            if (result != USB_XFER_ABORTED) {
                 // Real error occurred
-                debug_log("read_thread_proc: ERROR - WinUsb_ReadPipe failed: %lu", error);
-                break;
+                stats_add(&dev->stats.read_errors, 1);
+                debug_log("read_thread_proc: ERROR - Bulk read failed: %s", dev->transport->error);
             }
-            continue;
+            break;
         }
         
+        stats_histogram_record(&dev->stats.usb_read, ticks_to_us(dev, arrival - wait_start));
+        
         if (bytes_read > 0) {
-            process_data(dev, buffer, bytes_read);
+            stats_add64(&dev->stats.bytes_received, (long long)bytes_read);
+            stats_add64(&dev->stats.packets_received, 1);
+            
+            // Copied into the recorder's ring, written out by its own thread
+            packet_recorder_write(dev->recorder, data, bytes_read);
+            process_data(dev, data, (int)bytes_read, arrival);
+        }
+        
+        // Give the buffer back to the device
+        result = read_pipeline_requeue(&dev->pipeline);
+        if (result != USB_XFER_OK) {
+            stats_add(&dev->stats.read_errors, 1);
+            debug_log("read_thread_proc: ERROR - Failed to resubmit bulk read: %s", dev->transport->error);
+            break;
         }
     }
     
-    return 0;
+    // Cancel and reap the remaining transfers before the buffers go away
+    read_pipeline_stop(&dev->pipeline);
+    
+    platform_thread_revert(&sched);
 }
 
 // Get last error
@@ -776,254 +1026,1247 @@ CAMERA_API bool camera_is_streaming(CAMERA_HANDLE handle) {
     return dev ? dev->streaming : false;
 }
 
-// Get statistics
-CAMERA_API int camera_get_stats(CAMERA_HANDLE handle,
-                                 unsigned int *frames_captured,
-                                 unsigned int *frames_dropped) {
+// Set number of bulk reads kept in flight
+CAMERA_API int camera_set_transfer_depth(CAMERA_HANDLE handle, int depth) {
     camera_device_t *dev = (camera_device_t*)handle;
     
-    if (!dev) {
+    if (!dev || depth < 1 || depth > CAMERA_MAX_TRANSFER_DEPTH) {
+        set_error("Invalid parameters");
         return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    if (frames_captured) *frames_captured = dev->frames_captured;
-    if (frames_dropped) *frames_dropped = dev->frames_dropped;
+    dev->transfer_depth = depth;
+    return CAMERA_SUCCESS;
+}
+
+// Set the largest frame kept
+CAMERA_API int camera_set_max_frame_size(CAMERA_HANDLE handle, size_t max_bytes) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || max_bytes < CAMERA_MIN_FRAME_SIZE || max_bytes > CAMERA_MAX_FRAME_SIZE) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
     
+    dev->max_frame_size = max_bytes;
     return CAMERA_SUCCESS;
 }
 
-// Process received USB data and extract JPEG frames
-static void process_data(camera_device_t *dev, unsigned char *data, int length) {
-    static int packet_count = 0;
-    const int HEADER_SIZE = 12;  // Proprietary header is 12 bytes
-    const int MIN_JPEG_SIZE = 1000;
-    const int MAX_JPEG_SIZE = BUFFER_SIZE - 4096;  // Leave some headroom
+// Set number of frame buffers between the read thread and the application
+CAMERA_API int camera_set_frame_buffers(CAMERA_HANDLE handle, int count) {
+    camera_device_t *dev = (camera_device_t*)handle;
     
-    camera_frame_t *frame;
+    if (!dev || count < 2 || count > CAMERA_MAX_FRAME_BUFFERS) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
     
-    EnterCriticalSection(&dev->frame_lock);
-    frame = &dev->frames[dev->write_frame];
+    dev->frame_buffers = count;
+    return CAMERA_SUCCESS;
+}
+
+// Set which buffered frame reads return
+CAMERA_API int camera_set_read_mode(CAMERA_HANDLE handle, int mode) {
+    camera_device_t *dev = (camera_device_t*)handle;
     
-    // Debug first few packets (optional, can be removed in production)
-    if (packet_count < 10) {
-        char debug_buf[256] = {0};
-        int offset = 0;
-        offset += snprintf(debug_buf + offset, sizeof(debug_buf) - offset,
-                          "Packet %d (%d bytes): ", packet_count, length);
-        for (int i = 0; i < min(16, length) && offset < sizeof(debug_buf) - 10; i++) {
-            offset += snprintf(debug_buf + offset, sizeof(debug_buf) - offset,
-                             "%02x ", data[i]);
-        }
-        OutputDebugStringA(debug_buf);
-        packet_count++;
+    if (!dev || (mode != CAMERA_READ_FIFO && mode != CAMERA_READ_LATEST)) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    // Check for valid packet header (AA BB 07)
-    if (length >= 3 && data[0] == 0xaa && data[1] == 0xbb && data[2] == 0x07) {
-        // Valid packet with proprietary header
-        
-        // Allocate frame buffer if needed
-        if (!frame->data) {
-            frame->data = (unsigned char*)malloc(BUFFER_SIZE);
-            if (!frame->data) {
-                LeaveCriticalSection(&dev->frame_lock);
-                return;
-            }
-            frame->capacity = BUFFER_SIZE;
-            frame->size = 0;
-            frame->ready = false;
-        }
-        
-        // Extract payload (skip 12-byte header)
-        if (length > HEADER_SIZE) {
-            int payload_size = length - HEADER_SIZE;
-            unsigned char *payload = data + HEADER_SIZE;
-            
-            // Check for JPEG SOI marker (FF D8) at start of payload
-            // This indicates a new frame is starting
-            if (payload_size >= 2 && payload[0] == 0xFF && payload[1] == 0xD8) {
-                // New JPEG starting - if we have incomplete frame, discard it
-                if (frame->size > 0 && !frame->ready) {
-                    // Incomplete frame - discard and start fresh
-                    frame->size = 0;
-                }
-            }
-            
-            // Check if we have enough space in current frame
-            if (frame->size + payload_size > frame->capacity) {
-                // Buffer overflow - discard this incomplete frame and start fresh
-                frame->size = 0;
-                frame->ready = false;
-                
-                // If this packet has SOI, start new frame with it
-                if (payload_size >= 2 && payload[0] == 0xFF && payload[1] == 0xD8) {
-                    memcpy(frame->data, payload, payload_size);
-                    frame->size = payload_size;
-                }
-                LeaveCriticalSection(&dev->frame_lock);
-                return;
-            }
-            
-            // Copy payload to frame buffer
-            memcpy(frame->data + frame->size, payload, payload_size);
-            frame->size += payload_size;
-            
-            // Look for JPEG EOI marker (FF D9) - search entire frame buffer
-            for (size_t i = 1; i < frame->size; i++) {
-                if (frame->data[i-1] == 0xFF && frame->data[i] == 0xD9) {
-                    // Found potential end of JPEG
-                    size_t complete_frame_size = i + 1;
-                    
-                    // Verify this is a complete valid JPEG (has SOI at start)
-                    if (complete_frame_size >= MIN_JPEG_SIZE && 
-                        frame->data[0] == 0xFF && frame->data[1] == 0xD8) {
-                        
-                        debug_log("process_data: Complete frame detected, size=%zu bytes", complete_frame_size);
-                        
-                        // Calculate leftover data (data after EOI)
-                        size_t leftover = frame->size - complete_frame_size;
-                        unsigned char *leftover_data = NULL;
-                        
-                        // Save leftover data if it exists
-                        if (leftover > 0 && leftover < BUFFER_SIZE) {
-                            leftover_data = (unsigned char*)malloc(leftover);
-                            if (leftover_data) {
-                                memcpy(leftover_data, frame->data + complete_frame_size, leftover);
-                            }
-                        }
-                        
-                        // Mark current frame as complete
-                        frame->size = complete_frame_size;
-                        frame->ready = true;
-                        dev->frames_captured++;
-                        SetEvent(dev->frame_ready_event);
-                        
-                        // Move to next frame slot
-                        int next_write = (dev->write_frame + 1) % MAX_FRAMES;
-                        
-                        // Check if we're overwriting unread frames
-                        if (next_write == dev->read_frame && dev->frames[dev->read_frame].ready) {
-                            dev->frames_dropped++;
-                            debug_log("process_data: WARNING - Frame dropped (buffer full), total_dropped=%u", dev->frames_dropped);
-                            dev->read_frame = (dev->read_frame + 1) % MAX_FRAMES;
-                        }
-                        
-                        dev->write_frame = next_write;
-                        
-                        // Initialize next frame
-                        frame = &dev->frames[dev->write_frame];
-                        if (!frame->data) {
-                            frame->data = (unsigned char*)malloc(BUFFER_SIZE);
-                            if (!frame->data) {
-                                free(leftover_data);
-                                LeaveCriticalSection(&dev->frame_lock);
-                                return;
-                            }
-                            frame->capacity = BUFFER_SIZE;
-                        }
-                        
-                        // Copy leftover data to new frame, but only if it looks like JPEG start
-                        if (leftover_data && leftover >= 2) {
-                            // Check if leftover starts with SOI marker
-                            if (leftover_data[0] == 0xFF && leftover_data[1] == 0xD8) {
-                                memcpy(frame->data, leftover_data, leftover);
-                                frame->size = leftover;
-                            } else {
-                                // Leftover doesn't start a valid JPEG - discard it
-                                frame->size = 0;
-                            }
-                            free(leftover_data);
-                        } else {
-                            free(leftover_data);
-                            frame->size = 0;
-                        }
-                        frame->ready = false;
-                        
-                        // Found and processed EOI - stop searching
-                        break;
-                    }
-                }
-            }
-            
-            // Safety check: if frame is getting too large without EOI, discard it
-            if (frame->size > MAX_JPEG_SIZE && !frame->ready) {
-                debug_log("process_data: WARNING - Frame too large without EOI, discarding (size=%zu)", frame->size);
-                frame->size = 0;
-                frame->ready = false;
-            }
-        }
+    platform_lock_enter(dev->consumer_lock);
+    dev->read_mode = mode;
+    platform_lock_leave(dev->consumer_lock);
+    return CAMERA_SUCCESS;
+}
+
+// Set a driver thread's scheduling attributes
+CAMERA_API int camera_set_thread_attr(CAMERA_HANDLE handle, int thread, const camera_thread_attr_t *attr) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || !attr || thread < 0 || thread >= THREAD_ROLES ||
+        attr->priority < CAMERA_PRIORITY_NORMAL || attr->priority > CAMERA_PRIORITY_TIME_CRITICAL) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    // Read by the thread as it starts, so only while stopped
+    if (dev->streaming) {
+        set_error("Cannot change thread attributes while streaming");
+        return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    LeaveCriticalSection(&dev->frame_lock);
+    dev->thread_attr[thread] = *attr;
+    dev->thread_attr[thread].name[sizeof(attr->name) - 1] = '\0';
+    
+    debug_log("camera_set_thread_attr: %s priority=%d realtime=%d affinity=0x%llx",
+              default_thread_names[thread], attr->priority, attr->realtime ? 1 : 0,
+              attr->affinity_mask);
+    return CAMERA_SUCCESS;
 }
 
-// Read frame - blocking call with timeout
-CAMERA_API int camera_read_frame(CAMERA_HANDLE handle,
-                                  unsigned char *buffer,
-                                  size_t buffer_size,
-                                  size_t *bytes_read,
-                                  unsigned int timeout_ms) {
+// Get a driver thread's scheduling attributes
+CAMERA_API int camera_get_thread_attr(CAMERA_HANDLE handle, int thread, camera_thread_attr_t *attr) {
     camera_device_t *dev = (camera_device_t*)handle;
-    camera_frame_t *frame;
-    DWORD wait_result;
-    DWORD timeout = timeout_ms ? timeout_ms : INFINITE;
     
-    if (!dev || !buffer || !bytes_read) {
+    if (!dev || !attr || thread < 0 || thread >= THREAD_ROLES) {
         set_error("Invalid parameters");
         return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    *bytes_read = 0;
+    *attr = dev->thread_attr[thread];
+    if (!attr->name[0]) {
+        strncpy(attr->name, default_thread_names[thread], sizeof(attr->name) - 1);
+    }
+    return CAMERA_SUCCESS;
+}
+
+// Get frame drop counters by cause
+CAMERA_API int camera_get_drop_stats(CAMERA_HANDLE handle,
+                                     unsigned int *frames_oversize,
+                                     unsigned int *frames_overflow) {
+    camera_device_t *dev = (camera_device_t*)handle;
     
-    if (!dev->streaming) {
-        set_error("Camera is not streaming");
-        return CAMERA_ERROR_NO_FRAME;
+    if (!dev) {
+        return CAMERA_ERROR_INVALID_PARAM;
     }
     
-    // Wait for a frame to be ready
-    while (true) {
-        EnterCriticalSection(&dev->frame_lock);
-        
-        frame = &dev->frames[dev->read_frame];
+    if (frames_oversize) *frames_oversize = (unsigned int)atomic32_load_relaxed(&dev->stats.frames_oversize);
+    if (frames_overflow) *frames_overflow = (unsigned int)atomic32_load_relaxed(&dev->stats.frames_overflow);
+    
+    return CAMERA_SUCCESS;
+}
+
+// Get frame buffer allocation statistics
+CAMERA_API int camera_get_alloc_stats(CAMERA_HANDLE handle, camera_alloc_stats_t *stats) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || !stats) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    stats->allocations = dev->pool.allocations;
+    stats->allocated_bytes = dev->pool.allocated_bytes;
+    stats->buffers_grown = dev->buffers_grown;
+    
+    return CAMERA_SUCCESS;
+}
+
+// Start recording raw packets to a capture file
+CAMERA_API int camera_start_recording(CAMERA_HANDLE handle, const char *path) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || !path) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (packet_recorder_is_active(dev->recorder)) {
+        set_error("Already recording");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (!packet_recorder_start(dev->recorder, path)) {
+        set_error("Failed to start recording to '%s'", path);
+        debug_log("camera_start_recording: ERROR - Failed to start recording to '%s'", path);
+        return CAMERA_ERROR_OPEN_FAILED;
+    }
+    
+    debug_log("camera_start_recording: Recording packets to '%s'", path);
+    return CAMERA_SUCCESS;
+}
+
+// Stop recording raw packets
+CAMERA_API int camera_stop_recording(CAMERA_HANDLE handle) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev) {
+        set_error("Invalid handle");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (!packet_recorder_is_active(dev->recorder)) {
+        return CAMERA_SUCCESS;
+    }
+    
+    unsigned int dropped = packet_recorder_stop(dev->recorder);
+    debug_log("camera_stop_recording: Recording closed, %llu bytes written, %u packets dropped",
+              dev->recorder->bytes_written, dropped);
+    
+    if (dev->recorder->write_failed) {
+        set_error("Failed to write recording");
+        return CAMERA_ERROR_USB_FAILED;
+    }
+    
+    return CAMERA_SUCCESS;
+}
+
+// Start tracing pipeline events to a file
+CAMERA_API int camera_start_trace(CAMERA_HANDLE handle, const char *path) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || !path) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (trace_recorder_is_active(dev->tracer)) {
+        set_error("Already tracing");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (!trace_recorder_start(dev->tracer, path)) {
+        set_error("Failed to start trace to '%s'", path);
+        debug_log("camera_start_trace: ERROR - Failed to start trace to '%s'", path);
+        return CAMERA_ERROR_OPEN_FAILED;
+    }
+    
+    debug_log("camera_start_trace: Tracing to '%s'", path);
+    return CAMERA_SUCCESS;
+}
+
+// Stop tracing pipeline events
+CAMERA_API int camera_stop_trace(CAMERA_HANDLE handle) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev) {
+        set_error("Invalid handle");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (!trace_recorder_is_active(dev->tracer)) {
+        return CAMERA_SUCCESS;
+    }
+    
+    unsigned int dropped = trace_recorder_stop(dev->tracer);
+    debug_log("camera_stop_trace: Trace closed, %llu events written, %u dropped",
+              dev->tracer->events_written, dropped);
+    
+    if (dev->tracer->write_failed) {
+        set_error("Failed to write trace");
+        return CAMERA_ERROR_USB_FAILED;
+    }
+    
+    return CAMERA_SUCCESS;
+}
+
+// Get statistics
+CAMERA_API int camera_get_stats(CAMERA_HANDLE handle,
+                                 unsigned int *frames_captured,
+                                 unsigned int *frames_dropped) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    if (frames_captured) *frames_captured = (unsigned int)atomic32_load_relaxed(&dev->stats.frames_captured);
+    if (frames_dropped) *frames_dropped = (unsigned int)atomic32_load_relaxed(&dev->stats.frames_overflow);
+    
+    return CAMERA_SUCCESS;
+}
+
+// Copy a histogram out of the live statistics
+static void snapshot_histogram(camera_histogram_t *out, stats_histogram_t *h) {
+    for (int i = 0; i < CAMERA_HISTOGRAM_BUCKETS; i++) {
+        out->buckets[i] = (unsigned int)atomic32_load_relaxed(&h->buckets[i]);
+    }
+    out->count = (unsigned int)atomic32_load_relaxed(&h->count);
+    out->max_us = (unsigned int)atomic32_load_relaxed(&h->max_us);
+    out->sum_us = (unsigned long long)atomic64_load_relaxed(&h->sum_us);
+}
+
+// Get extended statistics
+CAMERA_API int camera_get_stats_ex(CAMERA_HANDLE handle, camera_stats_ex_t *stats) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    stream_stats_t *s;
+    camera_stats_ex_t snapshot;
+    
+    if (!dev || !stats || stats->size < offsetof(camera_stats_ex_t, bytes_received)) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    s = &dev->stats;
+    memset(&snapshot, 0, sizeof(snapshot));
+    snapshot.size = stats->size < sizeof(snapshot) ? stats->size : (unsigned int)sizeof(snapshot);
+    snapshot.version = CAMERA_STATS_VERSION;
+    snapshot.bytes_received = (unsigned long long)atomic64_load_relaxed(&s->bytes_received);
+    snapshot.packets_received = (unsigned long long)atomic64_load_relaxed(&s->packets_received);
+    snapshot.bad_header_packets = (unsigned int)atomic32_load_relaxed(&s->bad_header_packets);
+    snapshot.frames_captured = (unsigned int)atomic32_load_relaxed(&s->frames_captured);
+    snapshot.frames_discarded = (unsigned int)atomic32_load_relaxed(&s->frames_discarded);
+    snapshot.frames_oversize = (unsigned int)atomic32_load_relaxed(&s->frames_oversize);
+    snapshot.frames_overflow = (unsigned int)atomic32_load_relaxed(&s->frames_overflow);
+    snapshot.read_timeouts = (unsigned int)atomic32_load_relaxed(&s->read_timeouts);
+    snapshot.read_errors = (unsigned int)atomic32_load_relaxed(&s->read_errors);
+    snapshot_histogram(&snapshot.usb_read, &s->usb_read);
+    snapshot_histogram(&snapshot.assembly, &s->assembly);
+    snapshot_histogram(&snapshot.frame_interval, &s->frame_interval);
+    snapshot_histogram(&snapshot.consumer_latency, &s->consumer_latency);
+    snapshot.frames_skipped = (unsigned int)atomic32_load_relaxed(&s->frames_skipped);
+    snapshot.packets_lost = (unsigned int)atomic32_load_relaxed(&s->packets_lost);
+    snapshot.frames_lost = (unsigned int)atomic32_load_relaxed(&s->frames_lost);
+    snapshot.header_resyncs = (unsigned int)atomic32_load_relaxed(&s->header_resyncs);
+    snapshot.payloads_copied = (unsigned int)atomic32_load_relaxed(&s->payloads_copied);
+    snapshot.thread_attr_failures = (unsigned int)atomic32_load_relaxed(&s->thread_attr_failures);
+#ifdef USEEPLUS_HAVE_JPEG
+    if (dev->decoders) {
+        parallel_decoder_stats_t decode_stats;
+        parallel_decoder_get_stats(dev->decoders, &decode_stats);
+        snapshot.decode_frames_dropped = decode_stats.dropped +
+            (unsigned int)atomic32_load_relaxed(&s->decode_submit_failures);
+    }
+#endif
+    
+    // Older callers get the prefix their struct has room for
+    memcpy(stats, &snapshot, snapshot.size);
+    return CAMERA_SUCCESS;
+}
+
+// Move the frame under assembly to a buffer of at least needed bytes
+// Read thread only
+static void grow_write_slot(camera_device_t *dev, size_t needed) {
+    frame_slot_t *slot = frame_ring_write_slot(&dev->ring);
+    size_t capacity;
+    unsigned char *data = frame_pool_get(&dev->pool, needed, &capacity);
+    
+    if (!data) {
+        // frame_assembler_push reports the overflow
+        return;
+    }
+    
+    frame_assembler_relocate(&dev->assembler, data, capacity);
+    frame_pool_put(&dev->pool, slot->data, slot->capacity);
+    slot->data = data;
+    slot->capacity = capacity;
+    dev->buffers_grown++;
+    
+    debug_log("process_data: Frame buffer grown to %zu bytes", capacity);
+}
+
+// Record a read-thread trace event for the frame under assembly
+// (no-op unless tracing)
+static void trace_read(camera_device_t *dev, int type, unsigned int value) {
+    trace_recorder_emit(dev->tracer, TRACE_SOURCE_READ, type, dev->frame_seq, value);
+}
+
+static void frame_consumed(camera_device_t *dev, const frame_slot_t *frame);
+
+// Pass a frame to the frame callback; the slot stays valid until it returns
+static void invoke_callback(camera_device_t *dev, const frame_slot_t *frame) {
+    camera_frame_view_t view;
+    
+    view.data = frame->data;
+    view.size = frame->size;
+    view.sequence = frame->frame_id;
+    view.completed_us = ticks_to_us(dev, frame->ready_time);
+    view.delivered_us = ticks_to_us(dev, now_ticks());
+    dev->frame_callback(&view, dev->callback_user_data);
+}
+
+// CAMERA_CALLBACK_INLINE: consume the frames just queued on the read
+// thread itself. The lock is uncontended since reads are refused
+static void deliver_inline(camera_device_t *dev) {
+    frame_slot_t *frame;
+    
+    platform_lock_enter(dev->consumer_lock);
+    while ((frame = frame_ring_peek(&dev->ring)) != NULL) {
+        frame_consumed(dev, frame);
+        frame_slot_coalesce(frame);
+        invoke_callback(dev, frame);
+        frame_ring_pop(&dev->ring);
+    }
+    platform_lock_leave(dev->consumer_lock);
+}
+
+// Follow the packet header counters; once they have proven consistent a
+// gap means the bus lost packets, and a frame with a hole in it is dropped
+// rather than handed out as a corrupt JPEG. Returns the PACKET_* result
+static int check_packet_header(camera_device_t *dev, const unsigned char *data, int length,
+                               bool starts_frame) {
+    packet_stream_t *ps = &dev->packet_stream;
+    packet_header_t header;
+    bool was_trusted = ps->trusted;
+    
+    if (!packet_header_decode(data, (size_t)length, &header)) {
+        return PACKET_UNTRUSTED;  // frame_assembler_push counts it as a bad header
+    }
+    
+    int check = packet_stream_check(ps, &header, (size_t)length - FRAME_PACKET_HEADER_SIZE, starts_frame);
+    if (check == PACKET_LOST) {
+        frame_assembler_abandon(&dev->assembler);
+        atomic32_store_relaxed(&dev->stats.packets_lost, (long)ps->lost_packets);
+        atomic32_store_relaxed(&dev->stats.frames_lost, (long)ps->lost_frames);
+        debug_log("process_data: WARNING - Packet loss before frame %u packet %u, total lost packets=%u frames=%u",
+                  header.frame_id, header.packet_index, ps->lost_packets, ps->lost_frames);
+    } else if (ps->trusted != was_trusted) {
+        atomic32_store_relaxed(&dev->stats.header_resyncs, (long)ps->resyncs);
+        debug_log("process_data: Packet headers %s", ps->trusted ? "consistent, loss detection on" :
+                  "inconsistent, loss detection off");
+    }
+    return check;
+}
+
+// Process received USB data and extract JPEG frames
+// Runs on the read thread without taking any lock shared with consumers
+static void process_data(camera_device_t *dev, const unsigned char *data, int length,
+                         unsigned long long arrival) {
+    static int packet_count = 0;
+    frame_slot_t *slot;
+    bool was_empty;
+    int result;
+    
+    // Debug first few packets (optional, can be removed in production)
+    if (packet_count < 10) {
+        char debug_buf[256] = {0};
+        int offset = 0;
+        offset += snprintf(debug_buf + offset, sizeof(debug_buf) - offset,
+                          "Packet %d (%d bytes): ", packet_count, length);
+        for (int i = 0; i < min(16, length) && offset < sizeof(debug_buf) - 10; i++) {
+            offset += snprintf(debug_buf + offset, sizeof(debug_buf) - offset,
+                             "%02x ", data[i]);
+        }
+#ifdef _WIN32
+        OutputDebugStringA(debug_buf);
+#else
+        debug_log("%s", debug_buf);
+#endif
+        packet_count++;
+    }
+    
+    // A packet whose payload starts with SOI begins a frame
+    bool starts_frame = length >= FRAME_PACKET_HEADER_SIZE + 2 &&
+                        data[FRAME_PACKET_HEADER_SIZE] == 0xFF &&
+                        data[FRAME_PACKET_HEADER_SIZE + 1] == 0xD8;
+    
+    unsigned int restarts = dev->assembler.restarts;
+    unsigned int fallbacks = dev->assembler.fast_path_fallbacks;
+    bool fast_path = dev->assembler.fast_path;
+    int check = check_packet_header(dev, data, length, starts_frame);
+    
+    // Trusted headers that start a frame at this packet, or continue the
+    // current one, let the fast path skip the payload; see frame_assembler.h
+    dev->assembler.header_vouched = check == PACKET_FRAME_START || check == PACKET_IN_SEQUENCE;
+    
+    // Leave the payload in its receive buffer if the pipeline can spare it
+    rx_buffer_t *rx = read_pipeline_lend(&dev->pipeline);
+    
+    // A frame outgrowing its slot moves up a size class instead of being dropped
+    size_t needed = frame_assembler_required_capacity(&dev->assembler, data, (size_t)length);
+    if (needed > dev->assembler.capacity && needed <= dev->max_frame_size) {
+        grow_write_slot(dev, needed);
+    }
+    
+    // Append payload; only bytes not seen before (or, on the fast path,
+    // only the packet tail) are searched for EOI
+    result = frame_assembler_push_ref(&dev->assembler, rx, data, (size_t)length);
+    atomic32_store_relaxed(&dev->stats.frames_discarded, (long)dev->assembler.restarts);
+    atomic32_store_relaxed(&dev->stats.payloads_copied, (long)dev->assembler.payloads_copied);
+    if (result == FRAME_ASM_BAD_HEADER) {
+        stats_add(&dev->stats.bad_header_packets, 1);
+    }
+    
+    if (dev->assembler.fast_path_fallbacks != fallbacks) {
+        debug_log("process_data: Frame did not end at a packet tail, fast path off (fallbacks=%u)",
+                  dev->assembler.fast_path_fallbacks);
+    } else if (dev->assembler.fast_path && !fast_path) {
+        debug_log("process_data: Frames end at packet tails, fast path on");
+    }
+    
+    // A frame found late by a fast path fallback ends before this packet;
+    // the packet then starts the next frame after the hand-off below
+    bool deferred = dev->assembler.deferred != NULL;
+    if (starts_frame && !deferred) {
+        dev->frame_start = arrival;
+        dev->frame_packets = 1;
+        memcpy(dev->frame_header, data, FRAME_PACKET_HEADER_SIZE);
+    } else if (!starts_frame) {
+        dev->frame_packets++;
+    }
+    
+    trace_read(dev, TRACE_EVENT_PACKET, (unsigned int)length);
+    if (dev->assembler.restarts != restarts) {
+        trace_read(dev, TRACE_EVENT_DROP, TRACE_DROP_DISCARDED);
+    }
+    if (starts_frame && !deferred && result != FRAME_ASM_BAD_HEADER) {
+        dev->frame_seq++;
+        trace_read(dev, TRACE_EVENT_SOI, 0);
+    }
+    
+    while (result == FRAME_ASM_COMPLETE) {
+        size_t complete_frame_size = dev->assembler.complete_size;
         
-        if (frame->ready) {
-            // Frame is available
-            if (frame->size > buffer_size) {
-                LeaveCriticalSection(&dev->frame_lock);
-                set_error("Buffer too small: need %zu bytes, have %zu", frame->size, buffer_size);
-                return CAMERA_ERROR_BUFFER_SMALL;
-            }
-            
-            // Copy frame data to user buffer
-            memcpy(buffer, frame->data, frame->size);
-            *bytes_read = frame->size;
-            
-            // Mark frame as consumed
-            frame->ready = false;
-            frame->size = 0;
-            
-            // Move to next frame
-            dev->read_frame = (dev->read_frame + 1) % MAX_FRAMES;
+        debug_log("process_data: Complete frame detected, size=%zu bytes", complete_frame_size);
+        trace_read(dev, TRACE_EVENT_EOI, (unsigned int)complete_frame_size);
+        
+        stats_add(&dev->stats.frames_captured, 1);
+        stats_histogram_record(&dev->stats.assembly, ticks_to_us(dev, arrival - dev->frame_start));
+        if (dev->last_frame) {
+            stats_histogram_record(&dev->stats.frame_interval, ticks_to_us(dev, arrival - dev->last_frame));
+        }
+        dev->last_frame = arrival;
+        
+        // Queue the frame and move to a slot that is neither queued nor leased
+        slot = frame_ring_write_slot(&dev->ring);
+        slot->start_time = dev->frame_start;
+        slot->ready_time = arrival;
+        slot->frame_id = dev->frame_seq;
+        slot->packet_count = dev->frame_packets;
+        slot->segment_count = dev->assembler.segment_count;
+        memcpy(slot->header, dev->frame_header, FRAME_PACKET_HEADER_SIZE);
+        
+        // Leftover data carried into the next slot starts with this packet
+        dev->frame_start = arrival;
+        dev->frame_packets = 1;
+        memcpy(dev->frame_header, data, FRAME_PACKET_HEADER_SIZE);
+        
+        if (frame_ring_publish(&dev->ring, complete_frame_size, &was_empty) != FRAME_RING_PUBLISHED) {
+            // Consumers hold every other slot - the frame is dropped and
+            // its slot reused; the hand-off below keeps what follows it
+            stats_add(&dev->stats.frames_overflow, 1);
+            trace_read(dev, TRACE_EVENT_DROP, TRACE_DROP_OVERFLOW);
+            debug_log("process_data: WARNING - Frame dropped (buffer full), total_dropped=%ld",
+                      atomic32_load_relaxed(&dev->stats.frames_overflow));
+        } else {
+            trace_read(dev, TRACE_EVENT_FRAME_PUBLISHED, (unsigned int)complete_frame_size);
             
-            LeaveCriticalSection(&dev->frame_lock);
+            if (dev->frame_callback && dev->callback_mode == CAMERA_CALLBACK_INLINE) {
+                // The published slot is left alone until the next publish,
+                // so the carry-over below still finds its data
+                deliver_inline(dev);
+            } else if (was_empty) {
+                // Only wake consumers on the empty -> non-empty transition
+                platform_event_set(dev->frame_ready_event);
+            }
+        }
+        
+        // Carry leftover data (if it starts a new JPEG) into the next slot,
+        // or the same one after a drop, and check whether it already holds
+        // another complete frame
+        slot = frame_ring_write_slot(&dev->ring);
+        frame_assembler_handoff_gather(&dev->assembler, slot->data, slot->capacity,
+                                       slot->segments, FRAME_RING_MAX_SEGMENTS);
+        if (dev->assembler.size > 0) {
+            dev->frame_seq++;
+            trace_read(dev, TRACE_EVENT_SOI, 0);
+        }
+        result = frame_assembler_scan(&dev->assembler);
+    }
+    
+    if (result == FRAME_ASM_TOO_LARGE || result == FRAME_ASM_OVERFLOW) {
+        stats_add(&dev->stats.frames_oversize, 1);
+        trace_read(dev, TRACE_EVENT_DROP, TRACE_DROP_OVERSIZE);
+        debug_log("process_data: WARNING - Frame too large without EOI, discarded (limit=%zu), total_oversize=%ld",
+                  dev->max_frame_size, atomic32_load_relaxed(&dev->stats.frames_oversize));
+    }
+}
+
+// CAMERA_READ_LATEST: pass over every queued frame but the newest.
+// Called with consumer_lock held and at least one frame queued
+static frame_slot_t* skip_to_latest(camera_device_t *dev) {
+    while (frame_ring_queued(&dev->ring) > 1) {
+        frame_slot_t *old = frame_ring_peek(&dev->ring);
+        trace_recorder_emit(dev->tracer, TRACE_SOURCE_CONSUMER, TRACE_EVENT_DROP,
+                            old->frame_id, TRACE_DROP_SKIPPED);
+        frame_ring_pop(&dev->ring);
+        stats_add(&dev->stats.frames_skipped, 1);
+    }
+    return frame_ring_peek(&dev->ring);
+}
+
+// Wait until the ring holds a completed frame
+// On success returns with consumer_lock held
+static int wait_for_frame(camera_device_t *dev, unsigned int timeout_ms, frame_slot_t **out) {
+    int wait_result;
+    unsigned int timeout = timeout_ms ? timeout_ms : PLATFORM_WAIT_INFINITE;
+    
+    while (true) {
+        // Checked on every wakeup so camera_stop_streaming ends a wait
+        if (!dev->streaming) {
+            set_error("Camera is not streaming");
+            return CAMERA_ERROR_NO_FRAME;
+        }
+        
+        platform_lock_enter(dev->consumer_lock);
+        
+        *out = frame_ring_peek(&dev->ring);
+        if (*out) {
+            if (dev->read_mode == CAMERA_READ_LATEST) {
+                *out = skip_to_latest(dev);
+            }
             return CAMERA_SUCCESS;
         }
         
-        LeaveCriticalSection(&dev->frame_lock);
+        if (dev->stream_ended) {
+            platform_lock_leave(dev->consumer_lock);
+            set_error("End of stream");
+            return CAMERA_ERROR_NO_FRAME;
+        }
+        
+        // The producer only signals when it finds the ring empty; re-check
+        // after a fence so a frame published meanwhile is not slept through
+        bool empty = frame_ring_empty_before_wait(&dev->ring);
+        platform_lock_leave(dev->consumer_lock);
+        if (!empty) {
+            continue;
+        }
         
         // No frame ready - wait for one
-        wait_result = WaitForSingleObject(dev->frame_ready_event, timeout);
+        wait_result = platform_event_wait(dev->frame_ready_event, timeout);
         
-        if (wait_result == WAIT_TIMEOUT) {
+        if (wait_result == PLATFORM_WAIT_TIMEOUT) {
             set_error("Timeout waiting for frame");
             return CAMERA_ERROR_TIMEOUT;
         }
         
-        if (wait_result != WAIT_OBJECT_0) {
-            set_error("Wait failed: %d", GetLastError());
+        if (wait_result != PLATFORM_WAIT_OK) {
+            set_error("Wait failed: %lu", platform_last_error());
             return CAMERA_ERROR_USB_FAILED;
         }
         
         // Event was signaled, loop back to check for frame
     }
 }
+
+// Account for a frame handed to the application: latency since it
+// completed, and its trace event. Called with consumer_lock held, which
+// makes consumers a single writer
+static void frame_consumed(camera_device_t *dev, const frame_slot_t *frame) {
+    stats_histogram_record(&dev->stats.consumer_latency, ticks_to_us(dev, now_ticks() - frame->ready_time));
+    trace_recorder_emit(dev->tracer, TRACE_SOURCE_CONSUMER, TRACE_EVENT_FRAME_CONSUMED,
+                        frame->frame_id, (unsigned int)frame->size);
+}
+
+// CAMERA_CALLBACK_DISPATCHER: consume frames and run the callback off
+// the read thread. Holds a lease rather than the lock during the callback
+// so the producer keeps filling the other slots
+static void dispatch_thread_proc(void *param) {
+    camera_device_t *dev = (camera_device_t*)param;
+    frame_slot_t *frame;
+    int ret;
+    platform_thread_sched_t sched;
+    
+    apply_thread_attr(dev, CAMERA_THREAD_DISPATCH, &sched);
+    debug_log("dispatch_thread_proc: Dispatch thread started");
+    
+    while (true) {
+        ret = wait_for_frame(dev, DISPATCH_WAIT_TIMEOUT, &frame);
+        if (ret == CAMERA_ERROR_TIMEOUT) {
+            continue;
+        }
+        if (ret != CAMERA_SUCCESS) {
+            break;  // Stopped, or the stream ended and has been drained
+        }
+        
+        frame_ring_acquire(&dev->ring);
+        frame_consumed(dev, frame);
+        frame_slot_coalesce(frame);
+        platform_lock_leave(dev->consumer_lock);
+        
+        invoke_callback(dev, frame);
+        
+        platform_lock_enter(dev->consumer_lock);
+        frame_ring_release(&dev->ring, frame->data);
+        platform_lock_leave(dev->consumer_lock);
+    }
+    
+    debug_log("dispatch_thread_proc: Dispatch thread exiting");
+    platform_thread_revert(&sched);
+}
+
+// Frames go to the callback or the decode threads only; reading alongside
+// either would split the stream
+static bool callback_blocks_reads(camera_device_t *dev) {
+    if (dev->frame_callback) {
+        set_error("Frame callback is set");
+        return true;
+    }
+    if (dev->decoders) {
+        set_error("Decode threads are running");
+        return true;
+    }
+    return false;
+}
+
+// Read frame - blocking call with timeout
+CAMERA_API int camera_read_frame(CAMERA_HANDLE handle,
+                                  unsigned char *buffer,
+                                  size_t buffer_size,
+                                  size_t *bytes_read,
+                                  unsigned int timeout_ms) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    frame_slot_t *frame;
+    int ret;
+    
+    if (!dev || !buffer || !bytes_read) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    *bytes_read = 0;
+    
+    if (callback_blocks_reads(dev)) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    ret = wait_for_frame(dev, timeout_ms, &frame);
+    if (ret != CAMERA_SUCCESS) {
+        return ret;
+    }
+    
+    // Frame is available (consumer_lock held)
+    if (frame->size > buffer_size) {
+        platform_lock_leave(dev->consumer_lock);
+        set_error("Buffer too small: need %zu bytes, have %zu", frame->size, buffer_size);
+        return CAMERA_ERROR_BUFFER_SMALL;
+    }
+    
+    // Copy frame data to user buffer, straight from the receive buffers
+    // if the frame was left there
+    frame_slot_read(frame, buffer);
+    *bytes_read = frame->size;
+    frame_consumed(dev, frame);
+    
+    // Mark frame as consumed and hand the slot back to the producer
+    frame_ring_pop(&dev->ring);
+    
+    platform_lock_leave(dev->consumer_lock);
+    return CAMERA_SUCCESS;
+}
+
+// Read frame with metadata
+CAMERA_API int camera_read_frame_ex(CAMERA_HANDLE handle,
+                                    unsigned char *buffer,
+                                    size_t buffer_size,
+                                    size_t *bytes_read,
+                                    camera_frame_info_t *info,
+                                    unsigned int timeout_ms) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    frame_slot_t *frame;
+    int ret;
+    
+    if (!dev || !buffer || !bytes_read || !info) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    *bytes_read = 0;
+    
+    if (callback_blocks_reads(dev)) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    ret = wait_for_frame(dev, timeout_ms, &frame);
+    if (ret != CAMERA_SUCCESS) {
+        return ret;
+    }
+    
+    // Frame is available (consumer_lock held)
+    if (frame->size > buffer_size) {
+        platform_lock_leave(dev->consumer_lock);
+        set_error("Buffer too small: need %zu bytes, have %zu", frame->size, buffer_size);
+        return CAMERA_ERROR_BUFFER_SMALL;
+    }
+    
+    frame_slot_read(frame, buffer);
+    *bytes_read = frame->size;
+    
+    info->sequence = frame->frame_id;
+    info->packet_count = frame->packet_count;
+    info->first_packet_us = ticks_to_us(dev, frame->start_time);
+    info->completed_us = ticks_to_us(dev, frame->ready_time);
+    info->delivered_us = ticks_to_us(dev, now_ticks());
+    memcpy(info->header, frame->header, CAMERA_PACKET_HEADER_SIZE);
+    frame_consumed(dev, frame);
+    
+    frame_ring_pop(&dev->ring);
+    
+    platform_lock_leave(dev->consumer_lock);
+    return CAMERA_SUCCESS;
+}
+
+// Read a batch of frames - drains the queue under one lock hold
+CAMERA_API int camera_read_frames(CAMERA_HANDLE handle,
+                                  camera_frame_entry_t *frames,
+                                  int count,
+                                  int *frames_read,
+                                  unsigned int timeout_ms) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    frame_slot_t *frame;
+    int ret;
+    int n = 0;
+    
+    if (!dev || !frames || count < 1 || !frames_read) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    *frames_read = 0;
+    
+    if (callback_blocks_reads(dev)) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    ret = wait_for_frame(dev, timeout_ms, &frame);
+    if (ret != CAMERA_SUCCESS) {
+        return ret;
+    }
+    
+    // At least one frame is available (consumer_lock held); take what
+    // else is queued without waiting for more
+    do {
+        camera_frame_entry_t *entry = &frames[n];
+        
+        if (frame->size > entry->buffer_size) {
+            if (n == 0) {
+                entry->size = frame->size;
+                platform_lock_leave(dev->consumer_lock);
+                set_error("Buffer too small: need %zu bytes, have %zu", frame->size, entry->buffer_size);
+                return CAMERA_ERROR_BUFFER_SMALL;
+            }
+            break;  // Left queued for the next call
+        }
+        
+        frame_slot_read(frame, entry->buffer);
+        entry->size = frame->size;
+        entry->sequence = frame->frame_id;
+        entry->completed_us = ticks_to_us(dev, frame->ready_time);
+        frame_consumed(dev, frame);
+        frame_ring_pop(&dev->ring);
+        n++;
+    } while (n < count && dev->read_mode == CAMERA_READ_FIFO &&
+             (frame = frame_ring_peek(&dev->ring)) != NULL);
+    
+    platform_lock_leave(dev->consumer_lock);
+    
+    *frames_read = n;
+    return CAMERA_SUCCESS;
+}
+
+// Acquire frame - zero-copy variant of camera_read_frame
+CAMERA_API int camera_acquire_frame(CAMERA_HANDLE handle,
+                                     const unsigned char **data,
+                                     size_t *size,
+                                     unsigned int timeout_ms) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    frame_slot_t *frame;
+    int ret;
+    
+    if (!dev || !data || !size) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    *data = NULL;
+    *size = 0;
+    
+    if (callback_blocks_reads(dev)) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    ret = wait_for_frame(dev, timeout_ms, &frame);
+    if (ret != CAMERA_SUCCESS) {
+        return ret;
+    }
+    
+    // Hand out the slot itself; the producer skips it until released.
+    // Coalesced under the lock so stopping cannot free the receive
+    // buffers mid-copy
+    frame_ring_acquire(&dev->ring);
+    frame_slot_coalesce(frame);
+    *data = frame->data;
+    *size = frame->size;
+    frame_consumed(dev, frame);
+    
+    platform_lock_leave(dev->consumer_lock);
+    return CAMERA_SUCCESS;
+}
+
+// Release frame acquired with camera_acquire_frame
+CAMERA_API int camera_release_frame(CAMERA_HANDLE handle, const unsigned char *data) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    bool released;
+    
+    if (!dev || !data) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    platform_lock_enter(dev->consumer_lock);
+    released = frame_ring_release(&dev->ring, data);
+    platform_lock_leave(dev->consumer_lock);
+    
+    if (!released) {
+        set_error("Frame is not leased from this camera");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    return CAMERA_SUCCESS;
+}
+
+#ifdef USEEPLUS_HAVE_JPEG
+// Decode a JPEG into a decoded frame buffer (decode_lock held)
+static int decode_into(camera_device_t *dev, const unsigned char *jpeg, size_t size, int format,
+                       decoded_buffer_t *buffer, camera_decoded_frame_t *frame) {
+    frame_image_t image;
+    
+    if (!dev->decoder) {
+        dev->decoder = frame_decoder_create();
+        if (!dev->decoder) {
+            set_error("Failed to create JPEG decoder");
+            return CAMERA_ERROR_INIT_FAILED;
+        }
+    }
+    
+    if (!frame_decoder_start(dev->decoder, jpeg, size, format, dev->decode_width, dev->decode_height, &image)) {
+        set_error("JPEG decoding failed: %s", frame_decoder_error(dev->decoder));
+        return CAMERA_ERROR_DECODE_FAILED;
+    }
+    
+    // Move up a size class if the image outgrew the buffer
+    if (image.size > buffer->capacity) {
+        frame_pool_put(&dev->decode_pool, buffer->data, buffer->capacity);
+        buffer->data = frame_pool_get(&dev->decode_pool, image.size, &buffer->capacity);
+        if (!buffer->data) {
+            buffer->capacity = 0;
+            frame_decoder_abort(dev->decoder);
+            set_error("No buffer for a %dx%d decoded frame (%zu bytes)", image.width, image.height, image.size);
+            return CAMERA_ERROR_BUFFER_SMALL;
+        }
+    }
+    
+    if (!frame_decoder_finish(dev->decoder, buffer->data)) {
+        set_error("JPEG decoding failed: %s", frame_decoder_error(dev->decoder));
+        return CAMERA_ERROR_DECODE_FAILED;
+    }
+    
+    frame->format = format;
+    frame->width = image.width;
+    frame->height = image.height;
+    frame->scale = image.scale;
+    for (int i = 0; i < image.planes; i++) {
+        frame->planes[i] = buffer->data + image.offsets[i];
+        frame->strides[i] = image.strides[i];
+    }
+    return CAMERA_SUCCESS;
+}
+
+// Decode threads: consume frames like the dispatcher and submit each to
+// the parallel decoder, which copies it, so the lease ends right away
+static void decode_feed_thread_proc(void *param) {
+    camera_device_t *dev = (camera_device_t*)param;
+    frame_slot_t *frame;
+    int ret;
+    platform_thread_sched_t sched;
+    
+    // Stands in for the dispatch thread, which never runs alongside it
+    apply_thread_attr(dev, CAMERA_THREAD_DISPATCH, &sched);
+    debug_log("decode_feed_thread_proc: Feed thread started");
+    
+    while (true) {
+        ret = wait_for_frame(dev, DISPATCH_WAIT_TIMEOUT, &frame);
+        if (ret == CAMERA_ERROR_TIMEOUT) {
+            continue;
+        }
+        if (ret != CAMERA_SUCCESS) {
+            break;  // Stopped, or the stream ended and has been drained
+        }
+        
+        frame_ring_acquire(&dev->ring);
+        frame_consumed(dev, frame);
+        frame_slot_coalesce(frame);
+        platform_lock_leave(dev->consumer_lock);
+        
+        // Blocks only under CAMERA_DECODE_BLOCK; a stop flushes it free.
+        // Policy drops are counted by the decoders, and a frame flushed
+        // by the stop is not counted at all
+        ret = parallel_decoder_submit(dev->decoders, frame->data, frame->size, frame->frame_id,
+                                      frame->ready_time, PLATFORM_WAIT_INFINITE);
+        if (ret == PARALLEL_DECODER_FAILED) {
+            stats_add(&dev->stats.decode_submit_failures, 1);
+            debug_log("decode_feed_thread_proc: WARNING - No memory to queue frame %u (%zu bytes)",
+                      frame->frame_id, frame->size);
+        }
+        
+        platform_lock_enter(dev->consumer_lock);
+        frame_ring_release(&dev->ring, frame->data);
+        platform_lock_leave(dev->consumer_lock);
+    }
+    
+    debug_log("decode_feed_thread_proc: Feed thread exiting");
+    platform_thread_revert(&sched);
+}
+
+// camera_read_decoded_frame with decode threads: the next frame they finished
+static int read_from_decoders(camera_device_t *dev, int format, camera_decoded_frame_t *frame,
+                              unsigned int timeout_ms) {
+    decode_result_t result;
+    int ret;
+    
+    if (format != dev->decoders_format) {
+        set_error("Decode threads decode to pixel format %d, not %d", dev->decoders_format, format);
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    if (!dev->streaming) {
+        set_error("Camera is not streaming");
+        return CAMERA_ERROR_NO_FRAME;
+    }
+    
+    ret = parallel_decoder_next(dev->decoders, timeout_ms ? timeout_ms : PLATFORM_WAIT_INFINITE, &result);
+    switch (ret) {
+        case PARALLEL_DECODER_OK:
+            break;
+        case PARALLEL_DECODER_TIMEOUT:
+            set_error("Timeout waiting for frame");
+            return CAMERA_ERROR_TIMEOUT;
+        case PARALLEL_DECODER_FAILED:
+            set_error("JPEG decoding failed: %s", result.error);
+            debug_log("camera_read_decoded_frame: ERROR - Frame %u: %s", result.sequence, camera_get_error());
+            return CAMERA_ERROR_DECODE_FAILED;
+        default:
+            set_error("Camera is not streaming");
+            return CAMERA_ERROR_NO_FRAME;
+    }
+    
+    frame->format = format;
+    frame->width = result.image.width;
+    frame->height = result.image.height;
+    frame->scale = result.image.scale;
+    for (int i = 0; i < result.image.planes; i++) {
+        frame->planes[i] = result.data + result.image.offsets[i];
+        frame->strides[i] = result.image.strides[i];
+    }
+    frame->sequence = result.sequence;
+    frame->completed_us = ticks_to_us(dev, result.timestamp);
+    frame->decode_us = ticks_to_us(dev, result.decode_ticks);
+    return CAMERA_SUCCESS;
+}
+#endif
+
+// Read the next frame decoded to pixels
+CAMERA_API int camera_read_decoded_frame(CAMERA_HANDLE handle,
+                                         int format,
+                                         camera_decoded_frame_t *frame,
+                                         unsigned int timeout_ms) {
+#ifdef USEEPLUS_HAVE_JPEG
+    camera_device_t *dev = (camera_device_t*)handle;
+    decoded_buffer_t *buffer = NULL;
+    frame_slot_t *slot;
+    const unsigned char *jpeg;
+    size_t jpeg_size;
+    unsigned long long start;
+    int ret;
+    
+    if (!dev || !frame || format < CAMERA_PIXEL_RGBA || format > CAMERA_PIXEL_I420) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    memset(frame, 0, sizeof(*frame));
+    
+    if (dev->decoders) {
+        return read_from_decoders(dev, format, frame, timeout_ms);
+    }
+    
+    if (callback_blocks_reads(dev)) {
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    // Reserve a buffer first, so no frame is consumed that cannot be decoded
+    platform_lock_enter(dev->decode_lock);
+    for (int i = 0; i < CAMERA_MAX_DECODED_FRAMES && !buffer; i++) {
+        if (!dev->decoded[i].held) {
+            buffer = &dev->decoded[i];
+            buffer->held = true;
+        }
+    }
+    platform_lock_leave(dev->decode_lock);
+    
+    if (!buffer) {
+        set_error("All %d decoded frames are held; release one first", CAMERA_MAX_DECODED_FRAMES);
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    ret = wait_for_frame(dev, timeout_ms, &slot);
+    if (ret != CAMERA_SUCCESS) {
+        platform_lock_enter(dev->decode_lock);
+        buffer->held = false;
+        platform_lock_leave(dev->decode_lock);
+        return ret;
+    }
+    
+    // Lease the JPEG as camera_acquire_frame does, so decoding runs
+    // without consumer_lock
+    frame_ring_acquire(&dev->ring);
+    frame_slot_coalesce(slot);
+    jpeg = slot->data;
+    jpeg_size = slot->size;
+    frame->sequence = slot->frame_id;
+    frame->completed_us = ticks_to_us(dev, slot->ready_time);
+    frame_consumed(dev, slot);
+    platform_lock_leave(dev->consumer_lock);
+    
+    start = now_ticks();
+    platform_lock_enter(dev->decode_lock);
+    ret = decode_into(dev, jpeg, jpeg_size, format, buffer, frame);
+    if (ret != CAMERA_SUCCESS) {
+        buffer->held = false;
+    }
+    platform_lock_leave(dev->decode_lock);
+    frame->decode_us = ticks_to_us(dev, now_ticks() - start);
+    
+    platform_lock_enter(dev->consumer_lock);
+    frame_ring_release(&dev->ring, jpeg);
+    platform_lock_leave(dev->consumer_lock);
+    
+    if (ret != CAMERA_SUCCESS) {
+        debug_log("camera_read_decoded_frame: ERROR - Frame %u: %s", frame->sequence, camera_get_error());
+    }
+    return ret;
+#else
+    (void)handle;
+    (void)format;
+    (void)frame;
+    (void)timeout_ms;
+    set_error("JPEG decoding not available (library built without libjpeg-turbo)");
+    return CAMERA_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+// Set the size decoded frames are displayed at
+CAMERA_API int camera_set_decode_size(CAMERA_HANDLE handle, int width, int height) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || width < 0 || height < 0) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    platform_lock_enter(dev->decode_lock);
+    dev->decode_width = width;
+    dev->decode_height = height;
+#ifdef USEEPLUS_HAVE_JPEG
+    if (dev->decoders) {
+        parallel_decoder_set_target(dev->decoders, width, height);
+    }
+#endif
+    platform_lock_leave(dev->decode_lock);
+    return CAMERA_SUCCESS;
+}
+
+// Decode frames on a pool of background threads
+CAMERA_API int camera_set_decode_threads(CAMERA_HANDLE handle, int threads, int format, int policy) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || threads < 0 || threads > CAMERA_MAX_DECODE_THREADS ||
+        format < CAMERA_PIXEL_RGBA || format > CAMERA_PIXEL_I420 ||
+        policy < CAMERA_DECODE_BLOCK || policy > CAMERA_DECODE_DROP_NEWEST) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+#ifdef USEEPLUS_HAVE_JPEG
+    // The feed thread and readers use the decoders without a lock
+    if (dev->streaming) {
+        set_error("Cannot change decode threads while streaming");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    if (dev->decoders && parallel_decoder_held(dev->decoders) > 0) {
+        set_error("Decoded frames are still held; release them first");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    if (threads > 0 && dev->frame_callback) {
+        set_error("Decode threads and a frame callback cannot be used together");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    parallel_decoder_destroy(dev->decoders);
+    dev->decoders = NULL;
+    
+    if (threads > 0) {
+        dev->decoders = parallel_decoder_create(threads, threads * 2 + CAMERA_MAX_DECODED_FRAMES,
+                                                format, policy);
+        if (!dev->decoders) {
+            set_error("Failed to start %d decode threads", threads);
+            return CAMERA_ERROR_INIT_FAILED;
+        }
+        platform_lock_enter(dev->decode_lock);
+        parallel_decoder_set_target(dev->decoders, dev->decode_width, dev->decode_height);
+        platform_lock_leave(dev->decode_lock);
+        dev->decoders_format = format;
+    }
+    
+    debug_log("camera_set_decode_threads: %d threads (format=%d, policy=%d)", threads, format, policy);
+    return CAMERA_SUCCESS;
+#else
+    set_error("JPEG decoding not available (library built without libjpeg-turbo)");
+    return CAMERA_ERROR_NOT_SUPPORTED;
+#endif
+}
+
+// Release a frame returned by camera_read_decoded_frame
+CAMERA_API int camera_release_decoded_frame(CAMERA_HANDLE handle, const camera_decoded_frame_t *frame) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    bool released = false;
+    
+    if (!dev || !frame || !frame->planes[0]) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+#ifdef USEEPLUS_HAVE_JPEG
+    if (dev->decoders && parallel_decoder_release(dev->decoders, frame->planes[0])) {
+        return CAMERA_SUCCESS;
+    }
+#endif
+    
+    platform_lock_enter(dev->decode_lock);
+    for (int i = 0; i < CAMERA_MAX_DECODED_FRAMES && !released; i++) {
+        decoded_buffer_t *buffer = &dev->decoded[i];
+        if (buffer->held && buffer->data == frame->planes[0]) {
+            buffer->held = false;
+            released = true;
+        }
+    }
+    platform_lock_leave(dev->decode_lock);
+    
+    if (!released) {
+        set_error("Frame is not decoded from this camera");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    return CAMERA_SUCCESS;
+}
+
+// Set or clear the frame callback
+CAMERA_API int camera_set_frame_callback(CAMERA_HANDLE handle,
+                                         camera_frame_callback_t callback,
+                                         void *user_data,
+                                         int mode) {
+    camera_device_t *dev = (camera_device_t*)handle;
+    
+    if (!dev || (mode != CAMERA_CALLBACK_INLINE && mode != CAMERA_CALLBACK_DISPATCHER)) {
+        set_error("Invalid parameters");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    // The read and dispatch threads read these without a lock
+    if (dev->streaming) {
+        set_error("Cannot change the frame callback while streaming");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    if (callback && dev->decoders) {
+        set_error("Decode threads and a frame callback cannot be used together");
+        return CAMERA_ERROR_INVALID_PARAM;
+    }
+    
+    dev->frame_callback = callback;
+    dev->callback_user_data = user_data;
+    dev->callback_mode = mode;
+    
+    debug_log("camera_set_frame_callback: %s (mode=%s)", callback ? "set" : "cleared",
+              mode == CAMERA_CALLBACK_INLINE ? "inline" : "dispatcher");
+    return CAMERA_SUCCESS;
+}
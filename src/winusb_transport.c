@@ -0,0 +1,317 @@
+/**
+ * Useeplus SuperCamera - WinUSB Transport
+ *
+ * See winusb_transport.h for an overview.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#include "winusb_transport.h"
+
+#include <windows.h>
+#include <winusb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#pragma comment(lib, "winusb.lib")
+
+#define READ_TIMEOUT_MS 1000  // PIPE_TRANSFER_TIMEOUT for bulk IN reads
+#define STREAMING_ALT_SETTING 1
+
+typedef struct winusb_transport {
+    usb_transport_t base;
+    HANDLE device_handle;
+    WINUSB_INTERFACE_HANDLE winusb_handle;
+    UCHAR pipe_in;
+    UCHAR pipe_out;
+    OVERLAPPED reads[USB_TRANSPORT_MAX_READS];
+} winusb_transport_t;
+
+static void set_transport_error(winusb_transport_t *t, const char *what, DWORD error) {
+    snprintf(t->base.error, sizeof(t->base.error), "%s: error %lu (0x%lx)", what, error, error);
+}
+
+static int winusb_open(usb_transport_t *transport, const char *path) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+    USB_INTERFACE_DESCRIPTOR interface_desc;
+    char debug_msg[512];
+
+    // Open device handle - WinUSB requires FILE_FLAG_OVERLAPPED
+    t->device_handle = CreateFileA(path,
+                                   GENERIC_WRITE | GENERIC_READ,
+                                   FILE_SHARE_WRITE | FILE_SHARE_READ,
+                                   NULL,
+                                   OPEN_EXISTING,
+                                   FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED,
+                                   NULL);
+
+    if (t->device_handle == INVALID_HANDLE_VALUE) {
+        set_transport_error(t, "Failed to open device", GetLastError());
+        return USB_XFER_ERROR;
+    }
+
+    snprintf(debug_msg, sizeof(debug_msg), "CreateFileA succeeded, handle = 0x%p", t->device_handle);
+    OutputDebugStringA(debug_msg);
+
+    // Initialize WinUSB
+    if (!WinUsb_Initialize(t->device_handle, &t->winusb_handle)) {
+        DWORD error = GetLastError();
+
+        // Additional diagnostics
+        snprintf(debug_msg, sizeof(debug_msg),
+                "WinUsb_Initialize failed: error %lu (0x%lx), handle was 0x%p",
+                error, error, t->device_handle);
+        OutputDebugStringA(debug_msg);
+
+        snprintf(t->base.error, sizeof(t->base.error),
+                 "WinUSB initialization failed: error %lu (0x%lx). Possible issues:\n"
+                 "  1. WinUSB driver not correctly installed on Interface 1\n"
+                 "  2. Another application has the device open\n"
+                 "  3. Insufficient permissions (try running as Administrator)",
+                 error, error);
+        t->winusb_handle = NULL;
+        return USB_XFER_ERROR;
+    }
+
+    snprintf(debug_msg, sizeof(debug_msg), "WinUsb_Initialize succeeded! Handle = 0x%p", t->winusb_handle);
+    OutputDebugStringA(debug_msg);
+
+    // Clear any stale state from previous sessions
+    // Abort and flush all pipes first
+    WinUsb_AbortPipe(t->winusb_handle, t->pipe_in);
+    WinUsb_AbortPipe(t->winusb_handle, t->pipe_out);
+    WinUsb_FlushPipe(t->winusb_handle, t->pipe_in);
+    WinUsb_FlushPipe(t->winusb_handle, t->pipe_out);
+    WinUsb_ResetPipe(t->winusb_handle, t->pipe_in);
+    WinUsb_ResetPipe(t->winusb_handle, t->pipe_out);
+
+    // Ensure we start at alternate setting 0
+    WinUsb_SetCurrentAlternateSetting(t->winusb_handle, 0);
+    Sleep(100);
+
+    // Query interface to verify we have the right device
+    if (WinUsb_QueryInterfaceSettings(t->winusb_handle, 0, &interface_desc)) {
+        // Log interface info for debugging
+        snprintf(debug_msg, sizeof(debug_msg),
+                "Camera interface: class=0x%02x, subclass=0x%02x, protocol=0x%02x, endpoints=%d",
+                interface_desc.bInterfaceClass,
+                interface_desc.bInterfaceSubClass,
+                interface_desc.bInterfaceProtocol,
+                interface_desc.bNumEndpoints);
+        OutputDebugStringA(debug_msg);
+    }
+
+    return USB_XFER_OK;
+}
+
+static void winusb_close(usb_transport_t *transport) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+
+    // Aggressive cleanup to ensure device can be reopened
+    if (t->winusb_handle) {
+        // Abort any remaining transfers
+        WinUsb_AbortPipe(t->winusb_handle, t->pipe_in);
+        WinUsb_AbortPipe(t->winusb_handle, t->pipe_out);
+        Sleep(50);
+
+        // Flush pipes thoroughly
+        WinUsb_FlushPipe(t->winusb_handle, t->pipe_in);
+        WinUsb_FlushPipe(t->winusb_handle, t->pipe_out);
+        Sleep(50);
+
+        // Reset pipes to clear any stale state
+        WinUsb_ResetPipe(t->winusb_handle, t->pipe_in);
+        WinUsb_ResetPipe(t->winusb_handle, t->pipe_out);
+        Sleep(50);
+
+        // Reset interface to default state before closing
+        WinUsb_SetCurrentAlternateSetting(t->winusb_handle, 0);
+        Sleep(100);
+
+        WinUsb_Free(t->winusb_handle);
+        t->winusb_handle = NULL;
+    }
+
+    // Close device handle
+    if (t->device_handle != INVALID_HANDLE_VALUE) {
+        CloseHandle(t->device_handle);
+        t->device_handle = INVALID_HANDLE_VALUE;
+    }
+
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        if (t->reads[i].hEvent) {
+            CloseHandle(t->reads[i].hEvent);
+        }
+    }
+
+    free(t);
+}
+
+static void winusb_reset(usb_transport_t *transport) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+
+    // Flush the USB pipe to clear any stale data
+    if (t->winusb_handle) {
+        WinUsb_FlushPipe(t->winusb_handle, t->pipe_in);
+        WinUsb_ResetPipe(t->winusb_handle, t->pipe_in);
+    }
+}
+
+static int winusb_start_streaming(usb_transport_t *transport) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+    USB_INTERFACE_DESCRIPTOR if_desc;
+    ULONG timeout_ms = READ_TIMEOUT_MS;
+    UCHAR raw_io = TRUE;
+
+    // Query current interface descriptor
+    if (WinUsb_QueryInterfaceSettings(t->winusb_handle, 0, &if_desc)) {
+        char debug_msg[256];
+        snprintf(debug_msg, sizeof(debug_msg),
+                "Camera interface: %d alternate settings available\n",
+                if_desc.bNumEndpoints);
+        OutputDebugStringA(debug_msg);
+    }
+
+    // Reset to alternate setting 0 first, then set to 1 (clean state)
+    WinUsb_SetCurrentAlternateSetting(t->winusb_handle, 0);
+    Sleep(10);
+
+    // Reset and flush the input pipe before starting
+    WinUsb_ResetPipe(t->winusb_handle, t->pipe_in);
+    WinUsb_FlushPipe(t->winusb_handle, t->pipe_in);
+
+    // Set alternate interface setting to 1
+    if (!WinUsb_SetCurrentAlternateSetting(t->winusb_handle, STREAMING_ALT_SETTING)) {
+        set_transport_error(t, "Failed to set alternate setting", GetLastError());
+        return USB_XFER_ERROR;
+    }
+
+    // Set pipe policy for timeouts
+    WinUsb_SetPipePolicy(t->winusb_handle, t->pipe_in, PIPE_TRANSFER_TIMEOUT,
+                         sizeof(timeout_ms), &timeout_ms);
+
+    // Try to enable RAW_IO for better performance
+    WinUsb_SetPipePolicy(t->winusb_handle, t->pipe_in, RAW_IO,
+                         sizeof(raw_io), &raw_io);
+
+    return USB_XFER_OK;
+}
+
+static int winusb_write_command(usb_transport_t *transport, const unsigned char *data, size_t length) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+    ULONG bytes_sent;
+
+    if (!WinUsb_WritePipe(t->winusb_handle, t->pipe_out, (PUCHAR)data, (ULONG)length, &bytes_sent, NULL)) {
+        set_transport_error(t, "WinUsb_WritePipe failed", GetLastError());
+        return USB_XFER_ERROR;
+    }
+
+    if (bytes_sent != length) {
+        snprintf(t->base.error, sizeof(t->base.error), "Short write: %lu / %zu bytes", bytes_sent, length);
+        return USB_XFER_ERROR;
+    }
+
+    return USB_XFER_OK;
+}
+
+static int winusb_submit_read(usb_transport_t *transport, int slot,
+                              unsigned char *buffer, size_t length) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+    OVERLAPPED *ov = &t->reads[slot];
+    HANDLE event = ov->hEvent;
+
+    memset(ov, 0, sizeof(*ov));
+    ov->hEvent = event;
+    ResetEvent(event);
+
+    if (!WinUsb_ReadPipe(t->winusb_handle, t->pipe_in, buffer, (ULONG)length, NULL, ov)) {
+        DWORD error = GetLastError();
+        if (error != ERROR_IO_PENDING) {
+            set_transport_error(t, "WinUsb_ReadPipe failed", error);
+            return USB_XFER_ERROR;
+        }
+    }
+
+    // Completed or pending - either way the event is signalled on completion
+    return USB_XFER_OK;
+}
+
+static int winusb_wait_read(usb_transport_t *transport, int slot,
+                            unsigned int timeout_ms, size_t *bytes_read) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+    OVERLAPPED *ov = &t->reads[slot];
+    DWORD transferred = 0;
+    DWORD wait_result;
+
+    *bytes_read = 0;
+
+    wait_result = WaitForSingleObject(ov->hEvent,
+                                      timeout_ms == USB_WAIT_INFINITE ? INFINITE : timeout_ms);
+    if (wait_result == WAIT_TIMEOUT) {
+        return USB_XFER_TIMEOUT;
+    }
+    if (wait_result != WAIT_OBJECT_0) {
+        set_transport_error(t, "Wait failed", GetLastError());
+        return USB_XFER_ERROR;
+    }
+
+    if (!WinUsb_GetOverlappedResult(t->winusb_handle, ov, &transferred, FALSE)) {
+        DWORD error = GetLastError();
+        if (error == ERROR_SEM_TIMEOUT || error == ERROR_TIMEOUT) {
+            // PIPE_TRANSFER_TIMEOUT expired - no data, not an error
+            return USB_XFER_OK;
+        }
+        if (error == ERROR_OPERATION_ABORTED) {
+            return USB_XFER_ABORTED;
+        }
+        set_transport_error(t, "WinUsb_ReadPipe failed", error);
+        return USB_XFER_ERROR;
+    }
+
+    *bytes_read = transferred;
+    return USB_XFER_OK;
+}
+
+static void winusb_abort_reads(usb_transport_t *transport) {
+    winusb_transport_t *t = (winusb_transport_t*)transport;
+
+    // Abort any pending USB transfers (interrupts blocking reads)
+    if (t->winusb_handle) {
+        WinUsb_AbortPipe(t->winusb_handle, t->pipe_in);
+    }
+}
+
+static const usb_transport_ops_t winusb_ops = {
+    .open            = winusb_open,
+    .close           = winusb_close,
+    .reset           = winusb_reset,
+    .start_streaming = winusb_start_streaming,
+    .write_command   = winusb_write_command,
+    .submit_read     = winusb_submit_read,
+    .wait_read       = winusb_wait_read,
+    .abort_reads     = winusb_abort_reads,
+};
+
+usb_transport_t* winusb_transport_create(unsigned char pipe_in, unsigned char pipe_out) {
+    winusb_transport_t *t = (winusb_transport_t*)calloc(1, sizeof(winusb_transport_t));
+
+    if (!t) {
+        return NULL;
+    }
+
+    t->base.ops = &winusb_ops;
+    t->device_handle = INVALID_HANDLE_VALUE;
+    t->pipe_in = pipe_in;
+    t->pipe_out = pipe_out;
+
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        t->reads[i].hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        if (!t->reads[i].hEvent) {
+            winusb_close(&t->base);
+            return NULL;
+        }
+    }
+
+    return &t->base;
+}
@@ -0,0 +1,25 @@
+/**
+ * Useeplus SuperCamera - WinUSB Transport
+ *
+ * usb_transport_t implementation on WinUSB. Every transfer slot owns an
+ * OVERLAPPED with its own manual-reset event, so several WinUsb_ReadPipe
+ * calls can be outstanding on the bulk IN pipe at once.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef WINUSB_TRANSPORT_H
+#define WINUSB_TRANSPORT_H
+
+#include "usb_transport.h"
+
+/**
+ * Create an unopened WinUSB transport
+ *
+ * @param pipe_in Bulk IN endpoint address
+ * @param pipe_out Bulk OUT endpoint address
+ * @return Transport, or NULL if out of memory or events
+ */
+usb_transport_t* winusb_transport_create(unsigned char pipe_in, unsigned char pipe_out);
+
+#endif // WINUSB_TRANSPORT_H
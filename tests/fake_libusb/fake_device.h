@@ -0,0 +1,105 @@
+/**
+ * Fake libusb-1.0 - Simulated Camera
+ *
+ * The one device on the fake bus: a camera at FAKE_DEVICE_BUS:
+ * FAKE_DEVICE_ADDRESS that, once its streaming interface setting is
+ * selected and the connect command arrives on the bulk OUT endpoint,
+ * answers bulk IN transfers with one camera packet each (12-byte header,
+ * then a slice of the current frame), one packet per packet interval of
+ * bus time while a transfer is queued.
+ * Frames end at packet boundaries like the real camera's, unless run-on
+ * is set: then a frame starts right after the previous EOI, in the same
+ * packet.
+ *
+ * Frame n is generated by fake_device_frame(): SOI, n in four 7-bit
+ * bytes, filler without 0xFF bytes, EOI; its size varies with n. Tests
+ * regenerate frames to check what the driver delivered.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef FAKE_DEVICE_H
+#define FAKE_DEVICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define FAKE_DEVICE_BUS          1
+#define FAKE_DEVICE_ADDRESS      4
+#define FAKE_DEVICE_VENDOR_ID    0x2ce3
+#define FAKE_DEVICE_PRODUCT_ID   0x3828
+#define FAKE_DEVICE_PAYLOAD      4084     // Largest payload per packet
+#define FAKE_DEVICE_MAX_FRAME    (40*1024)
+#define FAKE_DEVICE_RUN_ON_MIN   16       // Fewest bytes of a frame started after an EOI
+
+// Faults fake_device_inject_fault() can put on a packet
+#define FAKE_FAULT_NONE          0
+#define FAKE_FAULT_DROP          1        // Never sent
+#define FAKE_FAULT_BAD_HEADER    2        // Sent without the AA BB magic
+
+typedef struct fake_device_counters {
+    unsigned int connects;              // Connect commands received
+    unsigned long long packets_sent;
+    unsigned int frames_started;
+    unsigned int transfers_cancelled;
+    unsigned int transfers_timed_out;
+    unsigned int packets_faulted;       // Packets an injected fault was applied to
+} fake_device_counters_t;
+
+/**
+ * Set the time between packets (default 200 us)
+ *
+ * @param interval_us Microseconds; 0 = as fast as transfers are submitted
+ */
+void fake_device_set_packet_interval(unsigned int interval_us);
+
+/**
+ * Start each frame in the packet that ends the previous one (default off)
+ *
+ * A frame whose last packet has fewer than FAKE_DEVICE_RUN_ON_MIN bytes
+ * to spare still starts in a packet of its own.
+ *
+ * @param run_on true to pack frames back to back
+ */
+void fake_device_set_run_on(bool run_on);
+
+/**
+ * Put a fault on a packet still to be sent, replacing any pending one
+ *
+ * @param fault FAKE_FAULT_*
+ * @param frame Frame number
+ * @param packet Packet index within the frame, or -1 for every packet
+ */
+void fake_device_inject_fault(int fault, unsigned int frame, int packet);
+
+/**
+ * Generate frame n
+ *
+ * @param index Frame number
+ * @param out Receives the frame, at least FAKE_DEVICE_MAX_FRAME bytes
+ * @return Frame size in bytes
+ */
+size_t fake_device_frame(unsigned int index, unsigned char *out);
+
+/**
+ * Read the frame number back from a generated frame
+ *
+ * @param jpeg Frame data
+ * @param size Frame size
+ * @return Frame number, or -1 if the data is too short
+ */
+long fake_device_frame_index(const unsigned char *jpeg, size_t size);
+
+/**
+ * Record when each of the next packets finished on the bus
+ *
+ * @param times_ns Receives CLOCK_MONOTONIC nanoseconds per packet, in the
+ *                 order the packets are sent (NULL with count 0 stops)
+ * @param count Entries in times_ns
+ */
+void fake_device_trace_completions(unsigned long long *times_ns, size_t count);
+
+// Snapshot of the device's counters
+void fake_device_get_counters(fake_device_counters_t *counters);
+
+#endif // FAKE_DEVICE_H
@@ -0,0 +1,584 @@
+/**
+ * Fake libusb-1.0 - Implementation
+ *
+ * See libusb.h and fake_device.h for an overview.
+ *
+ * Submitted transfers wait in one queue, served in order like a bulk
+ * endpoint. The device spends one packet interval of bus time on each
+ * packet, starting when both it and the head transfer are ready, so the
+ * bus idles only while no transfer is queued; packets that finished while
+ * nobody was handling events complete back to back, as they would from a
+ * host controller's queue. Event handling completes at most one transfer
+ * per call and runs its callback on the calling thread, as libusb does;
+ * it sleeps on a condition variable until the next packet is due, a
+ * transfer times out, a transfer is cancelled or the caller's timeout
+ * expires.
+ *
+ * Licensed under GPLv3 (same as original)
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "libusb.h"
+#include "fake_device.h"
+#include "packet_header.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define EP_IN  0x81
+#define EP_OUT 0x01
+#define CAMERA_INTERFACE 1
+
+struct libusb_context {
+    int unused;
+};
+
+struct libusb_device {
+    struct libusb_device_descriptor desc;
+    uint8_t bus;
+    uint8_t address;
+};
+
+struct libusb_device_handle {
+    libusb_device *dev;
+};
+
+// Public transfer plus the queue state behind it
+typedef struct fake_transfer {
+    struct libusb_transfer pub;
+    struct fake_transfer *next;
+    unsigned long long submitted_ns;
+    unsigned long long expires_ns;  // Device-side timeout, 0 = none
+    bool queued;
+    bool cancelled;
+} fake_transfer_t;
+
+static libusb_device g_device = {
+    { 18, 1, 0x0200, 0, 0, 0, 64, FAKE_DEVICE_VENDOR_ID, FAKE_DEVICE_PRODUCT_ID, 0x0100, 0, 0, 0, 1 },
+    FAKE_DEVICE_BUS, FAKE_DEVICE_ADDRESS
+};
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_changed;
+static pthread_once_t g_once = PTHREAD_ONCE_INIT;
+
+// Device state, under g_lock
+static bool g_claimed;
+static int g_alt_setting;
+static bool g_streaming;
+static unsigned int g_interval_us = 200;
+static bool g_run_on;
+static int g_fault;                         // FAKE_FAULT_*, on the packet below
+static unsigned int g_fault_frame;
+static int g_fault_packet;
+static unsigned long long g_bus_ns;         // When the last packet finished
+static fake_transfer_t *g_head;
+static fake_transfer_t *g_tail;
+static fake_device_counters_t g_counters;
+static unsigned long long *g_trace;
+static size_t g_trace_count;
+static size_t g_trace_next;
+static bool g_interrupted;                  // libusb_interrupt_event_handler, not yet seen
+
+// Frame being sent
+static unsigned char g_frame[FAKE_DEVICE_MAX_FRAME];
+static size_t g_frame_size;
+static size_t g_frame_offset;
+static unsigned int g_frame_index;
+static unsigned short g_packet_index;
+
+static void init_once(void) {
+    pthread_condattr_t attr;
+
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&g_changed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+static unsigned long long now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+size_t fake_device_frame(unsigned int index, unsigned char *out) {
+    size_t size = 6000 + (size_t)(index * 7919u % 30000u);
+
+    out[0] = 0xFF;
+    out[1] = 0xD8;
+    for (int i = 0; i < 4; i++) {
+        out[2 + i] = (unsigned char)((index >> (7 * i)) & 0x7F);
+    }
+    for (size_t i = 6; i < size - 2; i++) {
+        out[i] = (unsigned char)((index * 31u + i) % 251u);
+    }
+    out[size - 2] = 0xFF;
+    out[size - 1] = 0xD9;
+    return size;
+}
+
+long fake_device_frame_index(const unsigned char *jpeg, size_t size) {
+    long index = 0;
+
+    if (size < 6) {
+        return -1;
+    }
+    for (int i = 0; i < 4; i++) {
+        index |= (long)(jpeg[2 + i] & 0x7F) << (7 * i);
+    }
+    return index;
+}
+
+void fake_device_set_packet_interval(unsigned int interval_us) {
+    pthread_mutex_lock(&g_lock);
+    g_interval_us = interval_us;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void fake_device_set_run_on(bool run_on) {
+    pthread_mutex_lock(&g_lock);
+    g_run_on = run_on;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void fake_device_inject_fault(int fault, unsigned int frame, int packet) {
+    pthread_mutex_lock(&g_lock);
+    g_fault = fault;
+    g_fault_frame = frame;
+    g_fault_packet = packet;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void fake_device_trace_completions(unsigned long long *times_ns, size_t count) {
+    pthread_mutex_lock(&g_lock);
+    g_trace = times_ns;
+    g_trace_count = count;
+    g_trace_next = 0;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void fake_device_get_counters(fake_device_counters_t *counters) {
+    pthread_mutex_lock(&g_lock);
+    *counters = g_counters;
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void start_frame(void) {
+    g_frame_index = g_counters.frames_started++;
+    g_frame_size = fake_device_frame(g_frame_index, g_frame);
+    g_frame_offset = 0;
+    g_packet_index = 0;
+}
+
+// Fill a transfer with the next packet; returns the frame the header
+// belongs to (under g_lock)
+static unsigned int fill_packet(struct libusb_transfer *transfer, packet_header_t *out) {
+    packet_header_t header;
+    size_t limit = (size_t)transfer->length - PACKET_HEADER_SIZE;
+    size_t payload;
+    unsigned int frame;
+
+    if (limit > FAKE_DEVICE_PAYLOAD) {
+        limit = FAKE_DEVICE_PAYLOAD;
+    }
+    if (g_frame_offset == g_frame_size) {
+        start_frame();
+    }
+
+    frame = g_frame_index;
+    header.type = PACKET_TYPE_VIDEO;
+    header.camera = 0;
+    header.frame_id = (unsigned char)frame;
+    header.flags = 0;
+    header.packet_index = g_packet_index++;
+
+    payload = g_frame_size - g_frame_offset;
+    if (payload > limit) {
+        payload = limit;
+    }
+    memcpy(transfer->buffer + PACKET_HEADER_SIZE, g_frame + g_frame_offset, payload);
+    g_frame_offset += payload;
+
+    // Run-on: the next frame follows the EOI, if enough room is left
+    // for its SOI to be recognized
+    if (g_run_on && g_frame_offset == g_frame_size && limit - payload >= FAKE_DEVICE_RUN_ON_MIN) {
+        size_t first = limit - payload;
+
+        start_frame();
+        g_packet_index = 1;
+        memcpy(transfer->buffer + PACKET_HEADER_SIZE + payload, g_frame, first);
+        g_frame_offset = first;
+        payload += first;
+    }
+
+    header.payload_length = (unsigned short)payload;
+    packet_header_encode(transfer->buffer, &header);
+    transfer->actual_length = (int)(PACKET_HEADER_SIZE + payload);
+    *out = header;
+    return frame;
+}
+
+// The injected fault applies to this packet of frame `frame` (under g_lock)
+static bool fault_hits(int fault, unsigned int frame, const packet_header_t *header) {
+    if (g_fault != fault || g_fault_frame != frame) {
+        return false;
+    }
+    if (g_fault_packet < 0) {
+        // Whole frame: cleared once its last packet is out
+        if (g_frame_index != frame || g_frame_offset == g_frame_size) {
+            g_fault = FAKE_FAULT_NONE;
+        }
+        g_counters.packets_faulted++;
+        return true;
+    }
+    if (header->packet_index != (unsigned short)g_fault_packet) {
+        return false;
+    }
+    g_fault = FAKE_FAULT_NONE;
+    g_counters.packets_faulted++;
+    return true;
+}
+
+// Fill a transfer with the next packet, skipping dropped ones (under g_lock)
+static void next_packet(struct libusb_transfer *transfer) {
+    packet_header_t header;
+    unsigned int frame;
+
+    do {
+        frame = fill_packet(transfer, &header);
+    } while (fault_hits(FAKE_FAULT_DROP, frame, &header));
+
+    if (fault_hits(FAKE_FAULT_BAD_HEADER, frame, &header)) {
+        transfer->buffer[0] = 0x00;
+    }
+    g_counters.packets_sent++;
+}
+
+// Take the next transfer that is ready to complete, or work out when one
+// will be (under g_lock)
+static fake_transfer_t* take_ready(unsigned long long now, unsigned long long *wake_ns) {
+    fake_transfer_t *ready = NULL;
+    fake_transfer_t **link;
+
+    // Cancellations complete first, wherever they are in the queue
+    for (link = &g_head; *link; link = &(*link)->next) {
+        if ((*link)->cancelled) {
+            ready = *link;
+            ready->pub.status = LIBUSB_TRANSFER_CANCELLED;
+            ready->pub.actual_length = 0;
+            g_counters.transfers_cancelled++;
+            break;
+        }
+    }
+
+    if (!ready && g_head) {
+        unsigned long long start = g_head->submitted_ns > g_bus_ns ? g_head->submitted_ns : g_bus_ns;
+        unsigned long long due = start + g_interval_us * 1000ULL;
+
+        link = &g_head;
+        if (g_streaming && g_head->pub.endpoint == EP_IN && now >= due) {
+            ready = g_head;
+            ready->pub.status = LIBUSB_TRANSFER_COMPLETED;
+            next_packet(&ready->pub);
+            g_bus_ns = due;
+            if (g_trace_next < g_trace_count) {
+                g_trace[g_trace_next++] = due;
+            }
+        } else if (g_head->expires_ns && now >= g_head->expires_ns) {
+            ready = g_head;
+            ready->pub.status = LIBUSB_TRANSFER_TIMED_OUT;
+            ready->pub.actual_length = 0;
+            g_counters.transfers_timed_out++;
+        } else {
+            if (g_streaming && due < *wake_ns) {
+                *wake_ns = due;
+            }
+            if (g_head->expires_ns && g_head->expires_ns < *wake_ns) {
+                *wake_ns = g_head->expires_ns;
+            }
+        }
+    }
+
+    if (ready) {
+        *link = ready->next;
+        if (g_tail == ready) {
+            g_tail = NULL;
+            for (fake_transfer_t *t = g_head; t; t = t->next) {
+                g_tail = t;
+            }
+        }
+        ready->next = NULL;
+        ready->queued = false;
+    }
+
+    return ready;
+}
+
+static int handle_events_until(unsigned long long deadline_ns, int *completed) {
+    pthread_once(&g_once, init_once);
+
+    while (true) {
+        unsigned long long now = now_ns();
+        unsigned long long wake_ns = deadline_ns;
+        fake_transfer_t *ready;
+
+        pthread_mutex_lock(&g_lock);
+        if ((completed && *completed) || g_interrupted) {
+            g_interrupted = false;
+            pthread_mutex_unlock(&g_lock);
+            return LIBUSB_SUCCESS;
+        }
+
+        ready = take_ready(now, &wake_ns);
+        if (ready) {
+            pthread_mutex_unlock(&g_lock);
+            ready->pub.callback(&ready->pub);
+            return LIBUSB_SUCCESS;
+        }
+
+        if (now >= deadline_ns) {
+            pthread_mutex_unlock(&g_lock);
+            return LIBUSB_SUCCESS;
+        }
+
+        if (wake_ns == ~0ULL) {
+            pthread_cond_wait(&g_changed, &g_lock);
+        } else {
+            struct timespec ts;
+            ts.tv_sec = (time_t)(wake_ns / 1000000000ULL);
+            ts.tv_nsec = (long)(wake_ns % 1000000000ULL);
+            pthread_cond_timedwait(&g_changed, &g_lock, &ts);
+        }
+        pthread_mutex_unlock(&g_lock);
+    }
+}
+
+int libusb_init(libusb_context **ctx) {
+    pthread_once(&g_once, init_once);
+    *ctx = (libusb_context*)calloc(1, sizeof(libusb_context));
+    return *ctx ? LIBUSB_SUCCESS : LIBUSB_ERROR_NO_MEM;
+}
+
+void libusb_exit(libusb_context *ctx) {
+    free(ctx);
+}
+
+const char* libusb_error_name(int errcode) {
+    switch (errcode) {
+        case LIBUSB_SUCCESS:              return "LIBUSB_SUCCESS";
+        case LIBUSB_ERROR_IO:             return "LIBUSB_ERROR_IO";
+        case LIBUSB_ERROR_INVALID_PARAM:  return "LIBUSB_ERROR_INVALID_PARAM";
+        case LIBUSB_ERROR_ACCESS:         return "LIBUSB_ERROR_ACCESS";
+        case LIBUSB_ERROR_NO_DEVICE:      return "LIBUSB_ERROR_NO_DEVICE";
+        case LIBUSB_ERROR_NOT_FOUND:      return "LIBUSB_ERROR_NOT_FOUND";
+        case LIBUSB_ERROR_BUSY:           return "LIBUSB_ERROR_BUSY";
+        case LIBUSB_ERROR_TIMEOUT:        return "LIBUSB_ERROR_TIMEOUT";
+        case LIBUSB_ERROR_PIPE:           return "LIBUSB_ERROR_PIPE";
+        case LIBUSB_ERROR_INTERRUPTED:    return "LIBUSB_ERROR_INTERRUPTED";
+        case LIBUSB_ERROR_NO_MEM:         return "LIBUSB_ERROR_NO_MEM";
+        case LIBUSB_ERROR_NOT_SUPPORTED:  return "LIBUSB_ERROR_NOT_SUPPORTED";
+        default:                          return "LIBUSB_ERROR_OTHER";
+    }
+}
+
+ssize_t libusb_get_device_list(libusb_context *ctx, libusb_device ***list) {
+    (void)ctx;
+    *list = (libusb_device**)calloc(2, sizeof(libusb_device*));
+    if (!*list) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    (*list)[0] = &g_device;
+    return 1;
+}
+
+void libusb_free_device_list(libusb_device **list, int unref_devices) {
+    (void)unref_devices;
+    free(list);
+}
+
+int libusb_get_device_descriptor(libusb_device *dev, struct libusb_device_descriptor *desc) {
+    *desc = dev->desc;
+    return LIBUSB_SUCCESS;
+}
+
+uint8_t libusb_get_bus_number(libusb_device *dev) {
+    return dev->bus;
+}
+
+uint8_t libusb_get_device_address(libusb_device *dev) {
+    return dev->address;
+}
+
+int libusb_open(libusb_device *dev, libusb_device_handle **dev_handle) {
+    *dev_handle = (libusb_device_handle*)calloc(1, sizeof(libusb_device_handle));
+    if (!*dev_handle) {
+        return LIBUSB_ERROR_NO_MEM;
+    }
+    (*dev_handle)->dev = dev;
+    return LIBUSB_SUCCESS;
+}
+
+void libusb_close(libusb_device_handle *dev_handle) {
+    free(dev_handle);
+}
+
+int libusb_set_auto_detach_kernel_driver(libusb_device_handle *dev_handle, int enable) {
+    (void)dev_handle;
+    (void)enable;
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_claim_interface(libusb_device_handle *dev_handle, int interface_number) {
+    int rc = LIBUSB_SUCCESS;
+
+    (void)dev_handle;
+    pthread_mutex_lock(&g_lock);
+    if (interface_number != CAMERA_INTERFACE) {
+        rc = LIBUSB_ERROR_NOT_FOUND;
+    } else if (g_claimed) {
+        rc = LIBUSB_ERROR_BUSY;
+    } else {
+        g_claimed = true;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+int libusb_release_interface(libusb_device_handle *dev_handle, int interface_number) {
+    (void)dev_handle;
+    (void)interface_number;
+    pthread_mutex_lock(&g_lock);
+    g_claimed = false;
+    g_streaming = false;
+    pthread_mutex_unlock(&g_lock);
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_set_interface_alt_setting(libusb_device_handle *dev_handle, int interface_number,
+                                     int alternate_setting) {
+    (void)dev_handle;
+    if (interface_number != CAMERA_INTERFACE || alternate_setting < 0 || alternate_setting > 1) {
+        return LIBUSB_ERROR_NOT_FOUND;
+    }
+
+    // Leaving the streaming setting stops the camera
+    pthread_mutex_lock(&g_lock);
+    g_alt_setting = alternate_setting;
+    if (alternate_setting == 0) {
+        g_streaming = false;
+    }
+    pthread_mutex_unlock(&g_lock);
+    return LIBUSB_SUCCESS;
+}
+
+int libusb_clear_halt(libusb_device_handle *dev_handle, unsigned char endpoint) {
+    (void)dev_handle;
+    return endpoint == EP_IN || endpoint == EP_OUT ? LIBUSB_SUCCESS : LIBUSB_ERROR_NOT_FOUND;
+}
+
+int libusb_bulk_transfer(libusb_device_handle *dev_handle, unsigned char endpoint,
+                         unsigned char *data, int length, int *actual_length,
+                         unsigned int timeout) {
+    (void)dev_handle;
+    (void)timeout;
+
+    // Only commands are sent synchronously
+    if (endpoint != EP_OUT) {
+        return LIBUSB_ERROR_NOT_SUPPORTED;
+    }
+
+    pthread_once(&g_once, init_once);
+    pthread_mutex_lock(&g_lock);
+    if (length >= 3 && data[0] == 0xbb && data[1] == 0xaa && data[2] == 0x05) {
+        g_counters.connects++;
+        if (g_alt_setting == 1 && !g_streaming) {
+            g_streaming = true;
+            g_bus_ns = now_ns();
+            pthread_cond_broadcast(&g_changed);
+        }
+    }
+    pthread_mutex_unlock(&g_lock);
+
+    *actual_length = length;
+    return LIBUSB_SUCCESS;
+}
+
+struct libusb_transfer* libusb_alloc_transfer(int iso_packets) {
+    fake_transfer_t *t = (fake_transfer_t*)calloc(1, sizeof(fake_transfer_t));
+    (void)iso_packets;
+    return t ? &t->pub : NULL;
+}
+
+void libusb_free_transfer(struct libusb_transfer *transfer) {
+    free(transfer);
+}
+
+int libusb_submit_transfer(struct libusb_transfer *transfer) {
+    fake_transfer_t *t = (fake_transfer_t*)transfer;
+    int rc = LIBUSB_SUCCESS;
+
+    pthread_once(&g_once, init_once);
+    pthread_mutex_lock(&g_lock);
+    if (t->queued) {
+        rc = LIBUSB_ERROR_BUSY;
+    } else if (!g_claimed) {
+        rc = LIBUSB_ERROR_NO_DEVICE;
+    } else {
+        t->queued = true;
+        t->cancelled = false;
+        t->next = NULL;
+        t->submitted_ns = now_ns();
+        t->expires_ns = transfer->timeout ? t->submitted_ns + transfer->timeout * 1000000ULL : 0;
+        if (g_tail) {
+            g_tail->next = t;
+        } else {
+            g_head = t;
+        }
+        g_tail = t;
+        pthread_cond_broadcast(&g_changed);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+int libusb_cancel_transfer(struct libusb_transfer *transfer) {
+    fake_transfer_t *t = (fake_transfer_t*)transfer;
+    int rc = LIBUSB_ERROR_NOT_FOUND;
+
+    pthread_once(&g_once, init_once);
+    pthread_mutex_lock(&g_lock);
+    if (t->queued && !t->cancelled) {
+        t->cancelled = true;
+        rc = LIBUSB_SUCCESS;
+        pthread_cond_broadcast(&g_changed);
+    }
+    pthread_mutex_unlock(&g_lock);
+    return rc;
+}
+
+int libusb_handle_events_timeout_completed(libusb_context *ctx, struct timeval *tv, int *completed) {
+    (void)ctx;
+    return handle_events_until(now_ns() + (unsigned long long)tv->tv_sec * 1000000000ULL +
+                               (unsigned long long)tv->tv_usec * 1000ULL, completed);
+}
+
+int libusb_handle_events_completed(libusb_context *ctx, int *completed) {
+    (void)ctx;
+    return handle_events_until(~0ULL, completed);
+}
+
+void libusb_interrupt_event_handler(libusb_context *ctx) {
+    (void)ctx;
+    pthread_once(&g_once, init_once);
+    pthread_mutex_lock(&g_lock);
+    g_interrupted = true;
+    pthread_cond_broadcast(&g_changed);
+    pthread_mutex_unlock(&g_lock);
+}
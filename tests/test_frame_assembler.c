@@ -0,0 +1,175 @@
+/**
+ * Frame Assembler Test
+ *
+ * Checks the tail fast path of frame_assembler.c as a stream switches from
+ * frames that end at packet tails to frames run on behind the previous
+ * EOI, in the same packet:
+ *
+ *   - packet-aligned frames whose headers vouch for every packet turn the
+ *     fast path on, and are then completed from the packet tail without
+ *     scanning the payload
+ *   - once frames run on, the packets are no longer vouched for, every
+ *     frame is found where it ends mid-packet and comes out exactly as
+ *     sent - never glued to the frames after it - and the fast path is
+ *     switched off
+ *   - back on packet-aligned frames, the fast path is earned again
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "frame_assembler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PAYLOAD_SIZE    1024
+#define MAX_FRAME       (16*1024)
+#define ALIGNED_FRAMES  (FRAME_FAST_PATH_AFTER + 8)
+#define RUN_ON_FRAMES   24
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    frame_assembler_t fa;
+    unsigned char buffers[2][MAX_FRAME];
+    int slot;
+    unsigned int next_frame;    // Frame expected next
+    unsigned int unscanned;     // Frames completed without a payload scan
+} receiver_t;
+
+// Frame n: SOI, n, filler without 0xFF bytes, EOI; sizes are not
+// multiples of the payload, so frames end anywhere in a packet
+static size_t make_frame(unsigned int n, unsigned char *out) {
+    size_t size = 3000 + (size_t)(n * 733u % 4000u);
+
+    out[0] = 0xFF;
+    out[1] = 0xD8;
+    out[2] = (unsigned char)n;
+    out[3] = (unsigned char)(n >> 8);
+    for (size_t i = 4; i < size - 2; i++) {
+        out[i] = (unsigned char)((n * 31u + i) % 251u);
+    }
+    out[size - 2] = 0xFF;
+    out[size - 1] = 0xD9;
+    return size;
+}
+
+static void check_frame(receiver_t *r, const unsigned char *data, size_t size) {
+    unsigned char expected[MAX_FRAME];
+    unsigned int n = size >= 4 ? (unsigned int)(data[2] | (data[3] << 8)) : ~0u;
+    size_t expected_size = make_frame(r->next_frame, expected);
+
+    CHECK(n == r->next_frame, "frame %u delivered, expected %u", n, r->next_frame);
+    CHECK(size == expected_size && memcmp(data, expected, size) == 0,
+          "frame %u: %zu bytes delivered, %zu sent%s", r->next_frame, size, expected_size,
+          size > expected_size ? " (glued to the next frame)" : "");
+    r->next_frame++;
+}
+
+// Push one packet the way process_data does, checking what completes
+static void push(receiver_t *r, const unsigned char *payload, size_t size, bool vouched) {
+    unsigned char packet[FRAME_PACKET_HEADER_SIZE + PAYLOAD_SIZE];
+    int result;
+
+    memset(packet, 0, FRAME_PACKET_HEADER_SIZE);
+    packet[0] = 0xaa;
+    packet[1] = 0xbb;
+    packet[2] = 0x07;
+    memcpy(packet + FRAME_PACKET_HEADER_SIZE, payload, size);
+
+    r->fa.header_vouched = vouched;
+    result = frame_assembler_push(&r->fa, packet, FRAME_PACKET_HEADER_SIZE + size);
+    CHECK(result == FRAME_ASM_NEED_MORE || result == FRAME_ASM_COMPLETE,
+          "push returned %d before frame %u", result, r->next_frame);
+
+    while (result == FRAME_ASM_COMPLETE) {
+        // The tail check leaves the scan position untouched
+        if (r->fa.scan_pos == 0) {
+            r->unscanned++;
+        }
+        check_frame(r, r->fa.data, r->fa.complete_size);
+        r->slot ^= 1;
+        frame_assembler_handoff(&r->fa, r->buffers[r->slot], MAX_FRAME);
+        result = frame_assembler_scan(&r->fa);
+    }
+}
+
+// Frames [first, first + count), each starting a packet of its own
+static void send_aligned(receiver_t *r, unsigned int first, unsigned int count) {
+    unsigned char frame[MAX_FRAME];
+
+    for (unsigned int n = first; n < first + count; n++) {
+        size_t size = make_frame(n, frame);
+
+        for (size_t off = 0; off < size; off += PAYLOAD_SIZE) {
+            push(r, frame + off, size - off < PAYLOAD_SIZE ? size - off : PAYLOAD_SIZE, true);
+        }
+    }
+}
+
+// Frames [first, first + count) back to back, cut into full packets; the
+// headers of such a stream no longer line up with the frames, so nothing
+// is vouched for. The last packet is padded with zeros
+static void send_run_on(receiver_t *r, unsigned int first, unsigned int count) {
+    static unsigned char stream[RUN_ON_FRAMES * MAX_FRAME];
+    size_t length = 0;
+
+    for (unsigned int n = first; n < first + count; n++) {
+        length += make_frame(n, stream + length);
+    }
+    memset(stream + length, 0, PAYLOAD_SIZE);
+    for (size_t off = 0; off < length; off += PAYLOAD_SIZE) {
+        push(r, stream + off, PAYLOAD_SIZE, false);
+    }
+}
+
+static void test_aligned_to_run_on(void) {
+    static receiver_t r;
+    unsigned int fallbacks;
+
+    memset(&r, 0, sizeof(r));
+    frame_assembler_init(&r.fa, MAX_FRAME);
+    r.fa.fast_path_enabled = true;
+    frame_assembler_attach(&r.fa, r.buffers[0], MAX_FRAME);
+
+    send_aligned(&r, 0, ALIGNED_FRAMES);
+    CHECK(r.next_frame == ALIGNED_FRAMES, "%u of %u aligned frames delivered", r.next_frame, ALIGNED_FRAMES);
+    CHECK(r.fa.fast_path, "fast path off after %u frames ending at packet tails", ALIGNED_FRAMES);
+    CHECK(r.unscanned >= ALIGNED_FRAMES - FRAME_FAST_PATH_AFTER,
+          "only %u vouched frames completed from the packet tail", r.unscanned);
+
+    fallbacks = r.fa.fast_path_fallbacks;
+    r.unscanned = 0;
+    send_run_on(&r, ALIGNED_FRAMES, RUN_ON_FRAMES);
+    CHECK(r.next_frame == ALIGNED_FRAMES + RUN_ON_FRAMES, "%u of %u run-on frames delivered",
+          r.next_frame - ALIGNED_FRAMES, RUN_ON_FRAMES);
+    CHECK(!r.fa.fast_path && r.fa.fast_path_fallbacks > fallbacks,
+          "fast path still on with frames ending mid-packet");
+    CHECK(r.unscanned == 0, "%u run-on frames completed without a scan", r.unscanned);
+    CHECK(r.fa.restarts == 0, "%u frames abandoned", r.fa.restarts);
+
+    send_aligned(&r, ALIGNED_FRAMES + RUN_ON_FRAMES, ALIGNED_FRAMES);
+    CHECK(r.next_frame == 2 * ALIGNED_FRAMES + RUN_ON_FRAMES, "%u of %u aligned frames delivered after run-on",
+          r.next_frame - ALIGNED_FRAMES - RUN_ON_FRAMES, ALIGNED_FRAMES);
+    CHECK(r.fa.fast_path, "fast path not earned again after run-on");
+}
+
+int main(void) {
+    test_aligned_to_run_on();
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
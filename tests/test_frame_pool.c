@@ -0,0 +1,150 @@
+/**
+ * Frame Pool Test
+ *
+ * Checks frame_pool.c, the size-class pool behind the frame ring slots:
+ *
+ *   - sizes round up to the right class, and sizes past
+ *     FRAME_POOL_MAX_SIZE are refused
+ *   - a buffer given back is handed out again for any size of its class,
+ *     and never for another class
+ *   - once a working set of buffers across the classes has been through
+ *     the pool, cycling it again takes nothing from the heap
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "frame_pool.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define WORKING_SET  12     // Buffers held at once, like CAMERA_DEFAULT_FRAME_BUFFERS
+#define CYCLES       50
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+// Sizes spread over every class, including the exact class boundaries
+static size_t working_size(int cycle, int i) {
+    int c = (cycle + i) % FRAME_POOL_CLASSES;
+    size_t class_size = (size_t)FRAME_POOL_MIN_SIZE << c;
+    size_t below = c == 0 ? 1 : class_size / 2 + 1;
+
+    return i % 2 ? class_size : below + (size_t)(cycle * 7919) % (class_size - below);
+}
+
+static void test_class_sizes(void) {
+    CHECK(frame_pool_class_size(1) == FRAME_POOL_MIN_SIZE, "1 byte -> %zu", frame_pool_class_size(1));
+    CHECK(frame_pool_class_size(FRAME_POOL_MIN_SIZE) == FRAME_POOL_MIN_SIZE, "min size -> %zu",
+          frame_pool_class_size(FRAME_POOL_MIN_SIZE));
+    CHECK(frame_pool_class_size(FRAME_POOL_MIN_SIZE + 1) == 2 * FRAME_POOL_MIN_SIZE, "min size + 1 -> %zu",
+          frame_pool_class_size(FRAME_POOL_MIN_SIZE + 1));
+    CHECK(frame_pool_class_size(FRAME_POOL_MAX_SIZE) == FRAME_POOL_MAX_SIZE, "max size -> %zu",
+          frame_pool_class_size(FRAME_POOL_MAX_SIZE));
+    CHECK(frame_pool_class_size(FRAME_POOL_MAX_SIZE + 1) == 0, "max size + 1 -> %zu",
+          frame_pool_class_size(FRAME_POOL_MAX_SIZE + 1));
+}
+
+static void test_reuse(void) {
+    frame_pool_t pool;
+    size_t capacity = 0, other_capacity = 0;
+    unsigned char *buffer, *again, *other;
+
+    frame_pool_init(&pool);
+
+    CHECK(frame_pool_get(&pool, FRAME_POOL_MAX_SIZE + 1, &capacity) == NULL,
+          "buffer larger than FRAME_POOL_MAX_SIZE handed out");
+
+    buffer = frame_pool_get(&pool, 100 * 1024, &capacity);
+    CHECK(buffer && capacity == 128 * 1024, "100 KiB got capacity %zu", capacity);
+    memset(buffer, 0xAB, capacity);
+    frame_pool_put(&pool, buffer, capacity);
+    CHECK(pool.free_count[1] == 1, "%u buffers free in the 128 KiB class", pool.free_count[1]);
+
+    // Another size of the same class gets the same buffer back
+    again = frame_pool_get(&pool, 65 * 1024, &capacity);
+    CHECK(again == buffer && capacity == 128 * 1024, "128 KiB class buffer not reused");
+    CHECK(pool.allocations == 1, "%u allocations, expected 1", pool.allocations);
+
+    // Neighbouring classes do not take it
+    frame_pool_put(&pool, again, capacity);
+    other = frame_pool_get(&pool, 64 * 1024, &other_capacity);
+    CHECK(other != buffer && other_capacity == 64 * 1024, "64 KiB request got the 128 KiB buffer");
+    frame_pool_put(&pool, other, other_capacity);
+    other = frame_pool_get(&pool, 129 * 1024, &other_capacity);
+    CHECK(other != buffer && other_capacity == 256 * 1024, "256 KiB request got the 128 KiB buffer");
+    frame_pool_put(&pool, other, other_capacity);
+
+    CHECK(pool.allocations == 3, "%u allocations, expected 3", pool.allocations);
+    CHECK(pool.allocated_bytes == (64 + 128 + 256) * 1024ULL, "%llu bytes allocated",
+          pool.allocated_bytes);
+    frame_pool_free(&pool);
+}
+
+static void test_warm_up(void) {
+    frame_pool_t pool;
+    unsigned char *held[WORKING_SET];
+    size_t capacity[WORKING_SET];
+    unsigned int warm_allocations = 0;
+    unsigned long long warm_bytes = 0;
+    unsigned int free_total = 0;
+
+    frame_pool_init(&pool);
+
+    for (int cycle = 0; cycle < CYCLES; cycle++) {
+        for (int i = 0; i < WORKING_SET; i++) {
+            size_t size = working_size(cycle % FRAME_POOL_CLASSES, i);
+
+            held[i] = frame_pool_get(&pool, size, &capacity[i]);
+            CHECK(held[i] && capacity[i] == frame_pool_class_size(size),
+                  "cycle %d: %zu bytes got capacity %zu", cycle, size, capacity[i]);
+            if (held[i]) {
+                held[i][0] = held[i][size - 1] = (unsigned char)cycle;
+            }
+        }
+        for (int i = 0; i < WORKING_SET; i++) {
+            frame_pool_put(&pool, held[i], capacity[i]);
+        }
+
+        // The sizes repeat every FRAME_POOL_CLASSES cycles
+        if (cycle == FRAME_POOL_CLASSES - 1) {
+            warm_allocations = pool.allocations;
+            warm_bytes = pool.allocated_bytes;
+        }
+    }
+
+    CHECK(warm_allocations > 0 && pool.allocations == warm_allocations,
+          "%u allocations after warm-up, %u during it", pool.allocations - warm_allocations,
+          warm_allocations);
+    CHECK(pool.allocated_bytes == warm_bytes, "%llu bytes allocated after warm-up",
+          pool.allocated_bytes - warm_bytes);
+
+    for (int c = 0; c < FRAME_POOL_CLASSES; c++) {
+        free_total += pool.free_count[c];
+    }
+    CHECK(free_total == pool.allocations, "%u buffers free, %u allocated", free_total, pool.allocations);
+
+    frame_pool_free(&pool);
+    CHECK(pool.free_count[0] == 0 && pool.free_list[0] == NULL, "free lists not emptied");
+}
+
+int main(void) {
+    test_class_sizes();
+    test_reuse();
+    test_warm_up();
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,434 @@
+/**
+ * libusb Stack Test
+ *
+ * Runs the camera library - platform layer, libusb transport, read
+ * pipeline, frame assembly and the public API - against the simulated
+ * camera of the fake libusb (tests/fake_libusb), without hardware:
+ *
+ *   - camera_enumerate finds the camera at its bus:address path
+ *   - frames read with camera_read_frame_ex are exactly the frames the
+ *     camera generated, in order, with consistent metadata
+ *   - an inline frame callback runs on the read thread under the name
+ *     set with camera_set_thread_attr
+ *   - a frame callback, decode threads and reading exclude each other
+ *   - with every frame buffer full, only the completed frame is dropped:
+ *     the next frame, already begun in the same packet, arrives intact
+ *   - a packet missing from a frame, a whole frame missing where the
+ *     header frame id wraps, and a packet with a bad header are counted
+ *     as lost, and the frame they hit is abandoned, not delivered
+ *   - stopping cancels the outstanding transfers, and streaming restarts
+ *
+ * Exits 0 if every check passes.
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "useeplus_camera.h"
+#include "fake_device.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define FRAMES_TO_READ   120
+#define CALLBACK_FRAMES  20
+#define OVERFLOW_FRAMES  40
+#define FAULT_LEAD       40     // Frames before a fault, enough to trust the headers
+#define READ_TIMEOUT_MS  2000
+#define READ_THREAD_NAME "cam-test-read"
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+    int frames;
+    int wrong_thread;
+    int bad_frames;
+    char name[32];
+} callback_state_t;
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static void on_frame(const camera_frame_view_t *frame, void *user_data) {
+    callback_state_t *state = (callback_state_t*)user_data;
+    static unsigned char expected[FAKE_DEVICE_MAX_FRAME];
+    long index = fake_device_frame_index(frame->data, frame->size);
+    char name[32] = "";
+
+    pthread_getname_np(pthread_self(), name, sizeof(name));
+
+    pthread_mutex_lock(&state->lock);
+    if (strcmp(name, READ_THREAD_NAME) != 0) {
+        state->wrong_thread++;
+        snprintf(state->name, sizeof(state->name), "%s", name);
+    }
+    if (index < 0 || fake_device_frame((unsigned int)index, expected) != frame->size ||
+        memcmp(expected, frame->data, frame->size) != 0) {
+        state->bad_frames++;
+    }
+    if (++state->frames == CALLBACK_FRAMES) {
+        pthread_cond_signal(&state->done);
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+static void test_enumerate(void) {
+    camera_device_info_t devices[4];
+    char expected[32];
+    int count = camera_enumerate(devices, 4);
+
+    snprintf(expected, sizeof(expected), "%03d:%03d", FAKE_DEVICE_BUS, FAKE_DEVICE_ADDRESS);
+    CHECK(count == 1, "camera_enumerate returned %d, expected 1", count);
+    if (count == 1) {
+        CHECK(strcmp(devices[0].device_path, expected) == 0, "device path '%s', expected '%s'",
+              devices[0].device_path, expected);
+        CHECK(devices[0].vendor_id == FAKE_DEVICE_VENDOR_ID && devices[0].product_id == FAKE_DEVICE_PRODUCT_ID,
+              "device id %04x:%04x", devices[0].vendor_id, devices[0].product_id);
+    }
+}
+
+static void test_read_frames(CAMERA_HANDLE camera) {
+    static unsigned char buffer[FAKE_DEVICE_MAX_FRAME];
+    static unsigned char expected[FAKE_DEVICE_MAX_FRAME];
+    camera_frame_info_t info;
+    camera_stats_ex_t stats;
+    long last_index = -1;
+    unsigned int last_sequence = 0;
+    int ret;
+
+    ret = camera_start_streaming(camera);
+    CHECK(ret == CAMERA_SUCCESS, "camera_start_streaming: %s", camera_get_error());
+    if (ret != CAMERA_SUCCESS) {
+        return;
+    }
+
+    for (int i = 0; i < FRAMES_TO_READ; i++) {
+        size_t size = 0;
+
+        ret = camera_read_frame_ex(camera, buffer, sizeof(buffer), &size, &info, READ_TIMEOUT_MS);
+        if (ret != CAMERA_SUCCESS) {
+            CHECK(false, "frame %d: camera_read_frame_ex: %s", i, camera_get_error());
+            break;
+        }
+
+        // Frames may be dropped if this thread falls behind, but never
+        // reordered, merged or corrupted
+        long index = fake_device_frame_index(buffer, size);
+        CHECK(index > last_index, "frame %d: camera frame %ld after %ld", i, index, last_index);
+        CHECK(index >= 0 && fake_device_frame((unsigned int)index, expected) == size &&
+              memcmp(expected, buffer, size) == 0,
+              "frame %d: content differs from camera frame %ld (%zu bytes)", i, index, size);
+        CHECK(i == 0 || info.sequence > last_sequence, "frame %d: sequence %u after %u",
+              i, info.sequence, last_sequence);
+        CHECK(info.header[0] == 0xAA && info.header[1] == 0xBB && info.header[2] == 0x07,
+              "frame %d: header %02x %02x %02x", i, info.header[0], info.header[1], info.header[2]);
+        CHECK(info.packet_count == (unsigned int)((size + FAKE_DEVICE_PAYLOAD - 1) / FAKE_DEVICE_PAYLOAD),
+              "frame %d: %u packets for %zu bytes", i, info.packet_count, size);
+        CHECK(info.first_packet_us <= info.completed_us && info.completed_us <= info.delivered_us,
+              "frame %d: times %llu / %llu / %llu", i, info.first_packet_us, info.completed_us,
+              info.delivered_us);
+
+        last_index = index;
+        last_sequence = info.sequence;
+    }
+
+    memset(&stats, 0, sizeof(stats));
+    stats.size = sizeof(stats);
+    ret = camera_get_stats_ex(camera, &stats);
+    CHECK(ret == CAMERA_SUCCESS, "camera_get_stats_ex: %s", camera_get_error());
+    CHECK(stats.frames_captured >= FRAMES_TO_READ, "%u frames captured", stats.frames_captured);
+    CHECK(stats.bad_header_packets == 0, "%u bad headers", stats.bad_header_packets);
+    CHECK(stats.packets_lost == 0 && stats.frames_lost == 0, "%u packets / %u frames lost",
+          stats.packets_lost, stats.frames_lost);
+    CHECK(stats.read_errors == 0, "%u read errors", stats.read_errors);
+
+    camera_stop_streaming(camera);
+    CHECK(!camera_is_streaming(camera), "still streaming after camera_stop_streaming");
+}
+
+static void test_callback_thread(CAMERA_HANDLE camera) {
+    callback_state_t state;
+    camera_thread_attr_t attr;
+    struct timespec deadline;
+    int ret;
+
+    memset(&state, 0, sizeof(state));
+    pthread_mutex_init(&state.lock, NULL);
+    pthread_cond_init(&state.done, NULL);
+
+    memset(&attr, 0, sizeof(attr));
+    attr.priority = CAMERA_PRIORITY_NORMAL;
+    snprintf(attr.name, sizeof(attr.name), "%s", READ_THREAD_NAME);
+    ret = camera_set_thread_attr(camera, CAMERA_THREAD_READ, &attr);
+    CHECK(ret == CAMERA_SUCCESS, "camera_set_thread_attr: %s", camera_get_error());
+
+    ret = camera_set_frame_callback(camera, on_frame, &state, CAMERA_CALLBACK_INLINE);
+    CHECK(ret == CAMERA_SUCCESS, "camera_set_frame_callback: %s", camera_get_error());
+
+    ret = camera_start_streaming(camera);
+    CHECK(ret == CAMERA_SUCCESS, "camera_start_streaming (callback): %s", camera_get_error());
+    if (ret == CAMERA_SUCCESS) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 5;
+
+        pthread_mutex_lock(&state.lock);
+        while (state.frames < CALLBACK_FRAMES &&
+               pthread_cond_timedwait(&state.done, &state.lock, &deadline) == 0) {
+        }
+        pthread_mutex_unlock(&state.lock);
+
+        camera_stop_streaming(camera);
+    }
+
+    CHECK(state.frames >= CALLBACK_FRAMES, "%d callbacks, expected %d", state.frames, CALLBACK_FRAMES);
+    CHECK(state.wrong_thread == 0, "%d callbacks on thread '%s', expected '%s'",
+          state.wrong_thread, state.name, READ_THREAD_NAME);
+    CHECK(state.bad_frames == 0, "%d callbacks with wrong frame data", state.bad_frames);
+
+    camera_set_frame_callback(camera, NULL, NULL, CAMERA_CALLBACK_INLINE);
+    pthread_cond_destroy(&state.done);
+    pthread_mutex_destroy(&state.lock);
+}
+
+static camera_stats_ex_t get_stats(CAMERA_HANDLE camera) {
+    camera_stats_ex_t stats;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.size = sizeof(stats);
+    camera_get_stats_ex(camera, &stats);
+    return stats;
+}
+
+static void test_overflow(CAMERA_HANDLE camera) {
+    static unsigned char buffer[FAKE_DEVICE_MAX_FRAME];
+    static unsigned char expected[FAKE_DEVICE_MAX_FRAME];
+    camera_stats_ex_t before, after;
+    long last_index = -1;
+    long missing = 0;
+    int ret;
+
+    // Two buffers: the write slot and one queued frame, so a reader that
+    // falls behind overflows the ring on the next frame
+    fake_device_set_run_on(true);
+    camera_set_frame_buffers(camera, 2);
+    ret = camera_start_streaming(camera);
+    CHECK(ret == CAMERA_SUCCESS, "camera_start_streaming (overflow): %s", camera_get_error());
+    if (ret != CAMERA_SUCCESS) {
+        fake_device_set_run_on(false);
+        return;
+    }
+    before = get_stats(camera);
+
+    for (int i = 0; i < OVERFLOW_FRAMES; i++) {
+        size_t size = 0;
+
+        if (i % 4 == 0) {
+            sleep_ms(10);
+        }
+        ret = camera_read_frame(camera, buffer, sizeof(buffer), &size, READ_TIMEOUT_MS);
+        if (ret != CAMERA_SUCCESS) {
+            CHECK(false, "overflow frame %d: camera_read_frame: %s", i, camera_get_error());
+            break;
+        }
+
+        long index = fake_device_frame_index(buffer, size);
+        CHECK(index >= 0 && fake_device_frame((unsigned int)index, expected) == size &&
+              memcmp(expected, buffer, size) == 0,
+              "overflow frame %d: content differs from camera frame %ld (%zu bytes)", i, index, size);
+        if (last_index >= 0 && index > last_index) {
+            missing += index - last_index - 1;
+        }
+        last_index = index;
+    }
+
+    after = get_stats(camera);
+    camera_stop_streaming(camera);
+    fake_device_set_run_on(false);
+    camera_set_frame_buffers(camera, CAMERA_DEFAULT_FRAME_BUFFERS);
+
+    // Each overflow costs exactly the frame dropped
+    CHECK(after.frames_overflow > before.frames_overflow, "no frames overflowed");
+    CHECK(missing <= (long)(after.frames_overflow - before.frames_overflow),
+          "%ld frames missing, only %u overflowed", missing, after.frames_overflow - before.frames_overflow);
+    CHECK(after.frames_discarded == before.frames_discarded, "%u partial frames discarded",
+          after.frames_discarded - before.frames_discarded);
+}
+
+// Stream until two frames past `frame`, with the fault injected on it.
+// Returns whether the frame was delivered; *delta receives the counters
+// the stream added
+static bool stream_with_fault(CAMERA_HANDLE camera, const char *name, int fault,
+                              unsigned int frame, int packet, camera_stats_ex_t *delta) {
+    static unsigned char buffer[FAKE_DEVICE_MAX_FRAME];
+    static unsigned char expected[FAKE_DEVICE_MAX_FRAME];
+    camera_stats_ex_t before, after;
+    fake_device_counters_t device_before, device_after;
+    bool delivered = false;
+    long index = -1;
+    int ret;
+
+    memset(delta, 0, sizeof(*delta));
+    fake_device_get_counters(&device_before);
+    fake_device_inject_fault(fault, frame, packet);
+    ret = camera_start_streaming(camera);
+    CHECK(ret == CAMERA_SUCCESS, "%s: camera_start_streaming: %s", name, camera_get_error());
+    if (ret != CAMERA_SUCCESS) {
+        fake_device_inject_fault(FAKE_FAULT_NONE, 0, 0);
+        return false;
+    }
+    before = get_stats(camera);
+
+    while (index < (long)frame + 2) {
+        size_t size = 0;
+
+        ret = camera_read_frame(camera, buffer, sizeof(buffer), &size, READ_TIMEOUT_MS);
+        if (ret != CAMERA_SUCCESS) {
+            CHECK(false, "%s: camera_read_frame: %s", name, camera_get_error());
+            break;
+        }
+        index = fake_device_frame_index(buffer, size);
+        CHECK(index >= 0 && fake_device_frame((unsigned int)index, expected) == size &&
+              memcmp(expected, buffer, size) == 0,
+              "%s: content differs from camera frame %ld (%zu bytes)", name, index, size);
+        delivered |= index == (long)frame;
+    }
+
+    after = get_stats(camera);
+    camera_stop_streaming(camera);
+    fake_device_get_counters(&device_after);
+    fake_device_inject_fault(FAKE_FAULT_NONE, 0, 0);
+
+    CHECK(device_after.packets_faulted > device_before.packets_faulted,
+          "%s: the fault on frame %u never fired", name, frame);
+    CHECK(after.frames_overflow == before.frames_overflow, "%s: %u frames overflowed", name,
+          after.frames_overflow - before.frames_overflow);
+    delta->bad_header_packets = after.bad_header_packets - before.bad_header_packets;
+    delta->frames_discarded = after.frames_discarded - before.frames_discarded;
+    delta->packets_lost = after.packets_lost - before.packets_lost;
+    delta->frames_lost = after.frames_lost - before.frames_lost;
+    return delivered;
+}
+
+// First frame from `first` on with at least four packets, so that its
+// packet 2 is neither missing nor the last one (a lost last packet is
+// indistinguishable from the next frame starting early)
+static unsigned int frame_with_four_packets(unsigned int first) {
+    static unsigned char frame[FAKE_DEVICE_MAX_FRAME];
+
+    while (fake_device_frame(first, frame) <= 3 * FAKE_DEVICE_PAYLOAD) {
+        first++;
+    }
+    return first;
+}
+
+static void test_packet_loss(CAMERA_HANDLE camera) {
+    fake_device_counters_t counters;
+    camera_stats_ex_t delta;
+    unsigned int frame;
+
+    // A packet missing mid-frame: counted, and its frame abandoned
+    fake_device_get_counters(&counters);
+    frame = frame_with_four_packets(counters.frames_started + FAULT_LEAD);
+    CHECK(!stream_with_fault(camera, "gap", FAKE_FAULT_DROP, frame, 2, &delta),
+          "gap: frame %u delivered without its packet 2", frame);
+    CHECK(delta.packets_lost == 1 && delta.frames_lost == 0, "gap: %u packets / %u frames lost",
+          delta.packets_lost, delta.frames_lost);
+    CHECK(delta.frames_discarded == 1, "gap: %u frames discarded", delta.frames_discarded);
+
+    // A whole frame missing just before the 8-bit frame id wraps
+    fake_device_get_counters(&counters);
+    frame = (counters.frames_started + FAULT_LEAD) | 0xFF;
+    CHECK(!stream_with_fault(camera, "wrap", FAKE_FAULT_DROP, frame, -1, &delta),
+          "wrap: frame %u delivered though never sent", frame);
+    CHECK(delta.packets_lost == 0 && delta.frames_lost == 1, "wrap: %u packets / %u frames lost",
+          delta.packets_lost, delta.frames_lost);
+    CHECK(delta.frames_discarded == 0, "wrap: %u frames discarded", delta.frames_discarded);
+
+    // A bad header: the packet is rejected, so its frame has a gap
+    fake_device_get_counters(&counters);
+    frame = frame_with_four_packets(counters.frames_started + FAULT_LEAD);
+    CHECK(!stream_with_fault(camera, "bad header", FAKE_FAULT_BAD_HEADER, frame, 2, &delta),
+          "bad header: frame %u delivered without its packet 2", frame);
+    CHECK(delta.bad_header_packets == 1, "bad header: %u bad headers", delta.bad_header_packets);
+    CHECK(delta.packets_lost == 1 && delta.frames_lost == 0, "bad header: %u packets / %u frames lost",
+          delta.packets_lost, delta.frames_lost);
+    CHECK(delta.frames_discarded == 1, "bad header: %u frames discarded", delta.frames_discarded);
+}
+
+static void test_consumers_exclusive(CAMERA_HANDLE camera) {
+    static unsigned char buffer[FAKE_DEVICE_MAX_FRAME];
+    callback_state_t state;
+    size_t size = 0;
+    int ret;
+
+    memset(&state, 0, sizeof(state));
+    ret = camera_set_frame_callback(camera, on_frame, &state, CAMERA_CALLBACK_INLINE);
+    CHECK(ret == CAMERA_SUCCESS, "camera_set_frame_callback: %s", camera_get_error());
+    ret = camera_set_decode_threads(camera, 2, CAMERA_PIXEL_RGBA, CAMERA_DECODE_BLOCK);
+    CHECK(ret != CAMERA_SUCCESS, "camera_set_decode_threads accepted with a callback set");
+    camera_set_frame_callback(camera, NULL, NULL, CAMERA_CALLBACK_INLINE);
+
+    // Without libjpeg-turbo there are no decode threads to exclude
+    if (camera_set_decode_threads(camera, 2, CAMERA_PIXEL_RGBA, CAMERA_DECODE_BLOCK) != CAMERA_SUCCESS) {
+        return;
+    }
+    ret = camera_set_frame_callback(camera, on_frame, &state, CAMERA_CALLBACK_INLINE);
+    CHECK(ret == CAMERA_ERROR_INVALID_PARAM, "camera_set_frame_callback accepted with decode threads");
+    ret = camera_read_frame(camera, buffer, sizeof(buffer), &size, 0);
+    CHECK(ret == CAMERA_ERROR_INVALID_PARAM, "camera_read_frame returned %d with decode threads", ret);
+
+    ret = camera_set_decode_threads(camera, 0, CAMERA_PIXEL_RGBA, CAMERA_DECODE_BLOCK);
+    CHECK(ret == CAMERA_SUCCESS, "camera_set_decode_threads (0): %s", camera_get_error());
+}
+
+int main(void) {
+    fake_device_counters_t counters;
+    CAMERA_HANDLE camera;
+
+    test_enumerate();
+
+    camera = camera_open();
+    CHECK(camera != NULL, "camera_open: %s", camera_get_error());
+    if (!camera) {
+        return 1;
+    }
+
+    test_read_frames(camera);
+    test_packet_loss(camera);
+    test_callback_thread(camera);
+    test_consumers_exclusive(camera);
+    test_overflow(camera);
+
+    // Restart after every stop, then close while streaming
+    CHECK(camera_start_streaming(camera) == CAMERA_SUCCESS, "restart: %s", camera_get_error());
+    camera_close(camera);
+
+    fake_device_get_counters(&counters);
+    CHECK(counters.connects == 7, "%u connect commands, expected 7", counters.connects);
+    CHECK(counters.transfers_cancelled > 0, "no transfers cancelled by stop");
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed (%llu packets, %u frames sent)\n",
+           counters.packets_sent, counters.frames_started);
+    return 0;
+}
@@ -0,0 +1,155 @@
+/**
+ * Marker Scanner Test
+ *
+ * Checks every marker_find_ff kernel this CPU supports (scalar, SSE2,
+ * AVX2) against a plain byte loop:
+ *
+ *   - a single 0xFF at every position of buffers 0 to 200 bytes long,
+ *     at every alignment within 64 bytes, so each length of the vector
+ *     kernels' scalar and 16-byte tails is covered
+ *   - 0xFF as the very last byte, in a buffer allocated to end there
+ *     (run under AddressSanitizer, an over-read shows up as a fault)
+ *   - 0xFF just past the searched length, which must not be found
+ *   - pseudo-random buffers with sparse 0xFF bytes
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "marker_scan.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LENGTH     200
+#define MAX_ALIGN      64
+#define RANDOM_ROUNDS  2000
+#define MAX_REPORTED   20
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+static size_t reference_find_ff(const unsigned char *data, size_t length) {
+    size_t i = 0;
+    while (i < length && data[i] != 0xFF) {
+        i++;
+    }
+    return i;
+}
+
+// Search data[0, length) with the selected kernel and the reference
+static void compare(const char *kernel, const unsigned char *data, size_t length, const char *what) {
+    size_t expected = reference_find_ff(data, length);
+    size_t found = marker_find_ff(data, length);
+
+    // A broken kernel fails most of the millions of searches; report the first few
+    if (g_failures < MAX_REPORTED) {
+        CHECK(found == expected, "%s, %s: length %zu at offset %u, found %zu, expected %zu",
+              kernel, what, length, (unsigned int)((uintptr_t)data % MAX_ALIGN), found, expected);
+    } else if (found != expected) {
+        g_failures++;
+    }
+}
+
+static void test_positions(const char *kernel) {
+    static unsigned char buffer[MAX_ALIGN + MAX_LENGTH + 1];
+
+    for (size_t align = 0; align < MAX_ALIGN; align++) {
+        unsigned char *data = buffer + align;
+
+        for (size_t length = 0; length <= MAX_LENGTH; length++) {
+            memset(buffer, 0x00, sizeof(buffer));
+
+            // Not there, with 0xFF right after the end
+            data[length] = 0xFF;
+            compare(kernel, data, length, "0xFF past the end");
+            data[length] = 0x00;
+
+            for (size_t pos = 0; pos < length; pos++) {
+                data[pos] = 0xFF;
+                compare(kernel, data, length, "single 0xFF");
+                data[pos] = 0xFE;   // Near miss for the rest of the loop
+            }
+        }
+    }
+}
+
+static void test_buffer_end(const char *kernel) {
+    for (size_t length = 1; length <= MAX_LENGTH; length++) {
+        unsigned char *data = (unsigned char*)malloc(length);
+
+        if (!data) {
+            CHECK(0, "out of memory");
+            return;
+        }
+        memset(data, 0xD8, length);
+        data[length - 1] = 0xFF;
+        compare(kernel, data, length, "0xFF as the last byte");
+        data[length - 1] = 0xD9;
+        compare(kernel, data, length, "no 0xFF up to the end");
+        free(data);
+    }
+}
+
+static void test_random(const char *kernel) {
+    static unsigned char buffer[4096 + MAX_ALIGN];
+    unsigned int seed = 12345;
+
+    for (int round = 0; round < RANDOM_ROUNDS; round++) {
+        size_t align, length;
+
+        for (size_t i = 0; i < sizeof(buffer); i++) {
+            seed = seed * 1103515245u + 12345u;
+            buffer[i] = (unsigned char)(seed >> 16);
+            if (buffer[i] == 0xFF && (seed >> 8) % 64) {
+                buffer[i] = 0xFE;   // Keep 0xFF sparse, so long runs are searched
+            }
+        }
+        seed = seed * 1103515245u + 12345u;
+        align = (seed >> 16) % MAX_ALIGN;
+        length = (seed >> 4) % (sizeof(buffer) - MAX_ALIGN);
+        compare(kernel, buffer + align, length, "random");
+    }
+}
+
+int main(void) {
+    static const struct {
+        int kernel;
+        const char *name;
+    } kernels[] = {
+        { MARKER_SCAN_SCALAR, "scalar" },
+        { MARKER_SCAN_SSE2, "sse2" },
+        { MARKER_SCAN_AVX2, "avx2" },
+    };
+
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++) {
+        if (!marker_scan_supported(kernels[k].kernel)) {
+            printf("%s: not supported on this CPU, skipped\n", kernels[k].name);
+            continue;
+        }
+        CHECK(marker_scan_select(kernels[k].kernel) == kernels[k].kernel, "%s not selected",
+              kernels[k].name);
+        CHECK(strcmp(marker_scan_kernel_name(), kernels[k].name) == 0, "kernel name '%s', expected '%s'",
+              marker_scan_kernel_name(), kernels[k].name);
+
+        test_positions(kernels[k].name);
+        test_buffer_end(kernels[k].name);
+        test_random(kernels[k].name);
+    }
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,284 @@
+/**
+ * Packet Header Test
+ *
+ * Checks packet_header.c on synthetic packet streams laid out the way the
+ * header is inferred to work (frame id per frame, packet index from 0,
+ * SOI on packet 0 only):
+ *
+ *   - headers survive an encode/decode round trip; short packets and
+ *     packets without the AA BB magic are rejected
+ *   - the checker trusts the layout only after PACKET_STREAM_TRUST_AFTER
+ *     consistent packets, and a gap before that restarts the count
+ *   - once trusted, a frame start is reported where the frame id changes,
+ *     including where it wraps from 255 to 0
+ *   - a missing packet and whole missing frames, also across the wrap,
+ *     are counted as lost
+ *   - a wrong payload length, an SOI off packet 0 or a repeated packet
+ *     index drops the trust and counts a resync; trust is earned again
+ *   - packet_stream_resync drops the trust but keeps the counters
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "packet_header.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define PACKETS_PER_FRAME  5
+#define PAYLOAD_SIZE       4084
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+// Synthetic camera: frame n has PACKETS_PER_FRAME packets, frame id n % 256
+typedef struct {
+    packet_stream_t ps;
+    unsigned int frame;
+    unsigned short index;
+} stream_t;
+
+static void stream_start(stream_t *s, unsigned int frame) {
+    packet_stream_init(&s->ps);
+    s->frame = frame;
+    s->index = 0;
+}
+
+// Check a packet through an encoded header, the way the driver sees it
+static int check_packet(stream_t *s, unsigned int frame, unsigned short index,
+                        size_t payload_size, bool soi) {
+    unsigned char packet[PACKET_HEADER_SIZE];
+    packet_header_t header;
+
+    memset(&header, 0, sizeof(header));
+    header.type = PACKET_TYPE_VIDEO;
+    header.frame_id = (unsigned char)frame;
+    header.packet_index = index;
+    header.payload_length = (unsigned short)PAYLOAD_SIZE;
+    packet_header_encode(packet, &header);
+    if (!packet_header_decode(packet, sizeof(packet), &header)) {
+        return -1;
+    }
+    return packet_stream_check(&s->ps, &header, payload_size, soi);
+}
+
+// Next packet of the stream, as sent
+static int send_next(stream_t *s) {
+    int result = check_packet(s, s->frame, s->index, PAYLOAD_SIZE, s->index == 0);
+
+    if (++s->index == PACKETS_PER_FRAME) {
+        s->index = 0;
+        s->frame++;
+    }
+    return result;
+}
+
+// Send until the checker trusts the layout; returns the packets it took
+static int send_until_trusted(stream_t *s) {
+    int sent = 0;
+
+    while (!s->ps.trusted && sent < 10 * PACKET_STREAM_TRUST_AFTER) {
+        send_next(s);
+        sent++;
+    }
+    return sent;
+}
+
+static void skip_packets(stream_t *s, int count) {
+    for (int i = 0; i < count; i++) {
+        if (++s->index == PACKETS_PER_FRAME) {
+            s->index = 0;
+            s->frame++;
+        }
+    }
+}
+
+static void test_decode(void) {
+    unsigned char packet[PACKET_HEADER_SIZE];
+    packet_header_t in, out;
+
+    memset(&in, 0, sizeof(in));
+    in.type = PACKET_TYPE_VIDEO;
+    in.camera = 1;
+    in.frame_id = 0xC3;
+    in.flags = 0x5A;
+    in.packet_index = 0x1234;
+    in.payload_length = 0x0FF4;
+    packet_header_encode(packet, &in);
+
+    CHECK(packet[0] == 0xAA && packet[1] == 0xBB && packet[2] == 0x07, "magic %02x %02x %02x",
+          packet[0], packet[1], packet[2]);
+    CHECK(packet[6] == 0x34 && packet[7] == 0x12, "packet index not little-endian");
+    CHECK(packet_header_decode(packet, sizeof(packet), &out), "encoded header rejected");
+    CHECK(out.type == in.type && out.camera == in.camera && out.frame_id == in.frame_id &&
+          out.flags == in.flags && out.packet_index == in.packet_index &&
+          out.payload_length == in.payload_length, "round trip changed the header");
+
+    CHECK(!packet_header_decode(packet, PACKET_HEADER_SIZE - 1, &out), "short packet accepted");
+    packet[1] = 0xBC;
+    CHECK(!packet_header_decode(packet, sizeof(packet), &out), "packet without AA BB accepted");
+}
+
+static void test_trust(void) {
+    stream_t s;
+    int result;
+
+    stream_start(&s, 0);
+    for (int i = 1; i < PACKET_STREAM_TRUST_AFTER; i++) {
+        result = send_next(&s);
+        CHECK(result == PACKET_UNTRUSTED && !s.ps.trusted, "packet %d: result %d before trust", i, result);
+    }
+    send_next(&s);
+    CHECK(s.ps.trusted, "not trusted after %d consistent packets", PACKET_STREAM_TRUST_AFTER);
+
+    // Packets are now placed by their headers
+    while (s.index != 0) {
+        CHECK(send_next(&s) == PACKET_IN_SEQUENCE, "frame %u packet %u not in sequence", s.frame, s.index);
+    }
+    CHECK(send_next(&s) == PACKET_FRAME_START, "no frame start at frame %u", s.frame);
+    CHECK(send_next(&s) == PACKET_IN_SEQUENCE, "frame %u packet 1 not in sequence", s.frame);
+    CHECK(s.ps.lost_packets == 0 && s.ps.lost_frames == 0 && s.ps.resyncs == 0,
+          "clean stream counted %u packets / %u frames lost, %u resyncs",
+          s.ps.lost_packets, s.ps.lost_frames, s.ps.resyncs);
+
+    // A gap before the layout is trusted starts the count over; the
+    // packet after the gap does not count
+    stream_start(&s, 0);
+    for (int i = 0; i < PACKET_STREAM_TRUST_AFTER / 2 || s.index != 1; i++) {
+        send_next(&s);
+    }
+    skip_packets(&s, 1);
+    CHECK(send_until_trusted(&s) == PACKET_STREAM_TRUST_AFTER + 1, "gap before trust did not restart the count");
+    CHECK(s.ps.lost_packets == 0, "gap before trust counted as %u lost packets", s.ps.lost_packets);
+}
+
+static void test_loss(void) {
+    stream_t s;
+    int result;
+
+    stream_start(&s, 0);
+    send_until_trusted(&s);
+    while (s.index != 0) {
+        send_next(&s);
+    }
+
+    // Packet 2 of a frame missing
+    send_next(&s);
+    send_next(&s);
+    skip_packets(&s, 1);
+    result = send_next(&s);
+    CHECK(result == PACKET_LOST && s.ps.lost_packets == 1 && s.ps.lost_frames == 0,
+          "missing packet: result %d, %u packets / %u frames lost", result, s.ps.lost_packets,
+          s.ps.lost_frames);
+    CHECK(s.ps.trusted, "trust dropped by a counted loss");
+
+    // Two whole frames missing
+    while (s.index != 0) {
+        send_next(&s);
+    }
+    skip_packets(&s, 2 * PACKETS_PER_FRAME);
+    result = send_next(&s);
+    CHECK(result == PACKET_LOST && s.ps.lost_packets == 1 && s.ps.lost_frames == 2,
+          "missing frames: result %d, %u packets / %u frames lost", result, s.ps.lost_packets,
+          s.ps.lost_frames);
+}
+
+static void test_wrap(void) {
+    stream_t s;
+    int starts = 0;
+
+    // Trusted well before the frame id wraps from 255 to 0
+    stream_start(&s, 256 - 2 * PACKET_STREAM_TRUST_AFTER / PACKETS_PER_FRAME);
+    send_until_trusted(&s);
+    while (s.frame < 258) {
+        int result = send_next(&s);
+
+        CHECK(result == PACKET_FRAME_START || result == PACKET_IN_SEQUENCE,
+              "frame %u packet %u: result %d", s.frame, s.index, result);
+        starts += result == PACKET_FRAME_START;
+    }
+    CHECK(s.ps.lost_frames == 0 && s.ps.lost_packets == 0, "wrap counted %u frames / %u packets lost",
+          s.ps.lost_frames, s.ps.lost_packets);
+    CHECK(starts > 0, "no frame starts across the wrap");
+
+    // Frame 255 missing: frame id 254 is followed by 0
+    stream_start(&s, 254 - 2 * PACKET_STREAM_TRUST_AFTER / PACKETS_PER_FRAME);
+    send_until_trusted(&s);
+    while (s.frame < 255) {
+        send_next(&s);
+    }
+    skip_packets(&s, PACKETS_PER_FRAME);
+    CHECK(send_next(&s) == PACKET_LOST && s.ps.lost_frames == 1 && s.ps.lost_packets == 0,
+          "frame 255 missing: %u frames / %u packets lost", s.ps.lost_frames, s.ps.lost_packets);
+}
+
+static void test_resync(void) {
+    stream_t s;
+    int result;
+
+    stream_start(&s, 0);
+    send_until_trusted(&s);
+
+    // Payload length disagrees with the header
+    result = check_packet(&s, s.frame, s.index, PAYLOAD_SIZE - 1, s.index == 0);
+    CHECK(result == PACKET_UNTRUSTED && !s.ps.trusted && s.ps.resyncs == 1,
+          "wrong length: result %d, trusted %d, %u resyncs", result, s.ps.trusted, s.ps.resyncs);
+    skip_packets(&s, 1);
+    CHECK(send_until_trusted(&s) == PACKET_STREAM_TRUST_AFTER, "trust not earned again after a resync");
+
+    // SOI on a packet other than 0
+    while (s.index == 0) {
+        send_next(&s);
+    }
+    result = check_packet(&s, s.frame, s.index, PAYLOAD_SIZE, true);
+    CHECK(result == PACKET_UNTRUSTED && !s.ps.trusted && s.ps.resyncs == 2,
+          "SOI off packet 0: result %d, %u resyncs", result, s.ps.resyncs);
+    skip_packets(&s, 1);
+    send_until_trusted(&s);
+
+    // The same packet twice
+    while (s.index == 0) {
+        send_next(&s);
+    }
+    result = check_packet(&s, s.frame, (unsigned short)(s.index - 1), PAYLOAD_SIZE, false);
+    CHECK(result == PACKET_UNTRUSTED && !s.ps.trusted && s.ps.resyncs == 3,
+          "repeated packet: result %d, %u resyncs", result, s.ps.resyncs);
+    CHECK(s.ps.lost_packets == 0 && s.ps.lost_frames == 0, "resyncs counted %u packets / %u frames lost",
+          s.ps.lost_packets, s.ps.lost_frames);
+
+    // A new stream starts untrusted, with the counters kept
+    send_until_trusted(&s);
+    while (s.index != 1) {
+        send_next(&s);
+    }
+    skip_packets(&s, 1);
+    send_next(&s);
+    packet_stream_resync(&s.ps);
+    CHECK(!s.ps.trusted && s.ps.lost_packets == 1 && s.ps.resyncs == 3,
+          "after resync: trusted %d, %u packets lost, %u resyncs", s.ps.trusted, s.ps.lost_packets,
+          s.ps.resyncs);
+    CHECK(send_until_trusted(&s) == PACKET_STREAM_TRUST_AFTER, "trust not earned again on a new stream");
+}
+
+int main(void) {
+    test_decode();
+    test_trust();
+    test_loss();
+    test_wrap();
+    test_resync();
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,216 @@
+/**
+ * Parallel Decoder Test
+ *
+ * Runs parallel_decoder.c - the decode threads behind
+ * camera_set_decode_threads - with one worker and two slots on frames
+ * encoded here with libjpeg, and checks what PARALLEL_DECODER_DROP_OLDEST
+ * does when the ring is full, for each state of the oldest frame:
+ *
+ *   - decoded and not taken: dropped at once, its decode wasted
+ *   - being decoded: submit waits for the decode to finish, then drops it
+ *   - held by the consumer: the new frame is dropped instead
+ *
+ * In every case the frames that are delivered arrive in submit order.
+ *
+ * Exits 0 if every check passes.
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "parallel_decoder.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#define SMALL_SIZE      64
+#define LARGE_SIZE      4096    // Decodes for well over SETTLE_MS
+#define SETTLE_MS       50      // Lets the worker pick up a submitted frame
+#define WAIT_MS         5000
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+} jpeg_frame_t;
+
+static jpeg_frame_t g_small, g_large;
+
+// Encode a size x size gradient
+static int encode(int size, jpeg_frame_t *frame) {
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    unsigned char *row = (unsigned char*)malloc((size_t)size * 3);
+    unsigned char *out = NULL;
+    unsigned long out_size = 0;
+
+    if (!row) {
+        return 0;
+    }
+
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    jpeg_mem_dest(&cinfo, &out, &out_size);
+    cinfo.image_width = (JDIMENSION)size;
+    cinfo.image_height = (JDIMENSION)size;
+    cinfo.input_components = 3;
+    cinfo.in_color_space = JCS_RGB;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, 90, TRUE);
+    jpeg_start_compress(&cinfo, TRUE);
+    while (cinfo.next_scanline < cinfo.image_height) {
+        unsigned int y = cinfo.next_scanline;
+        for (int x = 0; x < size; x++) {
+            row[x * 3] = (unsigned char)(x * 7 + y);
+            row[x * 3 + 1] = (unsigned char)(x ^ y);
+            row[x * 3 + 2] = (unsigned char)(y * 3 - x);
+        }
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    free(row);
+
+    frame->data = (unsigned char*)malloc(out_size);
+    if (!frame->data) {
+        free(out);
+        return 0;
+    }
+    memcpy(frame->data, out, out_size);
+    frame->size = out_size;
+    free(out);
+    return 1;
+}
+
+static int submit(parallel_decoder_t *pd, const jpeg_frame_t *frame, unsigned int sequence) {
+    return parallel_decoder_submit(pd, frame->data, frame->size, sequence, platform_ticks(),
+                                   PLATFORM_WAIT_INFINITE);
+}
+
+static parallel_decoder_stats_t get_stats(parallel_decoder_t *pd) {
+    parallel_decoder_stats_t stats;
+    parallel_decoder_get_stats(pd, &stats);
+    return stats;
+}
+
+// Wait until the worker has decoded `count` frames in total
+static int wait_decoded(parallel_decoder_t *pd, unsigned long long count) {
+    for (int i = 0; i < WAIT_MS && get_stats(pd).decoded < count; i++) {
+        platform_sleep_ms(1);
+    }
+    return get_stats(pd).decoded >= count;
+}
+
+// Take the next frame, check its sequence and release it
+static void expect_next(parallel_decoder_t *pd, unsigned int sequence, const char *test) {
+    decode_result_t result;
+    int ret = parallel_decoder_next(pd, WAIT_MS, &result);
+
+    CHECK(ret == PARALLEL_DECODER_OK, "%s: next returned %d, expected frame %u", test, ret, sequence);
+    if (ret == PARALLEL_DECODER_OK) {
+        CHECK(result.sequence == sequence, "%s: frame %u, expected %u", test, result.sequence, sequence);
+        parallel_decoder_release(pd, result.data);
+    }
+}
+
+static void test_drop_decoded(void) {
+    parallel_decoder_t *pd = parallel_decoder_create(1, 2, FRAME_DECODER_I420, PARALLEL_DECODER_DROP_OLDEST);
+    int ret;
+
+    CHECK(submit(pd, &g_small, 0) == PARALLEL_DECODER_OK, "decoded: submit 0");
+    CHECK(submit(pd, &g_small, 1) == PARALLEL_DECODER_OK, "decoded: submit 1");
+    CHECK(wait_decoded(pd, 2), "decoded: frames 0 and 1 not decoded");
+
+    // Frame 0 is decoded but not taken: it goes, though decoding it was work
+    ret = submit(pd, &g_small, 2);
+    CHECK(ret == PARALLEL_DECODER_OK, "decoded: submit 2 returned %d", ret);
+    CHECK(get_stats(pd).dropped == 1, "decoded: %u dropped, expected 1", get_stats(pd).dropped);
+
+    expect_next(pd, 1, "decoded");
+    expect_next(pd, 2, "decoded");
+    CHECK(get_stats(pd).decoded == 3, "decoded: %llu decodes, expected 3", get_stats(pd).decoded);
+    parallel_decoder_destroy(pd);
+}
+
+static void test_drop_decoding(void) {
+    parallel_decoder_t *pd = parallel_decoder_create(1, 2, FRAME_DECODER_I420, PARALLEL_DECODER_DROP_OLDEST);
+    int ret;
+
+    CHECK(submit(pd, &g_large, 0) == PARALLEL_DECODER_OK, "decoding: submit 0");
+    platform_sleep_ms(SETTLE_MS);
+    CHECK(get_stats(pd).decoded == 0, "decoding: large frame decoded within %d ms", SETTLE_MS);
+    CHECK(submit(pd, &g_small, 1) == PARALLEL_DECODER_OK, "decoding: submit 1");
+
+    // Frame 0 is mid-decode: submit returns only once it has finished,
+    // and then drops it
+    ret = submit(pd, &g_small, 2);
+    CHECK(ret == PARALLEL_DECODER_OK, "decoding: submit 2 returned %d", ret);
+    CHECK(get_stats(pd).decoded >= 1, "decoding: submit returned before frame 0 was decoded");
+    CHECK(get_stats(pd).dropped == 1, "decoding: %u dropped, expected 1", get_stats(pd).dropped);
+
+    expect_next(pd, 1, "decoding");
+    expect_next(pd, 2, "decoding");
+    parallel_decoder_destroy(pd);
+}
+
+static void test_drop_held(void) {
+    parallel_decoder_t *pd = parallel_decoder_create(1, 2, FRAME_DECODER_I420, PARALLEL_DECODER_DROP_OLDEST);
+    decode_result_t held;
+    int taken, ret;
+
+    CHECK(submit(pd, &g_small, 0) == PARALLEL_DECODER_OK, "held: submit 0");
+    CHECK(submit(pd, &g_small, 1) == PARALLEL_DECODER_OK, "held: submit 1");
+    taken = parallel_decoder_next(pd, WAIT_MS, &held);
+    CHECK(taken == PARALLEL_DECODER_OK && held.sequence == 0, "held: next returned %d", taken);
+    CHECK(wait_decoded(pd, 2), "held: frame 1 not decoded");
+
+    // Frame 0's slot is held, so the new frame is the one dropped
+    ret = submit(pd, &g_small, 2);
+    CHECK(ret == PARALLEL_DECODER_DROPPED, "held: submit 2 returned %d, expected dropped", ret);
+    CHECK(get_stats(pd).dropped == 1, "held: %u dropped, expected 1", get_stats(pd).dropped);
+
+    expect_next(pd, 1, "held");
+    if (taken == PARALLEL_DECODER_OK) {
+        parallel_decoder_release(pd, held.data);
+    }
+
+    // Released, the slot takes the next frame
+    CHECK(submit(pd, &g_small, 3) == PARALLEL_DECODER_OK, "held: submit 3 after release");
+    expect_next(pd, 3, "held");
+    parallel_decoder_destroy(pd);
+}
+
+int main(void) {
+    if (!encode(SMALL_SIZE, &g_small) || !encode(LARGE_SIZE, &g_large)) {
+        printf("Failed to encode test frames\n");
+        return 1;
+    }
+
+    test_drop_decoded();
+    test_drop_decoding();
+    test_drop_held();
+
+    free(g_small.data);
+    free(g_large.data);
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,296 @@
+/**
+ * Read Pipeline Test
+ *
+ * Drives read_pipeline.c on a fake transport whose reads complete at
+ * once, and checks how the transfer slots are reused:
+ *
+ *   - every slot is submitted at start, reaped strictly in submission
+ *     order and resubmitted on the same slot, never while still pending
+ *   - a slot keeps its buffer until the buffer is lent and referenced;
+ *     the requeue then submits the spare in its place, the lent bytes stay
+ *     intact, and once the reference is dropped the buffer is reused
+ *   - with no spare in the pool nothing is lent and the slot keeps its
+ *     buffer
+ *   - a wait that times out leaves the slot pending, and the retry reaps
+ *     the same one
+ *   - stop cancels and reaps each outstanding slot exactly once, and the
+ *     pipeline starts again afterwards
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "read_pipeline.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define DEPTH          4
+#define TRANSFER_SIZE  1024
+#define PACKETS        (DEPTH * 5)
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+// Fake transport: a read completes as soon as it is waited for, its
+// buffer filled with the read's sequence number
+typedef struct {
+    usb_transport_t base;
+    unsigned int next_sequence;
+    int submits;
+    int misuses;        // Submit on a pending slot, or wait on an idle one
+    int timeouts;       // Next waits to report USB_XFER_TIMEOUT
+    int waits[USB_TRANSPORT_MAX_READS];
+    struct {
+        unsigned char *buffer;
+        unsigned int sequence;
+        int pending;
+        int aborted;
+    } reads[USB_TRANSPORT_MAX_READS];
+} fake_transport_t;
+
+static int fake_submit_read(usb_transport_t *transport, int slot,
+                            unsigned char *buffer, size_t length) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+
+    if (length != TRANSFER_SIZE || t->reads[slot].pending) {
+        t->misuses++;
+        return USB_XFER_ERROR;
+    }
+
+    t->reads[slot].buffer = buffer;
+    t->reads[slot].sequence = t->next_sequence++;
+    t->reads[slot].pending = 1;
+    t->reads[slot].aborted = 0;
+    t->submits++;
+    return USB_XFER_OK;
+}
+
+static int fake_wait_read(usb_transport_t *transport, int slot,
+                          unsigned int timeout_ms, size_t *bytes_read) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+
+    (void)timeout_ms;
+    *bytes_read = 0;
+
+    if (!t->reads[slot].pending) {
+        t->misuses++;
+        return USB_XFER_ERROR;
+    }
+    if (t->timeouts > 0 && !t->reads[slot].aborted) {
+        t->timeouts--;
+        return USB_XFER_TIMEOUT;
+    }
+
+    t->reads[slot].pending = 0;
+    t->waits[slot]++;
+    if (t->reads[slot].aborted) {
+        return USB_XFER_ABORTED;
+    }
+
+    memset(t->reads[slot].buffer, 0, TRANSFER_SIZE);
+    memcpy(t->reads[slot].buffer, &t->reads[slot].sequence, sizeof(unsigned int));
+    *bytes_read = TRANSFER_SIZE;
+    return USB_XFER_OK;
+}
+
+static void fake_abort_reads(usb_transport_t *transport) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        if (t->reads[i].pending) {
+            t->reads[i].aborted = 1;
+        }
+    }
+}
+
+// Only the read side is used by the pipeline
+static const usb_transport_ops_t fake_ops = {
+    .submit_read = fake_submit_read,
+    .wait_read   = fake_wait_read,
+    .abort_reads = fake_abort_reads,
+};
+
+static void fake_init(fake_transport_t *t) {
+    memset(t, 0, sizeof(*t));
+    t->base.ops = &fake_ops;
+}
+
+static int pending_reads(const fake_transport_t *t) {
+    int pending = 0;
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        pending += t->reads[i].pending;
+    }
+    return pending;
+}
+
+// Reap the next read, check it is the expected one and return its data
+static const unsigned char* expect_packet(read_pipeline_t *p, fake_transport_t *t,
+                                          unsigned int sequence, const char *test) {
+    const unsigned char *data;
+    size_t length;
+    unsigned int got;
+    int slot = p->head;
+    int ret = read_pipeline_wait(p, USB_WAIT_INFINITE, &data, &length);
+
+    CHECK(ret == USB_XFER_OK && length == TRANSFER_SIZE, "%s: wait returned %d, %zu bytes", test, ret,
+          length);
+    if (ret != USB_XFER_OK) {
+        return NULL;
+    }
+    CHECK(data == t->reads[slot].buffer, "%s: packet %u not from slot %d's buffer", test, sequence, slot);
+    memcpy(&got, data, sizeof(got));
+    CHECK(got == sequence, "%s: packet %u, expected %u", test, got, sequence);
+    return data;
+}
+
+static void test_slot_order(void) {
+    fake_transport_t t;
+    read_pipeline_t p;
+    unsigned char *first_buffers[DEPTH];
+
+    fake_init(&t);
+    CHECK(read_pipeline_init(&p, &t.base, DEPTH, TRANSFER_SIZE, DEPTH + 1), "order: init failed");
+    CHECK(read_pipeline_start(&p) == USB_XFER_OK, "order: start failed");
+    CHECK(t.submits == DEPTH && pending_reads(&t) == DEPTH, "order: %d of %d reads submitted", t.submits,
+          DEPTH);
+
+    for (int i = 0; i < DEPTH; i++) {
+        first_buffers[i] = t.reads[i].buffer;
+        for (int j = 0; j < i; j++) {
+            CHECK(first_buffers[i] != first_buffers[j], "order: slots %d and %d share a buffer", i, j);
+        }
+    }
+
+    // Each read comes back from the head slot and goes out again on it
+    for (unsigned int n = 0; n < PACKETS; n++) {
+        int slot = (int)(n % DEPTH);
+
+        CHECK(p.head == slot, "order: head %d, expected slot %d", p.head, slot);
+        expect_packet(&p, &t, n, "order");
+        CHECK(read_pipeline_requeue(&p) == USB_XFER_OK, "order: requeue of packet %u failed", n);
+        CHECK(t.reads[slot].pending && t.reads[slot].sequence == n + DEPTH,
+              "order: slot %d not resubmitted after packet %u", slot, n);
+        CHECK(t.reads[slot].buffer == first_buffers[slot], "order: slot %d changed buffer", slot);
+        CHECK(pending_reads(&t) == DEPTH, "order: %d reads pending", pending_reads(&t));
+    }
+    CHECK(t.waits[0] == PACKETS / DEPTH && t.waits[DEPTH - 1] == PACKETS / DEPTH,
+          "order: slots reaped unevenly (%d, %d)", t.waits[0], t.waits[DEPTH - 1]);
+    CHECK(t.misuses == 0, "order: %d submits on pending slots or waits on idle ones", t.misuses);
+
+    read_pipeline_stop(&p);
+    read_pipeline_free(&p);
+}
+
+static void test_lent_buffer(void) {
+    fake_transport_t t;
+    read_pipeline_t p;
+    const unsigned char *data;
+    unsigned char *old_buffer;
+    rx_buffer_t *lent, *lent_again;
+    unsigned int sequence = 0, kept;
+
+    fake_init(&t);
+    CHECK(read_pipeline_init(&p, &t.base, DEPTH, TRANSFER_SIZE, DEPTH + 1), "lent: init failed");
+    CHECK(read_pipeline_start(&p) == USB_XFER_OK, "lent: start failed");
+
+    // Slot 0's buffer is kept: the requeue puts the spare on slot 0
+    data = expect_packet(&p, &t, sequence++, "lent");
+    old_buffer = t.reads[0].buffer;
+    lent = read_pipeline_lend(&p);
+    CHECK(lent && lent->data == data, "lent: buffer not lent with a spare free");
+    if (!lent) {
+        read_pipeline_stop(&p);
+        read_pipeline_free(&p);
+        return;
+    }
+    rx_buffer_ref(lent);
+    CHECK(read_pipeline_requeue(&p) == USB_XFER_OK, "lent: requeue failed");
+    CHECK(t.reads[0].pending && t.reads[0].buffer != old_buffer, "lent: slot 0 resubmitted into the lent buffer");
+    CHECK(rx_pool_available(&p.pool) == 0, "lent: %d buffers free", rx_pool_available(&p.pool));
+
+    // A full round later the lent bytes are untouched
+    for (int i = 0; i < DEPTH; i++) {
+        expect_packet(&p, &t, sequence++, "lent");
+        CHECK(read_pipeline_lend(&p) == NULL, "lent: lent out with no spare left");
+        CHECK(read_pipeline_requeue(&p) == USB_XFER_OK, "lent: requeue failed");
+    }
+    memcpy(&kept, data, sizeof(kept));
+    CHECK(kept == 0, "lent: lent bytes overwritten by packet %u", kept);
+
+    // Dropped, the buffer goes back to the pool and is the next spare
+    rx_buffer_unref(lent);
+    CHECK(rx_pool_available(&p.pool) == 1, "lent: %d buffers free after unref", rx_pool_available(&p.pool));
+    expect_packet(&p, &t, sequence++, "lent");
+    lent_again = read_pipeline_lend(&p);
+    CHECK(lent_again != NULL, "lent: released buffer not taken as the spare");
+    if (lent_again) {
+        rx_buffer_ref(lent_again);
+    }
+    CHECK(read_pipeline_requeue(&p) == USB_XFER_OK, "lent: requeue failed");
+    CHECK(t.reads[1].buffer == old_buffer, "lent: released buffer not reused on slot 1");
+    CHECK(t.misuses == 0, "lent: %d submits on pending slots or waits on idle ones", t.misuses);
+
+    read_pipeline_stop(&p);
+    if (lent_again) {
+        rx_buffer_unref(lent_again);
+    }
+    read_pipeline_free(&p);
+}
+
+static void test_timeout_and_stop(void) {
+    fake_transport_t t;
+    read_pipeline_t p;
+    const unsigned char *data;
+    size_t length;
+    int ret;
+
+    fake_init(&t);
+    CHECK(read_pipeline_init(&p, &t.base, DEPTH, TRANSFER_SIZE, DEPTH), "stop: init failed");
+    CHECK(read_pipeline_start(&p) == USB_XFER_OK, "stop: start failed");
+    expect_packet(&p, &t, 0, "stop");
+    CHECK(read_pipeline_requeue(&p) == USB_XFER_OK, "stop: requeue failed");
+
+    // A timeout leaves slot 1 pending; the retry reaps it
+    t.timeouts = 1;
+    ret = read_pipeline_wait(&p, 10, &data, &length);
+    CHECK(ret == USB_XFER_TIMEOUT && p.head == 1 && t.reads[1].pending,
+          "stop: timeout returned %d, head %d", ret, p.head);
+    expect_packet(&p, &t, 1, "stop");
+
+    // Slot 1 reaped and not requeued, slots 2, 3 and 0 still in flight
+    read_pipeline_stop(&p);
+    CHECK(pending_reads(&t) == 0, "stop: %d reads left pending", pending_reads(&t));
+    CHECK(t.waits[0] == 2 && t.waits[1] == 1 && t.waits[2] == 1 && t.waits[3] == 1,
+          "stop: slots reaped %d, %d, %d, %d times", t.waits[0], t.waits[1], t.waits[2], t.waits[3]);
+    CHECK(!p.stuck, "stop: pipeline marked stuck");
+
+    // Restarted, the slots are submitted from 0 again
+    CHECK(read_pipeline_start(&p) == USB_XFER_OK, "stop: restart failed");
+    CHECK(p.head == 0 && pending_reads(&t) == DEPTH, "stop: restart left head %d, %d pending", p.head,
+          pending_reads(&t));
+    expect_packet(&p, &t, t.reads[0].sequence, "stop");
+    CHECK(t.misuses == 0, "stop: %d submits on pending slots or waits on idle ones", t.misuses);
+
+    read_pipeline_stop(&p);
+    read_pipeline_free(&p);
+}
+
+int main(void) {
+    test_slot_order();
+    test_lent_buffer();
+    test_timeout_and_stop();
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
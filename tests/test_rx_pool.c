@@ -0,0 +1,179 @@
+/**
+ * Receive Buffer Pool Test
+ *
+ * Checks the wake of rx_pool.c, which lets a claiming thread sleep while
+ * the pool is exhausted instead of polling it:
+ *
+ *   - without a wake callback an empty rx_pool_get only counts
+ *   - with one, the reference drop that frees a buffer after an empty
+ *     rx_pool_get runs it once; drops that leave references, or come
+ *     after the wake, do not
+ *   - a claiming thread that sleeps on the wake while another thread
+ *     frees buffers is always woken (no lost wakes)
+ *
+ * Exits 0 if every check passes.
+ */
+
+#include "rx_pool.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define POOL_BUFFERS  4
+#define CLAIMS        20000
+#define WAKE_WAIT_MS  2000  // A wake this late was lost
+
+static int g_failures = 0;
+
+#define CHECK(condition, ...) do { \
+    if (!(condition)) { \
+        printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+        printf(__VA_ARGS__); \
+        printf("\n"); \
+        g_failures++; \
+    } \
+} while (0)
+
+static void count_wake(void *context) {
+    (*(int*)context)++;
+}
+
+static void test_wake(void) {
+    rx_pool_t pool;
+    rx_buffer_t *a, *b;
+    int wakes = 0;
+
+    CHECK(rx_pool_init(&pool, 2, 64), "rx_pool_init failed");
+
+    // No callback: nothing to wake
+    a = rx_pool_get(&pool);
+    b = rx_pool_get(&pool);
+    CHECK(a && b && !rx_pool_get(&pool) && pool.exhausted == 1, "pool of 2 handed out %s",
+          pool.exhausted ? "too few" : "a third buffer");
+    CHECK(!atomic32_load_relaxed(&pool.starved), "pool without a wake callback marked starved");
+    rx_buffer_unref(a);
+    rx_buffer_unref(b);
+
+    rx_pool_set_wake(&pool, count_wake, &wakes);
+    a = rx_pool_get(&pool);
+    b = rx_pool_get(&pool);
+    CHECK(!rx_pool_get(&pool) && atomic32_load_relaxed(&pool.starved), "empty pool not marked starved");
+
+    // A frame segment's reference comes and goes; the buffer stays taken
+    rx_buffer_ref(a);
+    rx_buffer_unref(a);
+    CHECK(wakes == 0, "woken by a drop that left a reference");
+
+    rx_buffer_unref(a);
+    CHECK(wakes == 1, "%d wakes when a buffer was freed", wakes);
+    rx_buffer_unref(b);
+    CHECK(wakes == 1, "woken again without another empty rx_pool_get");
+
+    CHECK(rx_pool_get(&pool) && rx_pool_get(&pool), "freed buffers not handed out again");
+    CHECK(pool.exhausted == 2, "%u empty claims counted, expected 2", pool.exhausted);
+
+    for (int i = 0; i < 2; i++) {
+        rx_buffer_unref(&pool.buffers[i]);
+    }
+    rx_pool_free(&pool);
+}
+
+// Claimed buffers, passed to the releasing thread in order
+typedef struct {
+    rx_pool_t pool;
+    platform_event_t *woken;
+    rx_buffer_t *queue[2 * POOL_BUFFERS];
+    atomic32_t head;    // Next buffer the releasing thread drops
+    atomic32_t tail;    // Next free queue entry
+    atomic32_t done;
+} handoff_t;
+
+static void wake_claimer(void *context) {
+    platform_event_set((platform_event_t*)context);
+}
+
+static void release_proc(void *param) {
+    handoff_t *h = (handoff_t*)param;
+
+    while (!atomic32_load_acquire(&h->done)) {
+        long head = atomic32_load_relaxed(&h->head);
+
+        if (head == atomic32_load_acquire(&h->tail)) {
+            platform_sleep_ms(0);
+            continue;
+        }
+        rx_buffer_unref(h->queue[head % (2 * POOL_BUFFERS)]);
+        atomic32_store_release(&h->head, head + 1);
+    }
+}
+
+static void test_wake_threads(void) {
+    static handoff_t h;
+    platform_thread_t *releaser;
+    unsigned int waits = 0;
+    int claims;
+
+    memset(&h, 0, sizeof(h));
+    h.woken = platform_event_create(false);
+    CHECK(h.woken && rx_pool_init(&h.pool, POOL_BUFFERS, 64), "setup failed");
+    if (!h.woken) {
+        return;
+    }
+    rx_pool_set_wake(&h.pool, wake_claimer, h.woken);
+
+    releaser = platform_thread_create(release_proc, &h);
+    CHECK(releaser != NULL, "platform_thread_create failed");
+
+    // The queue holds twice the buffers, so the pool runs dry before it fills
+    for (claims = 0; releaser && claims < CLAIMS; claims++) {
+        rx_buffer_t *buffer = rx_pool_get(&h.pool);
+        long tail;
+
+        while (!buffer) {
+            waits++;
+            if (platform_event_wait(h.woken, WAKE_WAIT_MS) != PLATFORM_WAIT_OK) {
+                break;
+            }
+            buffer = rx_pool_get(&h.pool);
+        }
+        if (!buffer) {
+            CHECK(false, "claim %d: no wake within %d ms of the pool running dry", claims, WAKE_WAIT_MS);
+            break;
+        }
+
+        tail = atomic32_load_relaxed(&h.tail);
+        h.queue[tail % (2 * POOL_BUFFERS)] = buffer;
+        atomic32_store_release(&h.tail, tail + 1);
+    }
+
+    atomic32_store_release(&h.done, 1);
+    if (releaser) {
+        platform_thread_wait(releaser, PLATFORM_WAIT_INFINITE);
+        platform_thread_close(releaser);
+    }
+    CHECK(waits > 0, "the pool never ran dry in %d claims", claims);
+
+    // Buffers the releasing thread did not get to
+    while (atomic32_load_relaxed(&h.head) != atomic32_load_relaxed(&h.tail)) {
+        long head = atomic32_load_relaxed(&h.head);
+        rx_buffer_unref(h.queue[head % (2 * POOL_BUFFERS)]);
+        atomic32_store_relaxed(&h.head, head + 1);
+    }
+    CHECK(rx_pool_available(&h.pool) == POOL_BUFFERS, "%d of %d buffers free at the end",
+          rx_pool_available(&h.pool), POOL_BUFFERS);
+    rx_pool_free(&h.pool);
+    platform_event_destroy(h.woken);
+}
+
+int main(void) {
+    test_wake();
+    test_wake_threads();
+
+    if (g_failures) {
+        printf("%d check(s) failed\n", g_failures);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,189 @@
+/**
+ * Debug Logging Cost Benchmark
+ *
+ * Measures what a debug_log call costs the thread that makes it, in
+ * nanoseconds, with 1 and 4 threads logging at once:
+ *
+ *   locked  - the previous debug_log: global lock, local time, fprintf
+ *             and fflush on every call
+ *   async   - async_log_write into the calling thread's ring, paced so the
+ *             drain thread keeps up (the normal case)
+ *   flood   - async_log_write in a tight loop; once the ring fills, calls
+ *             take the drop path, and the drop count is reported
+ *
+ * Calls are timed in bursts of BURST messages; avg is over all calls, p99
+ * and max are per-call averages of the slowest bursts.
+ *
+ * Usage: bench_debug_log [messages_per_thread]
+ */
+
+#include "async_log.h"
+#include "platform.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+
+#define BURST           16
+#define MAX_THREADS     4
+#define LOCKED_LOG      "bench_debug_log_locked.log"
+#define ASYNC_LOG       "bench_debug_log_async.log"
+
+typedef enum { MODE_LOCKED, MODE_ASYNC, MODE_FLOOD } bench_mode_t;
+
+typedef struct {
+    bench_mode_t mode;
+    int bursts;
+    double *burst_ns;   // Per-call average of each burst
+} worker_t;
+
+static platform_lock_t *g_lock;
+static FILE *g_file;
+static double g_ns_per_tick;
+
+// The previous debug_log body
+static void locked_log(const char *format, ...) {
+    platform_local_time_t st;
+    va_list args;
+
+    platform_lock_enter(g_lock);
+    platform_local_time(&st);
+    fprintf(g_file, "[%02d:%02d:%02d.%03d][TID:%u] ",
+            st.hour, st.minute, st.second, st.millisecond, platform_thread_id());
+    va_start(args, format);
+    vfprintf(g_file, format, args);
+    va_end(args);
+    fprintf(g_file, "\n");
+    fflush(g_file);
+    platform_lock_leave(g_lock);
+}
+
+static void async_log(const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    async_log_write(format, args);
+    va_end(args);
+}
+
+static void worker_proc(void *param) {
+    worker_t *w = (worker_t*)param;
+    unsigned long long start, end;
+    size_t size = 30000;
+
+    for (int b = 0; b < w->bursts; b++) {
+        start = platform_ticks();
+        for (int i = 0; i < BURST; i++) {
+            size += 17;
+            // Same shape as the per-frame message in process_data
+            if (w->mode == MODE_LOCKED) {
+                locked_log("process_data: Complete frame detected, size=%zu bytes", size);
+            } else {
+                async_log("process_data: Complete frame detected, size=%zu bytes", size);
+            }
+        }
+        end = platform_ticks();
+        w->burst_ns[b] = (double)(end - start) * g_ns_per_tick / BURST;
+
+        // A streaming camera logs a few hundred messages a second, not
+        // millions; give the drain thread a chance
+        if (w->mode == MODE_ASYNC && b % 8 == 7) {
+            platform_sleep_ms(1);
+        }
+    }
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void run(const char *name, bench_mode_t mode, int threads, int messages) {
+    worker_t workers[MAX_THREADS];
+    platform_thread_t *threads_started[MAX_THREADS];
+    int bursts = messages / BURST;
+    size_t total = (size_t)bursts * threads;
+    double *all = (double*)malloc(total * sizeof(double));
+    double sum = 0.0;
+    unsigned int dropped_before = async_log_dropped();
+    unsigned int dropped = 0;
+
+    if (!all) {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+
+    if (mode == MODE_LOCKED) {
+        g_file = fopen(LOCKED_LOG, "w");
+    } else {
+        g_file = fopen(ASYNC_LOG, "w");
+        if (g_file && !async_log_start(g_file)) {
+            fprintf(stderr, "async_log_start failed\n");
+            exit(1);
+        }
+    }
+    if (!g_file) {
+        fprintf(stderr, "Cannot create log file\n");
+        exit(1);
+    }
+
+    for (int t = 0; t < threads; t++) {
+        workers[t].mode = mode;
+        workers[t].bursts = bursts;
+        workers[t].burst_ns = all + (size_t)t * bursts;
+        threads_started[t] = platform_thread_create(worker_proc, &workers[t]);
+        if (!threads_started[t]) {
+            fprintf(stderr, "Cannot create thread\n");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; t++) {
+        platform_thread_wait(threads_started[t], PLATFORM_WAIT_INFINITE);
+        platform_thread_close(threads_started[t]);
+    }
+
+    if (mode != MODE_LOCKED) {
+        async_log_stop();
+        dropped = async_log_dropped() - dropped_before;
+    }
+    fclose(g_file);
+
+    for (size_t i = 0; i < total; i++) {
+        sum += all[i];
+    }
+    qsort(all, total, sizeof(double), compare_double);
+
+    printf("  %-7s %d thread%s  avg %8.1f  p99 %8.1f  max %9.1f ns/call",
+           name, threads, threads > 1 ? "s" : " ", sum / total,
+           all[(size_t)(0.99 * (total - 1))], all[total - 1]);
+    if (mode == MODE_FLOOD) {
+        printf("  (%u of %zu dropped)", dropped, total * BURST);
+    }
+    printf("\n");
+
+    free(all);
+}
+
+int main(int argc, char *argv[]) {
+    int messages = argc > 1 ? atoi(argv[1]) : 20000;
+
+    if (messages < BURST) {
+        fprintf(stderr, "Usage: bench_debug_log [messages_per_thread (>= %d)]\n", BURST);
+        return 1;
+    }
+
+    g_ns_per_tick = 1e9 / (double)platform_ticks_per_second();
+    g_lock = platform_lock_create();
+
+    printf("debug_log cost, %d messages per thread\n", messages);
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 4) {
+        run("locked", MODE_LOCKED, threads, messages);
+        run("async", MODE_ASYNC, threads, messages);
+        run("flood", MODE_FLOOD, threads, messages);
+    }
+
+    platform_lock_destroy(g_lock);
+    remove(LOCKED_LOG);
+    remove(ASYNC_LOG);
+    return 0;
+}
@@ -0,0 +1,334 @@
+/**
+ * JPEG Decode Benchmark
+ *
+ * Times frame_decoder.c - the decode stage behind camera_read_decoded_frame
+ * - on camera frames, once per output format, and reports milliseconds
+ * per frame. A second table repeats BGRA and I420 at each scale of the
+ * scaled inverse DCT (camera_set_decode_size): 1/1, 1/2, 1/4 and 1/8.
+ *
+ * Frames come from a packet capture (camera_start_recording /
+ * USEEPLUS_RECORD), reassembled as the driver does, or from JPEG files.
+ * Without arguments, synthetic 1280x720 4:2:0 frames resembling a
+ * microscope image (vignetted background, soft structures, sensor noise)
+ * are encoded and used.
+ *
+ * Usage: bench_decode [capture_file | frame.jpg ...]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "frame_decoder.h"
+#include "frame_assembler.h"
+#include "capture_file.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define MAX_FRAMES          256
+#define MAX_FRAME_SIZE      (4*1024*1024)
+#define SYNTH_FRAMES        8
+#define SYNTH_WIDTH         1280
+#define SYNTH_HEIGHT        720
+#define SYNTH_QUALITY       85
+#define MIN_BENCH_SECONDS   1.0
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+    int width;              // Full-size dimensions, from the headers
+    int height;
+} jpeg_frame_t;
+
+static jpeg_frame_t g_frames[MAX_FRAMES];
+static int g_frame_count = 0;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static int add_frame(const unsigned char *data, size_t size) {
+    if (g_frame_count == MAX_FRAMES) {
+        return 0;
+    }
+    g_frames[g_frame_count].data = (unsigned char*)malloc(size);
+    if (!g_frames[g_frame_count].data) {
+        return 0;
+    }
+    memcpy(g_frames[g_frame_count].data, data, size);
+    g_frames[g_frame_count].size = size;
+    g_frame_count++;
+    return 1;
+}
+
+// Reassemble the frames of a packet capture, as capture_stats does
+static int load_capture(const char *path) {
+    capture_reader_t reader;
+    capture_record_t record;
+    frame_assembler_t assembler;
+    unsigned char *packet = (unsigned char*)malloc(CAPTURE_MAX_RECORD);
+    unsigned char *frame = (unsigned char*)malloc(MAX_FRAME_SIZE);
+
+    if (!packet || !frame || !capture_reader_open(&reader, path)) {
+        free(packet);
+        free(frame);
+        return 0;
+    }
+
+    frame_assembler_init(&assembler, MAX_FRAME_SIZE);
+    frame_assembler_attach(&assembler, frame, MAX_FRAME_SIZE);
+
+    while (g_frame_count < MAX_FRAMES &&
+           capture_reader_next(&reader, &record, packet, CAPTURE_MAX_RECORD) == CAPTURE_RECORD) {
+        int status = frame_assembler_push(&assembler, packet, record.length);
+        while (status == FRAME_ASM_COMPLETE && g_frame_count < MAX_FRAMES) {
+            add_frame(frame, assembler.complete_size);
+            frame_assembler_handoff(&assembler, frame, MAX_FRAME_SIZE);
+            status = frame_assembler_scan(&assembler);
+        }
+    }
+
+    capture_reader_close(&reader);
+    free(packet);
+    free(frame);
+    return 1;
+}
+
+static int load_jpeg_file(const char *path) {
+    FILE *f = fopen(path, "rb");
+    unsigned char *data;
+    long size;
+    int ok;
+
+    if (!f) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = size > 0 ? (unsigned char*)malloc((size_t)size) : NULL;
+    ok = data && fread(data, 1, (size_t)size, f) == (size_t)size && add_frame(data, (size_t)size);
+    free(data);
+    fclose(f);
+    return ok;
+}
+
+// Encode synthetic microscope-like frames with libjpeg
+static int make_synthetic_frames(void) {
+    unsigned char *rgb = (unsigned char*)malloc((size_t)SYNTH_WIDTH * SYNTH_HEIGHT * 3);
+    unsigned int seed = 1234;
+
+    if (!rgb) {
+        return 0;
+    }
+
+    for (int n = 0; n < SYNTH_FRAMES; n++) {
+        struct jpeg_compress_struct cinfo;
+        struct jpeg_error_mgr jerr;
+        unsigned char *out = NULL;
+        unsigned long out_size = 0;
+
+        for (int y = 0; y < SYNTH_HEIGHT; y++) {
+            for (int x = 0; x < SYNTH_WIDTH; x++) {
+                double dx = (x - SYNTH_WIDTH / 2) / (double)SYNTH_WIDTH;
+                double dy = (y - SYNTH_HEIGHT / 2) / (double)SYNTH_WIDTH;
+                double vignette = 1.0 - 1.6 * (dx * dx + dy * dy);
+                double cells = 0.5 + 0.5 * sin((x + n * 7) * 0.045) * cos((y - n * 5) * 0.05);
+                unsigned char *p = &rgb[((size_t)y * SYNTH_WIDTH + x) * 3];
+                int noise;
+
+                seed = seed * 1103515245u + 12345u;
+                noise = (int)((seed >> 16) % 13) - 6;
+                p[0] = (unsigned char)fmax(0.0, fmin(255.0, 200.0 * vignette - 60.0 * cells + noise));
+                p[1] = (unsigned char)fmax(0.0, fmin(255.0, 190.0 * vignette - 90.0 * cells + noise));
+                p[2] = (unsigned char)fmax(0.0, fmin(255.0, 210.0 * vignette - 30.0 * cells + noise));
+            }
+        }
+
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &out, &out_size);
+        cinfo.image_width = SYNTH_WIDTH;
+        cinfo.image_height = SYNTH_HEIGHT;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);  // YCbCr 4:2:0, like the camera
+        jpeg_set_quality(&cinfo, SYNTH_QUALITY, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            JSAMPROW row = &rgb[(size_t)cinfo.next_scanline * SYNTH_WIDTH * 3];
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+
+        add_frame(out, out_size);
+        free(out);
+    }
+
+    free(rgb);
+    return 1;
+}
+
+// Read every frame's dimensions; false if one is not a JPEG
+static int probe_frames(void) {
+    frame_decoder_t *decoder = frame_decoder_create();
+    int ok = decoder != NULL;
+
+    for (int i = 0; i < g_frame_count && ok; i++) {
+        frame_image_t image;
+
+        ok = frame_decoder_start(decoder, g_frames[i].data, g_frames[i].size, FRAME_DECODER_GRAY, 0, 0, &image);
+        if (ok) {
+            g_frames[i].width = image.width;
+            g_frames[i].height = image.height;
+            frame_decoder_abort(decoder);
+        } else {
+            fprintf(stderr, "Frame %d: %s\n", i, frame_decoder_error(decoder));
+        }
+    }
+
+    frame_decoder_destroy(decoder);
+    return ok;
+}
+
+// Decode every frame at 1/scale until MIN_BENCH_SECONDS have passed; ms per frame
+static double bench_format(int format, int scale, int *width, int *height) {
+    frame_decoder_t *decoder = frame_decoder_create();
+    unsigned char *buffer = NULL;
+    size_t capacity = 0;
+    long decoded = 0;
+    double start = now_seconds();
+    double elapsed;
+
+    do {
+        for (int i = 0; i < g_frame_count; i++) {
+            frame_image_t image;
+            int target_width = (g_frames[i].width + scale - 1) / scale;
+            int target_height = (g_frames[i].height + scale - 1) / scale;
+
+            if (!decoder || !frame_decoder_start(decoder, g_frames[i].data, g_frames[i].size, format,
+                                                 target_width, target_height, &image)) {
+                fprintf(stderr, "Frame %d: %s\n", i, decoder ? frame_decoder_error(decoder) : "out of memory");
+                return -1.0;
+            }
+            if (image.size > capacity) {
+                free(buffer);
+                capacity = image.size;
+                buffer = (unsigned char*)malloc(capacity);
+            }
+            if (!buffer || !frame_decoder_finish(decoder, buffer)) {
+                fprintf(stderr, "Frame %d: %s\n", i, buffer ? frame_decoder_error(decoder) : "out of memory");
+                return -1.0;
+            }
+            *width = image.width;
+            *height = image.height;
+            decoded++;
+        }
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECONDS);
+
+    frame_decoder_destroy(decoder);
+    free(buffer);
+    return elapsed * 1000.0 / (double)decoded;
+}
+
+int main(int argc, char *argv[]) {
+    static const struct {
+        int format;
+        const char *name;
+    } runs[] = {
+        { FRAME_DECODER_RGBA, "RGBA" },
+        { FRAME_DECODER_BGRA, "BGRA" },
+        { FRAME_DECODER_GRAY, "Gray" },
+        { FRAME_DECODER_I420, "I420 (YUV 4:2:0 planes)" },
+    };
+    static const struct {
+        int format;
+        const char *name;
+    } scaled_runs[] = {
+        { FRAME_DECODER_BGRA, "BGRA" },
+        { FRAME_DECODER_I420, "I420" },
+    };
+    size_t total = 0;
+
+    if (argc > 1) {
+        for (int i = 1; i < argc; i++) {
+            if (!load_capture(argv[i]) && !load_jpeg_file(argv[i])) {
+                fprintf(stderr, "%s: cannot read as capture or JPEG file\n", argv[i]);
+                return 1;
+            }
+        }
+    } else if (!make_synthetic_frames()) {
+        fprintf(stderr, "Failed to encode synthetic frames\n");
+        return 1;
+    }
+
+    if (g_frame_count == 0) {
+        fprintf(stderr, "No frames found\n");
+        return 1;
+    }
+    if (!probe_frames()) {
+        return 1;
+    }
+    for (int i = 0; i < g_frame_count; i++) {
+        total += g_frames[i].size;
+    }
+
+    printf("JPEG decode benchmark (%d %s frames, avg %.1f KiB)\n", g_frame_count,
+           argc > 1 ? "recorded" : "synthetic", (double)total / g_frame_count / 1024.0);
+    printf("=====================================================================\n");
+
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        int width = 0, height = 0;
+        double ms = bench_format(runs[i].format, 1, &width, &height);
+
+        if (ms < 0.0) {
+            return 1;
+        }
+        printf("  %-24s %4dx%-4d  %7.3f ms/frame  %7.1f frames/s  %6.1f MPix/s\n",
+               runs[i].name, width, height, ms, 1000.0 / ms, (double)width * height / ms / 1000.0);
+    }
+
+    printf("\nScaled inverse DCT (decode time vs. scale factor)\n");
+    printf("=====================================================================\n");
+
+    for (size_t i = 0; i < sizeof(scaled_runs) / sizeof(scaled_runs[0]); i++) {
+        double full_ms = 0.0;
+
+        for (int scale = 1; scale <= FRAME_DECODER_MAX_SCALE; scale *= 2) {
+            int width = 0, height = 0;
+            double ms = bench_format(scaled_runs[i].format, scale, &width, &height);
+
+            if (ms < 0.0) {
+                return 1;
+            }
+            if (scale == 1) {
+                full_ms = ms;
+            }
+            printf("  %-5s 1/%d  %4dx%-4d  %7.3f ms/frame  %7.1f frames/s  speed-up %4.2fx\n",
+                   scaled_runs[i].name, scale, width, height, ms, 1000.0 / ms, full_ms / ms);
+        }
+    }
+
+    return 0;
+}
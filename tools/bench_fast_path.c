@@ -0,0 +1,299 @@
+/**
+ * Frame Assembler Tail Fast Path Benchmark
+ *
+ * Feeds a synthetic camera stream (frames ending at a packet tail, the
+ * next frame starting with SOI in the next packet) through the frame
+ * assembler, paced at 1x, 10x and 100x the camera's real-time rate, once
+ * with the full incremental EOI scan and once with the tail fast path.
+ * Reports the time spent in the assembler as a share of wall time and the
+ * throughput while busy, so the headroom at each rate is visible.
+ *
+ * Before timing, both modes are run unpaced on a stream with anomalies -
+ * padding after EOI wider than the tail window, a truncated frame - and
+ * the benchmark aborts unless they recover the same frames.
+ *
+ * Usage: bench_fast_path [seconds_per_run] [frame_kib] [payload_bytes]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "frame_assembler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define FRAME_RATE      60
+#define STREAM_FRAMES   240
+#define BUFFER_SIZE     (1024*1024)
+
+typedef struct {
+    unsigned char *data;    // Concatenated packets
+    size_t *lengths;        // Length of each packet
+    size_t *frame_first;    // First packet of each frame (+1 past the last)
+    size_t packet_count;
+    size_t frame_count;
+    size_t total_bytes;
+} stream_t;
+
+#ifdef _WIN32
+static double now_seconds(void) {
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.002) {
+        Sleep((DWORD)(remaining * 1000.0) - 1);
+    }
+    while (now_seconds() < deadline) {
+        YieldProcessor();
+    }
+}
+#else
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.0005) {
+        struct timespec ts;
+        remaining -= 0.0002;
+        ts.tv_sec = (time_t)remaining;
+        ts.tv_nsec = (long)((remaining - (double)ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+    while (now_seconds() < deadline) {
+    }
+}
+#endif
+
+static void add_packet(stream_t *s, const unsigned char *payload, size_t size) {
+    unsigned char *p = s->data + s->total_bytes;
+    memset(p, 0, FRAME_PACKET_HEADER_SIZE);
+    p[0] = 0xaa;
+    p[1] = 0xbb;
+    p[2] = 0x07;
+    memcpy(p + FRAME_PACKET_HEADER_SIZE, payload, size);
+    s->lengths[s->packet_count++] = size + FRAME_PACKET_HEADER_SIZE;
+    s->total_bytes += size + FRAME_PACKET_HEADER_SIZE;
+}
+
+// Build STREAM_FRAMES JPEG-like frames cut into packets. With anomalies,
+// a few frames break the packet-tail pattern the fast path relies on
+static void build_stream(stream_t *s, size_t frame_size, size_t payload_size, int anomalies) {
+    size_t max_packets = STREAM_FRAMES * (frame_size / payload_size + 3);
+    unsigned char *frame = (unsigned char*)malloc(frame_size + 256);
+    unsigned int seed = 2024;
+
+    s->data = (unsigned char*)malloc(max_packets * (payload_size + FRAME_PACKET_HEADER_SIZE));
+    s->lengths = (size_t*)malloc(max_packets * sizeof(size_t));
+    s->frame_first = (size_t*)malloc((STREAM_FRAMES + 1) * sizeof(size_t));
+    s->packet_count = 0;
+    s->total_bytes = 0;
+    s->frame_count = STREAM_FRAMES;
+
+    for (size_t f = 0; f < STREAM_FRAMES; f++) {
+        // Vary the size so frames do not all end on a payload boundary
+        size_t size = frame_size - (f % 7) * 300;
+
+        frame[0] = 0xFF;
+        frame[1] = 0xD8;
+        for (size_t i = 2; i < size - 2; i++) {
+            seed = seed * 1103515245u + 12345u;
+            frame[i] = (unsigned char)(seed >> 16);
+            if (frame[i - 1] == 0xFF) frame[i] = 0x00;
+        }
+        frame[size - 3] = 0x00;
+        frame[size - 2] = 0xFF;
+        frame[size - 1] = 0xD9;
+
+        if (anomalies && f % 40 == 20) {
+            // Zero padding after EOI, wider than the tail window
+            memset(frame + size, 0x00, 100);
+            size += 100;
+        }
+        if (anomalies && f == 100) {
+            // Truncated: the frame never sends its EOI
+            size -= 500;
+        }
+
+        s->frame_first[f] = s->packet_count;
+        for (size_t off = 0; off < size; off += payload_size) {
+            size_t chunk = size - off < payload_size ? size - off : payload_size;
+            add_packet(s, frame + off, chunk);
+        }
+    }
+    s->frame_first[STREAM_FRAMES] = s->packet_count;
+
+    free(frame);
+}
+
+typedef struct {
+    size_t frames;
+    size_t frame_bytes;
+    unsigned int fallbacks;
+    unsigned int restarts;
+} result_t;
+
+// Push packets [first, last) the way process_data does
+static void feed(frame_assembler_t *fa, unsigned char *bufs[2], int *slot,
+                 const stream_t *s, size_t first, size_t last,
+                 const unsigned char **p, result_t *r, size_t *sizes) {
+    for (size_t n = first; n < last; *p += s->lengths[n], n++) {
+        int result = frame_assembler_push(fa, *p, s->lengths[n]);
+        while (result == FRAME_ASM_COMPLETE) {
+            if (sizes) sizes[r->frames] = fa->complete_size;
+            r->frame_bytes += fa->complete_size;
+            r->frames++;
+            *slot ^= 1;
+            frame_assembler_handoff(fa, bufs[*slot], BUFFER_SIZE);
+            result = frame_assembler_scan(fa);
+        }
+    }
+}
+
+static void start(frame_assembler_t *fa, unsigned char *bufs[2], int fast_path) {
+    frame_assembler_init(fa, BUFFER_SIZE);
+    fa->fast_path_enabled = fast_path != 0;
+    // The synthetic stream's packets stand in for ones with trusted headers
+    fa->header_vouched = fast_path != 0;
+    frame_assembler_attach(fa, bufs[0], BUFFER_SIZE);
+}
+
+// Both modes must recover exactly the same frames from a stream with anomalies
+static int verify(size_t frame_size, size_t payload_size, unsigned char *bufs[2]) {
+    stream_t s;
+    size_t sizes[2][STREAM_FRAMES];
+    result_t r[2];
+
+    build_stream(&s, frame_size, payload_size, 1);
+
+    for (int mode = 0; mode < 2; mode++) {
+        frame_assembler_t fa;
+        const unsigned char *p = s.data;
+        int slot = 0;
+
+        memset(&r[mode], 0, sizeof(r[mode]));
+        start(&fa, bufs, mode);
+        feed(&fa, bufs, &slot, &s, 0, s.packet_count, &p, &r[mode], sizes[mode]);
+        r[mode].fallbacks = fa.fast_path_fallbacks;
+        r[mode].restarts = fa.restarts;
+    }
+
+    int ok = r[0].frames == r[1].frames && r[0].restarts == r[1].restarts &&
+             memcmp(sizes[0], sizes[1], r[0].frames * sizeof(size_t)) == 0;
+
+    printf("Anomaly stream: full scan %zu frames, fast path %zu frames, %u fallbacks - %s\n",
+           r[0].frames, r[1].frames, r[1].fallbacks, ok ? "identical" : "MISMATCH");
+
+    free(s.data);
+    free(s.lengths);
+    free(s.frame_first);
+    return ok;
+}
+
+// Feed the stream at speed x real time for the given wall time
+static void run(const char *name, const stream_t *s, unsigned char *bufs[2],
+                int fast_path, double speed, double seconds) {
+    frame_assembler_t fa;
+    result_t r;
+    int slot = 0;
+    double interval = 1.0 / (FRAME_RATE * speed);
+    size_t frames_to_send = (size_t)(seconds / interval);
+    double busy = 0.0, max_late = 0.0;
+    unsigned long long bytes = 0;
+
+    memset(&r, 0, sizeof(r));
+    start(&fa, bufs, fast_path);
+
+    double t0 = now_seconds();
+    for (size_t f = 0; f < frames_to_send; f++) {
+        size_t index = f % s->frame_count;
+        const unsigned char *p = s->data;
+        double due = t0 + f * interval;
+
+        // Packets of a frame arrive as one burst at its due time
+        sleep_until(due);
+        double begin = now_seconds();
+        if (begin - due > max_late) max_late = begin - due;
+
+        for (size_t n = 0; n < s->frame_first[index]; n++) {
+            p += s->lengths[n];
+        }
+        feed(&fa, bufs, &slot, s, s->frame_first[index], s->frame_first[index + 1], &p, &r, NULL);
+
+        busy += now_seconds() - begin;
+        for (size_t n = s->frame_first[index]; n < s->frame_first[index + 1]; n++) {
+            bytes += s->lengths[n];
+        }
+    }
+    double elapsed = now_seconds() - t0;
+
+    printf("  %4gx %-10s frames=%6zu  busy=%6.2f%%  %8.1f MB/s while busy  max late=%7.2f ms%s\n",
+           speed, name, r.frames, busy / elapsed * 100.0,
+           busy > 0.0 ? (double)bytes / busy / (1024.0 * 1024.0) : 0.0,
+           max_late * 1e3, fa.fast_path ? "" : "  (fast path off)");
+}
+
+int main(int argc, char *argv[]) {
+    static const double speeds[] = { 1.0, 10.0, 100.0 };
+    double seconds = 2.0;
+    size_t frame_kib = 64;
+    size_t payload_size = 16 * 1024;
+    unsigned char *bufs[2];
+    stream_t stream;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) frame_kib = (size_t)atoi(argv[2]);
+    if (argc > 3) payload_size = (size_t)atoi(argv[3]);
+    if (seconds <= 0.0 || frame_kib < 4 || frame_kib > 512 ||
+        payload_size < 64 || payload_size > 64 * 1024 - FRAME_PACKET_HEADER_SIZE) {
+        fprintf(stderr, "Usage: bench_fast_path [seconds_per_run] [frame_kib (4-512)] [payload_bytes (64-65524)]\n");
+        return 1;
+    }
+
+    bufs[0] = (unsigned char*)malloc(BUFFER_SIZE);
+    bufs[1] = (unsigned char*)malloc(BUFFER_SIZE);
+    if (!bufs[0] || !bufs[1]) {
+        fprintf(stderr, "Failed to allocate buffers\n");
+        return 1;
+    }
+
+    printf("Frame assembler tail fast path benchmark\n");
+    printf("(%d fps real time, %zu KiB frames, %zu-byte payloads, %.1f s per run)\n",
+           FRAME_RATE, frame_kib, payload_size, seconds);
+    printf("=====================================================================\n");
+
+    if (!verify(frame_kib * 1024, payload_size, bufs)) {
+        fprintf(stderr, "Fast path and full scan disagree, aborting\n");
+        return 1;
+    }
+
+    build_stream(&stream, frame_kib * 1024, payload_size, 0);
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); i++) {
+        run("full scan", &stream, bufs, 0, speeds[i], seconds);
+        run("fast path", &stream, bufs, 1, speeds[i], seconds);
+    }
+
+    free(stream.data);
+    free(stream.lengths);
+    free(stream.frame_first);
+    free(bufs[0]);
+    free(bufs[1]);
+    return 0;
+}
@@ -0,0 +1,349 @@
+/**
+ * Frame Assembler Micro-Benchmark
+ *
+ * Feeds synthetic AA BB 07 packet streams through the frame assembler and
+ * reports parsing throughput for several frame sizes and for each marker
+ * scanner kernel the CPU supports. For comparison the previous algorithm
+ * (re-scanning the whole accumulated frame for FF D9 on every packet) is
+ * run on the same streams.
+ *
+ * The last two rows include handing each frame to a consumer buffer:
+ * "copy+out" copies payloads into the frame buffer and the frame out
+ * again, as the driver did before scatter-gather assembly; "gather+out"
+ * leaves payloads in place as segments and copies them out once.
+ *
+ * Before timing, every kernel is cross-checked against the scalar kernel
+ * on random and adversarial buffers (0xFF runs, stuffed FF 00, markers at
+ * every alignment) and the benchmark aborts on any mismatch.
+ *
+ * Usage: bench_frame_assembler [packet_payload_bytes]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "frame_assembler.h"
+#include "marker_scan.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define BUFFER_SIZE     (64*1024)
+#define MAX_JPEG_SIZE   (BUFFER_SIZE - 4096)
+#define STREAM_BYTES    (8*1024*1024)
+#define MIN_BENCH_SECS  0.5
+
+typedef struct {
+    unsigned char *data;    // Concatenated packets
+    size_t *lengths;        // Length of each packet
+    size_t packet_count;
+    size_t total_bytes;
+    size_t frame_count;
+} packet_stream_t;
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// Build a stream of packets carrying JPEG-like frames of frame_size bytes
+static void build_stream(packet_stream_t *s, size_t frame_size, size_t payload_size) {
+    size_t frames = STREAM_BYTES / frame_size;
+    size_t packets_per_frame = (frame_size + payload_size - 1) / payload_size;
+    unsigned char *frame = (unsigned char*)malloc(frame_size);
+    unsigned int seed = 12345;
+
+    s->packet_count = frames * packets_per_frame;
+    s->data = (unsigned char*)malloc(s->packet_count * (payload_size + FRAME_PACKET_HEADER_SIZE));
+    s->lengths = (size_t*)malloc(s->packet_count * sizeof(size_t));
+    s->total_bytes = 0;
+    s->frame_count = frames;
+
+    // SOI, entropy-coded body with byte stuffing (FF 00), EOI
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    for (size_t i = 2; i < frame_size - 2; i++) {
+        seed = seed * 1103515245u + 12345u;
+        frame[i] = (unsigned char)(seed >> 16);
+        if (frame[i - 1] == 0xFF) frame[i] = 0x00;
+    }
+    frame[frame_size - 3] = 0x00;
+    frame[frame_size - 2] = 0xFF;
+    frame[frame_size - 1] = 0xD9;
+
+    size_t n = 0;
+    for (size_t f = 0; f < frames; f++) {
+        for (size_t off = 0; off < frame_size; off += payload_size) {
+            size_t chunk = frame_size - off < payload_size ? frame_size - off : payload_size;
+            unsigned char *p = s->data + s->total_bytes;
+            memset(p, 0, FRAME_PACKET_HEADER_SIZE);
+            p[0] = 0xaa;
+            p[1] = 0xbb;
+            p[2] = 0x07;
+            memcpy(p + FRAME_PACKET_HEADER_SIZE, frame + off, chunk);
+            s->lengths[n++] = chunk + FRAME_PACKET_HEADER_SIZE;
+            s->total_bytes += chunk + FRAME_PACKET_HEADER_SIZE;
+        }
+    }
+    s->packet_count = n;
+
+    free(frame);
+}
+
+// Previous algorithm: append payload, then search the whole frame for EOI
+static size_t run_rescan(const packet_stream_t *s, unsigned char *bufs[2]) {
+    unsigned char *frame = bufs[0];
+    size_t size = 0;
+    size_t completed = 0;
+    int slot = 0;
+    const unsigned char *p = s->data;
+
+    for (size_t n = 0; n < s->packet_count; p += s->lengths[n], n++) {
+        size_t payload_size = s->lengths[n] - FRAME_PACKET_HEADER_SIZE;
+        const unsigned char *payload = p + FRAME_PACKET_HEADER_SIZE;
+
+        if (payload[0] == 0xFF && payload[1] == 0xD8) size = 0;
+        if (size + payload_size > BUFFER_SIZE) { size = 0; continue; }
+
+        memcpy(frame + size, payload, payload_size);
+        size += payload_size;
+
+        for (size_t i = 1; i < size; i++) {
+            if (frame[i-1] == 0xFF && frame[i] == 0xD9 &&
+                i + 1 >= FRAME_MIN_JPEG_SIZE && frame[0] == 0xFF && frame[1] == 0xD8) {
+                size_t leftover = size - (i + 1);
+                slot ^= 1;
+                memcpy(bufs[slot], frame + i + 1, leftover);
+                frame = bufs[slot];
+                size = leftover;
+                completed++;
+                break;
+            }
+        }
+        if (size > MAX_JPEG_SIZE) size = 0;
+    }
+    return completed;
+}
+
+// Current algorithm: frame_assembler with incremental EOI scanning
+static size_t run_incremental(const packet_stream_t *s, unsigned char *bufs[2]) {
+    frame_assembler_t fa;
+    size_t completed = 0;
+    int slot = 0;
+    const unsigned char *p = s->data;
+
+    frame_assembler_init(&fa, MAX_JPEG_SIZE);
+    frame_assembler_attach(&fa, bufs[0], BUFFER_SIZE);
+
+    for (size_t n = 0; n < s->packet_count; p += s->lengths[n], n++) {
+        int result = frame_assembler_push(&fa, p, s->lengths[n]);
+        while (result == FRAME_ASM_COMPLETE) {
+            completed++;
+            slot ^= 1;
+            frame_assembler_handoff(&fa, bufs[slot], BUFFER_SIZE);
+            result = frame_assembler_scan(&fa);
+        }
+    }
+    return completed;
+}
+
+// Payloads copied into the frame, the frame copied to the consumer
+static size_t run_copy_out(const packet_stream_t *s, unsigned char *bufs[2]) {
+    static unsigned char out[BUFFER_SIZE];
+    frame_assembler_t fa;
+    size_t completed = 0;
+    int slot = 0;
+    const unsigned char *p = s->data;
+
+    frame_assembler_init(&fa, MAX_JPEG_SIZE);
+    frame_assembler_attach(&fa, bufs[0], BUFFER_SIZE);
+
+    for (size_t n = 0; n < s->packet_count; p += s->lengths[n], n++) {
+        int result = frame_assembler_push(&fa, p, s->lengths[n]);
+        while (result == FRAME_ASM_COMPLETE) {
+            memcpy(out, fa.data, fa.complete_size);
+            completed++;
+            slot ^= 1;
+            frame_assembler_handoff(&fa, bufs[slot], BUFFER_SIZE);
+            result = frame_assembler_scan(&fa);
+        }
+    }
+    return completed;
+}
+
+// Payloads referenced in place, gathered straight to the consumer
+static size_t run_gather_out(const packet_stream_t *s, unsigned char *bufs[2]) {
+    static unsigned char out[BUFFER_SIZE];
+    static rx_segment_t segments[2][BUFFER_SIZE / 1024];
+    rx_buffer_t stream_buffer;  // The whole stream stands in for the receive buffers
+    frame_assembler_t fa;
+    size_t completed = 0;
+    int slot = 0;
+    int max_segments = (int)(sizeof(segments[0]) / sizeof(segments[0][0]));
+    const unsigned char *p = s->data;
+
+    stream_buffer.data = s->data;
+    stream_buffer.refs = 1;
+    frame_assembler_init(&fa, MAX_JPEG_SIZE);
+    frame_assembler_attach_gather(&fa, bufs[0], BUFFER_SIZE, segments[0], max_segments);
+
+    for (size_t n = 0; n < s->packet_count; p += s->lengths[n], n++) {
+        int result = frame_assembler_push_ref(&fa, &stream_buffer, p, s->lengths[n]);
+        while (result == FRAME_ASM_COMPLETE) {
+            unsigned char *w = out;
+            for (int i = 0; i < fa.segment_count; i++) {
+                memcpy(w, segments[slot][i].data, segments[slot][i].size);
+                w += segments[slot][i].size;
+                rx_buffer_unref(segments[slot][i].buffer);
+            }
+            completed++;
+            slot ^= 1;
+            frame_assembler_handoff_gather(&fa, bufs[slot], BUFFER_SIZE, segments[slot], max_segments);
+            result = frame_assembler_scan(&fa);
+        }
+    }
+    frame_assembler_attach(&fa, NULL, 0);
+    return completed;
+}
+
+// Cross-check a kernel against the scalar reference on one buffer
+static int verify_buffer(int kernel, const unsigned char *buf, size_t length) {
+    for (size_t start = 0; start < length; start++) {
+        size_t expected, actual;
+        marker_scan_select(MARKER_SCAN_SCALAR);
+        expected = marker_find_ff(buf + start, length - start);
+        marker_scan_select(kernel);
+        actual = marker_find_ff(buf + start, length - start);
+        if (expected != actual) {
+            fprintf(stderr, "MISMATCH (%s): start=%zu length=%zu expected=%zu got=%zu\n",
+                    marker_scan_kernel_name(), start, length, expected, actual);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int verify_kernels(void) {
+    unsigned char buf[512];
+    unsigned int seed = 777;
+
+    for (int kernel = MARKER_SCAN_SSE2; kernel <= MARKER_SCAN_AVX2; kernel++) {
+        if (!marker_scan_supported(kernel)) continue;
+
+        // Random data
+        for (int round = 0; round < 16; round++) {
+            for (size_t i = 0; i < sizeof(buf); i++) {
+                seed = seed * 1103515245u + 12345u;
+                buf[i] = (unsigned char)(seed >> 16);
+            }
+            if (!verify_buffer(kernel, buf, sizeof(buf))) return 0;
+        }
+
+        // No marker at all, a single marker at every position, 0xFF runs
+        // and stuffed FF 00 pairs
+        memset(buf, 0x00, sizeof(buf));
+        if (!verify_buffer(kernel, buf, sizeof(buf))) return 0;
+        for (size_t pos = 0; pos < 96; pos++) {
+            memset(buf, 0x00, sizeof(buf));
+            buf[pos] = 0xFF;
+            if (!verify_buffer(kernel, buf, 96)) return 0;
+        }
+        memset(buf, 0xFF, sizeof(buf));
+        if (!verify_buffer(kernel, buf, sizeof(buf))) return 0;
+        for (size_t i = 0; i < sizeof(buf); i++) buf[i] = (i % 2) ? 0x00 : 0xFF;
+        if (!verify_buffer(kernel, buf, sizeof(buf))) return 0;
+    }
+
+    marker_scan_select(MARKER_SCAN_AUTO);
+    return 1;
+}
+
+static void bench(const char *name, size_t (*fn)(const packet_stream_t*, unsigned char*[2]),
+                  const packet_stream_t *s, unsigned char *bufs[2]) {
+    size_t iterations = 0;
+    size_t frames = 0;
+    double start = now_seconds();
+    double elapsed;
+
+    do {
+        frames = fn(s, bufs);
+        iterations++;
+        elapsed = now_seconds() - start;
+    } while (elapsed < MIN_BENCH_SECS);
+
+    double mb_per_sec = (double)s->total_bytes * iterations / elapsed / (1024.0 * 1024.0);
+    printf("  %-12s %10.1f MB/s  %10.0f frames/s  (%zu/%zu frames per pass)\n",
+           name, mb_per_sec, (double)frames * iterations / elapsed, frames, s->frame_count);
+}
+
+int main(int argc, char *argv[]) {
+    static const size_t frame_sizes[] = { 8*1024, 16*1024, 32*1024, 56*1024 };
+    size_t payload_size = 1024;
+    unsigned char *bufs[2];
+
+    if (argc > 1) {
+        payload_size = (size_t)atoi(argv[1]);
+        if (payload_size < 16 || payload_size > BUFFER_SIZE - FRAME_PACKET_HEADER_SIZE) {
+            fprintf(stderr, "Invalid packet payload size\n");
+            return 1;
+        }
+    }
+
+    bufs[0] = (unsigned char*)malloc(BUFFER_SIZE);
+    bufs[1] = (unsigned char*)malloc(BUFFER_SIZE);
+    if (!bufs[0] || !bufs[1]) {
+        fprintf(stderr, "Failed to allocate buffers\n");
+        return 1;
+    }
+
+    printf("Frame assembler benchmark (%zu-byte packet payloads)\n", payload_size);
+    printf("====================================================\n");
+
+    if (!verify_kernels()) {
+        fprintf(stderr, "Marker scanner kernels disagree, aborting\n");
+        return 1;
+    }
+    printf("Marker scanner kernels verified (auto = %s)\n", marker_scan_kernel_name());
+
+    for (size_t i = 0; i < sizeof(frame_sizes) / sizeof(frame_sizes[0]); i++) {
+        packet_stream_t stream;
+        build_stream(&stream, frame_sizes[i], payload_size);
+
+        printf("\nFrame size %zu KiB (%zu packets/frame):\n", frame_sizes[i] / 1024,
+               stream.packet_count / stream.frame_count);
+        bench("rescan", run_rescan, &stream, bufs);
+        for (int kernel = MARKER_SCAN_SCALAR; kernel <= MARKER_SCAN_AVX2; kernel++) {
+            char name[32];
+            if (!marker_scan_supported(kernel)) continue;
+            marker_scan_select(kernel);
+            snprintf(name, sizeof(name), "incr/%s", marker_scan_kernel_name());
+            bench(name, run_incremental, &stream, bufs);
+        }
+        marker_scan_select(MARKER_SCAN_AUTO);
+        bench("copy+out", run_copy_out, &stream, bufs);
+        bench("gather+out", run_gather_out, &stream, bufs);
+
+        free(stream.data);
+        free(stream.lengths);
+    }
+
+    free(bufs[0]);
+    free(bufs[1]);
+    return 0;
+}
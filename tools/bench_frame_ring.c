@@ -0,0 +1,407 @@
+/**
+ * Frame Ring Contention Benchmark
+ *
+ * Runs a synthetic 60 fps producer (packets spread evenly across each
+ * frame interval, like the USB read thread sees them) against a consumer
+ * thread blocked in a read loop, and reports the reader-side latency from
+ * frame completion to the consumer returning with the frame: p50, p99
+ * and max.
+ *
+ * Two hand-off schemes are compared:
+ *   locked    - one mutex around packet processing and around the whole
+ *               consumer read, signalling on every frame (the previous
+ *               frame_lock design)
+ *   lock-free - frame_ring SPSC queue, the producer never takes a lock
+ *               and only signals on the empty -> non-empty transition
+ *
+ * Usage: bench_frame_ring [seconds] [frame_kib]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "frame_assembler.h"
+#include "frame_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define BUFFER_SIZE     (64*1024)
+#define MAX_JPEG_SIZE   (BUFFER_SIZE - 4096)
+#define PAYLOAD_SIZE    1024
+#define FRAME_RATE      60
+
+// Minimal thread/event/mutex shim so the benchmark runs on both platforms
+#ifdef _WIN32
+typedef HANDLE bench_thread_t;
+typedef CRITICAL_SECTION bench_mutex_t;
+typedef HANDLE bench_event_t;
+
+static void mutex_init(bench_mutex_t *m)   { InitializeCriticalSection(m); }
+static void mutex_lock(bench_mutex_t *m)   { EnterCriticalSection(m); }
+static void mutex_unlock(bench_mutex_t *m) { LeaveCriticalSection(m); }
+
+static void event_init(bench_event_t *e)   { *e = CreateEvent(NULL, FALSE, FALSE, NULL); }
+static void event_set(bench_event_t *e)    { SetEvent(*e); }
+static void event_wait(bench_event_t *e)   { WaitForSingleObject(*e, 100); }
+
+static double now_seconds(void) {
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.002) {
+        Sleep((DWORD)(remaining * 1000.0) - 1);
+    }
+    while (now_seconds() < deadline) {
+        YieldProcessor();
+    }
+}
+#else
+typedef pthread_t bench_thread_t;
+typedef pthread_mutex_t bench_mutex_t;
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int signalled;
+} bench_event_t;
+
+static void mutex_init(bench_mutex_t *m)   { pthread_mutex_init(m, NULL); }
+static void mutex_lock(bench_mutex_t *m)   { pthread_mutex_lock(m); }
+static void mutex_unlock(bench_mutex_t *m) { pthread_mutex_unlock(m); }
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Auto-reset event, same semantics as the Win32 one the library uses
+static void event_init(bench_event_t *e) {
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->cond, NULL);
+    e->signalled = 0;
+}
+
+static void event_set(bench_event_t *e) {
+    pthread_mutex_lock(&e->lock);
+    e->signalled = 1;
+    pthread_cond_signal(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void event_wait(bench_event_t *e) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100 * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&e->lock);
+    while (!e->signalled) {
+        if (pthread_cond_timedwait(&e->cond, &e->lock, &ts) != 0) break;
+    }
+    e->signalled = 0;
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.0005) {
+        struct timespec ts;
+        remaining -= 0.0002;
+        ts.tv_sec = (time_t)remaining;
+        ts.tv_nsec = (long)((remaining - (double)ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+    while (now_seconds() < deadline) {
+    }
+}
+#endif
+
+typedef struct {
+    // Synthetic stream: one frame cut into packets with AA BB 07 headers
+    unsigned char *packets;
+    size_t *lengths;
+    size_t packet_count;
+    int frames_to_send;
+
+    // Shared state for both schemes
+    frame_assembler_t assembler;
+    bench_event_t ready;
+    atomic32_t done;
+
+    // Locked scheme: one lock, a FIFO of published frame slots
+    bench_mutex_t lock;
+    unsigned char *locked_bufs[FRAME_RING_DEFAULT_SLOTS];
+    double locked_stamp[FRAME_RING_DEFAULT_SLOTS];
+    size_t locked_size[FRAME_RING_DEFAULT_SLOTS];
+    int write_slot;
+    int read_slot;
+    int count;
+
+    // Lock-free scheme
+    frame_ring_t ring;
+    double ring_stamp[FRAME_RING_DEFAULT_SLOTS];
+
+    // Consumer results
+    double *latencies;
+    int latency_count;
+    unsigned char *copy;
+    int dropped;
+} bench_ctx_t;
+
+static void build_frame_packets(bench_ctx_t *ctx, size_t frame_size) {
+    unsigned char *frame = (unsigned char*)malloc(frame_size);
+    unsigned int seed = 4242;
+    size_t total = 0;
+
+    for (size_t i = 0; i < frame_size; i++) {
+        seed = seed * 1103515245u + 12345u;
+        frame[i] = (unsigned char)(seed >> 16);
+        if (i > 0 && frame[i - 1] == 0xFF) frame[i] = 0x00;
+    }
+    frame[0] = 0xFF;
+    frame[1] = 0xD8;
+    frame[frame_size - 3] = 0x00;
+    frame[frame_size - 2] = 0xFF;
+    frame[frame_size - 1] = 0xD9;
+
+    ctx->packet_count = (frame_size + PAYLOAD_SIZE - 1) / PAYLOAD_SIZE;
+    ctx->packets = (unsigned char*)malloc(ctx->packet_count * (PAYLOAD_SIZE + FRAME_PACKET_HEADER_SIZE));
+    ctx->lengths = (size_t*)malloc(ctx->packet_count * sizeof(size_t));
+
+    for (size_t n = 0, off = 0; off < frame_size; off += PAYLOAD_SIZE, n++) {
+        size_t chunk = frame_size - off < PAYLOAD_SIZE ? frame_size - off : PAYLOAD_SIZE;
+        unsigned char *p = ctx->packets + total;
+        memset(p, 0, FRAME_PACKET_HEADER_SIZE);
+        p[0] = 0xaa;
+        p[1] = 0xbb;
+        p[2] = 0x07;
+        memcpy(p + FRAME_PACKET_HEADER_SIZE, frame + off, chunk);
+        ctx->lengths[n] = chunk + FRAME_PACKET_HEADER_SIZE;
+        total += ctx->lengths[n];
+    }
+
+    free(frame);
+}
+
+// Old design: packet processing and publishing under the shared lock
+static void locked_process(bench_ctx_t *ctx, const unsigned char *packet, size_t length) {
+    mutex_lock(&ctx->lock);
+    int result = frame_assembler_push(&ctx->assembler, packet, length);
+    while (result == FRAME_ASM_COMPLETE) {
+        ctx->locked_stamp[ctx->write_slot] = now_seconds();
+        ctx->locked_size[ctx->write_slot] = ctx->assembler.complete_size;
+        ctx->write_slot = (ctx->write_slot + 1) % FRAME_RING_DEFAULT_SLOTS;
+        if (ctx->count == FRAME_RING_DEFAULT_SLOTS - 1) {
+            ctx->read_slot = (ctx->read_slot + 1) % FRAME_RING_DEFAULT_SLOTS;
+            ctx->dropped++;
+        } else {
+            ctx->count++;
+        }
+        event_set(&ctx->ready);
+        frame_assembler_handoff(&ctx->assembler, ctx->locked_bufs[ctx->write_slot], BUFFER_SIZE);
+        result = frame_assembler_scan(&ctx->assembler);
+    }
+    mutex_unlock(&ctx->lock);
+}
+
+static void ring_process(bench_ctx_t *ctx, const unsigned char *packet, size_t length) {
+    int result = frame_assembler_push(&ctx->assembler, packet, length);
+    while (result == FRAME_ASM_COMPLETE) {
+        int slot = ctx->ring.write_slot;
+        bool was_empty;
+        ctx->ring_stamp[slot] = now_seconds();
+        if (frame_ring_publish(&ctx->ring, ctx->assembler.complete_size, &was_empty) != FRAME_RING_PUBLISHED) {
+            ctx->dropped++;     // Write slot unchanged; the hand-off keeps what follows
+        } else if (was_empty) {
+            event_set(&ctx->ready);
+        }
+        frame_slot_t *next = frame_ring_write_slot(&ctx->ring);
+        frame_assembler_handoff(&ctx->assembler, next->data, next->capacity);
+        result = frame_assembler_scan(&ctx->assembler);
+    }
+}
+
+static void producer_run(bench_ctx_t *ctx, int lock_free) {
+    double interval = 1.0 / FRAME_RATE;
+    double packet_interval = interval / (double)ctx->packet_count;
+    double start = now_seconds();
+
+    for (int f = 0; f < ctx->frames_to_send; f++) {
+        const unsigned char *p = ctx->packets;
+        for (size_t n = 0; n < ctx->packet_count; p += ctx->lengths[n], n++) {
+            sleep_until(start + f * interval + n * packet_interval);
+            if (lock_free) {
+                ring_process(ctx, p, ctx->lengths[n]);
+            } else {
+                locked_process(ctx, p, ctx->lengths[n]);
+            }
+        }
+    }
+    atomic32_store_release(&ctx->done, 1);
+    event_set(&ctx->ready);
+}
+
+// Consumer read: wait for a frame, copy it out, record the hand-off latency
+static int locked_read(bench_ctx_t *ctx) {
+    while (true) {
+        // Sample done first so a frame published just before it is not missed
+        long finished = atomic32_load_acquire(&ctx->done);
+        mutex_lock(&ctx->lock);
+        if (ctx->count > 0) {
+            int slot = ctx->read_slot;
+            memcpy(ctx->copy, ctx->locked_bufs[slot], ctx->locked_size[slot]);
+            ctx->read_slot = (slot + 1) % FRAME_RING_DEFAULT_SLOTS;
+            ctx->count--;
+            ctx->latencies[ctx->latency_count++] = now_seconds() - ctx->locked_stamp[slot];
+            mutex_unlock(&ctx->lock);
+            return 1;
+        }
+        mutex_unlock(&ctx->lock);
+        if (finished) {
+            return 0;
+        }
+        event_wait(&ctx->ready);
+    }
+}
+
+static int ring_read(bench_ctx_t *ctx) {
+    while (true) {
+        long finished = atomic32_load_acquire(&ctx->done);
+        frame_slot_t *slot = frame_ring_peek(&ctx->ring);
+        if (slot) {
+            int index = (int)(slot - ctx->ring.slots);
+            memcpy(ctx->copy, slot->data, slot->size);
+            ctx->latencies[ctx->latency_count++] = now_seconds() - ctx->ring_stamp[index];
+            frame_ring_pop(&ctx->ring);
+            return 1;
+        }
+        if (finished) {
+            return 0;
+        }
+        if (frame_ring_empty_before_wait(&ctx->ring)) {
+            event_wait(&ctx->ready);
+        }
+    }
+}
+
+static bench_ctx_t *g_ctx;
+static int g_lock_free;
+
+#ifdef _WIN32
+static DWORD WINAPI consumer_thread(LPVOID param) {
+#else
+static void* consumer_thread(void *param) {
+#endif
+    (void)param;
+    while (g_lock_free ? ring_read(g_ctx) : locked_read(g_ctx)) {
+    }
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, bench_ctx_t *ctx, int lock_free) {
+    bench_thread_t thread;
+    unsigned char *bufs[FRAME_RING_DEFAULT_SLOTS];
+
+    for (int i = 0; i < FRAME_RING_DEFAULT_SLOTS; i++) {
+        bufs[i] = (unsigned char*)malloc(BUFFER_SIZE);
+    }
+
+    // Fresh state for every run
+    frame_assembler_init(&ctx->assembler, MAX_JPEG_SIZE);
+    frame_ring_init(&ctx->ring, FRAME_RING_DEFAULT_SLOTS);
+    for (int i = 0; i < FRAME_RING_DEFAULT_SLOTS; i++) {
+        ctx->locked_bufs[i] = bufs[i];
+        ctx->ring.slots[i].data = bufs[i];
+        ctx->ring.slots[i].capacity = BUFFER_SIZE;
+    }
+    ctx->write_slot = ctx->read_slot = ctx->count = 0;
+    frame_assembler_attach(&ctx->assembler, bufs[0], BUFFER_SIZE);
+    ctx->latency_count = 0;
+    ctx->dropped = 0;
+    atomic32_store_release(&ctx->done, 0);
+
+    g_ctx = ctx;
+    g_lock_free = lock_free;
+#ifdef _WIN32
+    thread = CreateThread(NULL, 0, consumer_thread, NULL, 0, NULL);
+    producer_run(ctx, lock_free);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_create(&thread, NULL, consumer_thread, NULL);
+    producer_run(ctx, lock_free);
+    pthread_join(thread, NULL);
+#endif
+
+    qsort(ctx->latencies, ctx->latency_count, sizeof(double), compare_double);
+    if (ctx->latency_count > 0) {
+        int n = ctx->latency_count;
+        printf("  %-10s frames=%5d dropped=%3d  p50=%8.1f us  p99=%8.1f us  max=%8.1f us\n",
+               name, n, ctx->dropped,
+               ctx->latencies[n / 2] * 1e6,
+               ctx->latencies[(int)((n - 1) * 0.99)] * 1e6,
+               ctx->latencies[n - 1] * 1e6);
+    } else {
+        printf("  %-10s no frames delivered\n", name);
+    }
+
+    for (int i = 0; i < FRAME_RING_DEFAULT_SLOTS; i++) {
+        free(bufs[i]);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static bench_ctx_t ctx;
+    double seconds = 5.0;
+    size_t frame_kib = 32;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) frame_kib = (size_t)atoi(argv[2]);
+    if (seconds <= 0.0 || frame_kib < 2 || frame_kib * 1024 > MAX_JPEG_SIZE) {
+        fprintf(stderr, "Usage: bench_frame_ring [seconds] [frame_kib (2-%d)]\n", MAX_JPEG_SIZE / 1024);
+        return 1;
+    }
+
+    build_frame_packets(&ctx, frame_kib * 1024);
+    ctx.frames_to_send = (int)(seconds * FRAME_RATE);
+    ctx.latencies = (double*)malloc(ctx.frames_to_send * sizeof(double));
+    ctx.copy = (unsigned char*)malloc(BUFFER_SIZE);
+    mutex_init(&ctx.lock);
+    event_init(&ctx.ready);
+
+    printf("Frame ring contention benchmark (%d fps, %zu KiB frames, %zu packets/frame, %d frames)\n",
+           FRAME_RATE, frame_kib, ctx.packet_count, ctx.frames_to_send);
+    printf("Latency = frame completion -> consumer returns with the copied frame\n");
+    printf("=====================================================================\n");
+
+    run("locked", &ctx, 0);
+    run("lock-free", &ctx, 1);
+
+    free(ctx.latencies);
+    free(ctx.copy);
+    free(ctx.packets);
+    free(ctx.lengths);
+    return 0;
+}
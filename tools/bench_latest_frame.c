@@ -0,0 +1,294 @@
+/**
+ * Latest-Frame Read Benchmark
+ *
+ * A synthetic 60 fps producer publishes frames into a frame_ring while a
+ * preview consumer that needs `render_ms` per frame (slower than the
+ * camera) reads them. Reports how old each displayed frame is - frame
+ * completion to the consumer picking it up: p50, p99 and max - together
+ * with frames shown, skipped and dropped as overflow.
+ *
+ * Two read modes are compared, as camera_set_read_mode implements them:
+ *   fifo   - oldest queued frame first; the ring fills up and every frame
+ *            shown is about frame_buffers renders old
+ *   latest - newest queued frame, older ones skipped
+ *
+ * Usage: bench_latest_frame [seconds] [render_ms] [frame_buffers]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "frame_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define FRAME_RATE   60
+#define FRAME_SIZE   (48*1024)
+
+#define MODE_FIFO    0
+#define MODE_LATEST  1
+
+// Minimal thread/event shim so the benchmark runs on both platforms
+#ifdef _WIN32
+typedef HANDLE bench_thread_t;
+typedef HANDLE bench_event_t;
+
+static void event_init(bench_event_t *e)   { *e = CreateEvent(NULL, FALSE, FALSE, NULL); }
+static void event_set(bench_event_t *e)    { SetEvent(*e); }
+static void event_wait(bench_event_t *e)   { WaitForSingleObject(*e, 100); }
+
+static double now_seconds(void) {
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.002) {
+        Sleep((DWORD)(remaining * 1000.0) - 1);
+    }
+    while (now_seconds() < deadline) {
+        YieldProcessor();
+    }
+}
+#else
+typedef pthread_t bench_thread_t;
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int signalled;
+} bench_event_t;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// Auto-reset event, same semantics as the Win32 one the library uses
+static void event_init(bench_event_t *e) {
+    pthread_mutex_init(&e->lock, NULL);
+    pthread_cond_init(&e->cond, NULL);
+    e->signalled = 0;
+}
+
+static void event_set(bench_event_t *e) {
+    pthread_mutex_lock(&e->lock);
+    e->signalled = 1;
+    pthread_cond_signal(&e->cond);
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void event_wait(bench_event_t *e) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_nsec += 100 * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    pthread_mutex_lock(&e->lock);
+    while (!e->signalled) {
+        if (pthread_cond_timedwait(&e->cond, &e->lock, &ts) != 0) break;
+    }
+    e->signalled = 0;
+    pthread_mutex_unlock(&e->lock);
+}
+
+static void sleep_until(double deadline) {
+    double remaining;
+    while ((remaining = deadline - now_seconds()) > 0.0005) {
+        struct timespec ts;
+        remaining -= 0.0002;
+        ts.tv_sec = (time_t)remaining;
+        ts.tv_nsec = (long)((remaining - (double)ts.tv_sec) * 1e9);
+        nanosleep(&ts, NULL);
+    }
+    while (now_seconds() < deadline) {
+    }
+}
+#endif
+
+typedef struct {
+    frame_ring_t ring;
+    double stamp[FRAME_RING_MAX_SLOTS];  // Completion time per slot
+    unsigned char *frame;                // Synthetic JPEG copied into each slot
+    unsigned char *copy;                 // Consumer's display buffer
+    bench_event_t ready;
+    atomic32_t done;
+
+    int frames_to_send;
+    int overflow;
+    double render;
+    int mode;
+
+    double *latencies;
+    int shown;
+    int skipped;
+} bench_ctx_t;
+
+// Stands in for the read thread: one completed frame every 1/60 s
+static void producer_run(bench_ctx_t *ctx) {
+    double interval = 1.0 / FRAME_RATE;
+    double start = now_seconds();
+
+    for (int f = 0; f < ctx->frames_to_send; f++) {
+        sleep_until(start + f * interval);
+
+        frame_slot_t *slot = frame_ring_write_slot(&ctx->ring);
+        bool was_empty;
+        memcpy(slot->data, ctx->frame, FRAME_SIZE);
+        ctx->stamp[slot - ctx->ring.slots] = now_seconds();
+
+        if (frame_ring_publish(&ctx->ring, FRAME_SIZE, &was_empty) != FRAME_RING_PUBLISHED) {
+            ctx->overflow++;
+        } else if (was_empty) {
+            event_set(&ctx->ready);
+        }
+    }
+    atomic32_store_release(&ctx->done, 1);
+    event_set(&ctx->ready);
+}
+
+// Same skip as wait_for_frame does for CAMERA_READ_LATEST
+static frame_slot_t* next_frame(bench_ctx_t *ctx) {
+    if (ctx->mode == MODE_LATEST) {
+        while (frame_ring_queued(&ctx->ring) > 1) {
+            frame_ring_pop(&ctx->ring);
+            ctx->skipped++;
+        }
+    }
+    return frame_ring_peek(&ctx->ring);
+}
+
+// Preview loop: take a frame, note its age, spend render time on it
+static int consumer_read(bench_ctx_t *ctx) {
+    while (true) {
+        long finished = atomic32_load_acquire(&ctx->done);
+        frame_slot_t *slot = next_frame(ctx);
+        if (slot) {
+            double taken = now_seconds();
+            ctx->latencies[ctx->shown++] = taken - ctx->stamp[slot - ctx->ring.slots];
+            memcpy(ctx->copy, slot->data, slot->size);
+            frame_ring_pop(&ctx->ring);
+            sleep_until(taken + ctx->render);
+            return 1;
+        }
+        if (finished) {
+            return 0;
+        }
+        if (frame_ring_empty_before_wait(&ctx->ring)) {
+            event_wait(&ctx->ready);
+        }
+    }
+}
+
+static bench_ctx_t *g_ctx;
+
+#ifdef _WIN32
+static DWORD WINAPI consumer_thread(LPVOID param) {
+#else
+static void* consumer_thread(void *param) {
+#endif
+    (void)param;
+    while (consumer_read(g_ctx)) {
+    }
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, bench_ctx_t *ctx, int mode, int frame_buffers) {
+    bench_thread_t thread;
+
+    // Fresh ring for every run
+    frame_ring_init(&ctx->ring, frame_buffers);
+    for (int i = 0; i < frame_buffers; i++) {
+        ctx->ring.slots[i].data = (unsigned char*)malloc(FRAME_SIZE);
+        ctx->ring.slots[i].capacity = FRAME_SIZE;
+    }
+    ctx->mode = mode;
+    ctx->overflow = 0;
+    ctx->shown = 0;
+    ctx->skipped = 0;
+    atomic32_store_release(&ctx->done, 0);
+
+    g_ctx = ctx;
+#ifdef _WIN32
+    thread = CreateThread(NULL, 0, consumer_thread, NULL, 0, NULL);
+    producer_run(ctx);
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+#else
+    pthread_create(&thread, NULL, consumer_thread, NULL);
+    producer_run(ctx);
+    pthread_join(thread, NULL);
+#endif
+
+    qsort(ctx->latencies, ctx->shown, sizeof(double), compare_double);
+    if (ctx->shown > 0) {
+        int n = ctx->shown;
+        printf("  %-7s shown=%5d skipped=%5d overflow=%5d  p50=%7.1f ms  p99=%7.1f ms  max=%7.1f ms\n",
+               name, n, ctx->skipped, ctx->overflow,
+               ctx->latencies[n / 2] * 1e3,
+               ctx->latencies[(int)((n - 1) * 0.99)] * 1e3,
+               ctx->latencies[n - 1] * 1e3);
+    } else {
+        printf("  %-7s no frames delivered\n", name);
+    }
+
+    for (int i = 0; i < frame_buffers; i++) {
+        free(ctx->ring.slots[i].data);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    static bench_ctx_t ctx;
+    double seconds = 5.0;
+    double render_ms = 25.0;
+    int frame_buffers = FRAME_RING_DEFAULT_SLOTS;
+
+    if (argc > 1) seconds = atof(argv[1]);
+    if (argc > 2) render_ms = atof(argv[2]);
+    if (argc > 3) frame_buffers = atoi(argv[3]);
+    if (seconds <= 0.0 || render_ms < 0.0 || frame_buffers < 2 || frame_buffers > FRAME_RING_MAX_SLOTS) {
+        fprintf(stderr, "Usage: bench_latest_frame [seconds] [render_ms] [frame_buffers (2-%d)]\n",
+                FRAME_RING_MAX_SLOTS);
+        return 1;
+    }
+
+    ctx.frames_to_send = (int)(seconds * FRAME_RATE);
+    ctx.render = render_ms / 1000.0;
+    ctx.latencies = (double*)malloc(ctx.frames_to_send * sizeof(double));
+    ctx.frame = (unsigned char*)calloc(1, FRAME_SIZE);
+    ctx.copy = (unsigned char*)malloc(FRAME_SIZE);
+    event_init(&ctx.ready);
+
+    printf("Latest-frame read benchmark (%d fps producer, %.1f ms render, %d frame buffers, %d frames)\n",
+           FRAME_RATE, render_ms, frame_buffers, ctx.frames_to_send);
+    printf("Latency = frame completion -> preview picks it up\n");
+    printf("=====================================================================\n");
+
+    run("fifo", &ctx, MODE_FIFO, frame_buffers);
+    run("latest", &ctx, MODE_LATEST, frame_buffers);
+
+    free(ctx.latencies);
+    free(ctx.frame);
+    free(ctx.copy);
+    return 0;
+}
@@ -0,0 +1,297 @@
+/**
+ * Parallel Decode Benchmark
+ *
+ * Streams synthetic camera frames through parallel_decoder.c - the decode
+ * threads behind camera_set_decode_threads - and reports, for 1 to 16
+ * worker threads:
+ *
+ *   - frames/s with the producer submitting as fast as the decoder takes
+ *     frames (CAMERA_DECODE_BLOCK), and the speed-up over one thread
+ *   - latency from submit to the consumer receiving the frame (median,
+ *     99th percentile)
+ *   - frames workers stole from each other's queues
+ *
+ * A second table paces the producer at 1.5x what one thread can decode
+ * and compares the backpressure policies on two threads.
+ *
+ * Every run checks that frames arrive in submit order; the benchmark
+ * fails if one does not.
+ *
+ * Usage: bench_parallel_decode [frames]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "parallel_decoder.h"
+#include "platform.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <jpeglib.h>
+
+#define SYNTH_FRAMES    8
+#define SYNTH_WIDTH     1280
+#define SYNTH_HEIGHT    720
+#define SYNTH_QUALITY   85
+#define HELD_FRAMES     4       // As CAMERA_MAX_DECODED_FRAMES
+#define DRAIN_WAIT_MS   500     // Consumer gives up this long after the producer finished
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+} jpeg_frame_t;
+
+static jpeg_frame_t g_frames[SYNTH_FRAMES];
+
+typedef struct {
+    parallel_decoder_t *pd;
+    volatile bool producer_done;
+    int received;
+    int out_of_order;
+    int failed;
+    unsigned long long *latency;    // Ticks, one per frame received
+} consumer_t;
+
+// Encode synthetic microscope-like frames with libjpeg, as bench_decode does
+static int make_synthetic_frames(void) {
+    unsigned char *rgb = (unsigned char*)malloc((size_t)SYNTH_WIDTH * SYNTH_HEIGHT * 3);
+    unsigned int seed = 1234;
+
+    if (!rgb) {
+        return 0;
+    }
+
+    for (int n = 0; n < SYNTH_FRAMES; n++) {
+        struct jpeg_compress_struct cinfo;
+        struct jpeg_error_mgr jerr;
+        unsigned char *out = NULL;
+        unsigned long out_size = 0;
+
+        for (int y = 0; y < SYNTH_HEIGHT; y++) {
+            for (int x = 0; x < SYNTH_WIDTH; x++) {
+                double dx = (x - SYNTH_WIDTH / 2) / (double)SYNTH_WIDTH;
+                double dy = (y - SYNTH_HEIGHT / 2) / (double)SYNTH_WIDTH;
+                double vignette = 1.0 - 1.6 * (dx * dx + dy * dy);
+                double cells = 0.5 + 0.5 * sin((x + n * 7) * 0.045) * cos((y - n * 5) * 0.05);
+                unsigned char *p = &rgb[((size_t)y * SYNTH_WIDTH + x) * 3];
+                int noise;
+
+                seed = seed * 1103515245u + 12345u;
+                noise = (int)((seed >> 16) % 13) - 6;
+                p[0] = (unsigned char)fmax(0.0, fmin(255.0, 200.0 * vignette - 60.0 * cells + noise));
+                p[1] = (unsigned char)fmax(0.0, fmin(255.0, 190.0 * vignette - 90.0 * cells + noise));
+                p[2] = (unsigned char)fmax(0.0, fmin(255.0, 210.0 * vignette - 30.0 * cells + noise));
+            }
+        }
+
+        cinfo.err = jpeg_std_error(&jerr);
+        jpeg_create_compress(&cinfo);
+        jpeg_mem_dest(&cinfo, &out, &out_size);
+        cinfo.image_width = SYNTH_WIDTH;
+        cinfo.image_height = SYNTH_HEIGHT;
+        cinfo.input_components = 3;
+        cinfo.in_color_space = JCS_RGB;
+        jpeg_set_defaults(&cinfo);  // YCbCr 4:2:0, like the camera
+        jpeg_set_quality(&cinfo, SYNTH_QUALITY, TRUE);
+        jpeg_start_compress(&cinfo, TRUE);
+        while (cinfo.next_scanline < cinfo.image_height) {
+            JSAMPROW row = &rgb[(size_t)cinfo.next_scanline * SYNTH_WIDTH * 3];
+            jpeg_write_scanlines(&cinfo, &row, 1);
+        }
+        jpeg_finish_compress(&cinfo);
+        jpeg_destroy_compress(&cinfo);
+
+        g_frames[n].data = (unsigned char*)malloc(out_size);
+        if (!g_frames[n].data) {
+            free(out);
+            free(rgb);
+            return 0;
+        }
+        memcpy(g_frames[n].data, out, out_size);
+        g_frames[n].size = out_size;
+        free(out);
+    }
+
+    free(rgb);
+    return 1;
+}
+
+static int compare_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Take frames in order until the producer is done and nothing more arrives
+static void consumer_proc(void *arg) {
+    consumer_t *c = (consumer_t*)arg;
+    long long last_sequence = -1;
+    decode_result_t result;
+
+    while (true) {
+        int ret = parallel_decoder_next(c->pd, DRAIN_WAIT_MS, &result);
+
+        if (ret == PARALLEL_DECODER_TIMEOUT) {
+            if (c->producer_done) {
+                break;
+            }
+            continue;
+        }
+        if (ret == PARALLEL_DECODER_FAILED) {
+            c->failed++;
+            continue;
+        }
+        if (ret != PARALLEL_DECODER_OK) {
+            break;
+        }
+
+        c->latency[c->received++] = platform_ticks() - result.timestamp;
+        if ((long long)result.sequence <= last_sequence) {
+            c->out_of_order++;
+        }
+        last_sequence = result.sequence;
+        parallel_decoder_release(c->pd, result.data);
+    }
+}
+
+// Stream `frames` frames; interval_ticks 0 submits as fast as accepted.
+// Returns frames/s at the consumer, or -1 on failure
+static double run(int threads, int policy, int frames, unsigned long long interval_ticks,
+                  unsigned long long *latency, parallel_decoder_stats_t *stats, int *received) {
+    consumer_t consumer;
+    platform_thread_t *thread;
+    unsigned long long start, next, elapsed;
+    double ticks_per_second = (double)platform_ticks_per_second();
+
+    memset(&consumer, 0, sizeof(consumer));
+    consumer.latency = latency;
+    consumer.pd = parallel_decoder_create(threads, threads * 2 + HELD_FRAMES, FRAME_DECODER_BGRA, policy);
+    if (!consumer.pd) {
+        fprintf(stderr, "Failed to start %d decode threads\n", threads);
+        return -1.0;
+    }
+
+    thread = platform_thread_create(consumer_proc, &consumer);
+    if (!thread) {
+        parallel_decoder_destroy(consumer.pd);
+        return -1.0;
+    }
+
+    start = next = platform_ticks();
+    for (int i = 0; i < frames; i++) {
+        const jpeg_frame_t *frame = &g_frames[i % SYNTH_FRAMES];
+
+        if (interval_ticks) {
+            while (platform_ticks() < next) {
+                platform_sleep_ms(0);
+            }
+            next += interval_ticks;
+        }
+        parallel_decoder_submit(consumer.pd, frame->data, frame->size, (unsigned int)i,
+                                platform_ticks(), PLATFORM_WAIT_INFINITE);
+    }
+    consumer.producer_done = true;
+
+    platform_thread_wait(thread, PLATFORM_WAIT_INFINITE);
+    platform_thread_close(thread);
+    elapsed = platform_ticks() - start;
+
+    parallel_decoder_get_stats(consumer.pd, stats);
+    parallel_decoder_destroy(consumer.pd);
+
+    if (consumer.out_of_order || consumer.failed) {
+        fprintf(stderr, "%d threads: %d frames out of order, %d failed\n",
+                threads, consumer.out_of_order, consumer.failed);
+        return -1.0;
+    }
+
+    // The consumer's final wait is not part of the stream
+    if (elapsed > (unsigned long long)(DRAIN_WAIT_MS * ticks_per_second / 1000.0)) {
+        elapsed -= (unsigned long long)(DRAIN_WAIT_MS * ticks_per_second / 1000.0);
+    }
+
+    *received = consumer.received;
+    qsort(latency, (size_t)consumer.received, sizeof(latency[0]), compare_ull);
+    return consumer.received / ((double)elapsed / ticks_per_second);
+}
+
+static double ticks_to_ms(unsigned long long ticks) {
+    return (double)ticks * 1000.0 / (double)platform_ticks_per_second();
+}
+
+int main(int argc, char *argv[]) {
+    static const int thread_counts[] = { 1, 2, 4, 8, 16 };
+    static const struct {
+        int policy;
+        const char *name;
+    } policies[] = {
+        { PARALLEL_DECODER_BLOCK, "block" },
+        { PARALLEL_DECODER_DROP_OLDEST, "drop oldest" },
+        { PARALLEL_DECODER_DROP_NEWEST, "drop newest" },
+    };
+    int frames = argc > 1 ? atoi(argv[1]) : 400;
+    unsigned long long *latency;
+    double single = 0.0;
+    size_t total = 0;
+
+    if (frames < 20) {
+        fprintf(stderr, "Usage: bench_parallel_decode [frames]\n");
+        return 1;
+    }
+    if (!make_synthetic_frames()) {
+        fprintf(stderr, "Failed to encode synthetic frames\n");
+        return 1;
+    }
+    latency = (unsigned long long*)calloc((size_t)frames, sizeof(unsigned long long));
+    if (!latency) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (int i = 0; i < SYNTH_FRAMES; i++) {
+        total += g_frames[i].size;
+    }
+
+    printf("Parallel decode benchmark (%d frames of %dx%d to BGRA, avg %.1f KiB)\n", frames,
+           SYNTH_WIDTH, SYNTH_HEIGHT, (double)total / SYNTH_FRAMES / 1024.0);
+    printf("=====================================================================\n");
+
+    for (size_t i = 0; i < sizeof(thread_counts) / sizeof(thread_counts[0]); i++) {
+        parallel_decoder_stats_t stats;
+        int received = 0;
+        double fps = run(thread_counts[i], PARALLEL_DECODER_BLOCK, frames, 0, latency, &stats, &received);
+
+        if (fps < 0.0) {
+            return 1;
+        }
+        if (thread_counts[i] == 1) {
+            single = fps;
+        }
+        printf("  %2d threads  %7.1f frames/s  speed-up %5.2fx  latency p50 %7.2f  p99 %7.2f ms  stolen %llu\n",
+               thread_counts[i], fps, fps / single, ticks_to_ms(latency[received / 2]),
+               ticks_to_ms(latency[received * 99 / 100]), stats.stolen);
+    }
+
+    printf("\nBackpressure, 2 threads, producer at %.0f frames/s (1.5x one thread)\n", single * 1.5);
+    printf("=====================================================================\n");
+
+    for (size_t i = 0; i < sizeof(policies) / sizeof(policies[0]); i++) {
+        parallel_decoder_stats_t stats;
+        int received = 0;
+        unsigned long long interval = (unsigned long long)((double)platform_ticks_per_second() / (single * 1.5));
+        double fps = run(2, policies[i].policy, frames, interval, latency, &stats, &received);
+
+        if (fps < 0.0) {
+            return 1;
+        }
+        printf("  %-12s %4d delivered  %4u dropped  %7.1f frames/s  latency p50 %7.2f  p99 %7.2f ms\n",
+               policies[i].name, received, stats.dropped, fps, ticks_to_ms(latency[received / 2]),
+               ticks_to_ms(latency[received * 99 / 100]));
+    }
+
+    free(latency);
+    return 0;
+}
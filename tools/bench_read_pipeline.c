@@ -0,0 +1,229 @@
+/**
+ * Read Pipeline Benchmark
+ *
+ * Drives read_pipeline.c against a simulated transport, so the effect of
+ * keeping several bulk reads in flight can be measured without hardware.
+ *
+ * The simulated bus serves one transfer at a time. A transfer completes
+ * no earlier than `turnaround` after it was submitted (host controller
+ * scheduling, the camera answering an IN token) and no earlier than
+ * `service` after the previous completion (bus time for one packet).
+ * After each completion the reader spends `process` busy on the data, as
+ * process_data does. With one read in flight the endpoint idles for
+ * turnaround + process per packet; with N in flight the turnaround of
+ * one read overlaps the processing of the others.
+ *
+ * Every packet carries a sequence number and the benchmark checks that
+ * packets come out of the pipeline in submission order.
+ *
+ * Usage: bench_read_pipeline [turnaround_us] [service_us] [process_us]
+ */
+
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include "read_pipeline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#define TRANSFER_SIZE   (64*1024)
+#define PACKET_BYTES    (1024 + 12)
+#define PACKET_COUNT    4000
+
+static double now_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER freq, counter;
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&counter);
+    return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void spin_until(double deadline) {
+    while (now_seconds() < deadline) {
+    }
+}
+
+// Simulated transport: completion times follow the model described above
+typedef struct {
+    usb_transport_t base;
+    double turnaround;
+    double service;
+    double last_completion;
+    unsigned int next_sequence;
+    struct {
+        unsigned char *buffer;
+        double completion;
+        unsigned int sequence;
+        int pending;
+        int aborted;
+    } reads[USB_TRANSPORT_MAX_READS];
+} fake_transport_t;
+
+static int fake_submit_read(usb_transport_t *transport, int slot,
+                            unsigned char *buffer, size_t length) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+    double earliest = now_seconds() + t->turnaround;
+    double next_free = t->last_completion + t->service;
+
+    if (length < PACKET_BYTES || t->reads[slot].pending) {
+        return USB_XFER_ERROR;
+    }
+
+    t->reads[slot].buffer = buffer;
+    t->reads[slot].completion = earliest > next_free ? earliest : next_free;
+    t->reads[slot].sequence = t->next_sequence++;
+    t->reads[slot].pending = 1;
+    t->reads[slot].aborted = 0;
+    t->last_completion = t->reads[slot].completion;
+    return USB_XFER_OK;
+}
+
+static int fake_wait_read(usb_transport_t *transport, int slot,
+                          unsigned int timeout_ms, size_t *bytes_read) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+    double deadline = now_seconds() + timeout_ms / 1000.0;
+
+    *bytes_read = 0;
+
+    if (!t->reads[slot].pending) {
+        return USB_XFER_ERROR;
+    }
+    if (!t->reads[slot].aborted) {
+        if (timeout_ms != USB_WAIT_INFINITE && t->reads[slot].completion > deadline) {
+            spin_until(deadline);
+            return USB_XFER_TIMEOUT;
+        }
+        spin_until(t->reads[slot].completion);
+    }
+
+    t->reads[slot].pending = 0;
+    if (t->reads[slot].aborted) {
+        return USB_XFER_ABORTED;
+    }
+
+    memset(t->reads[slot].buffer, 0, PACKET_BYTES);
+    memcpy(t->reads[slot].buffer, &t->reads[slot].sequence, sizeof(unsigned int));
+    *bytes_read = PACKET_BYTES;
+    return USB_XFER_OK;
+}
+
+static void fake_abort_reads(usb_transport_t *transport) {
+    fake_transport_t *t = (fake_transport_t*)transport;
+    for (int i = 0; i < USB_TRANSPORT_MAX_READS; i++) {
+        if (t->reads[i].pending) {
+            t->reads[i].aborted = 1;
+        }
+    }
+}
+
+// Only the read side is used by the pipeline
+static const usb_transport_ops_t fake_ops = {
+    .submit_read = fake_submit_read,
+    .wait_read   = fake_wait_read,
+    .abort_reads = fake_abort_reads,
+};
+
+static int run(int depth, double turnaround, double service, double process) {
+    fake_transport_t transport;
+    read_pipeline_t pipeline;
+    const unsigned char *data;
+    size_t length;
+    unsigned int expected = 0;
+    double start, elapsed;
+
+    memset(&transport, 0, sizeof(transport));
+    transport.base.ops = &fake_ops;
+    transport.turnaround = turnaround;
+    transport.service = service;
+
+    if (!read_pipeline_init(&pipeline, &transport.base, depth, TRANSFER_SIZE, depth)) {
+        fprintf(stderr, "Failed to initialize pipeline (depth %d)\n", depth);
+        return 0;
+    }
+
+    start = now_seconds();
+    transport.last_completion = start;
+    if (read_pipeline_start(&pipeline) != USB_XFER_OK) {
+        fprintf(stderr, "Failed to start pipeline\n");
+        read_pipeline_free(&pipeline);
+        return 0;
+    }
+
+    for (int n = 0; n < PACKET_COUNT; n++) {
+        unsigned int sequence;
+        if (read_pipeline_wait(&pipeline, 1000, &data, &length) != USB_XFER_OK || length != PACKET_BYTES) {
+            fprintf(stderr, "Read failed at packet %d\n", n);
+            read_pipeline_stop(&pipeline);
+            read_pipeline_free(&pipeline);
+            return 0;
+        }
+        memcpy(&sequence, data, sizeof(sequence));
+        if (sequence != expected++) {
+            fprintf(stderr, "OUT OF ORDER: expected packet %u, got %u\n", expected - 1, sequence);
+            read_pipeline_stop(&pipeline);
+            read_pipeline_free(&pipeline);
+            return 0;
+        }
+
+        // Stand-in for process_data
+        spin_until(now_seconds() + process);
+
+        read_pipeline_requeue(&pipeline);
+    }
+
+    elapsed = now_seconds() - start;
+    read_pipeline_stop(&pipeline);
+    read_pipeline_free(&pipeline);
+
+    double period = elapsed / PACKET_COUNT;
+    double bound = (turnaround + process) / depth;
+    if (bound < service) bound = service;
+    printf("  depth %2d  %8.0f packets/s  %6.2f MB/s  %7.1f us/packet  (model %7.1f us)\n",
+           depth, PACKET_COUNT / elapsed,
+           (double)PACKET_COUNT * PACKET_BYTES / elapsed / (1024.0 * 1024.0),
+           period * 1e6, bound * 1e6);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    static const int depths[] = { 1, 2, 4, 6, 8, 16 };
+    double turnaround_us = 500.0;
+    double service_us = 125.0;
+    double process_us = 100.0;
+
+    if (argc > 1) turnaround_us = atof(argv[1]);
+    if (argc > 2) service_us = atof(argv[2]);
+    if (argc > 3) process_us = atof(argv[3]);
+    if (turnaround_us < 0.0 || service_us <= 0.0 || process_us < 0.0) {
+        fprintf(stderr, "Usage: bench_read_pipeline [turnaround_us] [service_us] [process_us]\n");
+        return 1;
+    }
+
+    printf("Read pipeline benchmark (simulated transport, %d packets of %d bytes)\n",
+           PACKET_COUNT, PACKET_BYTES);
+    printf("turnaround=%.0f us  service=%.0f us  process=%.0f us\n",
+           turnaround_us, service_us, process_us);
+    printf("=====================================================================\n");
+
+    for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]); i++) {
+        if (!run(depths[i], turnaround_us * 1e-6, service_us * 1e-6, process_us * 1e-6)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
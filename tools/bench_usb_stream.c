@@ -0,0 +1,183 @@
+/**
+ * libusb Streaming Benchmark
+ *
+ * Reads from the simulated camera of the fake libusb (tests/fake_libusb)
+ * through the real libusb transport and read pipeline, comparing the two
+ * ways the transport can keep bulk reads in flight:
+ *
+ *   read thread   the read thread handles libusb events in wait_read and
+ *                 resubmits each transfer after processing its packet
+ *   event thread  a dedicated event thread resubmits each transfer from
+ *                 its completion callback with a fresh pool buffer, and
+ *                 queues the completed buffer to the read thread
+ *
+ * The simulated bus spends `service` on each packet while a transfer is
+ * queued and idles otherwise; the reader spends `process` busy on each
+ * packet, as process_data does. Reported per run: sustained MB/s, and the
+ * latency from a packet finishing on the bus to the read thread picking
+ * its buffer up (median, 99th percentile, maximum).
+ *
+ * Usage: bench_usb_stream [service_us] [process_us] [packets]
+ */
+
+#include "libusb_transport.h"
+#include "read_pipeline.h"
+#include "platform.h"
+#include "fake_device.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRANSFER_SIZE   (64*1024)
+#define SPARE_BUFFERS   32
+#define INTERFACE_NUM   1
+#define EP_IN           0x81
+#define EP_OUT          0x01
+
+static const unsigned char connect_cmd[] = { 0xBB, 0xAA, 0x05, 0x00, 0x00 };
+
+static void spin_for(unsigned long long ticks) {
+    unsigned long long end = platform_ticks() + ticks;
+    while (platform_ticks() < end) {
+    }
+}
+
+static int compare_ull(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+static int run(bool streaming, int depth, double process_us, int packets,
+               unsigned long long *finished, unsigned long long *latency) {
+    static usb_transport_ops_t slot_ops;
+    usb_transport_t *transport;
+    read_pipeline_t pipeline;
+    const unsigned char *data;
+    size_t length;
+    unsigned long long frequency = platform_ticks_per_second();
+    unsigned long long process = (unsigned long long)(process_us * 1e-6 * (double)frequency);
+    unsigned long long start, elapsed, bytes = 0;
+    int received = 0;
+
+    transport = libusb_transport_create(INTERFACE_NUM, EP_IN, EP_OUT);
+    if (!transport) {
+        fprintf(stderr, "Failed to create transport\n");
+        return 0;
+    }
+
+    // Without the stream operations the pipeline falls back to its slots
+    if (!streaming) {
+        slot_ops = *transport->ops;
+        slot_ops.start_stream = NULL;
+        slot_ops.wait_stream = NULL;
+        slot_ops.stop_stream = NULL;
+        transport->ops = &slot_ops;
+    }
+
+    if (transport->ops->open(transport, "001:004") != USB_XFER_OK ||
+        transport->ops->start_streaming(transport) != USB_XFER_OK ||
+        !read_pipeline_init(&pipeline, transport, depth, TRANSFER_SIZE, depth + SPARE_BUFFERS)) {
+        fprintf(stderr, "Failed to open the simulated camera: %s\n", transport->error);
+        transport->ops->close(transport);
+        return 0;
+    }
+
+    fake_device_trace_completions(finished, (size_t)packets);
+    transport->ops->write_command(transport, connect_cmd, sizeof(connect_cmd));
+
+    start = platform_ticks();
+    if (read_pipeline_start(&pipeline) != USB_XFER_OK) {
+        fprintf(stderr, "Failed to start reads: %s\n", transport->error);
+        read_pipeline_free(&pipeline);
+        transport->ops->close(transport);
+        return 0;
+    }
+
+    while (received < packets) {
+        int result = read_pipeline_wait(&pipeline, 1000, &data, &length);
+        unsigned long long picked_up = platform_ticks();
+
+        if (result != USB_XFER_OK) {
+            fprintf(stderr, "Read failed at packet %d (%d): %s\n", received, result, transport->error);
+            break;
+        }
+
+        // Device-side timeouts come back empty in read thread mode
+        if (length > 0) {
+            latency[received] = (picked_up - finished[received]) * 1000000000ULL / frequency;
+            bytes += length;
+            received++;
+
+            // Stand-in for process_data
+            spin_for(process);
+        }
+
+        if (read_pipeline_requeue(&pipeline) != USB_XFER_OK) {
+            fprintf(stderr, "Resubmit failed at packet %d: %s\n", received, transport->error);
+            break;
+        }
+    }
+
+    elapsed = platform_ticks() - start;
+    read_pipeline_stop(&pipeline);
+    read_pipeline_free(&pipeline);
+    transport->ops->close(transport);
+    fake_device_trace_completions(NULL, 0);
+
+    if (received < packets) {
+        return 0;
+    }
+
+    double seconds = (double)elapsed / (double)frequency;
+    qsort(latency, (size_t)packets, sizeof(latency[0]), compare_ull);
+    printf("  %-12s depth %2d  %7.2f MB/s  %7.0f packets/s  latency p50 %7.1f  p99 %7.1f  max %8.1f us\n",
+           streaming ? "event thread" : "read thread", depth,
+           (double)bytes / seconds / (1024.0 * 1024.0), packets / seconds,
+           latency[packets / 2] / 1000.0, latency[packets * 99 / 100] / 1000.0,
+           latency[packets - 1] / 1000.0);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    static const int depths[] = { 1, 2, 4, 8, 16 };
+    double service_us = 100.0;
+    double process_us = 60.0;
+    int packets = 5000;
+    unsigned long long *finished, *latency;
+    int ok = 1;
+
+    if (argc > 1) service_us = atof(argv[1]);
+    if (argc > 2) process_us = atof(argv[2]);
+    if (argc > 3) packets = atoi(argv[3]);
+    if (service_us < 0.0 || process_us < 0.0 || packets < 100) {
+        fprintf(stderr, "Usage: bench_usb_stream [service_us] [process_us] [packets]\n");
+        return 1;
+    }
+
+    finished = (unsigned long long*)calloc((size_t)packets, sizeof(unsigned long long));
+    latency = (unsigned long long*)calloc((size_t)packets, sizeof(unsigned long long));
+    if (!finished || !latency) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    fake_device_set_packet_interval((unsigned int)service_us);
+
+    printf("libusb streaming benchmark (fake libusb, %d packets of up to %d bytes)\n",
+           packets, FAKE_DEVICE_PAYLOAD + 12);
+    printf("service=%.0f us  process=%.0f us  (bus limit %.2f MB/s)\n", service_us, process_us,
+           service_us > 0.0 ? (FAKE_DEVICE_PAYLOAD + 12) / service_us * 1e6 / (1024.0 * 1024.0) : 0.0);
+    printf("=====================================================================\n");
+
+    for (int streaming = 0; streaming <= 1 && ok; streaming++) {
+        for (size_t i = 0; i < sizeof(depths) / sizeof(depths[0]) && ok; i++) {
+            ok = run(streaming != 0, depths[i], process_us, packets, finished, latency);
+        }
+    }
+
+    free(finished);
+    free(latency);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,232 @@
+/**
+ * Capture Statistics
+ *
+ * Summarizes a packet capture written by camera_start_recording or
+ * USEEPLUS_RECORD: packet count and sizes, malformed packets, how many
+ * frames the frame assembler recovers from it and the gaps between them.
+ * Frame times are the arrival times of the packets that completed them.
+ *
+ * Packet headers are run through the same consistency check as in the
+ * driver (see packet_header.h): whether their frame and packet counters
+ * hold up over the capture, and the loss they show if they do. This is
+ * how the header layout is checked against recordings of new cameras.
+ *
+ * Frames are assembled with the driver's default size limit (1 MiB) unless
+ * another one is given.
+ *
+ * Usage: capture_stats <capture_file> [max_frame_kib]
+ */
+
+#include "capture_file.h"
+#include "frame_assembler.h"
+#include "frame_pool.h"
+#include "packet_header.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_MAX_FRAME_SIZE (1024*1024)  // CAMERA_DEFAULT_MAX_FRAME_SIZE
+
+typedef struct {
+    unsigned long long *items;
+    size_t count;
+    size_t capacity;
+} u64_array_t;
+
+static int push_u64(u64_array_t *a, unsigned long long value) {
+    if (a->count == a->capacity) {
+        size_t capacity = a->capacity ? a->capacity * 2 : 1024;
+        unsigned long long *items = (unsigned long long*)realloc(a->items, capacity * sizeof(*items));
+        if (!items) return 0;
+        a->items = items;
+        a->capacity = capacity;
+    }
+    a->items[a->count++] = value;
+    return 1;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    unsigned long long x = *(const unsigned long long*)a;
+    unsigned long long y = *(const unsigned long long*)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentile(const unsigned long long *sorted, size_t count, double p) {
+    size_t index = (size_t)(p * (double)(count - 1) + 0.5);
+    return (double)sorted[index];
+}
+
+int main(int argc, char *argv[]) {
+    capture_reader_t reader;
+    capture_record_t record;
+    frame_assembler_t assembler;
+    frame_pool_t pool;
+    packet_stream_t stream;
+    packet_header_t header;
+    size_t trusted_at = 0;
+    unsigned char *packet = (unsigned char*)malloc(CAPTURE_MAX_RECORD);
+    unsigned char *frames[2];
+    size_t capacities[2];
+    int current = 0;
+    int result;
+    size_t max_frame_size = DEFAULT_MAX_FRAME_SIZE;
+
+    size_t packets = 0, empty_packets = 0, bad_headers = 0, discarded = 0;
+    unsigned long long bytes = 0;
+    size_t min_packet = (size_t)-1, max_packet = 0;
+    unsigned long long first_us = 0, last_us = 0, max_packet_gap_us = 0;
+    size_t min_frame = (size_t)-1, max_frame = 0;
+    unsigned long long frame_bytes = 0;
+    u64_array_t frame_times = { NULL, 0, 0 };
+
+    if (argc > 2) {
+        max_frame_size = (size_t)atoi(argv[2]) * 1024;
+    }
+    if (argc < 2 || argc > 3 || max_frame_size < 4096 || max_frame_size > FRAME_POOL_MAX_SIZE) {
+        fprintf(stderr, "Usage: capture_stats <capture_file> [max_frame_kib (4-%d)]\n",
+                FRAME_POOL_MAX_SIZE / 1024);
+        return 1;
+    }
+
+    frame_pool_init(&pool);
+    frames[0] = frame_pool_get(&pool, FRAME_POOL_MIN_SIZE, &capacities[0]);
+    frames[1] = frame_pool_get(&pool, FRAME_POOL_MIN_SIZE, &capacities[1]);
+    if (!packet || !frames[0] || !frames[1]) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    if (!capture_reader_open(&reader, argv[1])) {
+        fprintf(stderr, "%s: not a capture file\n", argv[1]);
+        return 1;
+    }
+
+    packet_stream_init(&stream);
+    frame_assembler_init(&assembler, max_frame_size);
+    frame_assembler_attach(&assembler, frames[current], capacities[current]);
+
+    while ((result = capture_reader_next(&reader, &record, packet, CAPTURE_MAX_RECORD)) == CAPTURE_RECORD) {
+        if (packets == 0) {
+            first_us = record.timestamp_us;
+        } else if (record.timestamp_us > last_us && record.timestamp_us - last_us > max_packet_gap_us) {
+            max_packet_gap_us = record.timestamp_us - last_us;
+        }
+        last_us = record.timestamp_us;
+
+        packets++;
+        bytes += record.length;
+        if (record.length < min_packet) min_packet = record.length;
+        if (record.length > max_packet) max_packet = record.length;
+        if (record.length == 0) {
+            empty_packets++;
+            continue;
+        }
+
+        if (packet_header_decode(packet, record.length, &header)) {
+            size_t payload = record.length - PACKET_HEADER_SIZE;
+            bool soi = payload >= 2 && packet[PACKET_HEADER_SIZE] == 0xFF && packet[PACKET_HEADER_SIZE + 1] == 0xD8;
+            packet_stream_check(&stream, &header, payload, soi);
+            if (stream.trusted && trusted_at == 0) {
+                trusted_at = packets;
+            }
+        }
+
+        // Same steps as process_data, ping-ponging between two buffers
+        size_t needed = frame_assembler_required_capacity(&assembler, packet, record.length);
+        if (needed > assembler.capacity && needed <= max_frame_size) {
+            size_t capacity;
+            unsigned char *larger = frame_pool_get(&pool, needed, &capacity);
+            if (larger) {
+                frame_assembler_relocate(&assembler, larger, capacity);
+                frame_pool_put(&pool, frames[current], capacities[current]);
+                frames[current] = larger;
+                capacities[current] = capacity;
+            }
+        }
+
+        int status = frame_assembler_push(&assembler, packet, record.length);
+        while (status == FRAME_ASM_COMPLETE) {
+            size_t size = assembler.complete_size;
+            frame_bytes += size;
+            if (size < min_frame) min_frame = size;
+            if (size > max_frame) max_frame = size;
+            if (!push_u64(&frame_times, record.timestamp_us)) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+
+            current ^= 1;
+            frame_assembler_handoff(&assembler, frames[current], capacities[current]);
+            status = frame_assembler_scan(&assembler);
+        }
+
+        if (status == FRAME_ASM_BAD_HEADER) {
+            bad_headers++;
+        } else if (status == FRAME_ASM_OVERFLOW || status == FRAME_ASM_TOO_LARGE) {
+            discarded++;
+        }
+    }
+
+    capture_reader_close(&reader);
+
+    double duration = (double)(last_us - first_us) / 1e6;
+
+    printf("Capture %s\n", argv[1]);
+    if (result == CAPTURE_CORRUPT) {
+        printf("  WARNING: truncated or corrupt after %zu packets\n", packets);
+    }
+    printf("  Duration      %.3f s\n", duration);
+    printf("  Packets       %zu (%zu empty), %.1f/s\n",
+           packets, empty_packets, duration > 0.0 ? packets / duration : 0.0);
+    if (packets > 0) {
+        printf("  Packet bytes  %llu total, min %zu / avg %.0f / max %zu\n",
+               bytes, min_packet, (double)bytes / packets, max_packet);
+        printf("  Max gap       %.3f ms between packets\n", max_packet_gap_us / 1000.0);
+    }
+    printf("  Bad headers   %zu packets\n", bad_headers);
+    if (trusted_at > 0) {
+        printf("  Header layout consistent from packet %zu, %s at end, %u resyncs\n",
+               trusted_at, stream.trusted ? "still consistent" : "inconsistent", stream.resyncs);
+        printf("  Header loss   %u packets, %u whole frames\n", stream.lost_packets, stream.lost_frames);
+    } else {
+        printf("  Header layout never consistent, loss detection unavailable\n");
+    }
+    printf("  Oversize      %zu partial frames discarded (limit %zu KiB)\n", discarded, max_frame_size / 1024);
+    printf("  Frames        %zu", frame_times.count);
+    if (frame_times.count > 0) {
+        printf(", min %zu / avg %.0f / max %zu bytes", min_frame,
+               (double)frame_bytes / frame_times.count, max_frame);
+    }
+    printf("\n");
+
+    if (frame_times.count > 1) {
+        size_t gaps = frame_times.count - 1;
+        unsigned long long *sorted = (unsigned long long*)malloc(gaps * sizeof(*sorted));
+        unsigned long long span = frame_times.items[gaps] - frame_times.items[0];
+
+        if (!sorted) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+        for (size_t i = 0; i < gaps; i++) {
+            sorted[i] = frame_times.items[i + 1] - frame_times.items[i];
+        }
+        qsort(sorted, gaps, sizeof(*sorted), compare_u64);
+
+        printf("  Frame rate    %.2f fps\n", span > 0 ? gaps * 1e6 / (double)span : 0.0);
+        printf("  Frame gaps    min %.2f / avg %.2f / p50 %.2f / p99 %.2f / max %.2f ms\n",
+               sorted[0] / 1000.0, (double)span / gaps / 1000.0,
+               percentile(sorted, gaps, 0.50) / 1000.0,
+               percentile(sorted, gaps, 0.99) / 1000.0,
+               sorted[gaps - 1] / 1000.0);
+        free(sorted);
+    }
+
+    free(frame_times.items);
+    frame_pool_put(&pool, frames[0], capacities[0]);
+    frame_pool_put(&pool, frames[1], capacities[1]);
+    frame_pool_free(&pool);
+    free(packet);
+    return result == CAPTURE_CORRUPT ? 2 : 0;
+}
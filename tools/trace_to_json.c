@@ -0,0 +1,197 @@
+/**
+ * Trace to Chrome JSON
+ *
+ * Converts a pipeline trace written by camera_start_trace or
+ * USEEPLUS_TRACE into Chrome trace-event JSON, which chrome://tracing and
+ * ui.perfetto.dev open directly:
+ *
+ *   - USB read thread: one slice per bulk read wait, packet and frame
+ *     boundary markers
+ *   - Consumer: a marker for every frame handed to the application
+ *   - Per frame (async tracks keyed by frame id): "assembly" from the
+ *     packet with SOI to EOI, "queued" from publish to consumption
+ *   - Counter: frames waiting in the ring
+ *   - Drops: global markers naming the reason
+ *
+ * Usage: trace_to_json <trace_file> [output.json]
+ */
+
+#include "trace_file.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define PID 1
+
+static FILE *g_out;
+static int g_first = 1;
+
+static void begin_event(void) {
+    fprintf(g_out, g_first ? "\n  " : ",\n  ");
+    g_first = 0;
+}
+
+// Trace timestamps are microseconds
+static double to_us(unsigned long long ns) {
+    return (double)ns / 1000.0;
+}
+
+static int tid_of(const trace_event_t *e) {
+    return e->source == TRACE_SOURCE_CONSUMER ? 2 : 1;
+}
+
+static void instant(const trace_event_t *e, const char *name, const char *scope,
+                    const char *arg_name, unsigned int arg) {
+    begin_event();
+    fprintf(g_out, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,"
+            "\"args\":{\"frame\":%u,\"%s\":%u}}",
+            name, scope, to_us(e->time_ns), PID, tid_of(e), e->frame, arg_name, arg);
+}
+
+static void async_edge(const trace_event_t *e, const char *name, char phase) {
+    begin_event();
+    fprintf(g_out, "{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"%c\",\"id\":%u,\"ts\":%.3f,\"pid\":%d,\"tid\":%d}",
+            name, phase, e->frame, to_us(e->time_ns), PID, tid_of(e));
+}
+
+static void counter(const trace_event_t *e, int queued) {
+    begin_event();
+    fprintf(g_out, "{\"name\":\"queued frames\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":%d,\"args\":{\"frames\":%d}}",
+            to_us(e->time_ns), PID, queued);
+}
+
+static void thread_name(int tid, const char *name) {
+    begin_event();
+    fprintf(g_out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+            PID, tid, name);
+}
+
+static const char* drop_name(unsigned int reason) {
+    switch (reason) {
+        case TRACE_DROP_OVERFLOW:  return "drop: buffers full";
+        case TRACE_DROP_OVERSIZE:  return "drop: oversize";
+        case TRACE_DROP_DISCARDED: return "drop: incomplete";
+        case TRACE_DROP_SKIPPED:   return "drop: skipped for newer";
+        default:                   return "drop";
+    }
+}
+
+int main(int argc, char *argv[]) {
+    trace_reader_t reader;
+    trace_event_t e;
+    int result;
+    unsigned long long read_begin = 0;
+    int read_pending = 0;
+    unsigned int assembling = 0;    // Frame with an open "assembly" span, 0 = none
+    int queued = 0;
+    size_t events = 0;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: trace_to_json <trace_file> [output.json]\n");
+        return 1;
+    }
+
+    if (!trace_reader_open(&reader, argv[1])) {
+        fprintf(stderr, "%s: not a trace file\n", argv[1]);
+        return 1;
+    }
+
+    g_out = argc > 2 ? fopen(argv[2], "w") : stdout;
+    if (!g_out) {
+        fprintf(stderr, "Cannot create %s\n", argv[2]);
+        trace_reader_close(&reader);
+        return 1;
+    }
+
+    fprintf(g_out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    thread_name(1, "USB read thread");
+    thread_name(2, "Consumer");
+
+    while ((result = trace_reader_next(&reader, &e)) == TRACE_RECORD) {
+        events++;
+
+        switch (e.type) {
+        case TRACE_EVENT_USB_READ_BEGIN:
+            read_begin = e.time_ns;
+            read_pending = 1;
+            break;
+
+        case TRACE_EVENT_USB_READ_END:
+            if (read_pending) {
+                begin_event();
+                fprintf(g_out, "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":1,"
+                        "\"args\":{\"bytes\":%u}}",
+                        e.value ? "usb read" : "usb read (timeout)",
+                        to_us(read_begin), to_us(e.time_ns - read_begin), PID, e.value);
+                read_pending = 0;
+            }
+            break;
+
+        case TRACE_EVENT_PACKET:
+            instant(&e, "packet", "t", "bytes", e.value);
+            break;
+
+        case TRACE_EVENT_SOI:
+            if (assembling) {
+                // Previous frame never completed and had no drop event
+                trace_event_t end = e;
+                end.frame = assembling;
+                async_edge(&end, "assembly", 'e');
+            }
+            instant(&e, "SOI", "t", "bytes", 0);
+            async_edge(&e, "assembly", 'b');
+            assembling = e.frame;
+            break;
+
+        case TRACE_EVENT_EOI:
+            instant(&e, "EOI", "t", "bytes", e.value);
+            if (assembling == e.frame) {
+                async_edge(&e, "assembly", 'e');
+                assembling = 0;
+            }
+            break;
+
+        case TRACE_EVENT_FRAME_PUBLISHED:
+            async_edge(&e, "queued", 'b');
+            counter(&e, ++queued);
+            break;
+
+        case TRACE_EVENT_FRAME_CONSUMED:
+            instant(&e, "frame consumed", "t", "bytes", e.value);
+            async_edge(&e, "queued", 'e');
+            if (queued > 0) queued--;
+            counter(&e, queued);
+            break;
+
+        case TRACE_EVENT_DROP:
+            instant(&e, drop_name(e.value), "g", "reason", e.value);
+            if (e.value == TRACE_DROP_SKIPPED) {
+                // Left the queue without being consumed
+                async_edge(&e, "queued", 'e');
+                if (queued > 0) queued--;
+                counter(&e, queued);
+            }
+            if (assembling == e.frame && e.value != TRACE_DROP_OVERFLOW) {
+                async_edge(&e, "assembly", 'e');
+                assembling = 0;
+            }
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    fprintf(g_out, "\n]}\n");
+    trace_reader_close(&reader);
+    if (g_out != stdout) {
+        fclose(g_out);
+    }
+
+    fprintf(stderr, "%zu events converted\n", events);
+    if (result == TRACE_CORRUPT) {
+        fprintf(stderr, "WARNING: trace truncated or corrupt after %zu events\n", events);
+        return 2;
+    }
+    return 0;
+}